@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "EncodedImageBufferPool.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+void PooledEncodedImageBuffer::Resize(size_t size)
+{
+    if (size > m_data.size())
+    {
+        m_data.resize(size);
+    }
+    m_size = size;
+}
+
+EncodedImageBufferPool::EncodedImageBufferPool(size_t maxBuffers)
+    : m_maxBuffers(maxBuffers)
+{
+}
+
+rtc::scoped_refptr<PooledEncodedImageBuffer> EncodedImageBufferPool::CreateBuffer(size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& buffer : m_buffers)
+    {
+        // Only the pool refers to the buffer, so nobody reads it any more.
+        if (buffer->HasOneRef())
+        {
+            m_hitCount++;
+            buffer->Resize(size);
+            return buffer;
+        }
+    }
+    m_missCount++;
+    rtc::scoped_refptr<PooledBuffer> buffer = new PooledBuffer();
+    buffer->Resize(size);
+    if (m_buffers.size() < m_maxBuffers)
+    {
+        m_buffers.push_back(buffer);
+    }
+    return buffer;
+}
+
+void EncodedImageBufferPool::Release()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers.remove_if([](const rtc::scoped_refptr<PooledBuffer>& buffer) { return buffer->HasOneRef(); });
+}
+
+size_t EncodedImageBufferPool::GetBufferCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_buffers.size();
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <vector>
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Encoded bitstream which the encoder writes once and WebRTC packetizes without copying it again.
+// The capacity only grows, so a reused buffer does not allocate memory unless the frame is larger than before.
+class PooledEncodedImageBuffer : public ::webrtc::EncodedImageBufferInterface
+{
+public:
+    const uint8_t* data() const override { return m_data.data(); }
+    uint8_t* data() override { return m_data.data(); }
+    size_t size() const override { return m_size; }
+    size_t capacity() const { return m_data.size(); }
+
+    void Resize(size_t size);
+
+private:
+    std::vector<uint8_t> m_data;
+    size_t m_size = 0;
+};
+
+// Recycles encoded bitstream buffers so that sending a frame does not allocate memory in the steady state.
+// A buffer returns to the pool when the last reference outside of the pool is released,
+// which happens once WebRTC has packetized the encoded image.
+class EncodedImageBufferPool {
+public:
+    explicit EncodedImageBufferPool(size_t maxBuffers = 4);
+
+    // Returns a free buffer resized to the size, or allocates one.
+    // When every pooled buffer is in use, the returned buffer is not kept by the pool.
+    rtc::scoped_refptr<PooledEncodedImageBuffer> CreateBuffer(size_t size);
+    // Frees the buffers which are not in use.
+    void Release();
+
+    // A hit is a buffer reused from the pool, a miss is a new buffer.
+    uint64_t GetHitCount() const { return m_hitCount; }
+    uint64_t GetMissCount() const { return m_missCount; }
+    size_t GetBufferCount() const;
+
+private:
+    using PooledBuffer = rtc::RefCountedObject<PooledEncodedImageBuffer>;
+
+    const size_t m_maxBuffers;
+    mutable std::mutex m_mutex;
+    std::list<rtc::scoped_refptr<PooledBuffer>> m_buffers;
+    std::atomic<uint64_t> m_hitCount{ 0 };
+    std::atomic<uint64_t> m_missCount{ 0 };
+};
+
+} // end namespace webrtc
+} // end namespace unity
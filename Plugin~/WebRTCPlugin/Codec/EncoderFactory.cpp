@@ -16,6 +16,7 @@
 #endif
 
 #include "SoftwareCodec/SoftwareEncoder.h"
+#include "SimulcastEncoder.h"
 
 #include "NvCodec/NvEncoderCuda.h"
 
@@ -45,7 +46,8 @@ namespace webrtc
     }
 
     //Can throw exception. The caller is expected to catch it.
-    std::unique_ptr<IEncoder> EncoderFactory::Init(int width, int height, IGraphicsDevice* device, UnityEncoderType encoderType)
+    std::unique_ptr<IEncoder> EncoderFactory::Init(int width, int height, IGraphicsDevice* device, UnityEncoderType encoderType,
+        const ColorConversionOptions& options, uint32 bufferCount, int maxWidth, int maxHeight)
     {
         std::unique_ptr<IEncoder> encoder;
         const GraphicsDeviceType deviceType = device->GetDeviceType();
@@ -54,9 +56,9 @@ namespace webrtc
             case GRAPHICS_DEVICE_D3D11: {
                 if (encoderType == UnityEncoderType::UnityEncoderHardware)
                 {
-                    encoder = std::make_unique<NvEncoderD3D11>(width, height, device);
+                    encoder = std::make_unique<NvEncoderD3D11>(width, height, device, bufferCount);
                 } else {
-                    encoder = std::make_unique<SoftwareEncoder>(width, height, device);
+                    encoder = std::make_unique<SoftwareEncoder>(width, height, device, options, bufferCount);
                 }
                 break;
             }
@@ -65,36 +67,82 @@ namespace webrtc
             case GRAPHICS_DEVICE_D3D12: {
                 if (encoderType == UnityEncoderType::UnityEncoderHardware)
                 {
-                    encoder = std::make_unique<NvEncoderD3D12>(width, height, device);
+                    encoder = std::make_unique<NvEncoderD3D12>(width, height, device, bufferCount);
                 } else {
-                    encoder = std::make_unique<SoftwareEncoder>(width, height, device);
+                    encoder = std::make_unique<SoftwareEncoder>(width, height, device, options, bufferCount);
                 }
                 break;
             }
 #endif
 #if defined(SUPPORT_OPENGL_CORE)
             case GRAPHICS_DEVICE_OPENGL: {
-                encoder = std::make_unique<NvEncoderGL>(width, height, device);
+                if (encoderType == UnityEncoderType::UnityEncoderHardware)
+                {
+                    encoder = std::make_unique<NvEncoderGL>(width, height, device, bufferCount);
+                } else {
+                    encoder = std::make_unique<SoftwareEncoder>(width, height, device, options, bufferCount);
+                }
                 break;
             }
 #endif
 #if defined(SUPPORT_VULKAN)
             case GRAPHICS_DEVICE_VULKAN: {
-                encoder = std::make_unique<NvEncoderCuda>(width, height, device);
+                if (encoderType == UnityEncoderType::UnityEncoderHardware)
+                {
+                    encoder = std::make_unique<NvEncoderCuda>(width, height, device, bufferCount);
+                } else {
+                    encoder = std::make_unique<SoftwareEncoder>(width, height, device, options, bufferCount);
+                }
                 break;
             }
 #endif            
 #if defined(SUPPORT_METAL) && defined(SUPPORT_SOFTWARE_ENCODER)
             case GRAPHICS_DEVICE_METAL: {
-                encoder = std::make_unique<SoftwareEncoder>(width, height, device);
+                encoder = std::make_unique<SoftwareEncoder>(width, height, device, options, bufferCount);
                 break;
             }
 #endif            
+            case GRAPHICS_DEVICE_CPU: {
+                encoder = std::make_unique<SoftwareEncoder>(width, height, device, options, bufferCount);
+                break;
+            }
             default: {
                 throw std::invalid_argument("Invalid device to initialize NvEncoder");
                 break;
             }           
         }
+        encoder->SetMaxSize(maxWidth, maxHeight);
+        encoder->InitV();
+        return encoder;
+    }
+
+    std::unique_ptr<IEncoder> EncoderFactory::InitSimulcast(int width, int height,
+        const std::vector<float>& scaleResolutionDownBy, IGraphicsDevice* device, UnityEncoderType encoderType,
+        const ColorConversionOptions& options, uint32 bufferCount, int maxWidth, int maxHeight)
+    {
+        // The simulcast encoders are not resized, so they do not need a larger maximum size.
+        if (scaleResolutionDownBy.size() < 2 || encoderType != UnityEncoderType::UnityEncoderHardware)
+        {
+            return Init(width, height, device, encoderType, options, bufferCount, maxWidth, maxHeight);
+        }
+
+        std::vector<std::unique_ptr<IEncoder>> layers;
+        std::vector<bool> scaled;
+        for (const float scale : scaleResolutionDownBy)
+        {
+            if (scale <= 1.0f)
+            {
+                layers.push_back(Init(width, height, device, encoderType, options, bufferCount));
+                scaled.push_back(false);
+                continue;
+            }
+            // Hardware encoders need even sizes.
+            const int layerWidth = std::max(2, static_cast<int>(width / scale) & ~1);
+            const int layerHeight = std::max(2, static_cast<int>(height / scale) & ~1);
+            layers.push_back(Init(layerWidth, layerHeight, device, encoderType, options, bufferCount));
+            scaled.push_back(true);
+        }
+        std::unique_ptr<IEncoder> encoder = std::make_unique<SimulcastEncoder>(std::move(layers), std::move(scaled));
         encoder->InitV();
         return encoder;
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IEncoder.h"
+#include "GraphicsDevice/GraphicsUtility.h"
 
 namespace unity
 {
@@ -14,7 +15,18 @@ namespace webrtc
     public:
         static EncoderFactory& GetInstance();
         static bool GetHardwareEncoderSupport();
-        std::unique_ptr<IEncoder> Init(int width, int height, IGraphicsDevice* device, UnityEncoderType encoderType); //Can throw exception.
+        //Can throw exception. The options are used only by the software encoder.
+        //The buffer count is the depth of the ring of frames which the encoder holds.
+        //The encoder can be resized up to the max size, 0 keeps the initial size as the maximum.
+        std::unique_ptr<IEncoder> Init(int width, int height, IGraphicsDevice* device, UnityEncoderType encoderType,
+            const ColorConversionOptions& options = ColorConversionOptions(), uint32 bufferCount = bufferedFrameNum,
+            int maxWidth = 0, int maxHeight = 0);
+        //Can throw exception. Creates a hardware encoder for each simulcast layer, ordered as the simulcast streams.
+        //The software encoders are simulcast by WebRTC itself, so a single encoder is created for them.
+        std::unique_ptr<IEncoder> InitSimulcast(int width, int height, const std::vector<float>& scaleResolutionDownBy,
+            IGraphicsDevice* device, UnityEncoderType encoderType,
+            const ColorConversionOptions& options = ColorConversionOptions(), uint32 bufferCount = bufferedFrameNum,
+            int maxWidth = 0, int maxHeight = 0);
     private:
         EncoderFactory() = default;
         EncoderFactory(EncoderFactory const&) = delete;
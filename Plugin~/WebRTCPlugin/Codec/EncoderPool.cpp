@@ -0,0 +1,260 @@
+#include "pch.h"
+#include <tuple>
+#include "EncoderPool.h"
+#include "IEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+    bool EncoderPoolKey::operator<(const EncoderPoolKey& other) const
+    {
+        return std::tie(width, height, scaleResolutionDownBy, bufferCount, maxWidth, maxHeight, encoderType, device) <
+            std::tie(other.width, other.height, other.scaleResolutionDownBy, other.bufferCount, other.maxWidth,
+                other.maxHeight, other.encoderType, other.device);
+    }
+
+    // Measures the time until the first frame which the encoder captures.
+    // The frames may be captured on the retrieval thread of the encoder.
+    class EncoderPool::FirstFrameTimer : public sigslot::has_slots<>
+    {
+    public:
+        FirstFrameTimer(EncoderPool* pool, IEncoder* encoder, bool warm, Clock::time_point start)
+            : m_pool(pool), m_warm(warm), m_start(start)
+        {
+            encoder->CaptureFrame.connect(this, &FirstFrameTimer::OnFrame);
+        }
+
+    private:
+        void OnFrame(const webrtc::VideoFrame& frame)
+        {
+            // The slot stays connected, because disconnecting while the signal is emitted would deadlock.
+            if (m_recorded.exchange(true))
+                return;
+            m_pool->RecordTimeToFirstFrame(m_warm, Clock::now() - m_start);
+        }
+
+        EncoderPool* m_pool;
+        const bool m_warm;
+        const Clock::time_point m_start;
+        std::atomic<bool> m_recorded{ false };
+    };
+
+    EncoderPool& EncoderPool::GetInstance()
+    {
+        static EncoderPool pool;
+        return pool;
+    }
+
+    EncoderPool::EncoderPool(std::chrono::milliseconds timeToLive, size_t maxIdleEncoders)
+        : m_timeToLive(timeToLive)
+        , m_maxIdleEncoders(maxIdleEncoders)
+    {
+    }
+
+    EncoderPool::~EncoderPool()
+    {
+        Clear();
+        std::map<const IEncoder*, std::unique_ptr<FirstFrameTimer>> timers;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            timers.swap(m_timers);
+        }
+    }
+
+    std::unique_ptr<IEncoder> EncoderPool::Acquire(const EncoderPoolKey& key, const CreateEncoder& create)
+    {
+        const Clock::time_point start = Clock::now();
+        std::list<IdleEncoder> expired = TakeExpired(start);
+        std::unique_ptr<IEncoder> encoder;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // The most recently released encoder is reused first.
+            for (auto it = m_idleEncoders.rbegin(); it != m_idleEncoders.rend(); ++it)
+            {
+                if (key < it->key || it->key < key)
+                    continue;
+                encoder = std::move(it->encoder);
+                m_idleEncoders.erase(std::next(it).base());
+                m_hitCount++;
+                break;
+            }
+        }
+        // Frees the sessions of the expired encoders before a new one is opened.
+        expired.clear();
+
+        if (encoder != nullptr)
+        {
+            // The control of the previous track was detached, and the new track starts with a key frame.
+            encoder->ResetControl();
+            encoder->SetIdrFrame();
+            StartTimer(encoder.get(), true, start);
+            return encoder;
+        }
+
+        encoder = create();
+        if (encoder != nullptr &&
+            encoder->GetCodecInitializationResult() != CodecInitializationResult::Success && !IsEmpty())
+        {
+            // The idle encoders may hold every session which the driver allows.
+            encoder.reset();
+            Clear();
+            encoder = create();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_missCount++;
+        }
+        if (encoder != nullptr)
+        {
+            StartTimer(encoder.get(), false, start);
+        }
+        return encoder;
+    }
+
+    void EncoderPool::Release(const EncoderPoolKey& key, std::unique_ptr<IEncoder> encoder)
+    {
+        if (encoder == nullptr)
+            return;
+        StopTimer(encoder.get());
+
+        std::list<IdleEncoder> evicted;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_timeToLive.count() > 0 && m_maxIdleEncoders > 0 &&
+                key.encoderType == UnityEncoderHardware &&
+                encoder->GetCodecInitializationResult() == CodecInitializationResult::Success)
+            {
+                m_idleEncoders.push_back({ key, std::move(encoder), Clock::now() });
+                while (m_idleEncoders.size() > m_maxIdleEncoders)
+                {
+                    evicted.splice(evicted.end(), m_idleEncoders, m_idleEncoders.begin());
+                    m_evictionCount++;
+                }
+            }
+        }
+        // The encoders which are not kept are destroyed here, without holding the lock.
+    }
+
+    void EncoderPool::Evict(Clock::time_point now)
+    {
+        TakeExpired(now);
+    }
+
+    void EncoderPool::Clear()
+    {
+        std::list<IdleEncoder> idleEncoders;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            idleEncoders.swap(m_idleEncoders);
+        }
+        // The encoders are destroyed without holding the lock.
+    }
+
+    bool EncoderPool::IsEmpty() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_idleEncoders.empty();
+    }
+
+    std::chrono::milliseconds EncoderPool::GetTimeToLive() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_timeToLive;
+    }
+
+    void EncoderPool::SetTimeToLive(std::chrono::milliseconds timeToLive)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_timeToLive = std::max(std::chrono::milliseconds(0), timeToLive);
+    }
+
+    size_t EncoderPool::GetMaxIdleEncoders() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_maxIdleEncoders;
+    }
+
+    void EncoderPool::SetMaxIdleEncoders(size_t maxIdleEncoders)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_maxIdleEncoders = maxIdleEncoders;
+    }
+
+    EncoderPoolStats EncoderPool::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        EncoderPoolStats stats;
+        stats.idleEncoders = static_cast<uint32_t>(m_idleEncoders.size());
+        stats.hitCount = m_hitCount;
+        stats.missCount = m_missCount;
+        stats.evictionCount = m_evictionCount;
+        if (m_warmFirstFrames > 0)
+        {
+            stats.warmTimeToFirstFrameUs =
+                std::chrono::duration_cast<std::chrono::microseconds>(m_warmTimeToFirstFrame).count() /
+                static_cast<int64_t>(m_warmFirstFrames);
+        }
+        if (m_coldFirstFrames > 0)
+        {
+            stats.coldTimeToFirstFrameUs =
+                std::chrono::duration_cast<std::chrono::microseconds>(m_coldTimeToFirstFrame).count() /
+                static_cast<int64_t>(m_coldFirstFrames);
+        }
+        return stats;
+    }
+
+    void EncoderPool::StartTimer(IEncoder* encoder, bool warm, Clock::time_point start)
+    {
+        // Connecting and disconnecting lock the signal, which the frames of the encoder may hold while they wait
+        // for the lock of the pool, so the timers are created and destroyed outside of it.
+        auto timer = std::make_unique<FirstFrameTimer>(this, encoder, warm, start);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // The previous timer was disconnected when its encoder, which had the same address, was destroyed.
+        m_timers[encoder].swap(timer);
+    }
+
+    void EncoderPool::StopTimer(const IEncoder* encoder)
+    {
+        std::unique_ptr<FirstFrameTimer> timer;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_timers.find(encoder);
+            if (it == m_timers.end())
+                return;
+            timer = std::move(it->second);
+            m_timers.erase(it);
+        }
+    }
+
+    void EncoderPool::RecordTimeToFirstFrame(bool warm, Clock::duration elapsed)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (warm)
+        {
+            m_warmTimeToFirstFrame += elapsed;
+            m_warmFirstFrames++;
+        }
+        else
+        {
+            m_coldTimeToFirstFrame += elapsed;
+            m_coldFirstFrames++;
+        }
+    }
+
+    std::list<EncoderPool::IdleEncoder> EncoderPool::TakeExpired(Clock::time_point now)
+    {
+        std::list<IdleEncoder> expired;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // The encoders are ordered by the time they were released.
+        while (!m_idleEncoders.empty() && now - m_idleEncoders.front().releaseTime >= m_timeToLive)
+        {
+            expired.splice(expired.end(), m_idleEncoders, m_idleEncoders.begin());
+            m_evictionCount++;
+        }
+        return expired;
+    }
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace unity
+{
+namespace webrtc
+{
+
+    class IEncoder;
+    class IGraphicsDevice;
+
+    // What an idle encoder must match to be reused by a track.
+    struct EncoderPoolKey
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<float> scaleResolutionDownBy;
+        uint32 bufferCount = bufferedFrameNum;
+        int maxWidth = 0;
+        int maxHeight = 0;
+        UnityEncoderType encoderType = UnityEncoderHardware;
+        IGraphicsDevice* device = nullptr;
+
+        bool operator<(const EncoderPoolKey& other) const;
+    };
+
+    struct EncoderPoolStats
+    {
+        uint32_t idleEncoders = 0;
+        // A hit is an idle encoder reused by a track, a miss is a new encoder.
+        uint64_t hitCount = 0;
+        uint64_t missCount = 0;
+        // Idle encoders destroyed because their time to live elapsed or the pool was full.
+        uint64_t evictionCount = 0;
+        // Average time from acquiring the encoder to its first encoded frame, in microseconds.
+        // -1 until a frame has been encoded.
+        int64_t warmTimeToFirstFrameUs = -1;
+        int64_t coldTimeToFirstFrameUs = -1;
+    };
+
+    // Keeps the encoders of finalized tracks warm, so that a track which restarts with the same parameters
+    // does not pay for a new encoder session and new textures.
+    // You must call the methods other than the setters and GetStats on the rendering thread,
+    // because the encoders are created and destroyed there.
+    class EncoderPool
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using CreateEncoder = std::function<std::unique_ptr<IEncoder>()>;
+
+        static EncoderPool& GetInstance();
+
+        explicit EncoderPool(
+            std::chrono::milliseconds timeToLive = std::chrono::seconds(10), size_t maxIdleEncoders = 2);
+        ~EncoderPool();
+
+        // Returns an idle encoder of the key, or the encoder made by the function.
+        // The function can throw exception.
+        std::unique_ptr<IEncoder> Acquire(const EncoderPoolKey& key, const CreateEncoder& create);
+        // Keeps the encoder for the time to live. The encoder must be finalized before.
+        // Only the hardware encoders which succeeded to initialize are kept, the other ones are destroyed.
+        void Release(const EncoderPoolKey& key, std::unique_ptr<IEncoder> encoder);
+        // Destroys the encoders which have been idle for longer than the time to live.
+        void Evict(Clock::time_point now = Clock::now());
+        void Clear();
+        bool IsEmpty() const;
+
+        // 0 disables the pool.
+        std::chrono::milliseconds GetTimeToLive() const;
+        void SetTimeToLive(std::chrono::milliseconds timeToLive);
+        size_t GetMaxIdleEncoders() const;
+        void SetMaxIdleEncoders(size_t maxIdleEncoders);
+        EncoderPoolStats GetStats() const;
+
+    private:
+        class FirstFrameTimer;
+        struct IdleEncoder
+        {
+            EncoderPoolKey key;
+            std::unique_ptr<IEncoder> encoder;
+            Clock::time_point releaseTime;
+        };
+
+        void StartTimer(IEncoder* encoder, bool warm, Clock::time_point start);
+        void StopTimer(const IEncoder* encoder);
+        void RecordTimeToFirstFrame(bool warm, Clock::duration elapsed);
+        // Returns the encoders removed from the pool, to be destroyed without holding the lock.
+        std::list<IdleEncoder> TakeExpired(Clock::time_point now);
+
+        mutable std::mutex m_mutex;
+        std::chrono::milliseconds m_timeToLive;
+        size_t m_maxIdleEncoders;
+        // Ordered from the oldest released encoder.
+        std::list<IdleEncoder> m_idleEncoders;
+        std::map<const IEncoder*, std::unique_ptr<FirstFrameTimer>> m_timers;
+
+        uint64_t m_hitCount = 0;
+        uint64_t m_missCount = 0;
+        uint64_t m_evictionCount = 0;
+        Clock::duration m_warmTimeToFirstFrame{ 0 };
+        Clock::duration m_coldTimeToFirstFrame{ 0 };
+        uint64_t m_warmFirstFrames = 0;
+        uint64_t m_coldFirstFrames = 0;
+    };
+
+} // end namespace webrtc
+} // end namespace unity
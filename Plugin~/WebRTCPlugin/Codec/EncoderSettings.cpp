@@ -0,0 +1,88 @@
+#include "pch.h"
+#include <algorithm>
+#include "EncoderSettings.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+    static std::mutex s_defaultMutex;
+    static EncoderSettings s_defaultSettings;
+
+    EncoderSettings EncoderSettings::GetDefault()
+    {
+        std::lock_guard<std::mutex> lock(s_defaultMutex);
+        return s_defaultSettings;
+    }
+
+    void EncoderSettings::SetDefault(const EncoderSettings& settings)
+    {
+        std::lock_guard<std::mutex> lock(s_defaultMutex);
+        s_defaultSettings = settings;
+    }
+
+    bool EncoderSettings::Equals(const EncoderSettings& other) const
+    {
+        return rateControlMode == other.rateControlMode &&
+            minBitrate == other.minBitrate && maxBitrate == other.maxBitrate &&
+            minFramerate == other.minFramerate && maxFramerate == other.maxFramerate &&
+            minQP == other.minQP && maxQP == other.maxQP &&
+            intraRefreshPeriod == other.intraRefreshPeriod && intraRefreshCount == other.intraRefreshCount &&
+            enableAQ == other.enableAQ && maxNumRefFrames == other.maxNumRefFrames &&
+            infiniteGOP == other.infiniteGOP && sceneChangeDetection == other.sceneChangeDetection;
+    }
+
+    EncoderSettingsPublisher::EncoderSettingsPublisher(const EncoderSettings& settings)
+    {
+        Publish(settings);
+    }
+
+    void EncoderSettingsPublisher::Publish(const EncoderSettings& settings)
+    {
+        auto snapshot = std::make_unique<EncoderSettings>(settings);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        snapshot->version = ++m_version;
+        const EncoderSettings* current = snapshot.get();
+        m_snapshots.push_back(std::move(snapshot));
+        m_current.store(current);
+
+        // The reader announces a snapshot before it checks that the snapshot is still current, so the one which
+        // is announced after the store above is the new one.
+        const EncoderSettings* inUse = m_inUse.load();
+        m_snapshots.erase(
+            std::remove_if(m_snapshots.begin(), m_snapshots.end(),
+                [&](const std::unique_ptr<const EncoderSettings>& s) { return s.get() != current && s.get() != inUse; }),
+            m_snapshots.end());
+    }
+
+    EncoderSettings EncoderSettingsPublisher::Get() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return *m_current.load();
+    }
+
+    const EncoderSettings* EncoderSettingsPublisher::Read() const
+    {
+        const EncoderSettings* settings = m_current.load();
+        // The announced snapshot is not freed.
+        if (settings == m_inUse.load(std::memory_order_relaxed))
+            return settings;
+        while (true)
+        {
+            m_inUse.store(settings);
+            const EncoderSettings* current = m_current.load();
+            if (current == settings)
+                return settings;
+            settings = current;
+        }
+    }
+
+    size_t EncoderSettingsPublisher::GetSnapshotCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_snapshots.size();
+    }
+
+} // end namespace webrtc
+} // end namespace unity
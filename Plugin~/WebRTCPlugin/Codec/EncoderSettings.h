@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace unity
+{
+namespace webrtc
+{
+
+    // Parameters of the hardware encoder which the application sets for each track.
+    // 0 leaves the default of the driver, except for the QPs and the intra refresh which 0 disables.
+    struct EncoderSettings
+    {
+        // See NvEncoder::GetRateControlMode.
+        int rateControlMode = 0;
+        // The bitrate of the first frames, until WebRTC sets the rates.
+        int minBitrate = 500000;
+        // Only used by the variable bitrate modes.
+        int maxBitrate = 5000000;
+        int minFramerate = 10;
+        int maxFramerate = 0;
+        int minQP = 20;
+        int maxQP = 60;
+        int intraRefreshPeriod = 30;
+        int intraRefreshCount = 10;
+        bool enableAQ = true;
+        int maxNumRefFrames = 0;
+        bool infiniteGOP = false;
+        // Starts an IDR frame at each cut between scenes instead of every second, see SceneChangeDetector.
+        bool sceneChangeDetection = false;
+
+        // Increases with each snapshot published by an EncoderSettingsPublisher.
+        uint64_t version = 0;
+
+        // Whether the parameters are the same, regardless of the version.
+        bool Equals(const EncoderSettings& other) const;
+
+        // Used by the tracks which are created after the call.
+        static EncoderSettings GetDefault();
+        static void SetDefault(const EncoderSettings& settings);
+    };
+
+    // Publishes the settings of a track as immutable snapshots, so that the encoder reads them on the rendering
+    // or the encoder thread without a lock while the application changes them on another thread.
+    // Reading a snapshot which has not changed is a single atomic load. The reader announces the snapshot which it
+    // uses, and the publisher frees the other ones, so the reads must not be concurrent.
+    class EncoderSettingsPublisher
+    {
+    public:
+        explicit EncoderSettingsPublisher(const EncoderSettings& settings = EncoderSettings::GetDefault());
+
+        void Publish(const EncoderSettings& settings);
+        // The copy of the current settings, for changing some of them.
+        EncoderSettings Get() const;
+
+        // The snapshot stays valid until the next call.
+        const EncoderSettings* Read() const;
+
+        size_t GetSnapshotCount() const;
+
+    private:
+        mutable std::mutex m_mutex;
+        uint64_t m_version = 0;
+        // The current snapshot and the one which the reader may still use.
+        std::vector<std::unique_ptr<const EncoderSettings>> m_snapshots;
+        std::atomic<const EncoderSettings*> m_current{ nullptr };
+        mutable std::atomic<const EncoderSettings*> m_inUse{ nullptr };
+    };
+
+} // end namespace webrtc
+} // end namespace unity
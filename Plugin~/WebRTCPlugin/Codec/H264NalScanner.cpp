@@ -0,0 +1,196 @@
+#include "pch.h"
+#include "H264NalScanner.h"
+#include "GraphicsDevice/GraphicsUtility.h"
+
+#if defined(SUPPORT_SSE2)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(SUPPORT_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace
+{
+    // The QP is in the slice header, so the slice data does not have to be unescaped to read it.
+    // This covers the reference list modifications and the weight tables which may come before it.
+    const size_t kMaxSliceHeaderSize = 256;
+
+    inline void AddNalu(const uint8_t* data, size_t offset, std::vector<webrtc::H264::NaluIndex>* indices)
+    {
+        webrtc::H264::NaluIndex index = { offset, offset + 3, 0 };
+        // Four byte start code.
+        if (index.start_offset > 0 && data[index.start_offset - 1] == 0)
+            --index.start_offset;
+        if (!indices->empty())
+            indices->back().payload_size = index.start_offset - indices->back().payload_start_offset;
+        indices->push_back(index);
+    }
+
+#if defined(SUPPORT_SSE2)
+    inline int CountTrailingZeros(uint32_t value)
+    {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward(&index, value);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+#endif
+
+    // Searches the start codes which begin before the end, from the offset.
+    void FindStartCodes_C(const uint8_t* data, size_t offset, size_t end,
+        std::vector<webrtc::H264::NaluIndex>* indices)
+    {
+        size_t i = offset;
+        while (i < end)
+        {
+            if (data[i + 2] > 1)
+            {
+                i += 3;
+            }
+            else if (data[i + 2] == 1)
+            {
+                if (data[i + 1] == 0 && data[i] == 0)
+                    AddNalu(data, i, indices);
+                i += 3;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    // Returns the offset from which the remaining start codes have to be searched.
+    size_t FindStartCodes_SIMD(const uint8_t* data, size_t size, size_t end,
+        std::vector<webrtc::H264::NaluIndex>* indices)
+    {
+        size_t i = 0;
+#if defined(SUPPORT_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi8(1);
+        // Compares 16 candidate positions at once, reading 2 bytes past them.
+        for (; i + 18 <= size; i += 16)
+        {
+            const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+            const __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+            const __m128i match = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)), _mm_cmpeq_epi8(b2, one));
+            int mask = _mm_movemask_epi8(match);
+            while (mask != 0)
+            {
+                const size_t offset = i + CountTrailingZeros(static_cast<uint32_t>(mask));
+                if (offset < end)
+                    AddNalu(data, offset, indices);
+                mask &= mask - 1;
+            }
+        }
+#elif defined(SUPPORT_NEON)
+        const uint8x16_t one = vdupq_n_u8(1);
+        for (; i + 18 <= size; i += 16)
+        {
+            const uint8x16_t b0 = vld1q_u8(data + i);
+            const uint8x16_t b1 = vld1q_u8(data + i + 1);
+            const uint8x16_t b2 = vld1q_u8(data + i + 2);
+            // Zero where the start code begins.
+            const uint8x16_t diff = vorrq_u8(vorrq_u8(b0, b1), veorq_u8(b2, one));
+            if (vminvq_u8(diff) != 0)
+                continue;
+            for (size_t offset = i; offset < i + 16; offset++)
+            {
+                if (data[offset] == 0 && data[offset + 1] == 0 && data[offset + 2] == 1 && offset < end)
+                    AddNalu(data, offset, indices);
+            }
+        }
+#endif
+        return i;
+    }
+} // namespace
+
+void H264NalScanner::FindNaluIndices(const uint8_t* data, size_t size,
+    std::vector<webrtc::H264::NaluIndex>* indices, bool useSimd)
+{
+    indices->clear();
+    if (size < 3)
+        return;
+    const size_t end = size - 3;
+
+    size_t offset = 0;
+#if defined(SUPPORT_SSE2)
+    static const bool supported = GraphicsUtility::IsKernelSupported(ColorConversionKernel::SSE2);
+    if (useSimd && supported)
+        offset = FindStartCodes_SIMD(data, size, end, indices);
+#elif defined(SUPPORT_NEON)
+    if (useSimd)
+        offset = FindStartCodes_SIMD(data, size, end, indices);
+#endif
+    // The SIMD search has found the start codes which begin before the offset.
+    FindStartCodes_C(data, offset, end, indices);
+
+    if (!indices->empty())
+        indices->back().payload_size = size - indices->back().payload_start_offset;
+}
+
+bool H264NalScanner::Scan(const uint8_t* data, size_t size, webrtc::RTPFragmentationHeader* fragmentation)
+{
+    FindNaluIndices(data, size, &m_nalus);
+    m_keyFrame = false;
+
+    fragmentation->VerifyAndAllocateFragmentationHeader(m_nalus.size());
+    fragmentation->fragmentationVectorSize = static_cast<uint16_t>(m_nalus.size());
+
+    // Only the last slice sets the QP, but the parameter sets which come before it have to be parsed first.
+    const webrtc::H264::NaluIndex* pendingSlice = nullptr;
+    for (size_t i = 0; i < m_nalus.size(); i++)
+    {
+        const webrtc::H264::NaluIndex& nalu = m_nalus[i];
+        fragmentation->fragmentationOffset[i] = nalu.payload_start_offset;
+        fragmentation->fragmentationLength[i] = nalu.payload_size;
+        if (nalu.payload_size == 0)
+            continue;
+
+        const uint8_t* payload = data + nalu.payload_start_offset;
+        switch (webrtc::H264::ParseNaluType(payload[0]))
+        {
+        case webrtc::H264::kSps:
+        case webrtc::H264::kPps:
+            if (pendingSlice != nullptr)
+            {
+                m_parser.ParseSlice(data + pendingSlice->payload_start_offset,
+                    std::min(pendingSlice->payload_size, kMaxSliceHeaderSize));
+                pendingSlice = nullptr;
+            }
+            m_parser.ParseSlice(payload, nalu.payload_size);
+            break;
+        case webrtc::H264::kAud:
+        case webrtc::H264::kSei:
+            break;
+        case webrtc::H264::kIdr:
+            m_keyFrame = true;
+            pendingSlice = &nalu;
+            break;
+        default:
+            pendingSlice = &nalu;
+            break;
+        }
+    }
+    if (pendingSlice != nullptr)
+    {
+        m_parser.ParseSlice(data + pendingSlice->payload_start_offset,
+            std::min(pendingSlice->payload_size, kMaxSliceHeaderSize));
+    }
+    return !m_nalus.empty();
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+
+namespace unity
+{
+namespace webrtc
+{
+    namespace webrtc = ::webrtc;
+
+    // Finds the NAL units of an encoded H.264 frame, whether it is a key frame and the QP of its last slice
+    // in one pass over the bitstream, instead of searching the start codes again for each of them.
+    // The start codes are searched with SIMD where it is available.
+    class H264NalScanner
+    {
+    public:
+        // Scans the Annex B bitstream of a frame and fills the fragmentation header with its NAL units.
+        // Returns false when the bitstream has no NAL unit.
+        bool Scan(const uint8_t* data, size_t size, webrtc::RTPFragmentationHeader* fragmentation);
+
+        // Whether the last scanned frame has an IDR slice.
+        bool IsKeyFrame() const { return m_keyFrame; }
+        // Same as H264BitstreamParser::GetLastSliceQp. The parameter sets are kept across frames.
+        bool GetLastSliceQp(int* qp) const { return m_parser.GetLastSliceQp(qp); }
+        const std::vector<webrtc::H264::NaluIndex>& GetNaluIndices() const { return m_nalus; }
+
+        // Same result as webrtc::H264::FindNaluIndices, without allocating when the vector is large enough.
+        static void FindNaluIndices(const uint8_t* data, size_t size, std::vector<webrtc::H264::NaluIndex>* indices,
+            bool useSimd = true);
+
+    private:
+        class SliceParser : public webrtc::H264BitstreamParser
+        {
+        public:
+            using webrtc::H264BitstreamParser::ParseSlice;
+        };
+
+        SliceParser m_parser;
+        std::vector<webrtc::H264::NaluIndex> m_nalus;
+        bool m_keyFrame = false;
+    };
+
+} // end namespace webrtc
+} // end namespace unity
@@ -1,4 +1,6 @@
 #pragma once
+#include <memory>
+#include <mutex>
 
 namespace unity
 {
@@ -16,28 +18,137 @@ namespace webrtc
         EncoderInitializationFailed
     };
 
+    class IEncoder;
+    class EncoderSettingsPublisher;
+
+    // The bitrates of the frames which the encoder of a track sent, summed over the simulcast streams.
+    struct EncoderBitrateStats
+    {
+        // Set by the congestion controller.
+        uint32_t targetBitrate = 0;
+        // Set to the encoder, so that the frames it encodes reach the target.
+        uint32_t adjustedBitrate = 0;
+        // Measured over the frames of the last seconds, 0 until enough frames were sent.
+        uint32_t encodedBitrate = 0;
+        // encodedBitrate / targetBitrate - 1, negative when the encoder undershoots.
+        float overshoot = 0.0f;
+        uint64_t frameCount = 0;
+    };
+
+    // How the sinks of a track want a frame to be cropped and scaled, computed when the frame is captured.
+    // A scale size of 0 keeps the frame as it is.
+    struct FrameAdaptation
+    {
+        int cropX = 0;
+        int cropY = 0;
+        int cropWidth = 0;
+        int cropHeight = 0;
+        int scaleWidth = 0;
+        int scaleHeight = 0;
+    };
+
+    // Lets the webrtc::VideoEncoder which sends the frames of an IEncoder control its rates and key frames.
+    // The IEncoder detaches itself when it is destroyed, after which the calls do nothing.
+    class EncoderControl : public rtc::RefCountInterface
+    {
+    public:
+        explicit EncoderControl(IEncoder* encoder) : m_encoder(encoder) {}
+
+        inline void SetRates(uint32_t bitRate, int64_t frameRate);
+        inline void SetIdrFrame();
+        void Detach()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_encoder = nullptr;
+        }
+
+        // Reported by the webrtc::VideoEncoder after each frame.
+        void SetBitrateStats(const EncoderBitrateStats& stats)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bitrateStats = stats;
+        }
+        EncoderBitrateStats GetBitrateStats()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_bitrateStats;
+        }
+
+    private:
+        std::mutex m_mutex;
+        IEncoder* m_encoder;
+        EncoderBitrateStats m_bitrateStats;
+    };
+
     class IEncoder {
     public:
-        virtual ~IEncoder() {};        
+        IEncoder() : m_control(new rtc::RefCountedObject<EncoderControl>(this)) {}
+        virtual ~IEncoder() { m_control->Detach(); }
         virtual void InitV() = 0;   //Can throw exception. 
         virtual void SetRates(uint32_t bitRate, int64_t frameRate) = 0;
         virtual void UpdateSettings() = 0;
         virtual bool CopyBuffer(void* frame) = 0;
+        // Copies the whole frame scaled to the size of the encoder, for the lower simulcast layers.
+        virtual bool ScaleBuffer(void* frame) { return false; }
         virtual bool EncodeFrame() = 0;
         virtual bool IsSupported() const = 0;
         virtual void SetIdrFrame() = 0;
         virtual uint64 GetCurrentFrameCount() const = 0;
+
+        // Encoders which have more than one buffer can encode on the encoder thread of the track.
+        // The rendering thread copies each frame into one of the buffers, and the encoder thread encodes the buffer
+        // later, so EncodeFrameAt must not use the graphics device.
+        virtual uint32 GetBufferCount() const { return 0; }
+        virtual bool CopyBufferAt(void* frame, uint32 bufferIndex) { return false; }
+        virtual bool EncodeFrameAt(uint32 bufferIndex) { return false; }
+        // Applied to the frames copied into the buffer afterwards, CopyBuffer copies into the buffer 0.
+        // Only the software encoder adapts the frames. The hardware encoders, and the other encoders which capture
+        // encoded frames, ignore it and encode the whole frame at their own size.
+        virtual void SetAdaptation(uint32 bufferIndex, const FrameAdaptation& adaptation) {}
+        // Changes the size of the frames without creating the encoder again. The caller stops calling the other
+        // methods meanwhile. Returns false when the encoder cannot be resized, and it keeps its size then.
+        virtual bool Resize(int width, int height) { return false; }
+        // The largest size which Resize accepts, to be set before InitV. 0 keeps the initial size as the maximum.
+        virtual void SetMaxSize(int width, int height) {}
+        // Encoders which retrieve the encoded frames on their own thread capture them from that thread by default.
+        // When disabled, the frame is captured before EncodeFrame returns.
+        virtual void SetAsyncOutput(bool enabled) {}
+        // The settings of the track, which the encoder reads before each frame in UpdateSettings.
+        virtual void SetSettings(std::shared_ptr<EncoderSettingsPublisher> settings) {}
         sigslot::signal1<const webrtc::VideoFrame&> CaptureFrame;
 
-        // todo(kazuki): remove this virtual method after refactoring DummyVideoEncoder
-        virtual void SetEncoderId(const uint32_t id) { m_encoderId = id;  }
-        virtual uint32_t Id() const { return m_encoderId; }
+        // Attached to the frames which the encoder captures.
+        const rtc::scoped_refptr<EncoderControl>& GetControl() const { return m_control; }
+        // Stops the senders of the track from calling the encoder, before it is destroyed or released to the pool.
+        // Encoders whose frames carry the controls of other encoders detach those as well.
+        virtual void DetachControl() { m_control->Detach(); }
+        // Replaces the control detached from the previous track when the encoder is reused by another one.
+        virtual void ResetControl()
+        {
+            m_control->Detach();
+            m_control = new rtc::RefCountedObject<EncoderControl>(this);
+        }
 
         CodecInitializationResult GetCodecInitializationResult() const { return m_initializationResult; }
     protected:
         CodecInitializationResult m_initializationResult = CodecInitializationResult::NotInitialized;
-        uint32_t m_encoderId;
+    private:
+        rtc::scoped_refptr<EncoderControl> m_control;
     };
+
+    void EncoderControl::SetRates(uint32_t bitRate, int64_t frameRate)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_encoder != nullptr)
+            m_encoder->SetRates(bitRate, frameRate);
+    }
+
+    void EncoderControl::SetIdrFrame()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_encoder != nullptr)
+            m_encoder->SetIdrFrame();
+    }
     
 } // end namespace webrtc
 } // end namespace unity
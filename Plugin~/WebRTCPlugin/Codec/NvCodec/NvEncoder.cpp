@@ -1,11 +1,14 @@
 #include "pch.h"
 #include "NvEncoder.h"
 #include "Context.h"
+#include <algorithm>
 #include <cstring>
+#include "GraphicsDevice/GraphicsUtility.h"
 #include "GraphicsDevice/IGraphicsDevice.h"
-#include "HWSettings.h"
+#include "GraphicsDevice/ITexture2D.h"
 #include <iostream>
 #include "Debugger.h"
+#include "WebRTCMacros.h"
 #if _WIN32
 #else
 #include <dlfcn.h>
@@ -18,18 +21,25 @@ namespace unity
 
         static void* s_hModule = nullptr;
         static std::unique_ptr<NV_ENCODE_API_FUNCTION_LIST> pNvEncodeAPI;
+        static bool s_functionListOverridden = false;
+        // The largest QP of H.264, which the frames of a new scene may use so that they do not overflow the VBV.
+        static const int s_widenedMaxQP = 51;
 
         NvEncoder::NvEncoder(
             const NV_ENC_DEVICE_TYPE type,
             const NV_ENC_INPUT_RESOURCE_TYPE inputType,
             const NV_ENC_BUFFER_FORMAT bufferFormat,
-            const int width, const int height, IGraphicsDevice* device)
+            const int width, const int height, IGraphicsDevice* device, const uint32 bufferCount)
             : m_width(width)
             , m_height(height)
             , m_device(device)
             , m_deviceType(type)
             , m_inputType(inputType)
             , m_bufferFormat(bufferFormat)
+            , m_bufferCount(std::max(1u, std::min(bufferCount, maxEncoderBufferCount)))
+            , bufferedFrames(m_bufferCount)
+            , renderTextures(m_bufferCount, nullptr)
+            , m_settings(std::make_shared<EncoderSettingsPublisher>())
             , m_clock(webrtc::Clock::GetRealTimeClock())
         {
             LogPrint(StringFormat("width is %d, height is %d", width, height).c_str());
@@ -80,8 +90,9 @@ namespace unity
             nvEncInitializeParams.reportSliceOffsets = 0;
             nvEncInitializeParams.enableSubFrameWrite = 0;
             nvEncInitializeParams.encodeConfig = &nvEncConfig;
-            nvEncInitializeParams.maxEncodeWidth = 3840;
-            nvEncInitializeParams.maxEncodeHeight = 2160;
+            // The frames can be resized up to this size without a new session.
+            nvEncInitializeParams.maxEncodeWidth = std::max(m_maxWidth, m_width);
+            nvEncInitializeParams.maxEncodeHeight = std::max(m_maxHeight, m_height);
 #pragma endregion
 #pragma region get preset ocnfig and set it
             NV_ENC_PRESET_CONFIG presetConfig = { 0 };
@@ -137,52 +148,18 @@ namespace unity
 
             // [autr] begin...
 
-            HWSettings* hw = HWSettings::getPtr();
-            HWSettings& hw_ = *hw;
+            m_appliedSettings = *m_settings->Read();
+            const EncoderSettings& settings = m_appliedSettings;
 
-            // Set RCM
-
-            nvEncConfig.rcParams.rateControlMode = GetRateControlMode(hw->rateControlMode); // [autr] default CBR
-
-            // Set FPS
-
-            //m_frameRate = hw->minFramerate; // TODO: investigate why setting this causes more glitches
+            //m_frameRate = settings.minFramerate; // TODO: investigate why setting this causes more glitches
             nvEncInitializeParams.frameRateNum = m_frameRate;
 
-            // Optimise: infinite or FPS gop length
-
-            nvEncConfig.encodeCodecConfig.h264Config.idrPeriod = m_frameRate;
-            nvEncConfig.gopLength = (hw->infiniteGOP) ? NVENC_INFINITE_GOPLENGTH : m_frameRate; // NVENC_INFINITE_GOPLENGTH
-
-            // Error Recovery Settings: infra frame refreshing
-
-            if (hw->intraRefreshPeriod > 0 && hw->intraRefreshCount > 0) {
-
-                nvEncConfig.encodeCodecConfig.h264Config.enableIntraRefresh = true;
-                nvEncConfig.encodeCodecConfig.h264Config.intraRefreshPeriod = hw->intraRefreshPeriod;
-                nvEncConfig.encodeCodecConfig.h264Config.intraRefreshCnt = hw->intraRefreshCount;
-            }
-
             // Optimise: bitrates
 
-            if (hw->minBitrate > 0) nvEncConfig.rcParams.averageBitRate = hw->minBitrate; // used with CBR, VBR etc (will override Unity's default calculation)
-            if (hw->maxBitrate > 0) nvEncConfig.rcParams.maxBitRate = hw->maxBitrate; // VBR only
+            if (settings.minBitrate > 0) nvEncConfig.rcParams.averageBitRate = settings.minBitrate; // used with CBR, VBR etc (will override Unity's default calculation)
 
-            // Error Recovery Settings: adaptive quantization
-
-            if (hw->enableAQ) nvEncConfig.rcParams.enableAQ = true;
-            if (hw->maxNumRefFrames > 0) nvEncConfig.encodeCodecConfig.h264Config.maxNumRefFrames = hw->maxNumRefFrames;  // zero will use driver's default size
-
-            // Optimise: quantisation parameters
-
-            if (hw->minQP > 0) {
-                nvEncConfig.rcParams.enableMinQP = true;
-                nvEncConfig.rcParams.minQP.qpIntra = nvEncConfig.rcParams.minQP.qpInterP = nvEncConfig.rcParams.minQP.qpInterB = hw->minQP;
-            }
-            if (hw->maxQP > 0) {
-                nvEncConfig.rcParams.enableMaxQP = true;
-                nvEncConfig.rcParams.maxQP.qpIntra = nvEncConfig.rcParams.maxQP.qpInterP = nvEncConfig.rcParams.maxQP.qpInterB = hw->maxQP;
-            }
+            ApplySettings(settings);
+            m_targetBitrate = nvEncConfig.rcParams.averageBitRate;
 
             // Error Recovery Settings: long term reference
 
@@ -203,19 +180,33 @@ namespace unity
             int32 asyncMode = 0;
             errorCode = pNvEncodeAPI->nvEncGetEncodeCaps(pEncoderInterface, nvEncInitializeParams.encodeGUID, &capsParam, &asyncMode);
             checkf(NV_RESULT(errorCode), StringFormat("Failed to get NVEncoder capability params %d", errorCode).c_str());
-            nvEncInitializeParams.enableEncodeAsync = 0;
+#if defined(_WIN32)
+            // The completion events are Win32 events, the driver does not support the asynchronous mode elsewhere.
+            m_asyncEncode = asyncMode != 0;
+#endif
+            nvEncInitializeParams.enableEncodeAsync = m_asyncEncode ? 1 : 0;
 #pragma endregion
 #pragma region initialize hardware encoder session
             errorCode = pNvEncodeAPI->nvEncInitializeEncoder(pEncoderInterface, &nvEncInitializeParams);
             result = NV_RESULT(errorCode);
             checkf(result, StringFormat("Failed to initialize NVEncoder %d", errorCode).c_str());
+            if (!result)
+            {
+                pNvEncodeAPI->nvEncDestroyEncoder(pEncoderInterface);
+                pEncoderInterface = nullptr;
+                m_initializationResult = CodecInitializationResult::EncoderInitializationFailed;
+                return;
+            }
 #pragma endregion
             InitEncoderResources();
+            m_retrievalThread = std::thread(&NvEncoder::RunRetrievalThread, this);
             m_isNvEncoderSupported = true;
         }
 
         NvEncoder::~NvEncoder()
         {
+            // The submitted frames are retrieved before their buffers are released.
+            StopRetrievalThread();
             ReleaseEncoderResources();
             if (pEncoderInterface)
             {
@@ -225,8 +216,18 @@ namespace unity
             }
         }
 
+        void NvEncoder::OverrideFunctionList(const NV_ENCODE_API_FUNCTION_LIST* functionList)
+        {
+            s_functionListOverridden = functionList != nullptr;
+            pNvEncodeAPI = s_functionListOverridden ? std::make_unique<NV_ENCODE_API_FUNCTION_LIST>(*functionList) : nullptr;
+        }
+
         CodecInitializationResult NvEncoder::LoadCodec()
         {
+            if (s_functionListOverridden)
+            {
+                return CodecInitializationResult::Success;
+            }
             pNvEncodeAPI = std::make_unique<NV_ENCODE_API_FUNCTION_LIST>();
             pNvEncodeAPI->version = NV_ENCODE_API_FUNCTION_LIST_VER;
 
@@ -308,10 +309,106 @@ namespace unity
             }
         }
 
+        void NvEncoder::ApplySettings(const EncoderSettings& settings)
+        {
+            // Set RCM
+
+            nvEncConfig.rcParams.rateControlMode = GetRateControlMode(settings.rateControlMode); // [autr] default CBR
+
+            // Optimise: infinite or FPS gop length
+
+            // With the detection of the scene changes, the IDR frames start the scenes instead of following a timer.
+            // The timer is kept when the device can not detect them.
+            m_detectSceneChanges = settings.sceneChangeDetection && !m_sceneChangeUnsupported;
+            const bool infiniteGOP = settings.infiniteGOP || m_detectSceneChanges;
+            // The driver starts IDR frames every idrPeriod frames whatever the GOP length, so both are infinite.
+            const uint32_t gopLength = infiniteGOP ? NVENC_INFINITE_GOPLENGTH : m_frameRate;
+            nvEncConfig.encodeCodecConfig.h264Config.idrPeriod = gopLength;
+            nvEncConfig.gopLength = gopLength;
+
+            // Error Recovery Settings: infra frame refreshing
+
+            const bool intraRefresh = settings.intraRefreshPeriod > 0 && settings.intraRefreshCount > 0;
+            nvEncConfig.encodeCodecConfig.h264Config.enableIntraRefresh = intraRefresh;
+            nvEncConfig.encodeCodecConfig.h264Config.intraRefreshPeriod = intraRefresh ? settings.intraRefreshPeriod : 0;
+            nvEncConfig.encodeCodecConfig.h264Config.intraRefreshCnt = intraRefresh ? settings.intraRefreshCount : 0;
+
+            // Optimise: bitrates
+
+            nvEncConfig.rcParams.maxBitRate = std::max(0, settings.maxBitrate); // VBR only
+
+            // Error Recovery Settings: adaptive quantization
+
+            nvEncConfig.rcParams.enableAQ = settings.enableAQ;
+            nvEncConfig.encodeCodecConfig.h264Config.maxNumRefFrames = std::max(0, settings.maxNumRefFrames); // zero will use driver's default size
+
+            // Optimise: quantisation parameters
+
+            ApplyQPBounds(settings, m_qpWidened);
+        }
+
+        void NvEncoder::ApplyQPBounds(const EncoderSettings& settings, bool widened)
+        {
+            const int maxQP = widened ? s_widenedMaxQP : settings.maxQP;
+            nvEncConfig.rcParams.enableMinQP = settings.minQP > 0;
+            nvEncConfig.rcParams.minQP.qpIntra = nvEncConfig.rcParams.minQP.qpInterP = nvEncConfig.rcParams.minQP.qpInterB =
+                std::max(0, settings.minQP);
+            nvEncConfig.rcParams.enableMaxQP = maxQP > 0;
+            nvEncConfig.rcParams.maxQP.qpIntra = nvEncConfig.rcParams.maxQP.qpInterP = nvEncConfig.rcParams.maxQP.qpInterB =
+                std::max(0, maxQP);
+        }
+
+        void NvEncoder::SetSettings(std::shared_ptr<EncoderSettingsPublisher> settings)
+        {
+            if (settings == nullptr)
+                return;
+            m_settings = std::move(settings);
+            // The versions are counted by each publisher, so the first snapshot of this one is compared.
+            m_appliedSettings.version = 0;
+        }
+
         void NvEncoder::UpdateSettings()
         {
             bool settingChanged = false;
 
+            // The settings of the track changed, which may change the structure of the stream.
+            const EncoderSettings* settings = m_settings->Read();
+            bool settingsReset = false;
+            if (settings->version != m_appliedSettings.version)
+            {
+                settingsReset = !settings->Equals(m_appliedSettings);
+                if (settingsReset)
+                {
+                    ApplySettings(*settings);
+                    settingChanged = true;
+                }
+                m_appliedSettings = *settings;
+            }
+            // The device turned out not to detect the scene changes, so the IDR frames follow the timer again.
+            if (m_detectSceneChanges && m_sceneChangeUnsupported)
+            {
+                ApplySettings(m_appliedSettings);
+                settingsReset = true;
+                settingChanged = true;
+            }
+            // The QP bounds are widened from the frame which starts a new scene, for half a second, when the settings
+            // bound the QP below the largest one.
+            const bool widenQP = m_sceneChangeFramesLeft > 0 && m_appliedSettings.maxQP > 0 &&
+                m_appliedSettings.maxQP < s_widenedMaxQP;
+            if (m_sceneChangeFramesLeft > 0)
+                m_sceneChangeFramesLeft--;
+            if (widenQP != m_qpWidened)
+            {
+                m_qpWidened = widenQP;
+                ApplyQPBounds(m_appliedSettings, widenQP);
+                settingChanged = true;
+            }
+            RateGovernor::Rates rates;
+            if (m_rateGovernor.Poll(m_clock->TimeInMilliseconds(), &rates))
+            {
+                m_targetBitrate = rates.bitRate;
+                m_frameRate = rates.frameRate;
+            }
             if (nvEncConfig.rcParams.averageBitRate != m_targetBitrate)
             {
 
@@ -323,10 +420,8 @@ namespace unity
             }
             if (nvEncInitializeParams.frameRateNum != m_frameRate)
             {
-                HWSettings* hw = HWSettings::getPtr();
-
                 if (m_frameRate > 240) m_frameRate = 240; // unlikely: nvcodec do not allow a framerate over 240
-                //if (m_frameRate > hw->maxFramerate) m_frameRate = hw->maxFramerate;
+                //if (m_frameRate > settings->maxFramerate) m_frameRate = settings->maxFramerate;
 
                 Debugger::Log("frameRateNum", m_frameRate);
 
@@ -335,9 +430,11 @@ namespace unity
             }
             if (settingChanged)
             {
-                NV_ENC_RECONFIGURE_PARAMS nvEncReconfigureParams;
+                NV_ENC_RECONFIGURE_PARAMS nvEncReconfigureParams = {};
                 std::memcpy(&nvEncReconfigureParams.reInitEncodeParams, &nvEncInitializeParams, sizeof(nvEncInitializeParams));
                 nvEncReconfigureParams.version = NV_ENC_RECONFIGURE_PARAMS_VER;
+                nvEncReconfigureParams.resetEncoder = settingsReset ? 1 : 0;
+                nvEncReconfigureParams.forceIDR = settingsReset ? 1 : 0;
                 errorCode = pNvEncodeAPI->nvEncReconfigureEncoder(pEncoderInterface, &nvEncReconfigureParams);
                 checkf(NV_RESULT(errorCode), StringFormat("Failed to reconfigure encoder setting %d %d %d",
                     errorCode, nvEncInitializeParams.frameRateNum, nvEncConfig.rcParams.averageBitRate).c_str());
@@ -346,36 +443,97 @@ namespace unity
 
         void NvEncoder::SetRates(uint32_t bitRate, int64_t frameRate)
         {
-            m_frameRate = frameRate;
-            m_targetBitrate = bitRate;
-
-            // [autr] begin...
-
-            HWSettings* hw = HWSettings::getPtr();
-            hw->minFramerate = (int)frameRate;
-            hw->minBitrate = (int)bitRate;
+            // A key frame costs several times the bitrate, which would lower the next estimate again, so the rates
+            // are changed in the same sequence. Key frames are requested by the receiver or a change of size.
+            m_rateGovernor.SetRates(bitRate, static_cast<uint32_t>(frameRate));
+        }
 
-            // [/autr] end.
+        bool NvEncoder::CopyBuffer(void* frame)
+        {
+            return CopyBufferAt(frame, GetCurrentFrameCount() % m_bufferCount);
+        }
 
-            isIdrFrame = true;
+        bool NvEncoder::ScaleBuffer(void* frame)
+        {
+            const uint32 bufferIndex = GetCurrentFrameCount() % m_bufferCount;
+            const auto tex = renderTextures[bufferIndex];
+            if (tex == nullptr)
+                return false;
+            WaitForFrame(bufferIndex);
+            return m_device->ScaleResourceFromNativeV(tex, frame);
         }
 
-        bool NvEncoder::CopyBuffer(void* frame)
+        bool NvEncoder::CopyBufferAt(void* frame, uint32 bufferIndex)
         {
-            const int curFrameNum = GetCurrentFrameCount() % bufferedFrameNum;
-            const auto tex = renderTextures[curFrameNum];
+            const auto tex = renderTextures[bufferIndex];
             if (tex == nullptr)
                 return false;
-            m_device->CopyResourceFromNativeV(tex, frame);
+            // The driver may still read the texture of a frame which has not been retrieved.
+            WaitForFrame(bufferIndex);
+            // The frame is skipped when it can not be copied, and it is not compared with the next scene either.
+            if (!m_device->CopyResourceFromNativeV(tex, frame))
+                return false;
+            if (m_detectSceneChanges)
+            {
+                bufferedFrames[bufferIndex].sceneChange = DetectSceneChange(frame, tex);
+            }
+            else
+            {
+                // The next scene is not compared with the frames before the detection was disabled.
+                m_sceneChangeDetector.Reset();
+            }
             return true;
         }
 
+        bool NvEncoder::DetectSceneChange(void* frame, ITexture2D* tex)
+        {
+            if (m_sceneChangeUnsupported)
+                return false;
+            // The frames which the CPU device copies are in system memory, so they are compared without a readback.
+            if (m_device->GetDeviceType() == GRAPHICS_DEVICE_CPU)
+            {
+                return m_sceneChangeDetector.DetectBGRA(static_cast<const uint8_t*>(tex->GetNativeTexturePtrV()),
+                    tex->GetWidth(), tex->GetHeight(), tex->GetWidth() * 4);
+            }
+            // The other devices scale a thumbnail on the GPU. Devices which can not are skipped, since a readback of
+            // every frame at full size would stall the rendering thread.
+            if (m_sceneTexture == nullptr)
+            {
+                m_sceneTexture = m_device->CreateCPUReadTextureV(
+                    SceneChangeDetector::thumbnailWidth, SceneChangeDetector::thumbnailHeight);
+            }
+            if (m_sceneTexture == nullptr || !m_device->ScaleResourceFromNativeV(m_sceneTexture, frame))
+            {
+                LogPrint("The graphics device can not scale thumbnails, scene changes are not detected");
+                m_sceneChangeUnsupported = true;
+                SAFE_DELETE(m_sceneTexture);
+                return false;
+            }
+            // The thumbnail is read back through the ring of the texture without waiting for the GPU, so the result
+            // is the thumbnail of an earlier frame, or nothing until the ring is filled.
+            const rtc::scoped_refptr<webrtc::I420Buffer> thumbnail =
+                m_device->ConvertRGBToI420(m_sceneTexture, ColorConversionOptions());
+            if (thumbnail == nullptr)
+                return false;
+            return m_sceneChangeDetector.Detect(
+                thumbnail->DataY(), thumbnail->width(), thumbnail->height(), thumbnail->StrideY());
+        }
+
         //entry for encoding a frame
         bool NvEncoder::EncodeFrame()
         {
+            return EncodeFrameAt(frameCount % m_bufferCount);
+        }
+
+        bool NvEncoder::EncodeFrameAt(uint32 bufferIndex)
+        {
+            Frame& frame = bufferedFrames[bufferIndex];
+            if (frame.sceneChange)
+            {
+                m_sceneChangeFramesLeft = std::max<uint32_t>(1, m_frameRate / 2);
+            }
             UpdateSettings();
-            uint32 bufferIndexToWrite = frameCount % bufferedFrameNum;
-            Frame& frame = bufferedFrames[bufferIndexToWrite];
+            WaitForFrame(bufferIndex);
 #pragma region configure per-frame encode parameters
             NV_ENC_PIC_PARAMS picParams = { 0 };
             picParams.version = NV_ENC_PIC_PARAMS_VER;
@@ -386,18 +544,41 @@ namespace unity
             picParams.inputHeight = nvEncInitializeParams.encodeHeight;
             picParams.outputBitstream = frame.outputFrame;
             picParams.inputTimeStamp = frameCount;
+            picParams.completionEvent = frame.completionEvent;
 #pragma endregion
 #pragma region start encoding
-            if (isIdrFrame)
+            // WebRTC requests key frames from its own threads, so a request made while this frame is encoded is
+            // kept for the next one.
+            const bool idrRequested = isIdrFrame.exchange(false);
+            if (idrRequested || frame.sceneChange)
             {
                 picParams.encodePicFlags |= NV_ENC_PIC_FLAG_FORCEIDR; // [autr] fix (no intras)
-                isIdrFrame = false;
+                frame.sceneChange = false;
             }
             errorCode = pNvEncodeAPI->nvEncEncodePicture(pEncoderInterface, &picParams);
             checkf(NV_RESULT(errorCode), StringFormat("Failed to encode frame, error is %d", errorCode).c_str());
+            if (!NV_RESULT(errorCode))
+            {
+                // The next frame is the key frame which was requested.
+                if (idrRequested)
+                    isIdrFrame = true;
+                return false;
+            }
 #pragma endregion
-            ProcessEncodedFrame(frame);
+            // The frame is stamped when it is captured, not when its bitstream is retrieved.
+            frame.timestampUs = timestamp_aligner_.TranslateTimestamp(m_clock->TimeInMicroseconds(), rtc::TimeMicros());
             frameCount++;
+            if (!m_asyncOutput)
+            {
+                ProcessEncodedFrame(frame);
+                return true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_retrievalMutex);
+                frame.pending = true;
+                m_submittedFrames.push_back(bufferIndex);
+            }
+            m_submittedCondition.notify_one();
             return true;
         }
 
@@ -405,40 +586,152 @@ namespace unity
         void NvEncoder::ProcessEncodedFrame(Frame& frame)
         {
 #pragma region retrieve encoded frame from output buffer
+#if defined(_WIN32)
+            if (frame.completionEvent != nullptr &&
+                WaitForSingleObject(static_cast<HANDLE>(frame.completionEvent), 20000) != WAIT_OBJECT_0)
+            {
+                LogPrint("Waiting for the completion event of NVENC is timed out");
+            }
+#endif
+            // Waits for the driver unless the completion event has been signalled.
             NV_ENC_LOCK_BITSTREAM lockBitStream = { 0 };
             lockBitStream.version = NV_ENC_LOCK_BITSTREAM_VER;
             lockBitStream.outputBitstream = frame.outputFrame;
-            lockBitStream.doNotWait = nvEncInitializeParams.enableEncodeAsync;
-            errorCode = pNvEncodeAPI->nvEncLockBitstream(pEncoderInterface, &lockBitStream);
-            checkf(NV_RESULT(errorCode), StringFormat("Failed to lock bit stream, error is %d", errorCode).c_str());
+            lockBitStream.doNotWait = 0;
+            NVENCSTATUS result = pNvEncodeAPI->nvEncLockBitstream(pEncoderInterface, &lockBitStream);
+            checkf(NV_RESULT(result), StringFormat("Failed to lock bit stream, error is %d", result).c_str());
+            if (!NV_RESULT(result))
+                return;
+            const rtc::scoped_refptr<PooledEncodedImageBuffer> encodedFrame =
+                m_encodedBufferPool.CreateBuffer(lockBitStream.bitstreamSizeInBytes);
             if (lockBitStream.bitstreamSizeInBytes)
             {
-                frame.encodedFrame.resize(lockBitStream.bitstreamSizeInBytes);
-                std::memcpy(frame.encodedFrame.data(), lockBitStream.bitstreamBufferPtr, lockBitStream.bitstreamSizeInBytes);
+                std::memcpy(encodedFrame->data(), lockBitStream.bitstreamBufferPtr, lockBitStream.bitstreamSizeInBytes);
             }
-            errorCode = pNvEncodeAPI->nvEncUnlockBitstream(pEncoderInterface, frame.outputFrame);
-            checkf(NV_RESULT(errorCode), StringFormat("Failed to unlock bit stream, error is %d", errorCode).c_str());
+            result = pNvEncodeAPI->nvEncUnlockBitstream(pEncoderInterface, frame.outputFrame);
+            checkf(NV_RESULT(result), StringFormat("Failed to unlock bit stream, error is %d", result).c_str());
 #pragma endregion
             const rtc::scoped_refptr<FrameBuffer> buffer =
                 new rtc::RefCountedObject<FrameBuffer>(
-                    m_width, m_height, frame.encodedFrame, m_encoderId);
-            const int64_t timestamp_us = m_clock->TimeInMicroseconds();
-            const int64_t now_us = rtc::TimeMicros();
-            const int64_t translated_camera_time_us =
-                timestamp_aligner_.TranslateTimestamp(
-                    timestamp_us,
-                    now_us);
+                    m_width, m_height, encodedFrame, GetControl());
 
             webrtc::VideoFrame::Builder builder =
                 webrtc::VideoFrame::Builder()
                 .set_video_frame_buffer(buffer)
-                .set_timestamp_us(translated_camera_time_us)
+                .set_timestamp_us(frame.timestampUs)
                 .set_timestamp_rtp(0)
                 .set_ntp_time_ms(rtc::TimeMillis());
 
             CaptureFrame(builder.build());
         }
 
+        void NvEncoder::WaitForFrame(uint32 bufferIndex)
+        {
+            std::unique_lock<std::mutex> lock(m_retrievalMutex);
+            m_retrievedCondition.wait(lock, [&] { return !bufferedFrames[bufferIndex].pending; });
+        }
+
+        void NvEncoder::WaitForAllFrames()
+        {
+            std::unique_lock<std::mutex> lock(m_retrievalMutex);
+            m_retrievedCondition.wait(lock, [&]
+            {
+                return std::none_of(std::begin(bufferedFrames), std::end(bufferedFrames),
+                    [](const Frame& frame) { return frame.pending; });
+            });
+        }
+
+        void NvEncoder::SetAsyncOutput(bool enabled)
+        {
+            m_asyncOutput = enabled;
+            if (enabled)
+                return;
+            // The frames which have been submitted are still captured on the retrieval thread.
+            WaitForAllFrames();
+        }
+
+        void NvEncoder::SetMaxSize(int width, int height)
+        {
+            m_maxWidth = std::max(0, width);
+            m_maxHeight = std::max(0, height);
+        }
+
+        bool NvEncoder::Resize(int width, int height)
+        {
+            if (!m_isNvEncoderSupported || width <= 0 || height <= 0 ||
+                static_cast<uint32>(width) > nvEncInitializeParams.maxEncodeWidth ||
+                static_cast<uint32>(height) > nvEncInitializeParams.maxEncodeHeight)
+            {
+                return false;
+            }
+            if (width == m_width && height == m_height)
+                return true;
+            // The driver reads the textures of the frames which have not been retrieved, and the retrieved frames
+            // are captured with the size of the encoder.
+            WaitForAllFrames();
+
+            NV_ENC_RECONFIGURE_PARAMS nvEncReconfigureParams = {};
+            nvEncReconfigureParams.version = NV_ENC_RECONFIGURE_PARAMS_VER;
+            std::memcpy(&nvEncReconfigureParams.reInitEncodeParams, &nvEncInitializeParams, sizeof(nvEncInitializeParams));
+            NV_ENC_INITIALIZE_PARAMS& params = nvEncReconfigureParams.reInitEncodeParams;
+            params.encodeWidth = params.darWidth = width;
+            params.encodeHeight = params.darHeight = height;
+            // The stream starts a new sequence at the new size.
+            nvEncReconfigureParams.resetEncoder = 1;
+            nvEncReconfigureParams.forceIDR = 1;
+            errorCode = pNvEncodeAPI->nvEncReconfigureEncoder(pEncoderInterface, &nvEncReconfigureParams);
+            if (!NV_RESULT(errorCode))
+            {
+                LogPrint(StringFormat("Failed to resize encoder to %dx%d %d", width, height, errorCode).c_str());
+                return false;
+            }
+            nvEncInitializeParams.encodeWidth = nvEncInitializeParams.darWidth = width;
+            nvEncInitializeParams.encodeHeight = nvEncInitializeParams.darHeight = height;
+
+            ReleaseInputResources();
+            m_width = width;
+            m_height = height;
+            InitInputResources();
+            m_sceneChangeDetector.Reset();
+            return true;
+        }
+
+        void NvEncoder::StopRetrievalThread()
+        {
+            if (!m_retrievalThread.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> lock(m_retrievalMutex);
+                m_stopRetrieval = true;
+            }
+            m_submittedCondition.notify_one();
+            m_retrievalThread.join();
+        }
+
+        void NvEncoder::RunRetrievalThread()
+        {
+            while (true)
+            {
+                uint32 bufferIndex = 0;
+                {
+                    std::unique_lock<std::mutex> lock(m_retrievalMutex);
+                    m_submittedCondition.wait(lock, [&] { return m_stopRetrieval || !m_submittedFrames.empty(); });
+                    // The submitted frames are retrieved before the thread stops.
+                    if (m_submittedFrames.empty())
+                        return;
+                    bufferIndex = m_submittedFrames.front();
+                    m_submittedFrames.pop_front();
+                }
+                Frame& frame = bufferedFrames[bufferIndex];
+                ProcessEncodedFrame(frame);
+                {
+                    std::lock_guard<std::mutex> lock(m_retrievalMutex);
+                    frame.pending = false;
+                }
+                m_retrievedCondition.notify_all();
+            }
+        }
+
         NV_ENC_REGISTERED_PTR NvEncoder::RegisterResource(NV_ENC_INPUT_RESOURCE_TYPE inputType, void* buffer)
         {
             NV_ENC_REGISTER_RESOURCE registerResource = { NV_ENC_REGISTER_RESOURCE_VER };
@@ -479,9 +772,9 @@ namespace unity
             checkf(NV_RESULT(errorCode), StringFormat("nvEncCreateBitstreamBuffer error is %d", errorCode).c_str());
             return createBitstreamBuffer.bitstreamBuffer;
         }
-        void NvEncoder::InitEncoderResources()
+        void NvEncoder::InitInputResources()
         {
-            for (uint32 i = 0; i < bufferedFrameNum; i++)
+            for (uint32 i = 0; i < m_bufferCount; i++)
             {
                 renderTextures[i] = m_device->CreateDefaultTextureV(m_width, m_height);
                 void* buffer = AllocateInputResourceV(renderTextures[i]);
@@ -490,7 +783,35 @@ namespace unity
                 frame.inputFrame.registeredResource = RegisterResource(m_inputType, buffer);
                 frame.inputFrame.bufferFormat = m_bufferFormat;
                 MapResources(frame.inputFrame);
+            }
+        }
+
+        void NvEncoder::ReleaseInputResources()
+        {
+            for (uint32 i = 0; i < m_bufferCount; i++)
+            {
+                ReleaseFrameInputBuffer(bufferedFrames[i]);
+                SAFE_DELETE(renderTextures[i]);
+            }
+            SAFE_DELETE(m_sceneTexture);
+        }
+
+        void NvEncoder::InitEncoderResources()
+        {
+            InitInputResources();
+            for (Frame& frame : bufferedFrames)
+            {
                 frame.outputFrame = InitializeBitstreamBuffer();
+#if defined(_WIN32)
+                if (m_asyncEncode)
+                {
+                    frame.completionEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+                    NV_ENC_EVENT_PARAMS eventParams = { NV_ENC_EVENT_PARAMS_VER };
+                    eventParams.completionEvent = frame.completionEvent;
+                    errorCode = pNvEncodeAPI->nvEncRegisterAsyncEvent(pEncoderInterface, &eventParams);
+                    checkf(NV_RESULT(errorCode), StringFormat("nvEncRegisterAsyncEvent error is %d", errorCode).c_str());
+                }
+#endif
             }
         }
 
@@ -512,15 +833,26 @@ namespace unity
         }
         void NvEncoder::ReleaseEncoderResources()
         {
+            ReleaseInputResources();
             for (Frame& frame : bufferedFrames)
             {
-                ReleaseFrameInputBuffer(frame);
                 if (frame.outputFrame != nullptr)
                 {
                     errorCode = pNvEncodeAPI->nvEncDestroyBitstreamBuffer(pEncoderInterface, frame.outputFrame);
                     checkf(NV_RESULT(errorCode), StringFormat("Failed to destroy output buffer bit stream %d", errorCode).c_str());
                     frame.outputFrame = nullptr;
                 }
+#if defined(_WIN32)
+                if (frame.completionEvent != nullptr)
+                {
+                    NV_ENC_EVENT_PARAMS eventParams = { NV_ENC_EVENT_PARAMS_VER };
+                    eventParams.completionEvent = frame.completionEvent;
+                    errorCode = pNvEncodeAPI->nvEncUnregisterAsyncEvent(pEncoderInterface, &eventParams);
+                    checkf(NV_RESULT(errorCode), StringFormat("Failed to unregister completion event %d", errorCode).c_str());
+                    CloseHandle(static_cast<HANDLE>(frame.completionEvent));
+                    frame.completionEvent = nullptr;
+                }
+#endif
             }
         }
         uint32_t NvEncoder::GetNumChromaPlanes(const NV_ENC_BUFFER_FORMAT bufferFormat)
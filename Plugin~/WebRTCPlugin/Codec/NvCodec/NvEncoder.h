@@ -1,10 +1,18 @@
 #pragma once
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <rtc_base/timestamp_aligner.h>
 
 #include "nvEncodeAPI.h"
 #include "Codec/IEncoder.h"
+#include "Codec/EncodedImageBufferPool.h"
+#include "Codec/EncoderSettings.h"
+#include "Codec/RateGovernor.h"
+#include "Codec/SceneChangeDetector.h"
 
 namespace unity
 {
@@ -28,14 +36,20 @@ namespace webrtc
         {
             InputFrame inputFrame = {nullptr, nullptr, NV_ENC_BUFFER_FORMAT_UNDEFINED };
             OutputFrame outputFrame = nullptr;
-            std::vector<uint8> encodedFrame = {};
+            // Signalled by the driver when the frame is encoded, only in the asynchronous mode.
+            void* completionEvent = nullptr;
+            // Submitted and not retrieved yet, guarded by m_retrievalMutex.
+            bool pending = false;
+            int64_t timestampUs = 0;
+            // Starts a new scene, set when the frame is copied.
+            bool sceneChange = false;
         };
     public:
         NvEncoder(
             NV_ENC_DEVICE_TYPE type,
             NV_ENC_INPUT_RESOURCE_TYPE inputType,
             NV_ENC_BUFFER_FORMAT bufferFormat,
-            int width, int height, IGraphicsDevice* device);
+            int width, int height, IGraphicsDevice* device, uint32 bufferCount = bufferedFrameNum);
         virtual ~NvEncoder();
 
         static CodecInitializationResult LoadCodec();
@@ -44,20 +58,42 @@ namespace webrtc
         static uint32_t GetNumChromaPlanes(NV_ENC_BUFFER_FORMAT);
         static uint32_t GetChromaHeight(const NV_ENC_BUFFER_FORMAT bufferFormat, const uint32_t lumaHeight);
         static uint32_t GetWidthInBytes(const NV_ENC_BUFFER_FORMAT bufferFormat, const uint32_t width);
-        static int NvEncoder::GetRateControlString(const NV_ENC_PARAMS_RC_MODE mode);
-        static NV_ENC_PARAMS_RC_MODE NvEncoder::GetRateControlMode(int mode);
+        static int GetRateControlString(const NV_ENC_PARAMS_RC_MODE mode);
+        static NV_ENC_PARAMS_RC_MODE GetRateControlMode(int mode);
+        // Runs the encoders against a stub of the driver in the tests. nullptr loads the driver again.
+        static void OverrideFunctionList(const NV_ENCODE_API_FUNCTION_LIST* functionList);
 
         void InitV() override;
         void SetRates(uint32_t bitRate, int64_t frameRate) override;
         void UpdateSettings() override;
         bool CopyBuffer(void* frame) override;
+        bool ScaleBuffer(void* frame) override;
         bool EncodeFrame() override;
         bool IsSupported() const override { return m_isNvEncoderSupported; }
         void SetIdrFrame()  override { isIdrFrame = true; }
         uint64 GetCurrentFrameCount() const override { return frameCount; }
+        // Only the CUDA context can be used on the encoder thread, the graphics APIs are bound to the rendering thread.
+        uint32 GetBufferCount() const override { return m_deviceType == NV_ENC_DEVICE_TYPE_CUDA ? m_bufferCount : 0; }
+        bool CopyBufferAt(void* frame, uint32 bufferIndex) override;
+        bool EncodeFrameAt(uint32 bufferIndex) override;
+        // Reconfigures the session for the size, up to the maximum encode size set at initialization,
+        // and creates the input textures again. The next frame is an IDR frame.
+        bool Resize(int width, int height) override;
+        // The decoded picture buffers of the session are allocated for the maximum size.
+        void SetMaxSize(int width, int height) override;
+        // A new snapshot is applied when the next frame is encoded, with an IDR frame.
+        void SetSettings(std::shared_ptr<EncoderSettingsPublisher> settings) override;
+
+        // Encoding a frame only submits it, the retrieval thread captures it when the driver is done.
+        void SetAsyncOutput(bool enabled) override;
+        bool IsAsyncOutput() const { return m_asyncOutput; }
+        // Whether the driver signals completion events, otherwise the retrieval thread waits in nvEncLockBitstream.
+        bool IsAsyncEncode() const { return m_asyncEncode; }
     protected:
         int m_width;
         int m_height;
+        int m_maxWidth = 0;
+        int m_maxHeight = 0;
         IGraphicsDevice* m_device;
 
         NV_ENC_DEVICE_TYPE m_deviceType;
@@ -69,25 +105,71 @@ namespace webrtc
         virtual void* AllocateInputResourceV(ITexture2D* tex) = 0;
 
     private:
+        // Fills the parameters of the session which the settings of the track control.
+        void ApplySettings(const EncoderSettings& settings);
+        // The frames after a scene change may use a coarser quantizer.
+        void ApplyQPBounds(const EncoderSettings& settings, bool widened);
+        // Returns true when a cut is found. The CPU device compares the copied frame itself. On the GPU devices, the
+        // thumbnails are read back (bufferedFrameNum - 1) frames later, so the key frame follows the cut by as much.
+        bool DetectSceneChange(void* frame, ITexture2D* tex);
         void InitEncoderResources();
         void ReleaseEncoderResources();
+        // The textures and their registrations, which depend on the size of the frames.
+        void InitInputResources();
+        void ReleaseInputResources();
 
         void ReleaseFrameInputBuffer(Frame& frame);
         void ProcessEncodedFrame(Frame& frame);
+        void WaitForFrame(uint32 bufferIndex);
+        void WaitForAllFrames();
+        void StopRetrievalThread();
+        void RunRetrievalThread();
         NV_ENC_REGISTERED_PTR RegisterResource(NV_ENC_INPUT_RESOURCE_TYPE type, void *pBuffer);
         void MapResources(InputFrame& inputFrame);
         NV_ENC_OUTPUT_PTR InitializeBitstreamBuffer();
         NV_ENC_INITIALIZE_PARAMS nvEncInitializeParams = {};
         NV_ENC_CONFIG nvEncConfig = {};
         NVENCSTATUS errorCode;
-        Frame bufferedFrames[bufferedFrameNum];
-        ITexture2D* renderTextures[bufferedFrameNum];
-        uint64 frameCount = 0;
+        // A deeper ring keeps the driver busy, a shallower one waits less for each frame.
+        const uint32 m_bufferCount;
+        std::vector<Frame> bufferedFrames;
+        std::vector<ITexture2D*> renderTextures;
+        std::atomic<uint64> frameCount{ 0 };
         void* pEncoderInterface = nullptr;
-        bool isIdrFrame = false;
+        // Set by the threads of WebRTC, and cleared by the thread which encodes.
+        std::atomic<bool> isIdrFrame{ false };
+        std::shared_ptr<EncoderSettingsPublisher> m_settings;
+        // The settings which the session was configured with last.
+        EncoderSettings m_appliedSettings;
+
+        // Set by the settings on the encoder thread, used when the frames are copied on the rendering thread.
+        std::atomic<bool> m_detectSceneChanges{ false };
+        SceneChangeDetector m_sceneChangeDetector;
+        ITexture2D* m_sceneTexture = nullptr;
+        // The device can neither scale on the GPU nor is in system memory.
+        // Set on the rendering thread, the encoder thread then configures the periodic IDR frames again.
+        std::atomic<bool> m_sceneChangeUnsupported{ false };
+        // The number of frames which are still encoded with the wider QP bounds.
+        uint32_t m_sceneChangeFramesLeft = 0;
+        bool m_qpWidened = false;
+
+        // The bitstream is copied once out of the locked NVENC buffer, then sent without another copy.
+        EncodedImageBufferPool m_encodedBufferPool;
+
+        bool m_asyncEncode = false;
+        std::atomic<bool> m_asyncOutput{ true };
+        // Frames submitted to the driver, retrieved in the order they were submitted.
+        std::deque<uint32> m_submittedFrames;
+        std::mutex m_retrievalMutex;
+        std::condition_variable m_submittedCondition;
+        std::condition_variable m_retrievedCondition;
+        bool m_stopRetrieval = false;
+        std::thread m_retrievalThread;
 
         webrtc::Clock* m_clock;
 
+        // The rates which WebRTC sets, applied before a frame when they change enough.
+        RateGovernor m_rateGovernor;
         uint32_t m_frameRate = 30;
         uint32_t m_targetBitrate = 0;
         rtc::TimestampAligner timestamp_aligner_;
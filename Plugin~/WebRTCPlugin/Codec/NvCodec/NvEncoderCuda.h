@@ -9,7 +9,7 @@ namespace webrtc
     class NvEncoderCuda : public NvEncoder
     {
     public:
-        NvEncoderCuda(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device);
+        NvEncoderCuda(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device, uint32_t bufferCount = bufferedFrameNum);
         virtual ~NvEncoderCuda() = default;
     protected:
         virtual void* AllocateInputResourceV(ITexture2D* tex) override;
@@ -8,7 +8,7 @@ namespace webrtc
 
     class NvEncoderD3D12 : public NvEncoder {
     public:
-        NvEncoderD3D12(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device);
+        NvEncoderD3D12(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device, uint32_t bufferCount = bufferedFrameNum);
         virtual ~NvEncoderD3D12();
     protected:
 
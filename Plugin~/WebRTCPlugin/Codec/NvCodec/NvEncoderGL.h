@@ -8,7 +8,7 @@ namespace webrtc
 
     class NvEncoderGL : public NvEncoder {
     public:
-        NvEncoderGL(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device);
+        NvEncoderGL(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device, uint32_t bufferCount = bufferedFrameNum);
         virtual ~NvEncoderGL();
     protected:
         virtual void* AllocateInputResourceV(ITexture2D* tex) override;
@@ -0,0 +1,65 @@
+#include "pch.h"
+#include "RateGovernor.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+    RateGovernor::RateGovernor(double threshold, int64_t minIntervalMs)
+        : m_threshold(threshold)
+        , m_minIntervalMs(minIntervalMs)
+    {
+    }
+
+    void RateGovernor::SetRates(uint32_t bitRate, uint32_t frameRate)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requested.bitRate = bitRate;
+        m_requested.frameRate = frameRate;
+        m_hasRequest = true;
+        m_requestCount++;
+    }
+
+    bool RateGovernor::Poll(int64_t nowMs, Rates* rates)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_hasRequest)
+            return false;
+
+        // The first rates replace the initial bitrate of the session.
+        bool apply = m_appliedCount == 0;
+        if (!apply)
+        {
+            const double bitRate = m_requested.bitRate;
+            const double applied = m_applied.bitRate;
+            const bool lower = bitRate < applied * (1.0 - m_threshold);
+            const bool higher = bitRate > applied * (1.0 + m_threshold);
+            const bool frameRateChanged = m_requested.frameRate != m_applied.frameRate;
+            const bool elapsed = nowMs - m_appliedTimeMs >= m_minIntervalMs;
+            apply = lower || ((higher || frameRateChanged) && elapsed);
+        }
+        if (!apply)
+            return false;
+
+        m_applied = m_requested;
+        m_appliedTimeMs = nowMs;
+        m_appliedCount++;
+        *rates = m_applied;
+        return true;
+    }
+
+    uint64_t RateGovernor::GetRequestCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requestCount;
+    }
+
+    uint64_t RateGovernor::GetAppliedCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_appliedCount;
+    }
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,45 @@
+#pragma once
+#include <mutex>
+
+namespace unity
+{
+namespace webrtc
+{
+
+    // Coalesces the rates which WebRTC sets several times per second, so that the encoder is only reconfigured
+    // when they change enough, and without a key frame.
+    // A drop of the bitrate beyond the threshold is applied right away so that the sender does not overshoot the
+    // link. A rise, or a change of the frame rate, is applied at most once per interval.
+    class RateGovernor
+    {
+    public:
+        struct Rates
+        {
+            uint32_t bitRate = 0;
+            uint32_t frameRate = 0;
+        };
+
+        explicit RateGovernor(double threshold = 0.1, int64_t minIntervalMs = 1000);
+
+        // Called by WebRTC on its encoder thread.
+        void SetRates(uint32_t bitRate, uint32_t frameRate);
+        // Called before each frame. Returns true with the rates which the encoder must be reconfigured with.
+        bool Poll(int64_t nowMs, Rates* rates);
+
+        uint64_t GetRequestCount() const;
+        uint64_t GetAppliedCount() const;
+
+    private:
+        mutable std::mutex m_mutex;
+        const double m_threshold;
+        const int64_t m_minIntervalMs;
+        Rates m_requested;
+        Rates m_applied;
+        bool m_hasRequest = false;
+        int64_t m_appliedTimeMs = 0;
+        uint64_t m_requestCount = 0;
+        uint64_t m_appliedCount = 0;
+    };
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "SceneChangeDetector.h"
+#include "GraphicsDevice/GraphicsUtility.h"
+#include <algorithm>
+
+#if defined(SUPPORT_SSE2)
+#include <emmintrin.h>
+#elif defined(SUPPORT_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace
+{
+    // Weight of the last frame in the average difference of the recent frames.
+    const float kAverageWeight = 0.1f;
+
+    uint64_t SumOfAbsoluteDifferences_C(const uint8_t* a, const uint8_t* b, size_t size)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        }
+        return sum;
+    }
+
+    // Returns the number of bytes which were summed.
+    size_t SumOfAbsoluteDifferences_SIMD(const uint8_t* a, const uint8_t* b, size_t size, uint64_t* sum)
+    {
+        size_t i = 0;
+#if defined(SUPPORT_SSE2)
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 16 <= size; i += 16)
+        {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            // Two sums of 8 bytes, in the low 16 bits of each 64 bit lane.
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        *sum = lanes[0] + lanes[1];
+#elif defined(SUPPORT_NEON)
+        uint32x4_t acc = vdupq_n_u32(0);
+        for (; i + 16 <= size; i += 16)
+        {
+            const uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+            acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+        }
+        *sum = vaddvq_u32(acc);
+#else
+        *sum = 0;
+#endif
+        return i;
+    }
+} // namespace
+
+SceneChangeDetector::SceneChangeDetector(float threshold, float ratio)
+    : m_threshold(threshold)
+    , m_ratio(ratio)
+    , m_previous(thumbnailWidth * thumbnailHeight)
+    , m_current(thumbnailWidth * thumbnailHeight)
+{
+}
+
+uint64_t SceneChangeDetector::SumOfAbsoluteDifferences(const uint8_t* a, const uint8_t* b, size_t size, bool useSimd)
+{
+    uint64_t sum = 0;
+    size_t offset = 0;
+#if defined(SUPPORT_SSE2)
+    static const bool supported = GraphicsUtility::IsKernelSupported(ColorConversionKernel::SSE2);
+    if (useSimd && supported)
+        offset = SumOfAbsoluteDifferences_SIMD(a, b, size, &sum);
+#elif defined(SUPPORT_NEON)
+    if (useSimd)
+        offset = SumOfAbsoluteDifferences_SIMD(a, b, size, &sum);
+#endif
+    return sum + SumOfAbsoluteDifferences_C(a + offset, b + offset, size - offset);
+}
+
+template <int PixelSize, typename Luma>
+void SceneChangeDetector::SampleThumbnail(const uint8_t* pixels, int width, int height, int stride, Luma luma)
+{
+    // Each pixel of the thumbnail averages 4 pixels at the quarters of its cell, which is enough to tell the
+    // scenes apart without reading the whole plane.
+    for (int ty = 0; ty < thumbnailHeight; ty++)
+    {
+        const int y0 = (4 * ty + 1) * height / (4 * thumbnailHeight);
+        const int y1 = (4 * ty + 3) * height / (4 * thumbnailHeight);
+        const uint8_t* row0 = pixels + static_cast<size_t>(y0) * stride;
+        const uint8_t* row1 = pixels + static_cast<size_t>(y1) * stride;
+        for (int tx = 0; tx < thumbnailWidth; tx++)
+        {
+            const int x0 = (4 * tx + 1) * width / (4 * thumbnailWidth) * PixelSize;
+            const int x1 = (4 * tx + 3) * width / (4 * thumbnailWidth) * PixelSize;
+            m_current[ty * thumbnailWidth + tx] = static_cast<uint8_t>(
+                (luma(row0 + x0) + luma(row0 + x1) + luma(row1 + x0) + luma(row1 + x1) + 2) / 4);
+        }
+    }
+}
+
+bool SceneChangeDetector::Detect(const uint8_t* luma, int width, int height, int stride)
+{
+    if (luma == nullptr || width <= 0 || height <= 0)
+        return false;
+    SampleThumbnail<1>(luma, width, height, stride, [](const uint8_t* pixel) { return static_cast<int>(*pixel); });
+    return CompareThumbnail();
+}
+
+bool SceneChangeDetector::DetectBGRA(const uint8_t* bgra, int width, int height, int pitch)
+{
+    if (bgra == nullptr || width <= 0 || height <= 0)
+        return false;
+    // The luma of the I420 conversion, in the limited range.
+    SampleThumbnail<4>(bgra, width, height, pitch, [](const uint8_t* pixel) {
+        return ((66 * pixel[2] + 129 * pixel[1] + 25 * pixel[0] + 128) >> 8) + 16;
+    });
+    return CompareThumbnail();
+}
+
+bool SceneChangeDetector::CompareThumbnail()
+{
+    if (!m_hasPrevious)
+    {
+        m_current.swap(m_previous);
+        m_hasPrevious = true;
+        m_lastDifference = 0.0f;
+        return false;
+    }
+
+    const uint64_t sum = SumOfAbsoluteDifferences(m_current.data(), m_previous.data(), m_current.size());
+    const float previousDifference = m_lastDifference;
+    m_lastDifference = static_cast<float>(sum) / m_current.size();
+    m_current.swap(m_previous);
+
+    // The difference is compared with the previous one as well as the average, so that only the first frame of a
+    // fast motion may be taken for a cut, while the average catches up with it.
+    const float motion = std::max(m_averageDifference, previousDifference);
+    const bool cut = m_lastDifference >= m_threshold && m_lastDifference >= m_ratio * motion;
+    m_averageDifference += kAverageWeight * (m_lastDifference - m_averageDifference);
+    return cut;
+}
+
+void SceneChangeDetector::Reset()
+{
+    m_hasPrevious = false;
+    m_averageDifference = 0.0f;
+    m_lastDifference = 0.0f;
+}
+
+} // end namespace webrtc
+} // end namespace unity
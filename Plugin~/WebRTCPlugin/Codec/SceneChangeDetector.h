@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+
+namespace unity
+{
+namespace webrtc
+{
+
+    // Detects the cuts between scenes from the luma plane of the captured frames.
+    // The plane is sampled down to a thumbnail, which is compared with the thumbnail of the previous frame.
+    // A cut is a mean absolute difference above the threshold which is also several times the difference of the
+    // previous frame and the average difference of the recent frames, so that fast motion is not taken for a cut.
+    class SceneChangeDetector
+    {
+    public:
+        static const int thumbnailWidth = 64;
+        static const int thumbnailHeight = 36;
+
+        explicit SceneChangeDetector(float threshold = 25.0f, float ratio = 3.0f);
+
+        // Returns true when the frame starts a new scene. The first frame is compared with nothing.
+        bool Detect(const uint8_t* luma, int width, int height, int stride);
+        // Same as Detect, with the luma computed from BGRA32 pixels.
+        bool DetectBGRA(const uint8_t* bgra, int width, int height, int pitch);
+        // Forgets the previous frame, after a change of size for instance.
+        void Reset();
+        // The mean absolute difference of the last frame with the previous one, from 0 to 255.
+        float GetLastDifference() const { return m_lastDifference; }
+
+        static uint64_t SumOfAbsoluteDifferences(const uint8_t* a, const uint8_t* b, size_t size, bool useSimd = true);
+
+    private:
+        template <int PixelSize, typename Luma>
+        void SampleThumbnail(const uint8_t* pixels, int width, int height, int stride, Luma luma);
+        bool CompareThumbnail();
+
+        const float m_threshold;
+        const float m_ratio;
+        std::vector<uint8_t> m_previous;
+        std::vector<uint8_t> m_current;
+        bool m_hasPrevious = false;
+        float m_averageDifference = 0.0f;
+        float m_lastDifference = 0.0f;
+    };
+
+} // end namespace webrtc
+} // end namespace unity
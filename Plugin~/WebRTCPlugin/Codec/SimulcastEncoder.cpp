@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "SimulcastEncoder.h"
+#include "DummyVideoEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+    SimulcastEncoder::SimulcastEncoder(std::vector<std::unique_ptr<IEncoder>> layers, std::vector<bool> scaled)
+        : m_layers(std::move(layers))
+        , m_scaled(std::move(scaled))
+        , m_copied(m_layers.size(), false)
+        , m_layerFrames(m_layers.size())
+    {
+        RTC_DCHECK_EQ(m_layers.size(), m_scaled.size());
+        for (const auto& layer : m_layers)
+        {
+            // The layer frames are gathered while each layer is encoded.
+            layer->SetAsyncOutput(false);
+            layer->CaptureFrame.connect(this, &SimulcastEncoder::OnLayerFrame);
+        }
+    }
+
+    SimulcastEncoder::~SimulcastEncoder()
+    {
+        // The senders call the layer encoders from their own threads.
+        for (const auto& layer : m_layers)
+        {
+            layer->DetachControl();
+        }
+    }
+
+    void SimulcastEncoder::InitV()
+    {
+        // The layer encoders have been initialized by the factory.
+        m_initializationResult = CodecInitializationResult::Success;
+        for (const auto& layer : m_layers)
+        {
+            if (layer->GetCodecInitializationResult() != CodecInitializationResult::Success)
+            {
+                m_initializationResult = layer->GetCodecInitializationResult();
+                return;
+            }
+        }
+    }
+
+    void SimulcastEncoder::SetRates(uint32_t bitRate, int64_t frameRate)
+    {
+        m_layers.back()->SetRates(bitRate, frameRate);
+    }
+
+    void SimulcastEncoder::UpdateSettings()
+    {
+        for (const auto& layer : m_layers)
+        {
+            layer->UpdateSettings();
+        }
+    }
+
+    void SimulcastEncoder::SetSettings(std::shared_ptr<EncoderSettingsPublisher> settings)
+    {
+        for (const auto& layer : m_layers)
+        {
+            layer->SetSettings(settings);
+        }
+    }
+
+    void SimulcastEncoder::DetachControl()
+    {
+        IEncoder::DetachControl();
+        for (const auto& layer : m_layers)
+        {
+            layer->DetachControl();
+        }
+    }
+
+    void SimulcastEncoder::ResetControl()
+    {
+        IEncoder::ResetControl();
+        for (const auto& layer : m_layers)
+        {
+            layer->ResetControl();
+        }
+    }
+
+    bool SimulcastEncoder::CopyBuffer(void* frame)
+    {
+        for (size_t i = 0; i < m_layers.size(); i++)
+        {
+            if (!m_scaled[i])
+            {
+                m_copied[i] = m_layers[i]->CopyBuffer(frame);
+                continue;
+            }
+            m_copied[i] = m_layers[i]->ScaleBuffer(frame);
+            if (!m_copied[i])
+            {
+                LogPrint("Scaling the simulcast layer %d is failed", static_cast<int>(i));
+            }
+        }
+        // The full resolution must be sent, the lower layers are skipped when they fail.
+        return m_copied.back();
+    }
+
+    bool SimulcastEncoder::EncodeFrame()
+    {
+        for (size_t i = 0; i < m_layers.size(); i++)
+        {
+            m_layerFrames[i] = nullptr;
+            if (!m_copied[i])
+                continue;
+            m_encodingLayer = i;
+            if (!m_layers[i]->EncodeFrame())
+            {
+                LogPrint("Encoding the simulcast layer %d is failed", static_cast<int>(i));
+            }
+        }
+        const rtc::scoped_refptr<FrameBuffer> top = m_layerFrames.back();
+        if (top == nullptr)
+            return false;
+
+        const rtc::scoped_refptr<FrameBuffer> buffer =
+            new rtc::RefCountedObject<FrameBuffer>(top->width(), top->height(), top->buffer(), GetControl());
+        buffer->SetSimulcastLayers(m_layerFrames);
+        const webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+            .set_video_frame_buffer(buffer)
+            .set_timestamp_us(m_capturedTimestampUs)
+            .set_timestamp_rtp(0)
+            .set_ntp_time_ms(rtc::TimeMillis())
+            .build();
+        CaptureFrame(frame);
+        return true;
+    }
+
+    bool SimulcastEncoder::IsSupported() const
+    {
+        for (const auto& layer : m_layers)
+        {
+            if (!layer->IsSupported())
+                return false;
+        }
+        return true;
+    }
+
+    void SimulcastEncoder::SetIdrFrame()
+    {
+        for (const auto& layer : m_layers)
+        {
+            layer->SetIdrFrame();
+        }
+    }
+
+    uint64 SimulcastEncoder::GetCurrentFrameCount() const
+    {
+        return m_layers.back()->GetCurrentFrameCount();
+    }
+
+    void SimulcastEncoder::OnLayerFrame(const webrtc::VideoFrame& frame)
+    {
+        m_layerFrames[m_encodingLayer] = static_cast<FrameBuffer*>(frame.video_frame_buffer().get());
+        if (m_encodingLayer + 1 == m_layers.size())
+        {
+            m_capturedTimestampUs = frame.timestamp_us();
+        }
+    }
+
+} // end namespace webrtc
+} // end namespace unity
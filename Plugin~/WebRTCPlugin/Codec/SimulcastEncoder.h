@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Codec/IEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+    class FrameBuffer;
+
+    // Encodes the simulcast layers of a track from one captured texture.
+    // The lower layers are scaled down on the GPU, then each layer is encoded by its own hardware encoder.
+    // The captured frame carries the encoded layers in the order of the simulcast streams.
+    class SimulcastEncoder : public IEncoder, public sigslot::has_slots<>
+    {
+    public:
+        // The encoders are ordered by simulcast stream index, the last one encodes the full resolution.
+        // The layers which are not scaled copy the captured texture as it is.
+        SimulcastEncoder(std::vector<std::unique_ptr<IEncoder>> layers, std::vector<bool> scaled);
+        ~SimulcastEncoder() override;
+
+        void InitV() override;
+        // Used when the receiver does not accept simulcast, so only the full resolution is sent.
+        void SetRates(uint32_t bitRate, int64_t frameRate) override;
+        void UpdateSettings() override;
+        bool CopyBuffer(void* frame) override;
+        bool EncodeFrame() override;
+        bool IsSupported() const override;
+        void SetIdrFrame() override;
+        uint64 GetCurrentFrameCount() const override;
+        // The layers read the settings one after another in UpdateSettings.
+        void SetSettings(std::shared_ptr<EncoderSettingsPublisher> settings) override;
+        // The layer frames carry the controls of the layer encoders, which the senders of the track keep.
+        void DetachControl() override;
+        void ResetControl() override;
+
+        size_t GetLayerCount() const { return m_layers.size(); }
+        IEncoder* GetLayer(size_t index) const { return m_layers[index].get(); }
+
+    private:
+        void OnLayerFrame(const webrtc::VideoFrame& frame);
+
+        std::vector<std::unique_ptr<IEncoder>> m_layers;
+        std::vector<bool> m_scaled;
+        // Whether each layer was copied for the current frame.
+        std::vector<bool> m_copied;
+        // The layer encoders capture their frames synchronously while the layer is encoded.
+        std::vector<rtc::scoped_refptr<FrameBuffer>> m_layerFrames;
+        size_t m_encodingLayer = 0;
+        int64_t m_capturedTimestampUs = 0;
+    };
+
+} // end namespace webrtc
+} // end namespace unity
@@ -3,6 +3,7 @@
 #include "Context.h"
 #include <cstring>
 #include "GraphicsDevice/IGraphicsDevice.h"
+#include "WebRTCMacros.h"
 
 #if _WIN32
 #else
@@ -14,28 +15,166 @@ namespace unity
 namespace webrtc
 {
 
-    SoftwareEncoder::SoftwareEncoder(int _width, int _height, IGraphicsDevice* device) : m_width(_width), m_height(_height), m_device(device)
+    SoftwareEncoder::SoftwareEncoder(int _width, int _height, IGraphicsDevice* device, const ColorConversionOptions& options,
+        uint32 bufferCount)
+        : m_device(device)
+        , m_bufferCount(std::max(1u, std::min(bufferCount, maxEncoderBufferCount)))
+        , m_width(_width), m_height(_height), m_options(options)
     {
+        m_options.bufferPool = &m_bufferPool;
+    }
 
+    SoftwareEncoder::~SoftwareEncoder()
+    {
+        DeleteTextures();
     }
 
     void SoftwareEncoder::InitV()
     {
-        m_encodeTex = m_device->CreateCPUReadTextureV(m_width, m_height);
+        if (m_device->GetDeviceType() != GRAPHICS_DEVICE_CPU)
+            m_bufferCount = 1;
+        m_encodeTextures.resize(m_bufferCount, nullptr);
+        m_adaptedBuffers.resize(m_bufferCount);
+        CreateTextures();
         m_initializationResult = CodecInitializationResult::Success;
     }
 
-    bool SoftwareEncoder::CopyBuffer(void* frame)
+    bool SoftwareEncoder::Resize(int width, int height)
+    {
+        if (width <= 0 || height <= 0)
+            return false;
+        if (width == m_width && height == m_height)
+            return true;
+        DeleteTextures();
+        m_width = width;
+        m_height = height;
+        CreateTextures();
+        return true;
+    }
+
+    void SoftwareEncoder::CreateTextures()
+    {
+        for (ITexture2D*& tex : m_encodeTextures)
+        {
+            tex = m_device->CreateCPUReadTextureV(m_width, m_height);
+        }
+    }
+
+    void SoftwareEncoder::DeleteTextures()
+    {
+        for (ITexture2D*& tex : m_encodeTextures)
+        {
+            SAFE_DELETE(tex);
+        }
+        for (AdaptedBuffer& buffer : m_adaptedBuffers)
+        {
+            SAFE_DELETE(buffer.scaledTexture);
+            buffer.scaled = false;
+        }
+    }
+
+    void SoftwareEncoder::SetAdaptation(uint32 bufferIndex, const FrameAdaptation& adaptation)
+    {
+        if (bufferIndex < m_adaptedBuffers.size())
+            m_adaptedBuffers[bufferIndex].adaptation = adaptation;
+    }
+
+    bool SoftwareEncoder::CopyScaledBuffer(void* frame, AdaptedBuffer& buffer)
     {
-        m_device->CopyResourceFromNativeV(m_encodeTex, frame);
+        // The devices only scale whole textures, so the frame is scaled as the crop is and cropped once it is
+        // converted. Frames which are not scaled down are copied at full size and cropped on the CPU.
+        const FrameAdaptation& adaptation = buffer.adaptation;
+        if (m_scaledCopyUnsupported || adaptation.scaleWidth <= 0 || adaptation.scaleHeight <= 0 ||
+            adaptation.cropWidth <= 0 || adaptation.cropHeight <= 0 ||
+            adaptation.cropX + adaptation.cropWidth > m_width || adaptation.cropY + adaptation.cropHeight > m_height ||
+            adaptation.scaleWidth > adaptation.cropWidth || adaptation.scaleHeight > adaptation.cropHeight ||
+            (adaptation.scaleWidth == adaptation.cropWidth && adaptation.scaleHeight == adaptation.cropHeight))
+        {
+            return false;
+        }
+        const int width = m_width * adaptation.scaleWidth / adaptation.cropWidth;
+        const int height = m_height * adaptation.scaleHeight / adaptation.cropHeight;
+        FrameAdaptation& scaledAdaptation = buffer.scaledAdaptation;
+        scaledAdaptation.cropX = adaptation.cropX * adaptation.scaleWidth / adaptation.cropWidth;
+        scaledAdaptation.cropY = adaptation.cropY * adaptation.scaleHeight / adaptation.cropHeight;
+        scaledAdaptation.cropWidth = adaptation.scaleWidth;
+        scaledAdaptation.cropHeight = adaptation.scaleHeight;
+        scaledAdaptation.scaleWidth = adaptation.scaleWidth;
+        scaledAdaptation.scaleHeight = adaptation.scaleHeight;
+        if (buffer.scaledTexture != nullptr &&
+            !buffer.scaledTexture->IsSize(static_cast<uint32_t>(width), static_cast<uint32_t>(height)))
+        {
+            SAFE_DELETE(buffer.scaledTexture);
+        }
+        if (buffer.scaledTexture == nullptr)
+        {
+            buffer.scaledTexture = m_device->CreateCPUReadTextureV(width, height);
+        }
+        if (buffer.scaledTexture == nullptr || !m_device->ScaleResourceFromNativeV(buffer.scaledTexture, frame))
+        {
+            m_scaledCopyUnsupported = true;
+            SAFE_DELETE(buffer.scaledTexture);
+            return false;
+        }
         return true;
     }
 
+    rtc::scoped_refptr<webrtc::I420Buffer> SoftwareEncoder::Adapt(
+        const rtc::scoped_refptr<webrtc::I420Buffer>& i420Buffer, const FrameAdaptation& adaptation)
+    {
+        if (adaptation.scaleWidth <= 0 || adaptation.scaleHeight <= 0 ||
+            (adaptation.scaleWidth == i420Buffer->width() && adaptation.scaleHeight == i420Buffer->height()))
+        {
+            return i420Buffer;
+        }
+        // The adaptation was computed for the size of the texture, which may have changed since.
+        if (adaptation.cropX + adaptation.cropWidth > i420Buffer->width() ||
+            adaptation.cropY + adaptation.cropHeight > i420Buffer->height())
+        {
+            return i420Buffer;
+        }
+        const rtc::scoped_refptr<webrtc::I420Buffer> scaled =
+            m_scaledBufferPool.CreateBuffer(adaptation.scaleWidth, adaptation.scaleHeight);
+        scaled->CropAndScaleFrom(*i420Buffer,
+            adaptation.cropX, adaptation.cropY, adaptation.cropWidth, adaptation.cropHeight);
+        return scaled;
+    }
+
+    bool SoftwareEncoder::CopyBuffer(void* frame)
+    {
+        return CopyBufferAt(frame, 0);
+    }
+
+    bool SoftwareEncoder::CopyBufferAt(void* frame, uint32 bufferIndex)
+    {
+        AdaptedBuffer& buffer = m_adaptedBuffers[bufferIndex];
+        const bool scaled = CopyScaledBuffer(frame, buffer);
+        // Some devices read the textures back a few frames late, so the texture which was not copied into
+        // while the frames were scaled holds an old frame.
+        if (!scaled && buffer.scaled)
+        {
+            SAFE_DELETE(buffer.scaledTexture);
+            SAFE_DELETE(m_encodeTextures[bufferIndex]);
+            m_encodeTextures[bufferIndex] = m_device->CreateCPUReadTextureV(m_width, m_height);
+        }
+        buffer.scaled = scaled;
+        // The frame is skipped when it can not be copied, instead of encoding what the texture held before.
+        return scaled || m_device->CopyResourceFromNativeV(m_encodeTextures[bufferIndex], frame);
+    }
+
     bool SoftwareEncoder::EncodeFrame()
     {
-        const rtc::scoped_refptr<webrtc::I420Buffer> i420Buffer = m_device->ConvertRGBToI420(m_encodeTex);
+        return EncodeFrameAt(0);
+    }
+
+    bool SoftwareEncoder::EncodeFrameAt(uint32 bufferIndex)
+    {
+        const AdaptedBuffer& buffer = m_adaptedBuffers[bufferIndex];
+        rtc::scoped_refptr<webrtc::I420Buffer> i420Buffer = m_device->ConvertRGBToI420(
+            buffer.scaled ? buffer.scaledTexture : m_encodeTextures[bufferIndex], m_options);
         if (nullptr == i420Buffer)
             return false;
+        i420Buffer = Adapt(i420Buffer, buffer.scaled ? buffer.scaledAdaptation : buffer.adaptation);
 
         webrtc::VideoFrame frame = webrtc::VideoFrame::Builder().set_video_frame_buffer(i420Buffer).set_rotation(webrtc::kVideoRotation_0).set_timestamp_us(0).build();
         CaptureFrame(frame);
@@ -3,6 +3,8 @@
 #include <thread>
 #include <atomic>
 #include "Codec/IEncoder.h"
+#include "GraphicsDevice/GraphicsUtility.h"
+#include "GraphicsDevice/I420FrameBufferPool.h"
 
 namespace unity
 {
@@ -14,7 +16,9 @@ namespace webrtc
     class SoftwareEncoder : public IEncoder
     {
     public:
-        SoftwareEncoder(int _width, int _height, IGraphicsDevice* device);
+        SoftwareEncoder(int _width, int _height, IGraphicsDevice* device,
+            const ColorConversionOptions& options = ColorConversionOptions(), uint32 bufferCount = bufferedFrameNum);
+        ~SoftwareEncoder() override;
         void InitV() override;
         void SetRates(uint32_t bitRate, int64_t frameRate) override {}
         void UpdateSettings() override {}
@@ -23,13 +27,46 @@ namespace webrtc
         bool IsSupported() const override { return true; }
         void SetIdrFrame() override {}
         uint64 GetCurrentFrameCount() const override { return m_frameCount; }
+        uint32 GetBufferCount() const override { return m_bufferCount > 1 ? m_bufferCount : 0; }
+        bool CopyBufferAt(void* frame, uint32 bufferIndex) override;
+        bool EncodeFrameAt(uint32 bufferIndex) override;
+        // The buffer is copied scaled down on the GPU when the device supports it, so that less pixels are
+        // read back and converted. Otherwise the converted frame is cropped and scaled.
+        void SetAdaptation(uint32 bufferIndex, const FrameAdaptation& adaptation) override;
+        // Only the readback textures depend on the size, the frames are converted at the size of the texture.
+        bool Resize(int width, int height) override;
+        const I420FrameBufferPool& GetBufferPool() const { return m_bufferPool; }
 
     private:
+        // The adaptation of the frame in a buffer, which the copy and the conversion of the frame apply.
+        struct AdaptedBuffer
+        {
+            FrameAdaptation adaptation;
+            ITexture2D* scaledTexture = nullptr;
+            // Whether the frame was copied into the scaled texture.
+            bool scaled = false;
+            // The crop of the scaled texture, which holds the whole frame scaled as the crop is.
+            FrameAdaptation scaledAdaptation;
+        };
+
+        void CreateTextures();
+        void DeleteTextures();
+        bool CopyScaledBuffer(void* frame, AdaptedBuffer& buffer);
+        rtc::scoped_refptr<webrtc::I420Buffer> Adapt(
+            const rtc::scoped_refptr<webrtc::I420Buffer>& i420Buffer, const FrameAdaptation& adaptation);
+
         IGraphicsDevice* m_device;
-        ITexture2D* m_encodeTex;
+        // Only the CPU device converts without the graphics API, so the other devices have no extra buffers.
+        std::vector<ITexture2D*> m_encodeTextures;
+        std::vector<AdaptedBuffer> m_adaptedBuffers;
+        bool m_scaledCopyUnsupported = false;
+        I420FrameBufferPool m_scaledBufferPool;
+        uint32 m_bufferCount;
         int m_width = 1920;
         int m_height = 1080;
-        uint64 m_frameCount = 0;
+        std::atomic<uint64> m_frameCount{ 0 };
+        ColorConversionOptions m_options;
+        I420FrameBufferPool m_bufferPool;
     };
 //---------------------------------------------------------------------------------------------------------------------
     
@@ -10,7 +10,7 @@ namespace webrtc
 
     class VTEncoderMetal : public IEncoder{
     public:
-        VTEncoderMetal(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device);
+        VTEncoderMetal(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device, uint32_t bufferCount = bufferedFrameNum);
         ~VTEncoderMetal();
         void SetRates(uint32_t bitRate, int64_t frameRate) override {};
         void UpdateSettings() override {};
@@ -25,9 +25,10 @@ namespace webrtc
         uint64 m_width = 0;
         uint64 m_height = 0;
         IGraphicsDevice* m_device;
-        ITexture2D* renderTextures[bufferedFrameNum];
-        CVPixelBufferRef pixelBuffers[bufferedFrameNum];
-        std::vector<uint8> encodedBuffers[bufferedFrameNum];
+        uint32 m_bufferCount;
+        std::vector<ITexture2D*> renderTextures;
+        std::vector<CVPixelBufferRef> pixelBuffers;
+        std::vector<std::vector<uint8>> encodedBuffers;
 
         VTCompressionSessionRef encoderSession;
     };
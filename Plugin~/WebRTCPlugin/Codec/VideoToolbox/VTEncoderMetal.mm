@@ -139,8 +139,12 @@ namespace webrtc
         encoder->CaptureFrame(*encodedFrame);
     }
 
-    VTEncoderMetal::VTEncoderMetal(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device)
-        : m_device(device), m_width(nWidth), m_height(nHeight)
+    VTEncoderMetal::VTEncoderMetal(uint32_t nWidth, uint32_t nHeight, IGraphicsDevice* device, uint32_t bufferCount)
+        : m_width(nWidth), m_height(nHeight), m_device(device)
+        , m_bufferCount(std::max(1u, std::min(bufferCount, maxEncoderBufferCount)))
+        , renderTextures(m_bufferCount, nullptr)
+        , pixelBuffers(m_bufferCount, nullptr)
+        , encodedBuffers(m_bufferCount)
     {
         OSStatus status = VTCompressionSessionCreate(NULL, nWidth, nHeight,
                                                      kCMVideoCodecType_H264,
@@ -154,7 +158,7 @@ namespace webrtc
             // return false;
         }
     
-        for(NSInteger i = 0; i < bufferedFrameNum; i++)
+        for(NSInteger i = 0; i < m_bufferCount; i++)
         {
             CVPixelBufferPoolRef pixelBufferPool; // Pool to precisely match the format
             pixelBufferPool = VTCompressionSessionGetPixelBufferPool(encoderSession);
@@ -204,7 +208,7 @@ namespace webrtc
 
     bool VTEncoderMetal::CopyBuffer(void* frame)
     {
-        const int curFrameNum = GetCurrentFrameCount() % bufferedFrameNum;
+        const int curFrameNum = GetCurrentFrameCount() % m_bufferCount;
         const auto tex = renderTextures[curFrameNum];
         if (tex == nullptr)
             return false;
@@ -214,7 +218,7 @@ namespace webrtc
     bool VTEncoderMetal::EncodeFrame()
     {
         UpdateSettings();
-        uint32 bufferIndexToWrite = frameCount % bufferedFrameNum;
+        uint32 bufferIndexToWrite = frameCount % m_bufferCount;
 
         CMTime presentationTimeStamp = CMTimeMake(frameCount, 1000);
         VTEncodeInfoFlags flags;
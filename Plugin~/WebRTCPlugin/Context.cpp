@@ -4,6 +4,7 @@
 
 #include "Codec/NvCodec/NvEncoder.h"
 #include "DummyVideoEncoder.h"
+#include "GraphicsDevice/CPU/CPUGraphicsDevice.h"
 #include "MediaStreamObserver.h"
 #include "SetSessionDescriptionObserver.h"
 #include "UnityVideoEncoderFactory.h"
@@ -72,11 +73,6 @@ namespace webrtc
         m_contexts.clear();
     }
 
-#pragma region open an encode session
-    uint32_t Context::s_encoderId = 0;
-    uint32_t Context::GenerateUniqueId() { return s_encoderId++; }
-#pragma endregion 
-
     bool Convert(const std::string& str, webrtc::PeerConnectionInterface::RTCConfiguration& config)
     {
         config = webrtc::PeerConnectionInterface::RTCConfiguration{};
@@ -151,7 +147,9 @@ namespace webrtc
     Context::Context(int uid, UnityEncoderType encoderType)
         : m_uid(uid)
         , m_encoderType(encoderType)
+        , m_workerPool(std::make_unique<WorkerPool>())
     {
+        m_colorConversionOptions.workerPool = m_workerPool.get();
         m_workerThread.reset(new rtc::Thread(rtc::SocketServer::CreateDefault()));
         m_workerThread->Start();
         m_signalingThread.reset(new rtc::Thread(rtc::SocketServer::CreateDefault()));
@@ -163,12 +161,12 @@ namespace webrtc
 
 #if defined(SUPPORT_METAL) && defined(SUPPORT_SOFTWARE_ENCODER)
         //Always use SoftwareEncoder on Mac for now.
-        std::unique_ptr<webrtc::VideoEncoderFactory> videoEncoderFactory = webrtc::CreateBuiltinVideoEncoderFactory();
+        std::unique_ptr<webrtc::VideoEncoderFactory> videoEncoderFactory = std::make_unique<UnityVideoEncoderFactory>(
+            UnityEncoderType::UnityEncoderSoftware, [this]() { return GetVideoEncoderCoreCount(); });
         std::unique_ptr<webrtc::VideoDecoderFactory> videoDecoderFactory = webrtc::CreateBuiltinVideoDecoderFactory();
 #else
         std::unique_ptr<webrtc::VideoEncoderFactory> videoEncoderFactory =
-            m_encoderType == UnityEncoderType::UnityEncoderHardware ?
-            std::make_unique<UnityVideoEncoderFactory>(static_cast<IVideoEncoderObserver*>(this)) : webrtc::CreateBuiltinVideoEncoderFactory();
+            std::make_unique<UnityVideoEncoderFactory>(m_encoderType, [this]() { return GetVideoEncoderCoreCount(); });
         std::unique_ptr<webrtc::VideoDecoderFactory> videoDecoderFactory =
             m_encoderType == UnityEncoderType::UnityEncoderHardware ?
             std::make_unique<UnityVideoDecoderFactory>() : webrtc::CreateBuiltinVideoDecoderFactory();
@@ -192,9 +190,13 @@ namespace webrtc
         m_peerConnectionFactory = nullptr;
         m_audioTrack = nullptr;
 
-        m_mapIdAndEncoder.clear();
         m_mediaSteamTrackList.clear();
         m_mapClients.clear();
+        for (const auto& pair : m_mapFrameBuffer)
+        {
+            CPUGraphicsDevice::UnregisterBuffer(pair.second);
+        }
+        m_mapFrameBuffer.clear();
         m_mapVideoCapturer.clear();
         m_mapMediaStream.clear();
         m_mapMediaStreamObserver.clear();
@@ -215,20 +217,42 @@ namespace webrtc
             return false;
         }
 
-        m_mapVideoCapturer[track]->SetEncoder(encoder);
-
-        uint32_t id = GenerateUniqueId();
-        encoder->SetEncoderId(id);
-        m_mapIdAndEncoder[id] = encoder;
+        auto it = m_mapVideoEncoderParameter.find(track);
+        if (it != m_mapVideoEncoderParameter.end() && it->second != nullptr)
+        {
+            encoder->SetSettings(it->second->settings);
+        }
+        m_mapVideoCapturer[track]->SetEncoder(encoder, m_encoderQueuePolicy);
         return true;
     }
 
     bool Context::FinalizeEncoder(IEncoder* encoder)
     {
-        m_mapIdAndEncoder.erase(encoder->Id());
+        // Stop the encoder thread of the track before the encoder is destroyed.
+        for (auto& pair : m_mapVideoCapturer)
+        {
+            if (pair.second != nullptr && pair.second->GetEncoder() == encoder)
+            {
+                pair.second->SetEncoder(nullptr);
+            }
+        }
+        // The senders call the encoder from their own threads, so detach it before it is destroyed.
+        encoder->DetachControl();
         return true;
     }
 
+    bool Context::ResizeEncoder(IEncoder* encoder, webrtc::MediaStreamTrackInterface* track, int width, int height)
+    {
+        auto it = m_mapVideoCapturer.find(track);
+        if (it == m_mapVideoCapturer.end() || it->second == nullptr || it->second->GetEncoder() != encoder)
+            return false;
+        // The encoder thread of the track may use the buffers which are created again.
+        it->second->SetEncoder(nullptr);
+        const bool resized = encoder->Resize(width, height);
+        it->second->SetEncoder(encoder, m_encoderQueuePolicy);
+        return resized;
+    }
+
     bool Context::EncodeFrame(webrtc::MediaStreamTrackInterface* track)
     {
         auto it = m_mapVideoCapturer.find(track);
@@ -239,29 +263,98 @@ namespace webrtc
         return true;
     }
 
+    int Context::GetVideoEncoderCoreCount() const
+    {
+        if (m_videoEncoderCoreCount > 0)
+            return m_videoEncoderCoreCount;
+        // The cores which do not convert frames are left to the encoder.
+        const int cores = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, cores - GetConversionThreadCount());
+    }
+
+    bool Context::GetEncoderQueueStats(const webrtc::MediaStreamTrackInterface* track, EncoderQueueStats* stats)
+    {
+        auto it = m_mapVideoCapturer.find(track);
+        if (it == m_mapVideoCapturer.end() || it->second == nullptr)
+            return false;
+        return it->second->GetEncoderQueueStats(stats);
+    }
+
+    bool Context::GetEncoderBitrateStats(const webrtc::MediaStreamTrackInterface* track, EncoderBitrateStats* stats)
+    {
+        auto it = m_mapVideoCapturer.find(track);
+        if (it == m_mapVideoCapturer.end() || it->second == nullptr || it->second->GetEncoder() == nullptr)
+            return false;
+        *stats = it->second->GetEncoder()->GetControl()->GetBitrateStats();
+        return true;
+    }
+
     const VideoEncoderParameter* Context::GetEncoderParameter(const webrtc::MediaStreamTrackInterface* track)
     {
         return m_mapVideoEncoderParameter[track].get();
     }
 
-    void Context::SetEncoderParameter(const webrtc::MediaStreamTrackInterface* track, int width, int height)
+    bool Context::SetEncoderBufferCount(const webrtc::MediaStreamTrackInterface* track, int bufferCount)
+    {
+        auto it = m_mapVideoEncoderParameter.find(track);
+        if (it == m_mapVideoEncoderParameter.end() || it->second == nullptr ||
+            bufferCount < 1 || bufferCount > static_cast<int>(maxEncoderBufferCount))
+            return false;
+        it->second->bufferCount = static_cast<uint32>(bufferCount);
+        return true;
+    }
+
+    bool Context::SetEncoderMaxSize(const webrtc::MediaStreamTrackInterface* track, int maxWidth, int maxHeight)
     {
-        m_mapVideoEncoderParameter[track] = std::make_unique<VideoEncoderParameter>(width, height);
+        auto it = m_mapVideoEncoderParameter.find(track);
+        if (it == m_mapVideoEncoderParameter.end() || it->second == nullptr || maxWidth < 0 || maxHeight < 0)
+            return false;
+        it->second->maxWidth = maxWidth;
+        it->second->maxHeight = maxHeight;
+        return true;
     }
 
-    void Context::SetKeyFrame(uint32_t id)
+    bool Context::SetEncoderSimulcastLayers(const webrtc::MediaStreamTrackInterface* track,
+        const float* scaleResolutionDownBy, int layerCount)
     {
-        if (m_mapIdAndEncoder.count(id))
+        auto it = m_mapVideoEncoderParameter.find(track);
+        if (it == m_mapVideoEncoderParameter.end() || it->second == nullptr || layerCount < 0)
+            return false;
+        // The simulcast streams of WebRTC are ordered from the lowest resolution.
+        for (int i = 1; i < layerCount; i++)
         {
-            m_mapIdAndEncoder[id]->SetIdrFrame();
+            if (scaleResolutionDownBy[i] > scaleResolutionDownBy[i - 1])
+                return false;
         }
+        it->second->scaleResolutionDownBy.assign(scaleResolutionDownBy, scaleResolutionDownBy + layerCount);
+        return true;
+    }
+
+    bool Context::SetEncoderSettings(const webrtc::MediaStreamTrackInterface* track, const EncoderSettings& settings)
+    {
+        auto it = m_mapVideoEncoderParameter.find(track);
+        if (it == m_mapVideoEncoderParameter.end() || it->second == nullptr)
+            return false;
+        it->second->settings->Publish(settings);
+        return true;
     }
 
-    void Context::SetRates(uint32_t id, uint32_t bitRate, int64_t frameRate)
+    void Context::SetEncoderParameter(const webrtc::MediaStreamTrackInterface* track, int width, int height)
     {
-        if(m_mapIdAndEncoder.count(id))
+        auto param = std::make_unique<VideoEncoderParameter>(width, height);
+        // The encoder of the track keeps the settings and its maximum size when the size changes.
+        auto it = m_mapVideoEncoderParameter.find(track);
+        if (it != m_mapVideoEncoderParameter.end() && it->second != nullptr)
         {
-            m_mapIdAndEncoder[id]->SetRates(bitRate, frameRate);
+            param->settings = it->second->settings;
+            param->maxWidth = it->second->maxWidth;
+            param->maxHeight = it->second->maxHeight;
+        }
+        m_mapVideoEncoderParameter[track] = std::move(param);
+        auto capturer = m_mapVideoCapturer.find(track);
+        if (capturer != m_mapVideoCapturer.end() && capturer->second != nullptr)
+        {
+            capturer->second->SetFrameSize(width, height);
         }
     }
 
@@ -326,9 +419,30 @@ namespace webrtc
 
     void Context::DeleteMediaStreamTrack(webrtc::MediaStreamTrackInterface* track)
     {
+        UnregisterFrameBuffer(track);
         track->Release();
     }
 
+    bool Context::RegisterFrameBuffer(const webrtc::MediaStreamTrackInterface* track, int size)
+    {
+        auto it = m_mapVideoCapturer.find(track);
+        if (it == m_mapVideoCapturer.end() || it->second == nullptr || it->second->GetFrame() == nullptr || size <= 0)
+            return false;
+        UnregisterFrameBuffer(track);
+        m_mapFrameBuffer[track] = it->second->GetFrame();
+        CPUGraphicsDevice::RegisterBuffer(it->second->GetFrame(), static_cast<size_t>(size));
+        return true;
+    }
+
+    void Context::UnregisterFrameBuffer(const webrtc::MediaStreamTrackInterface* track)
+    {
+        auto it = m_mapFrameBuffer.find(track);
+        if (it == m_mapFrameBuffer.end())
+            return;
+        CPUGraphicsDevice::UnregisterBuffer(it->second);
+        m_mapFrameBuffer.erase(it);
+    }
+
     void Context::ProcessAudioData(const float* data, int32 size)
     {
         m_audioDevice->ProcessAudioData(data, size);
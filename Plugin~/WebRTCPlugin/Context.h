@@ -4,6 +4,10 @@
 #include "DummyVideoEncoder.h"
 #include "PeerConnectionObject.h"
 #include "Codec/IEncoder.h"
+#include "Codec/EncoderSettings.h"
+#include "EncoderThread.h"
+#include "GraphicsDevice/GraphicsUtility.h"
+#include "WorkerPool.h"
 
 namespace unity
 {
@@ -37,10 +41,20 @@ namespace webrtc
     {
         int width;
         int height;
-        VideoEncoderParameter(int width, int height) :width(width), height(height) { }
+        // Divisor of the size for each simulcast layer, in the order of the send encodings from the lowest resolution.
+        std::vector<float> scaleResolutionDownBy;
+        // Depth of the ring of frames held by the encoder, from 1 to maxEncoderBufferCount.
+        uint32 bufferCount = bufferedFrameNum;
+        // The largest size which the hardware encoder can be resized to without a new session, 0 for the initial size.
+        int maxWidth = 0;
+        int maxHeight = 0;
+        // Shared with the encoder of the track, which reads a snapshot before each frame.
+        std::shared_ptr<EncoderSettingsPublisher> settings;
+        VideoEncoderParameter(int width, int height)
+            : width(width), height(height), settings(std::make_shared<EncoderSettingsPublisher>()) { }
     };
 
-    class Context : public IVideoEncoderObserver
+    class Context
     {
     public:
         
@@ -49,7 +63,22 @@ namespace webrtc
 
         // Utility
         UnityEncoderType GetEncoderType() const;
+        // Options used by the software encoder which are created after calling the setter.
+        // The rendering thread reads them while it holds the mutex, which the setter takes.
+        ColorConversionOptions GetColorConversionOptions() const { return m_colorConversionOptions; }
+        void SetChromaSubsampling(ChromaSubsampling chromaSubsampling)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            m_colorConversionOptions.chromaSubsampling = chromaSubsampling;
+        }
+        // Number of threads converting a frame for the software encoder, including the render thread.
+        int GetConversionThreadCount() const { return m_workerPool->GetThreadCount(); }
+        void SetConversionThreadCount(int threadCount) { m_workerPool->SetThreadCount(threadCount); }
         CodecInitializationResult GetInitializationResult(webrtc::MediaStreamTrackInterface* track);
+        // Number of cores each VP8, VP9 or AV1 encoder of the software encoder may use, applied to the encoders
+        // created after the call. 0 leaves the cores which do not convert frames to the encoders.
+        int GetVideoEncoderCoreCount() const;
+        void SetVideoEncoderCoreCount(int coreCount) { m_videoEncoderCoreCount = coreCount; }
 
         // MediaStream
         webrtc::MediaStreamInterface* CreateMediaStream(const std::string& streamId);
@@ -61,6 +90,10 @@ namespace webrtc
         webrtc::VideoTrackInterface* CreateVideoTrack(const std::string& label, void* frame);
         webrtc::AudioTrackInterface* CreateAudioTrack(const std::string& label);
         void DeleteMediaStreamTrack(webrtc::MediaStreamTrackInterface* track);
+        // With the null renderer, the frames of a video track are read from the BGRA32 pixels which it was created
+        // with. The buffer is read until it is unregistered or the track is deleted.
+        bool RegisterFrameBuffer(const webrtc::MediaStreamTrackInterface* track, int size);
+        void UnregisterFrameBuffer(const webrtc::MediaStreamTrackInterface* track);
         void StopMediaStreamTrack(webrtc::MediaStreamTrackInterface* track);
         void ProcessAudioData(const float* data, int32 size);
 
@@ -85,10 +118,24 @@ namespace webrtc
         // You must call these methods on Rendering thread.
         bool InitializeEncoder(IEncoder* encoder, webrtc::MediaStreamTrackInterface* track);
         bool FinalizeEncoder(IEncoder* encoder);
+        // Keeps the encoder of the track, and its sender, when only the size of the frames changes.
+        bool ResizeEncoder(IEncoder* encoder, webrtc::MediaStreamTrackInterface* track, int width, int height);
         // You must call these methods on Rendering thread.
         bool EncodeFrame(webrtc::MediaStreamTrackInterface* track);
         const VideoEncoderParameter* GetEncoderParameter(const webrtc::MediaStreamTrackInterface* track);
         void SetEncoderParameter(const webrtc::MediaStreamTrackInterface* track, int width, int height);
+        // Call these after SetEncoderParameter and before the encoder is initialized.
+        bool SetEncoderBufferCount(const webrtc::MediaStreamTrackInterface* track, int bufferCount);
+        bool SetEncoderMaxSize(const webrtc::MediaStreamTrackInterface* track, int maxWidth, int maxHeight);
+        bool SetEncoderSimulcastLayers(const webrtc::MediaStreamTrackInterface* track,
+            const float* scaleResolutionDownBy, int layerCount);
+        // Published to the encoder of the track, which applies them before its next frame.
+        bool SetEncoderSettings(const webrtc::MediaStreamTrackInterface* track, const EncoderSettings& settings);
+        // Applied to the encoders initialized after the call.
+        void SetEncoderQueuePolicy(EncoderQueuePolicy policy) { m_encoderQueuePolicy = policy; }
+        bool GetEncoderQueueStats(const webrtc::MediaStreamTrackInterface* track, EncoderQueueStats* stats);
+        // How far the frames which the track sent overshoot the target of the congestion controller.
+        bool GetEncoderBitrateStats(const webrtc::MediaStreamTrackInterface* track, EncoderBitrateStats* stats);
 
         // mutex;
         std::mutex mutex;
@@ -96,6 +143,10 @@ namespace webrtc
     private:
         int m_uid;
         UnityEncoderType m_encoderType;
+        ColorConversionOptions m_colorConversionOptions;
+        EncoderQueuePolicy m_encoderQueuePolicy = EncoderQueuePolicy::DropOldest;
+        std::atomic<int> m_videoEncoderCoreCount{ 0 };
+        std::unique_ptr<WorkerPool> m_workerPool;
         std::unique_ptr<rtc::Thread> m_workerThread;
         std::unique_ptr<rtc::Thread> m_signalingThread;
         rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> m_peerConnectionFactory;
@@ -105,23 +156,12 @@ namespace webrtc
         std::vector<rtc::scoped_refptr<const webrtc::RTCStatsReport>> m_listStatsReport;
         std::map<const PeerConnectionObject*, rtc::scoped_refptr<PeerConnectionObject>> m_mapClients;
         std::map<const webrtc::MediaStreamTrackInterface*, UnityVideoTrackSource*> m_mapVideoCapturer;
+        std::map<const webrtc::MediaStreamTrackInterface*, const void*> m_mapFrameBuffer;
         std::map<const std::string, rtc::scoped_refptr<webrtc::MediaStreamInterface>> m_mapMediaStream;
         std::map<const webrtc::MediaStreamInterface*, std::unique_ptr<MediaStreamObserver>> m_mapMediaStreamObserver;
         std::map<const webrtc::PeerConnectionInterface*, rtc::scoped_refptr<SetSessionDescriptionObserver>> m_mapSetSessionDescriptionObserver;
         std::map<const webrtc::MediaStreamTrackInterface*, std::unique_ptr<VideoEncoderParameter>> m_mapVideoEncoderParameter;
         std::map<const DataChannelObject*, std::unique_ptr<DataChannelObject>> m_mapDataChannels;
-
-        // todo(kazuki): remove map after moving hardware encoder instance to DummyVideoEncoder.
-        std::map<const uint32_t, IEncoder*> m_mapIdAndEncoder;
-
-        // todo(kazuki): remove these callback methods by moving hardware encoder instance to DummyVideoEncoder.
-        //               attention point is multi-threaded opengl implementation with nvcodec.
-        void SetKeyFrame(uint32_t id) override;
-        void SetRates(uint32_t id, uint32_t bitRate, int64_t frameRate) override;
-
-        // todo(kazuki): static variable to set id each encoder.
-        static uint32_t s_encoderId;
-        static uint32_t GenerateUniqueId();
     };
 
     extern bool Convert(const std::string& str, webrtc::PeerConnectionInterface::RTCConfiguration& config);
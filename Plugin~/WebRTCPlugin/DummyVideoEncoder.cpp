@@ -7,13 +7,28 @@ namespace unity
 namespace webrtc
 {
 
-    DummyVideoEncoder::DummyVideoEncoder(IVideoEncoderObserver* observer)
-        : m_encode_fps(1000, 1000)
+    // Bounds of the bitrate set to an encoder, relative to the target. An encoder which undershoots is allowed a
+    // little above the target, but only while the stream stays under the target. One which overshoots is lowered
+    // further.
+    static const float minAdjustedBitrateRatio = 0.5f;
+    static const float maxAdjustedBitrateRatio = 1.2f;
+
+    DummyVideoEncoder::DummyVideoEncoder()
+        : m_streams(CreateStreams(1))
+        , m_encode_fps(1000, 1000)
         , m_clock(webrtc::Clock::GetRealTimeClock())
-        , m_bitrateAdjuster(std::make_unique<webrtc::BitrateAdjuster>(0.5f, 0.95f))
     {
-        this->m_setKeyFrame.connect(observer, &IVideoEncoderObserver::SetKeyFrame);
-        this->m_setRates.connect(observer, &IVideoEncoderObserver::SetRates);
+    }
+
+    std::vector<DummyVideoEncoder::Stream> DummyVideoEncoder::CreateStreams(size_t count)
+    {
+        std::vector<Stream> streams(count);
+        for (Stream& stream : streams)
+        {
+            stream.bitrateAdjuster =
+                std::make_unique<webrtc::BitrateAdjuster>(minAdjustedBitrateRatio, maxAdjustedBitrateRatio);
+        }
+        return streams;
     }
 
     int32_t DummyVideoEncoder::InitEncode(const webrtc::VideoCodec* codec_settings, int32_t number_of_cores, size_t max_payload_size)
@@ -37,6 +52,7 @@ namespace webrtc
         }
 
         m_codec = *codec_settings;
+        m_streams = CreateStreams(std::max<size_t>(1, m_codec.numberOfSimulcastStreams));
         webrtc::SimulcastRateAllocator init_allocator(m_codec);
         webrtc::VideoBitrateAllocation allocation =
             init_allocator.Allocate(webrtc::VideoBitrateAllocationParameters(
@@ -55,88 +71,208 @@ namespace webrtc
     int32_t DummyVideoEncoder::Release()
     {
         this->callback = nullptr;
-        this->m_setKeyFrame.disconnect_all();
-        this->m_setRates.disconnect_all();
+        for (Stream& stream : m_streams)
+        {
+            stream.encoderControl = nullptr;
+        }
         return WEBRTC_VIDEO_CODEC_OK;
     }
 
     int32_t DummyVideoEncoder::Encode(const webrtc::VideoFrame& frame, const std::vector<webrtc::VideoFrameType>* frameTypes)
     {
         FrameBuffer* frameBuffer = static_cast<FrameBuffer*>(frame.video_frame_buffer().get());
-        std::vector<uint8_t>& frameDataBuffer = frameBuffer->buffer();
-
-        // todo(kazuki): remove it when refactor video encoding process.
-        m_encoderId = frameBuffer->encoderId();
-
-        m_encodedImage._completeFrame = true;
-        m_encodedImage.SetTimestamp(frame.timestamp());
-        m_encodedImage._encodedWidth = frame.video_frame_buffer()->width();
-        m_encodedImage._encodedHeight = frame.video_frame_buffer()->height();
-        m_encodedImage.rotation_ = frame.rotation();
-        m_encodedImage.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
-        m_encodedImage.timing_.flags = webrtc::VideoSendTiming::kInvalid;
-        m_encodedImage._frameType = webrtc::VideoFrameType::kVideoFrameDelta;
-        m_encodedImage.SetColorSpace(frame.color_space());
-        std::vector<webrtc::H264::NaluIndex> naluIndices =
-            webrtc::H264::FindNaluIndices(&frameDataBuffer[0], frameDataBuffer.size());
-        for (uint32_t i = 0; i < naluIndices.size(); i++)
+        const std::vector<rtc::scoped_refptr<FrameBuffer>>& layers = frameBuffer->simulcastLayers();
+        auto keyFrameRequested = [frameTypes](size_t streamIndex)
+        {
+            return frameTypes != nullptr && streamIndex < frameTypes->size() &&
+                (*frameTypes)[streamIndex] == webrtc::VideoFrameType::kVideoFrameKey;
+        };
+
+        if (m_streams.size() == 1)
+        {
+            // Without simulcast only the full resolution is sent.
+            const FrameBuffer& buffer = layers.empty() ? *frameBuffer : *layers.back();
+            const int32_t result = EncodeStream(frame, buffer, 0, keyFrameRequested(0));
+            if (result != WEBRTC_VIDEO_CODEC_OK)
+                return result;
+        }
+        else if (layers.empty())
         {
-            const webrtc::H264::NaluType naluType = webrtc::H264::ParseNaluType(frameDataBuffer[naluIndices[i].payload_start_offset]);
-            if (naluType == webrtc::H264::kIdr)
+            // The track was not set up for simulcast, its single bitstream is sent as the top active stream.
+            for (size_t i = m_streams.size(); i-- > 0;)
             {
-                m_encodedImage._frameType = webrtc::VideoFrameType::kVideoFrameKey;
+                if (!IsStreamActive(i))
+                    continue;
+                const int32_t result = EncodeStream(frame, *frameBuffer, i, keyFrameRequested(i));
+                if (result != WEBRTC_VIDEO_CODEC_OK)
+                    return result;
                 break;
             }
         }
+        else
+        {
+            // The layers are the highest streams when the track encodes fewer layers than WebRTC set up.
+            const size_t firstStream = m_streams.size() > layers.size() ? m_streams.size() - layers.size() : 0;
+            for (size_t i = firstStream; i < m_streams.size() && i - firstStream < layers.size(); i++)
+            {
+                const rtc::scoped_refptr<FrameBuffer>& layer = layers[i - firstStream];
+                if (layer == nullptr || !IsStreamActive(i))
+                    continue;
+                const int32_t result = EncodeStream(frame, *layer, i, keyFrameRequested(i));
+                if (result != WEBRTC_VIDEO_CODEC_OK)
+                    return result;
+            }
+        }
+
+        int64_t now_ms = m_clock->TimeInMilliseconds();
+        m_encode_fps.Update(1, now_ms);
+
+        // The control of the track's encoder, which is the simulcast encoder when there are layers.
+        ReportBitrateStats(frameBuffer->encoderControl());
+
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
 
-        if (m_encodedImage._frameType != webrtc::VideoFrameType::kVideoFrameKey && frameTypes && (*frameTypes)[0] == webrtc::VideoFrameType::kVideoFrameKey)
+    bool DummyVideoEncoder::IsStreamActive(size_t streamIndex) const
+    {
+        return m_codec.simulcastStream[streamIndex].active && m_streams[streamIndex].bitRate > 0;
+    }
+
+    int32_t DummyVideoEncoder::EncodeStream(const webrtc::VideoFrame& frame, const FrameBuffer& buffer,
+        size_t streamIndex, bool keyFrameRequested)
+    {
+        Stream& stream = m_streams[streamIndex];
+        SetStreamControl(stream, buffer.encoderControl());
+        const rtc::scoped_refptr<webrtc::EncodedImageBufferInterface>& encodedData = buffer.buffer();
+        const uint8_t* frameData = encodedData->data();
+        const size_t frameSize = encodedData->size();
+        webrtc::EncodedImage& encodedImage = stream.encodedImage;
+
+        encodedImage._completeFrame = true;
+        encodedImage.SetTimestamp(frame.timestamp());
+        encodedImage._encodedWidth = buffer.width();
+        encodedImage._encodedHeight = buffer.height();
+        encodedImage.rotation_ = frame.rotation();
+        encodedImage.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
+        encodedImage.timing_.flags = webrtc::VideoSendTiming::kInvalid;
+        encodedImage.SetColorSpace(frame.color_space());
+        if (m_streams.size() > 1)
         {
-            m_setKeyFrame(m_encoderId);
+            encodedImage.SetSpatialIndex(static_cast<int>(streamIndex));
         }
 
-        m_encodedImage.SetEncodedData(webrtc::EncodedImageBuffer::Create(&frameDataBuffer[0], frameDataBuffer.size()));
-        m_encodedImage.set_size(frameDataBuffer.size());
+        // Finds the fragments, the frame type and the QP in one pass over the bitstream.
+        webrtc::RTPFragmentationHeader& fragHeader = stream.fragHeader;
+        stream.nalScanner.Scan(frameData, frameSize, &fragHeader);
+        encodedImage._frameType = stream.nalScanner.IsKeyFrame() ?
+            webrtc::VideoFrameType::kVideoFrameKey : webrtc::VideoFrameType::kVideoFrameDelta;
+        int qp = -1;
+        stream.nalScanner.GetLastSliceQp(&qp);
+        encodedImage.qp_ = qp;
 
-        m_fragHeader.VerifyAndAllocateFragmentationHeader(naluIndices.size());
-        m_fragHeader.fragmentationVectorSize = static_cast<uint16_t>(naluIndices.size());
-        for (uint32_t i = 0; i < naluIndices.size(); i++)
+        if (encodedImage._frameType != webrtc::VideoFrameType::kVideoFrameKey && keyFrameRequested &&
+            stream.encoderControl != nullptr)
         {
-            webrtc::H264::NaluIndex const& NALUIndex = naluIndices[i];
-            m_fragHeader.fragmentationOffset[i] = NALUIndex.payload_start_offset;
-            m_fragHeader.fragmentationLength[i] = NALUIndex.payload_size;
+            stream.encoderControl->SetIdrFrame();
         }
 
-        int qp;
-        m_h264BitstreamParser.ParseBitstream(frameDataBuffer.data(), frameDataBuffer.size());
-        m_h264BitstreamParser.GetLastSliceQp(&qp);
-        m_encodedImage.qp_ = qp;
+        // The encoder wrote the bitstream into a buffer of its pool, which is packetized without a copy.
+        encodedImage.SetEncodedData(encodedData);
+        encodedImage.set_size(frameSize);
 
         webrtc::CodecSpecificInfo codecInfo;
         codecInfo.codecType = webrtc::kVideoCodecH264;
         codecInfo.codecSpecific.H264.packetization_mode = webrtc::H264PacketizationMode::NonInterleaved;
 
-        const auto result = callback->OnEncodedImage(m_encodedImage, &codecInfo, &m_fragHeader);
+        const auto result = callback->OnEncodedImage(encodedImage, &codecInfo, &fragHeader);
         if (result.error != webrtc::EncodedImageCallback::Result::OK)
         {
             LogPrint("Encode callback failed %d", result.error);
             return WEBRTC_VIDEO_CODEC_ERROR;
         }
 
-        int64_t now_ms = m_clock->TimeInMilliseconds();
-        m_encode_fps.Update(1, now_ms);
+        // The adjusted bitrate changes at most once a second, from the bitrate which the stream really sent.
+        stream.bitrateAdjuster->Update(frameSize);
+        stream.frameCount++;
+        ApplyStreamRates(stream);
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
 
-        m_bitrateAdjuster->Update(frameDataBuffer.size());
+    uint32_t DummyVideoEncoder::GetAdjustedBitrate(const Stream& stream)
+    {
+        const uint32_t bitRate = stream.bitrateAdjuster->GetAdjustedBitrateBps();
+        if (bitRate <= stream.bitRate)
+            return bitRate;
+        // The adjuster raises the bitrate at most once a second, so an encoder which stops undershooting
+        // would send above the target until then.
+        const absl::optional<uint32_t> encoded = stream.bitrateAdjuster->GetEstimatedBitrateBps();
+        if (!encoded.has_value() || encoded.value() >= stream.bitRate)
+            return stream.bitRate;
+        return bitRate;
+    }
 
-        return WEBRTC_VIDEO_CODEC_OK;
+    void DummyVideoEncoder::ApplyStreamRates(Stream& stream)
+    {
+        // A stream without bitrate is paused, so its encoder keeps the previous rates.
+        if (stream.encoderControl == nullptr || stream.bitRate == 0)
+            return;
+        const uint32_t bitRate = GetAdjustedBitrate(stream);
+        if (bitRate == stream.appliedBitRate)
+            return;
+        stream.appliedBitRate = bitRate;
+        stream.encoderControl->SetRates(bitRate, m_frameRate);
     }
 
-    void DummyVideoEncoder::SetRates(const RateControlParameters& parameters)
+    void DummyVideoEncoder::ReportBitrateStats(const rtc::scoped_refptr<EncoderControl>& control)
     {
-        int64_t frameRate = parameters.framerate_fps;
+        if (control == nullptr)
+            return;
+        EncoderBitrateStats stats;
+        bool measured = true;
+        for (Stream& stream : m_streams)
+        {
+            if (stream.bitRate == 0)
+                continue;
+            stats.targetBitrate += stream.bitRate;
+            stats.adjustedBitrate += GetAdjustedBitrate(stream);
+            stats.frameCount += stream.frameCount;
+            const absl::optional<uint32_t> encoded = stream.bitrateAdjuster->GetEstimatedBitrateBps();
+            measured = measured && encoded.has_value();
+            stats.encodedBitrate += encoded.value_or(0);
+        }
+        if (!measured)
+            stats.encodedBitrate = 0;
+        if (stats.encodedBitrate > 0 && stats.targetBitrate > 0)
+            stats.overshoot = static_cast<float>(stats.encodedBitrate) / stats.targetBitrate - 1.0f;
+        control->SetBitrateStats(stats);
+    }
 
-        uint32_t bitRate = parameters.bitrate.get_sum_bps();
+    void DummyVideoEncoder::SetStreamControl(Stream& stream, const rtc::scoped_refptr<EncoderControl>& control)
+    {
+        if (stream.encoderControl == control)
+            return;
+        stream.encoderControl = control;
+        // The new encoder is set to the rates once.
+        stream.appliedBitRate = 0;
+        ApplyStreamRates(stream);
+    }
 
-        m_setRates(m_encoderId, bitRate, frameRate);
+    void DummyVideoEncoder::SetRates(const RateControlParameters& parameters)
+    {
+        m_frameRate = static_cast<int64_t>(parameters.framerate_fps);
+        for (size_t i = 0; i < m_streams.size(); i++)
+        {
+            Stream& stream = m_streams[i];
+            stream.bitRate = m_streams.size() == 1 ?
+                parameters.bitrate.get_sum_bps() : parameters.bitrate.GetSpatialLayerSum(i);
+            if (stream.bitRate > 0)
+                stream.bitrateAdjuster->SetTargetBitrateBps(stream.bitRate);
+
+            // Until the first frame of the stream arrives, the rates are kept for the encoder which sends it.
+            // The encoder is set to the rates again even when the adjusted bitrate did not change.
+            stream.appliedBitRate = 0;
+            ApplyStreamRates(stream);
+        }
     }
 
 } // end namespace webrtc
@@ -1,24 +1,22 @@
 #pragma once
-#include "HWSettings.h"
+#include "Codec/IEncoder.h"
+#include "Codec/H264NalScanner.h"
 namespace unity
 {
 namespace webrtc
 {
     namespace webrtc = ::webrtc;
 
-    // todo(kazuki): this interface class is used to access hardware encoder from webrtc::VideoEncoder for controlling bitrate
-    //               remove this after webrtc::Video Encoder can access hw encoder directly.
-    class IVideoEncoderObserver : public sigslot::has_slots<>
-    {
-    public:
-        virtual void SetKeyFrame(uint32_t id) = 0;
-        virtual void SetRates(uint32_t id, uint32_t bitRate, int64_t frameRate) = 0;
-    };
+    class FrameBuffer;
 
+    // Sends the frames which a hardware encoder has already encoded.
+    // The hardware encoder is referenced by the frames, so the rates and key frame requests reach it directly.
+    // Frames which carry simulcast layers are sent as one encoded image for each simulcast stream, the others as the
+    // top active stream.
     class DummyVideoEncoder : public webrtc::VideoEncoder
     {
     public:
-        DummyVideoEncoder(IVideoEncoderObserver* observer);
+        DummyVideoEncoder();
 
         // webrtc::VideoEncoder
         // Initialize the encoder with the information from the codecSettings
@@ -33,22 +31,38 @@ namespace webrtc
         // Default fallback: Just use the sum of bitrates as the single target rate.
         virtual void SetRates(const RateControlParameters& parameters) override;
     private:
+        struct Stream
+        {
+            webrtc::EncodedImage encodedImage;
+            webrtc::RTPFragmentationHeader fragHeader;
+            H264NalScanner nalScanner;
+            // Set by the first frame of the stream, the rates requested before it are applied then.
+            rtc::scoped_refptr<EncoderControl> encoderControl;
+            uint32_t bitRate = 0;
+            // Compensates the overshoot of the encoder, from the size of the frames it sent.
+            std::unique_ptr<webrtc::BitrateAdjuster> bitrateAdjuster;
+            // The bitrate which the encoder was set to last.
+            uint32_t appliedBitRate = 0;
+            uint64_t frameCount = 0;
+        };
+
+        bool IsStreamActive(size_t streamIndex) const;
+        int32_t EncodeStream(const webrtc::VideoFrame& frame, const FrameBuffer& buffer, size_t streamIndex,
+            bool keyFrameRequested);
+        void SetStreamControl(Stream& stream, const rtc::scoped_refptr<EncoderControl>& control);
+        // The bitrate set to the encoder of the stream.
+        static uint32_t GetAdjustedBitrate(const Stream& stream);
+        void ApplyStreamRates(Stream& stream);
+        void ReportBitrateStats(const rtc::scoped_refptr<EncoderControl>& control);
+        std::vector<Stream> CreateStreams(size_t count);
+
         webrtc::EncodedImageCallback* callback = nullptr;
-        webrtc::EncodedImage m_encodedImage;
-        webrtc::RTPFragmentationHeader m_fragHeader;
-        webrtc::H264BitstreamParser m_h264BitstreamParser;
+        std::vector<Stream> m_streams;
         webrtc::VideoCodec m_codec;
 
         webrtc::RateStatistics m_encode_fps;
         webrtc::Clock* m_clock;
-        std::unique_ptr<webrtc::BitrateAdjuster> m_bitrateAdjuster;
-
-        // todo(kazuki): this member is for identify video encoder instance (IEncoder implemented).
-        uint32_t m_encoderId = 0;
-
-        // todo(kazuki): remove these signals when moving hardware encoder instance to this class
-        sigslot::signal1<uint32_t> m_setKeyFrame;
-        sigslot::signal3<uint32_t, uint32_t, int64_t> m_setRates;
+        int64_t m_frameRate = 0;
     };
 
     // todo::(kazuki)
@@ -57,11 +71,11 @@ namespace webrtc
     public:
         FrameBuffer(int width,
             int height,
-            std::vector<uint8>& data,
-            const int encoderId)
+            const rtc::scoped_refptr<webrtc::EncodedImageBufferInterface>& data,
+            const rtc::scoped_refptr<EncoderControl>& encoderControl)
             : m_frameWidth(width),
             m_frameHeight(height),
-            m_encoderId(encoderId),
+            m_encoderControl(encoderControl),
             m_buffer(data)
         {}
 
@@ -83,16 +97,26 @@ namespace webrtc
             return m_frameHeight;
         }
 
-        std::vector<uint8>& buffer() const
+        // The encoded bitstream, which is sent as it is.
+        const rtc::scoped_refptr<webrtc::EncodedImageBufferInterface>& buffer() const
         {
             return m_buffer;
         }
 
-        // todo(kazuki): remove the method by refactoring video encoding.
-        // The id is for identifying encoder which encoded this frame.
-        int encoderId() const
+        // The encoder which encoded this frame.
+        const rtc::scoped_refptr<EncoderControl>& encoderControl() const
+        {
+            return m_encoderControl;
+        }
+
+        // The layers in the order of the simulcast streams. A layer which was not encoded is null.
+        const std::vector<rtc::scoped_refptr<FrameBuffer>>& simulcastLayers() const
+        {
+            return m_simulcastLayers;
+        }
+        void SetSimulcastLayers(const std::vector<rtc::scoped_refptr<FrameBuffer>>& layers)
         {
-            return m_encoderId;
+            m_simulcastLayers = layers;
         }
 
         // Returns a memory-backed frame buffer in I420 format. If the pixel data is
@@ -107,8 +131,9 @@ namespace webrtc
     private:
         int m_frameWidth;
         int m_frameHeight;
-        int m_encoderId;
-        std::vector<uint8>& m_buffer;
+        rtc::scoped_refptr<EncoderControl> m_encoderControl;
+        std::vector<rtc::scoped_refptr<FrameBuffer>> m_simulcastLayers;
+        rtc::scoped_refptr<webrtc::EncodedImageBufferInterface> m_buffer;
     };
 } // end namespace webrtc
 } // end namespace unity
@@ -0,0 +1,178 @@
+#include "pch.h"
+#include "EncoderThread.h"
+#include "Codec/IEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+    BufferIndexQueue::BufferIndexQueue(uint32_t capacity)
+        : m_capacity(capacity)
+        , m_indices(new std::atomic<uint32_t>[capacity])
+    {
+    }
+
+    bool BufferIndexQueue::Push(uint32_t index)
+    {
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) >= m_capacity)
+            return false;
+        m_indices[tail % m_capacity].store(index, std::memory_order_relaxed);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool BufferIndexQueue::Pop(uint32_t* index)
+    {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        while (head != m_tail.load(std::memory_order_acquire))
+        {
+            // The slot is not written again until the head moves past it, so the value read here is valid
+            // when the exchange succeeds.
+            const uint32_t value = m_indices[head % m_capacity].load(std::memory_order_relaxed);
+            if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel))
+            {
+                *index = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t BufferIndexQueue::Size() const
+    {
+        const uint64_t head = m_head.load(std::memory_order_acquire);
+        return static_cast<uint32_t>(m_tail.load(std::memory_order_acquire) - head);
+    }
+
+    EncoderThread::EncoderThread(IEncoder* encoder, EncoderQueuePolicy policy)
+        : m_encoder(encoder)
+        , m_policy(policy)
+        , m_freeBuffers(encoder->GetBufferCount())
+        , m_queuedBuffers(encoder->GetBufferCount())
+    {
+        for (uint32_t i = 0; i < encoder->GetBufferCount(); i++)
+        {
+            m_freeBuffers.Push(i);
+        }
+        m_thread = std::thread(&EncoderThread::Run, this);
+    }
+
+    EncoderThread::~EncoderThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_queuedCondition.notify_one();
+        m_freeCondition.notify_all();
+        m_thread.join();
+    }
+
+    bool EncoderThread::AcquireBuffer(uint32_t* index)
+    {
+        if (m_spareBuffer >= 0)
+        {
+            *index = static_cast<uint32_t>(m_spareBuffer);
+            m_spareBuffer = -1;
+            return true;
+        }
+        if (m_freeBuffers.Pop(index))
+            return true;
+
+        if (m_policy == EncoderQueuePolicy::Block)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_freeCondition.wait(lock, [&] { return m_stop || m_freeBuffers.Size() > 0; });
+            return m_freeBuffers.Pop(index);
+        }
+
+        // The oldest frame has not started encoding yet, so its buffer can be used for the new frame.
+        if (m_queuedBuffers.Pop(index))
+        {
+            m_droppedFrames++;
+            return true;
+        }
+        // The encoder thread has just taken the last queued frame.
+        return m_freeBuffers.Pop(index);
+    }
+
+    bool EncoderThread::CopyAndQueueFrame(void* frame, const FrameAdaptation& adaptation)
+    {
+        uint32_t index = 0;
+        if (!AcquireBuffer(&index))
+        {
+            m_droppedFrames++;
+            return false;
+        }
+        // The adaptation goes with the frame in the buffer.
+        m_encoder->SetAdaptation(index, adaptation);
+        if (!m_encoder->CopyBufferAt(frame, index))
+        {
+            m_spareBuffer = index;
+            return false;
+        }
+        m_queuedBuffers.Push(index);
+        m_queuedFrames++;
+
+        const uint32_t depth = m_queuedBuffers.Size();
+        uint32_t maxDepth = m_maxDepth.load();
+        while (depth > maxDepth && !m_maxDepth.compare_exchange_weak(maxDepth, depth))
+        {
+        }
+
+        // Taking the lock makes sure that the encoder thread is either waiting or will see the frame.
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_queuedCondition.notify_one();
+        return true;
+    }
+
+    EncoderQueueStats EncoderThread::GetStats() const
+    {
+        EncoderQueueStats stats;
+        stats.depth = m_queuedBuffers.Size();
+        stats.maxDepth = m_maxDepth;
+        stats.queuedFrames = m_queuedFrames;
+        stats.droppedFrames = m_droppedFrames;
+        stats.encodedFrames = m_encodedFrames;
+        return stats;
+    }
+
+    void EncoderThread::Run()
+    {
+        while (true)
+        {
+            uint32_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_queuedCondition.wait(lock, [&] { return m_stop || m_queuedBuffers.Size() > 0; });
+                if (m_stop)
+                    return;
+            }
+            // The render thread may have dropped the frame in the meantime.
+            if (!m_queuedBuffers.Pop(&index))
+                continue;
+
+            if (m_encoder->EncodeFrameAt(index))
+            {
+                m_encodedFrames++;
+            }
+            else
+            {
+                LogPrint("Encode frame is failed");
+            }
+
+            // Here the free queue has only one producer, the encoder thread.
+            m_freeBuffers.Push(index);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+            m_freeCondition.notify_one();
+        }
+    }
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Codec/IEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+    // What the render thread does when every buffer of the encoder is waiting for the encoder thread.
+    enum class EncoderQueuePolicy
+    {
+        // Reuses the buffer of the oldest queued frame, so the render thread never waits.
+        DropOldest = 0,
+        // Waits until the encoder thread finishes a frame.
+        Block = 1
+    };
+
+    struct EncoderQueueStats
+    {
+        uint32_t depth = 0;
+        uint32_t maxDepth = 0;
+        uint64_t queuedFrames = 0;
+        uint64_t droppedFrames = 0;
+        uint64_t encodedFrames = 0;
+    };
+
+    // Bounded ring of buffer indices without locks.
+    // Only one thread pushes, but several threads may pop.
+    class BufferIndexQueue
+    {
+    public:
+        explicit BufferIndexQueue(uint32_t capacity);
+
+        bool Push(uint32_t index);
+        bool Pop(uint32_t* index);
+        uint32_t Size() const;
+        uint32_t Capacity() const { return m_capacity; }
+
+    private:
+        const uint32_t m_capacity;
+        std::unique_ptr<std::atomic<uint32_t>[]> m_indices;
+        std::atomic<uint64_t> m_head{ 0 };
+        std::atomic<uint64_t> m_tail{ 0 };
+    };
+
+    // Encodes the frames of a track on its own thread, so that a slow encoder does not hitch the render thread.
+    // The render thread copies each frame into a free buffer of the encoder and queues the index of the buffer,
+    // then the encoder thread encodes the buffers in the order they were queued.
+    class EncoderThread
+    {
+    public:
+        EncoderThread(IEncoder* encoder, EncoderQueuePolicy policy);
+        // Queued frames which have not been encoded yet are discarded.
+        ~EncoderThread();
+
+        // You must call this method on the rendering thread.
+        // Returns false when the copy failed or the frame was dropped.
+        bool CopyAndQueueFrame(void* frame, const FrameAdaptation& adaptation = FrameAdaptation());
+
+        EncoderQueuePolicy GetPolicy() const { return m_policy; }
+        void SetPolicy(EncoderQueuePolicy policy) { m_policy = policy; }
+        EncoderQueueStats GetStats() const;
+
+    private:
+        bool AcquireBuffer(uint32_t* index);
+        void Run();
+
+        IEncoder* m_encoder;
+        std::atomic<EncoderQueuePolicy> m_policy;
+
+        // Buffers which the render thread can copy into, returned by the encoder thread.
+        BufferIndexQueue m_freeBuffers;
+        // Buffers waiting to be encoded. The render thread also pops them when it drops the oldest frame.
+        BufferIndexQueue m_queuedBuffers;
+        // Buffer kept by the render thread after a failed copy, because only the encoder thread returns buffers.
+        int64_t m_spareBuffer = -1;
+
+        // The threads only sleep on these when there is nothing to do.
+        std::mutex m_mutex;
+        std::condition_variable m_queuedCondition;
+        std::condition_variable m_freeCondition;
+        bool m_stop = false;
+        std::thread m_thread;
+
+        std::atomic<uint32_t> m_maxDepth{ 0 };
+        std::atomic<uint64_t> m_queuedFrames{ 0 };
+        std::atomic<uint64_t> m_droppedFrames{ 0 };
+        std::atomic<uint64_t> m_encodedFrames{ 0 };
+    };
+
+} // end namespace webrtc
+} // end namespace unity
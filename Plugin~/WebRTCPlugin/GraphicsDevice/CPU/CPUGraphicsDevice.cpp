@@ -0,0 +1,96 @@
+#include "pch.h"
+#include <cstring>
+#include "CPUGraphicsDevice.h"
+#include "CPUTexture2D.h"
+#include "GraphicsDevice/GraphicsUtility.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+std::mutex CPUGraphicsDevice::s_bufferMutex;
+std::map<const void*, size_t> CPUGraphicsDevice::s_buffers;
+
+CPUGraphicsDevice::CPUGraphicsDevice()
+{
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+CPUGraphicsDevice::~CPUGraphicsDevice() {
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CPUGraphicsDevice::InitV() {
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+void CPUGraphicsDevice::ShutdownV() {
+
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+ITexture2D* CPUGraphicsDevice::CreateDefaultTextureV(uint32_t w, uint32_t h) {
+    return new CPUTexture2D(w, h, this);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+ITexture2D* CPUGraphicsDevice::CreateCPUReadTextureV(uint32_t w, uint32_t h) {
+    return new CPUTexture2D(w, h, this);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CPUGraphicsDevice::RegisterBuffer(const void* data, size_t size) {
+    if (nullptr == data)
+        return;
+    std::lock_guard<std::mutex> lock(s_bufferMutex);
+    s_buffers[data] = size;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void CPUGraphicsDevice::UnregisterBuffer(const void* data) {
+    std::lock_guard<std::mutex> lock(s_bufferMutex);
+    s_buffers.erase(data);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CPUGraphicsDevice::CopyResourceV(ITexture2D* dest, ITexture2D* src) {
+    if (dest == src)
+        return false;
+    if (!dest->IsSize(src->GetWidth(), src->GetHeight()))
+        return false;
+    return CopyResourceFromNativeV(dest, src->GetNativeTexturePtrV());
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+bool CPUGraphicsDevice::CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) {
+    if (nullptr == nativeTexturePtr)
+        return false;
+    CPUTexture2D* tex = static_cast<CPUTexture2D*>(dest);
+    if (nativeTexturePtr == tex->GetNativeTexturePtrV())
+        return false;
+    // The pointer comes from the application, it is only read when the size of its buffer is registered.
+    std::lock_guard<std::mutex> lock(s_bufferMutex);
+    const auto buffer = s_buffers.find(nativeTexturePtr);
+    if (buffer == s_buffers.end() || buffer->second < tex->m_data.size())
+        return false;
+    std::memcpy(tex->m_data.data(), nativeTexturePtr, tex->m_data.size());
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+rtc::scoped_refptr<webrtc::I420Buffer> CPUGraphicsDevice::ConvertRGBToI420(
+    ITexture2D* baseTex, const ColorConversionOptions& options)
+{
+    CPUTexture2D* tex = static_cast<CPUTexture2D*>(baseTex);
+    if (nullptr == tex)
+        return nullptr;
+    return GraphicsUtility::ConvertRGBToI420Buffer(
+        tex->GetWidth(), tex->GetHeight(), tex->GetPitch(), tex->m_data.data(), options);
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include "GraphicsDevice/IGraphicsDevice.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace webrtc = ::webrtc;
+
+// Graphics device without GPU, which is used in batch mode with the null renderer of Unity.
+// The native texture pointers passed to this device point to BGRA32 pixels in system memory. Only the textures of
+// the CPU devices and the buffers registered to them are copied from, any other pointer is rejected.
+class CPUGraphicsDevice : public IGraphicsDevice {
+public:
+    CPUGraphicsDevice();
+    virtual ~CPUGraphicsDevice();
+
+    virtual bool InitV() override;
+    virtual void ShutdownV() override;
+    inline virtual void* GetEncodeDevicePtrV() override;
+
+    virtual ITexture2D* CreateDefaultTextureV(uint32_t w, uint32_t h) override;
+    virtual ITexture2D* CreateCPUReadTextureV(uint32_t width, uint32_t height) override;
+    virtual bool CopyResourceV(ITexture2D* dest, ITexture2D* src) override;
+    virtual bool CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) override;
+    virtual rtc::scoped_refptr<webrtc::I420Buffer> ConvertRGBToI420(
+        ITexture2D* tex, const ColorConversionOptions& options) override;
+    inline virtual GraphicsDeviceType GetDeviceType() const override;
+
+    // Lets the devices copy from pixels in system memory, until they are unregistered. The buffers are shared by
+    // every CPU device of the process, so that they outlive the device which is recreated for each encoding.
+    static void RegisterBuffer(const void* data, size_t size);
+    static void UnregisterBuffer(const void* data);
+
+private:
+    // The size of the buffers which the native texture pointers may point to.
+    static std::mutex s_bufferMutex;
+    static std::map<const void*, size_t> s_buffers;
+};
+
+void* CPUGraphicsDevice::GetEncodeDevicePtrV() { return nullptr; }
+GraphicsDeviceType CPUGraphicsDevice::GetDeviceType() const { return GRAPHICS_DEVICE_CPU; }
+
+//---------------------------------------------------------------------------------------------------------------------
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,27 @@
+#include "pch.h"
+#include "CPUTexture2D.h"
+#include "CPUGraphicsDevice.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+//---------------------------------------------------------------------------------------------------------------------
+
+CPUTexture2D::CPUTexture2D(uint32_t w, uint32_t h, CPUGraphicsDevice* device) : ITexture2D(w,h)
+    , m_data(static_cast<size_t>(w) * h * 4)
+    , m_device(device)
+{
+    m_device->RegisterBuffer(m_data.data(), m_data.size());
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+CPUTexture2D::~CPUTexture2D()
+{
+    m_device->UnregisterBuffer(m_data.data());
+}
+
+} // end namespace webrtc
+} // end namespace unity
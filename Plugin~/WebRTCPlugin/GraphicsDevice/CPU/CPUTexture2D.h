@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GraphicsDevice/ITexture2D.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+class CPUGraphicsDevice;
+
+// Texture in system memory. The pixels are BGRA32 without padding between rows,
+// and the native texture pointer is the pointer to the first pixel.
+// The pixels are registered to the device which created the texture while it lives.
+struct CPUTexture2D : ITexture2D {
+public:
+    std::vector<uint8_t> m_data;
+
+    CPUTexture2D(uint32_t w, uint32_t h, CPUGraphicsDevice* device);
+    virtual ~CPUTexture2D() override;
+
+    uint32_t GetPitch() const { return m_width * 4; }
+
+    inline virtual void* GetNativeTexturePtrV() override;
+    inline virtual const void* GetNativeTexturePtrV() const override;
+    inline virtual void* GetEncodeTexturePtrV() override;
+    inline virtual const void* GetEncodeTexturePtrV() const override;
+
+private:
+    CPUGraphicsDevice* m_device;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+
+void* CPUTexture2D::GetNativeTexturePtrV() { return m_data.data(); }
+const void* CPUTexture2D::GetNativeTexturePtrV() const { return m_data.data(); };
+void* CPUTexture2D::GetEncodeTexturePtrV() { return m_data.data(); }
+const void* CPUTexture2D::GetEncodeTexturePtrV() const { return m_data.data(); }
+
+} // end namespace webrtc
+} // end namespace unity
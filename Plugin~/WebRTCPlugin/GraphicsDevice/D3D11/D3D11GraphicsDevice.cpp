@@ -94,7 +94,8 @@ bool D3D11GraphicsDevice::CopyResourceFromNativeV(ITexture2D* dest, void* native
 
 //---------------------------------------------------------------------------------------------------------------------
 
-rtc::scoped_refptr<webrtc::I420Buffer> D3D11GraphicsDevice::ConvertRGBToI420(ITexture2D* tex) {
+rtc::scoped_refptr<webrtc::I420Buffer> D3D11GraphicsDevice::ConvertRGBToI420(
+    ITexture2D* tex, const ColorConversionOptions& options) {
     D3D11_MAPPED_SUBRESOURCE resource;
 
     ID3D11Resource* nativeTex = reinterpret_cast<ID3D11Resource*>(tex->GetNativeTexturePtrV());
@@ -111,7 +112,7 @@ rtc::scoped_refptr<webrtc::I420Buffer> D3D11GraphicsDevice::ConvertRGBToI420(ITe
     const uint32_t height = tex->GetHeight();
 
     rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = GraphicsUtility::ConvertRGBToI420Buffer(
-        width, height, resource.RowPitch, static_cast<uint8_t*>(resource.pData)
+        width, height, resource.RowPitch, static_cast<uint8_t*>(resource.pData), options
     );
 
     m_d3d11Context->Unmap(nativeTex, 0);
@@ -20,7 +20,8 @@ public:
     virtual bool CopyResourceV(ITexture2D* dest, ITexture2D* src) override;
     virtual bool CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) override;
     inline virtual GraphicsDeviceType GetDeviceType() const override;
-    virtual rtc::scoped_refptr < ::webrtc::I420Buffer > ConvertRGBToI420(ITexture2D* tex) override;
+    virtual rtc::scoped_refptr < ::webrtc::I420Buffer > ConvertRGBToI420(
+        ITexture2D* tex, const ColorConversionOptions& options) override;
 
 private:
     ID3D11Device* m_d3d11Device;
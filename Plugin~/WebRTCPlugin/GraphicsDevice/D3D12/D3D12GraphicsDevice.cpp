@@ -226,7 +226,8 @@ ITexture2D* D3D12GraphicsDevice::CreateCPUReadTextureV(uint32_t w, uint32_t h) {
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-rtc::scoped_refptr<webrtc::I420Buffer> D3D12GraphicsDevice::ConvertRGBToI420(ITexture2D* baseTex)
+rtc::scoped_refptr<webrtc::I420Buffer> D3D12GraphicsDevice::ConvertRGBToI420(
+    ITexture2D* baseTex, const ColorConversionOptions& options)
 {
     D3D12Texture2D* tex = reinterpret_cast<D3D12Texture2D*>(baseTex);
     assert(nullptr != tex);
@@ -251,7 +252,7 @@ rtc::scoped_refptr<webrtc::I420Buffer> D3D12GraphicsDevice::ConvertRGBToI420(ITe
     }
 
     rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = GraphicsUtility::ConvertRGBToI420Buffer(
-        width, height, static_cast<uint32_t>(resFP->RowSize), static_cast<uint8_t*>(data)
+        width, height, static_cast<uint32_t>(resFP->RowSize), static_cast<uint8_t*>(data), options
     );
 
     D3D12_RANGE emptyRange{ 0, 0 };
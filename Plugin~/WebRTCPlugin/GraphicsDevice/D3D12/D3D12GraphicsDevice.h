@@ -54,7 +54,8 @@ public:
     inline virtual GraphicsDeviceType GetDeviceType() const override;
 
     virtual ITexture2D* CreateCPUReadTextureV(uint32_t w, uint32_t h) override;
-    virtual rtc::scoped_refptr<webrtc::I420Buffer> ConvertRGBToI420(ITexture2D* tex) override;
+    virtual rtc::scoped_refptr<webrtc::I420Buffer> ConvertRGBToI420(
+        ITexture2D* tex, const ColorConversionOptions& options) override;
 
 private:
 
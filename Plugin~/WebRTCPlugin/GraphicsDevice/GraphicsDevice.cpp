@@ -2,6 +2,8 @@
 #include "GraphicsDevice.h"
 
 //Graphics
+#include "CPU/CPUGraphicsDevice.h"
+
 #if defined(SUPPORT_D3D11) || defined(SUPPORT_D3D12)
 #include "D3D11/D3D11GraphicsDevice.h" 
 #include "D3D12/D3D12GraphicsDevice.h" 
@@ -49,6 +51,9 @@ bool GraphicsDevice::Init(IUnityInterfaces* unityInterface) {
         case kUnityGfxRendererOpenGLCore: {
             return Init(rendererType, nullptr, nullptr);
         }
+        case kUnityGfxRendererNull: {
+            return Init(rendererType, nullptr, nullptr);
+        }
 #if defined(SUPPORT_VULKAN)
         case kUnityGfxRendererVulkan : {
             IUnityGraphicsVulkan* deviceInterface = unityInterface->Get<IUnityGraphicsVulkan>();
@@ -111,6 +116,10 @@ bool GraphicsDevice::Init(const UnityGfxRenderer rendererType, void* device, IUn
         break;
     }
 #endif
+    case kUnityGfxRendererNull: {
+        m_device = new CPUGraphicsDevice();
+        break;
+    }
 #if defined(SUPPORT_METAL)
     case kUnityGfxRendererMetal: {
         id<MTLDevice> metalDevice = reinterpret_cast<id<MTLDevice>>(device);
@@ -11,6 +11,7 @@ enum GraphicsDeviceType {
     GRAPHICS_DEVICE_OPENGL  = 10,
     GRAPHICS_DEVICE_METAL   = 20,
     GRAPHICS_DEVICE_VULKAN  = 30,
+    GRAPHICS_DEVICE_CPU     = 40,
 };
 
 } // end namespace webrtc
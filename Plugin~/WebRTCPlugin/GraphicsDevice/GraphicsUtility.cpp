@@ -1,5 +1,16 @@
 #include "pch.h"
 #include "GraphicsUtility.h"
+#include "GraphicsUtilityRow.h"
+#include "I420FrameBufferPool.h"
+#include "WorkerPool.h"
+
+#if defined(SUPPORT_SSE2) || defined(SUPPORT_AVX2)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
 
 namespace unity
 {
@@ -8,46 +19,266 @@ namespace webrtc
 
 namespace webrtc = ::webrtc;
 
-rtc::scoped_refptr<webrtc::I420Buffer> GraphicsUtility::ConvertRGBToI420Buffer(const uint32_t width, const uint32_t height,
-    const uint32_t rowToRowInBytes, const uint8_t* srcData)
+namespace
 {
 
-    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = webrtc::I420Buffer::Create(width, height);
+#if defined(SUPPORT_SSE2) || defined(SUPPORT_AVX2)
+    void GetCpuId(int info[4], int function, int subfunction)
+    {
+#if defined(_MSC_VER)
+        __cpuidex(info, function, subfunction);
+#else
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        __cpuid_count(function, subfunction, eax, ebx, ecx, edx);
+        info[0] = static_cast<int>(eax);
+        info[1] = static_cast<int>(ebx);
+        info[2] = static_cast<int>(ecx);
+        info[3] = static_cast<int>(edx);
+#endif
+    }
 
-    int yIndex = 0;
-    int uIndex = 0;
-    int vIndex = 0;
+    uint64_t GetXCR0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax = 0, edx = 0;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
 
-    uint8_t* yuv_y = i420_buffer->MutableDataY();
-    uint8_t* yuv_u = i420_buffer->MutableDataU();
-    uint8_t* yuv_v = i420_buffer->MutableDataV();
+    bool HasSSE2()
+    {
+        int info[4] = {};
+        GetCpuId(info, 1, 0);
+        return (info[3] & (1 << 26)) != 0;
+    }
 
-    for (uint32_t i = 0; i < height; i++)
+    bool HasAVX2()
     {
-        for (uint32_t j = 0; j < width; j++)
+        int info[4] = {};
+        GetCpuId(info, 0, 0);
+        if (info[0] < 7)
+            return false;
+        GetCpuId(info, 1, 0);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx)
+            return false;
+        // The OS must save both XMM and YMM registers on context switch.
+        if ((GetXCR0() & 0x6) != 0x6)
+            return false;
+        GetCpuId(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+#endif
+
+    ConvertRowPairFunc GetRowPairFunc(ColorConversionKernel kernel, ChromaSubsampling chromaSubsampling)
+    {
+        const bool box = chromaSubsampling == ChromaSubsampling::Box;
+        switch (kernel)
         {
-            const uint32_t startIndex = i * rowToRowInBytes + j * 4;
-            const int B = srcData[startIndex + 0];
-            const int G = srcData[startIndex + 1];
-            const int R = srcData[startIndex + 2];
+#if defined(SUPPORT_SSE2)
+        case ColorConversionKernel::SSE2:
+            return box ? ConvertRowPairBox_SSE2 : ConvertRowPairTopLeft_SSE2;
+#endif
+#if defined(SUPPORT_AVX2)
+        case ColorConversionKernel::AVX2:
+            return box ? ConvertRowPairBox_AVX2 : ConvertRowPairTopLeft_AVX2;
+#endif
+#if defined(SUPPORT_NEON)
+        case ColorConversionKernel::NEON:
+            return box ? ConvertRowPairBox_NEON : ConvertRowPairTopLeft_NEON;
+#endif
+        default:
+            return box ? ConvertRowPairBox_C : ConvertRowPairTopLeft_C;
+        }
+    }
 
-            const int Y = ((66 * R + 129 * G + 25 * B + 128) >> 8) + 16;
-            const int U = ((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128;
-            const int V = ((112 * R - 94 * G - 18 * B + 128) >> 8) + 128;
+    inline uint8_t RGBToY(int R, int G, int B)
+    {
+        return static_cast<uint8_t>(((66 * R + 129 * G + 25 * B + 128) >> 8) + 16);
+    }
 
-            yuv_y[yIndex++] = static_cast<uint8_t>((Y < 0) ? 0 : ((Y > 255) ? 255 : Y));
-            if (i % 2 == 0 && j % 2 == 0)
+    inline uint8_t RGBToU(int R, int G, int B)
+    {
+        return static_cast<uint8_t>(((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128);
+    }
+
+    inline uint8_t RGBToV(int R, int G, int B)
+    {
+        return static_cast<uint8_t>(((112 * R - 94 * G - 18 * B + 128) >> 8) + 128);
+    }
+
+    // The results of the formulas are always in [16, 240], so no clamping is needed.
+    template<ChromaSubsampling mode>
+    void ConvertRowPair_C(
+        const uint8_t* src0, const uint8_t* src1,
+        uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+        uint32_t width)
+    {
+        // The last row and column of an odd sized image are repeated for the box filter.
+        const uint8_t* below = src1 != nullptr ? src1 : src0;
+        for (uint32_t j = 0; j < width; j++)
+        {
+            const uint8_t* p = src0 + j * 4;
+            dstY0[j] = RGBToY(p[2], p[1], p[0]);
+            if (j % 2 != 0)
+                continue;
+            if (mode == ChromaSubsampling::TopLeft)
+            {
+                dstU[j / 2] = RGBToU(p[2], p[1], p[0]);
+                dstV[j / 2] = RGBToV(p[2], p[1], p[0]);
+                continue;
+            }
+            const uint32_t right = (j + 1 < width ? j + 1 : j) * 4;
+            int sum[3];
+            for (int c = 0; c < 3; c++)
             {
-                yuv_u[uIndex++] = static_cast<uint8_t>((U < 0) ? 0 : ((U > 255) ? 255 : U));
-                yuv_v[vIndex++] = static_cast<uint8_t>((V < 0) ? 0 : ((V > 255) ? 255 : V));
+                sum[c] = (src0[j * 4 + c] + src0[right + c] + below[j * 4 + c] + below[right + c] + 2) >> 2;
             }
+            dstU[j / 2] = RGBToU(sum[2], sum[1], sum[0]);
+            dstV[j / 2] = RGBToV(sum[2], sum[1], sum[0]);
+        }
+        if (src1 == nullptr)
+            return;
+        for (uint32_t j = 0; j < width; j++)
+        {
+            const uint8_t* p = src1 + j * 4;
+            dstY1[j] = RGBToY(p[2], p[1], p[0]);
         }
     }
 
+} // end namespace
+
+void ConvertRowPairTopLeft_C(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair_C<ChromaSubsampling::TopLeft>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+void ConvertRowPairBox_C(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair_C<ChromaSubsampling::Box>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+bool GraphicsUtility::IsKernelSupported(ColorConversionKernel kernel)
+{
+    switch (kernel)
+    {
+    case ColorConversionKernel::Auto:
+    case ColorConversionKernel::C:
+        return true;
+#if defined(SUPPORT_SSE2)
+    case ColorConversionKernel::SSE2:
+    {
+        static const bool supported = HasSSE2();
+        return supported;
+    }
+#endif
+#if defined(SUPPORT_AVX2)
+    case ColorConversionKernel::AVX2:
+    {
+        static const bool supported = HasAVX2();
+        return supported;
+    }
+#endif
+#if defined(SUPPORT_NEON)
+    case ColorConversionKernel::NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+ColorConversionKernel GraphicsUtility::GetDefaultKernel()
+{
+    static const ColorConversionKernel kernel = []()
+    {
+        const ColorConversionKernel candidates[] = {
+            ColorConversionKernel::AVX2,
+            ColorConversionKernel::SSE2,
+            ColorConversionKernel::NEON
+        };
+        for (const ColorConversionKernel candidate : candidates)
+        {
+            if (IsKernelSupported(candidate))
+                return candidate;
+        }
+        return ColorConversionKernel::C;
+    }();
+    return kernel;
+}
+
+rtc::scoped_refptr<webrtc::I420Buffer> GraphicsUtility::ConvertRGBToI420Buffer(const uint32_t width, const uint32_t height,
+    const uint32_t rowToRowInBytes, const uint8_t* srcData, const ColorConversionOptions& options)
+{
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = options.bufferPool != nullptr ?
+        options.bufferPool->CreateBuffer(width, height) : webrtc::I420Buffer::Create(width, height);
+    ConvertRGBToI420(width, height, rowToRowInBytes, srcData, i420_buffer.get(), options);
     return i420_buffer;
+}
+
+void GraphicsUtility::ConvertRGBToI420(const uint32_t width, const uint32_t height,
+    const uint32_t rowToRowInBytes, const uint8_t* srcData, webrtc::I420Buffer* dst,
+    const ColorConversionOptions& options)
+{
+    RTC_DCHECK_EQ(static_cast<int>(width), dst->width());
+    RTC_DCHECK_EQ(static_cast<int>(height), dst->height());
+
+    ColorConversionKernel kernel = options.kernel;
+    if (kernel == ColorConversionKernel::Auto || !IsKernelSupported(kernel))
+    {
+        kernel = GetDefaultKernel();
+    }
+    const ConvertRowPairFunc convertRowPair = GetRowPairFunc(kernel, options.chromaSubsampling);
+
+    uint8_t* yuv_y = dst->MutableDataY();
+    uint8_t* yuv_u = dst->MutableDataU();
+    uint8_t* yuv_v = dst->MutableDataV();
+    const int strideY = dst->StrideY();
+    const int strideU = dst->StrideU();
+    const int strideV = dst->StrideV();
 
+    // Converts the rows in [rowBegin, rowEnd), rowBegin must be even.
+    const auto convertRows = [&](uint32_t rowBegin, uint32_t rowEnd)
+    {
+        for (uint32_t i = rowBegin; i < rowEnd; i += 2)
+        {
+            const bool hasSecondRow = i + 1 < height;
+            const uint8_t* src0 = srcData + i * rowToRowInBytes;
+            const uint8_t* src1 = hasSecondRow ? src0 + rowToRowInBytes : nullptr;
+            uint8_t* dstY0 = yuv_y + i * strideY;
+            uint8_t* dstY1 = hasSecondRow ? dstY0 + strideY : nullptr;
+            convertRowPair(src0, src1, dstY0, dstY1,
+                yuv_u + (i / 2) * strideU, yuv_v + (i / 2) * strideV, width);
+        }
+    };
+
+    // Small bands cost more in synchronization than they save.
+    const uint32_t minRowsPerBand = 64;
+    const int threadCount = options.workerPool != nullptr ? options.workerPool->GetThreadCount() : 1;
+    const uint32_t bandCount = std::min(static_cast<uint32_t>(threadCount), height / minRowsPerBand);
+    if (bandCount < 2)
+    {
+        convertRows(0, height);
+        return;
+    }
+    // Each band starts at an even row so that the chroma rows of the bands do not overlap.
+    const uint32_t rowsPerBand = ((height + bandCount - 1) / bandCount + 1) & ~1u;
+    options.workerPool->ParallelFor(static_cast<int>(bandCount), [&](int band)
+    {
+        const uint32_t rowBegin = band * rowsPerBand;
+        convertRows(rowBegin, std::min(rowBegin + rowsPerBand, height));
+    });
 }
 
 } // end namespace webrtc
 } // end namespace unity
-
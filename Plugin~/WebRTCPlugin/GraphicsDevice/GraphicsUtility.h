@@ -6,10 +6,51 @@ namespace unity
 namespace webrtc
 {
 
+class I420FrameBufferPool;
+class WorkerPool;
+
+// Implementations of the RGB to I420 conversion.
+// Auto selects the fastest one which is supported by the running CPU.
+enum class ColorConversionKernel
+{
+    Auto = 0,
+    C = 1,
+    SSE2 = 2,
+    AVX2 = 3,
+    NEON = 4,
+};
+
+// How U and V are sampled from each 2x2 block of pixels.
+// TopLeft takes the top-left pixel, Box averages the four pixels which avoids chroma aliasing.
+enum class ChromaSubsampling
+{
+    TopLeft = 0,
+    Box = 1,
+};
+
+struct ColorConversionOptions
+{
+    ChromaSubsampling chromaSubsampling = ChromaSubsampling::TopLeft;
+    ColorConversionKernel kernel = ColorConversionKernel::Auto;
+    // Splits the image into row bands which are converted in parallel. nullptr converts on the calling thread.
+    WorkerPool* workerPool = nullptr;
+    // Recycles the buffers returned by ConvertRGBToI420Buffer. nullptr allocates a new buffer for every frame.
+    I420FrameBufferPool* bufferPool = nullptr;
+};
+
 class GraphicsUtility {
 public:
     static rtc::scoped_refptr<::webrtc::I420Buffer> ConvertRGBToI420Buffer(const uint32_t width, const uint32_t height,
-        const uint32_t rowToRowInBytes, const uint8_t* srcData);
+        const uint32_t rowToRowInBytes, const uint8_t* srcData,
+        const ColorConversionOptions& options = ColorConversionOptions());
+
+    // Converts BGRA pixels into the I420 buffer which has the same size of the source image.
+    static void ConvertRGBToI420(const uint32_t width, const uint32_t height,
+        const uint32_t rowToRowInBytes, const uint8_t* srcData, ::webrtc::I420Buffer* dst,
+        const ColorConversionOptions& options = ColorConversionOptions());
+
+    static bool IsKernelSupported(ColorConversionKernel kernel);
+    static ColorConversionKernel GetDefaultKernel();
 };
 
 } // end namespace webrtc
@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "GraphicsUtilityRow.h"
+
+#if defined(SUPPORT_AVX2)
+#include <immintrin.h>
+
+// MSVC allows AVX2 intrinsics without any compiler option, GCC and Clang need the target attribute.
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace
+{
+    // _mm256_packs_epi32 and _mm256_packus_epi16 work on each 128-bit lane,
+    // this restores the order of the 64-bit blocks.
+    TARGET_AVX2 inline __m256i FixLaneOrder(__m256i v)
+    {
+        return _mm256_permute4x64_epi64(v, 0xD8);
+    }
+
+    // Unpacks 16 BGRA pixels into 16-bit B, G and R lanes.
+    TARGET_AVX2 inline void LoadBGR(const uint8_t* src, __m256i& b, __m256i& g, __m256i& r)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xFF);
+        const __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        const __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+        b = FixLaneOrder(_mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask)));
+        g = FixLaneOrder(_mm256_packs_epi32(
+            _mm256_and_si256(_mm256_srli_epi32(p0, 8), mask), _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask)));
+        r = FixLaneOrder(_mm256_packs_epi32(
+            _mm256_and_si256(_mm256_srli_epi32(p0, 16), mask), _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask)));
+    }
+
+    TARGET_AVX2 inline __m256i CalcY(__m256i b, __m256i g, __m256i r)
+    {
+        const __m256i y = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)), _mm256_mullo_epi16(g, _mm256_set1_epi16(129))),
+            _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(25)), _mm256_set1_epi16(128)));
+        return _mm256_add_epi16(_mm256_srli_epi16(y, 8), _mm256_set1_epi16(16));
+    }
+
+    TARGET_AVX2 inline __m256i CalcU(__m256i b, __m256i g, __m256i r)
+    {
+        const __m256i u = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(-38)), _mm256_mullo_epi16(g, _mm256_set1_epi16(-74))),
+            _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(112)), _mm256_set1_epi16(128)));
+        return _mm256_add_epi16(_mm256_srai_epi16(u, 8), _mm256_set1_epi16(128));
+    }
+
+    TARGET_AVX2 inline __m256i CalcV(__m256i b, __m256i g, __m256i r)
+    {
+        const __m256i v = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(112)), _mm256_mullo_epi16(g, _mm256_set1_epi16(-94))),
+            _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(-18)), _mm256_set1_epi16(128)));
+        return _mm256_add_epi16(_mm256_srai_epi16(v, 8), _mm256_set1_epi16(128));
+    }
+
+    TARGET_AVX2 inline __m256i EvenLanes(__m256i a, __m256i b)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xFFFF);
+        return FixLaneOrder(_mm256_packs_epi32(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask)));
+    }
+
+    // Rounded average of each 2x2 block, a0 and b0 hold the upper row and a1 and b1 hold the lower row.
+    TARGET_AVX2 inline __m256i BoxAverage(__m256i a0, __m256i b0, __m256i a1, __m256i b1)
+    {
+        const __m256i ones = _mm256_set1_epi16(1);
+        const __m256i sum = FixLaneOrder(_mm256_packs_epi32(
+            _mm256_madd_epi16(_mm256_add_epi16(a0, a1), ones), _mm256_madd_epi16(_mm256_add_epi16(b0, b1), ones)));
+        return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+    }
+
+    TARGET_AVX2 inline void StoreY(uint8_t* dstY, __m256i y0, __m256i y1)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY), FixLaneOrder(_mm256_packus_epi16(y0, y1)));
+    }
+
+    TARGET_AVX2 inline void StoreUV(uint8_t* dst, __m256i uv)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+            _mm256_castsi256_si128(FixLaneOrder(_mm256_packus_epi16(uv, uv))));
+    }
+
+    // Processes 32 pixels per iteration.
+    template<bool box>
+    TARGET_AVX2 void ConvertRowPair(
+        const uint8_t* src0, const uint8_t* src1,
+        uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+        uint32_t width)
+    {
+        uint32_t x = 0;
+        for (; x + 32 <= width; x += 32)
+        {
+            __m256i b0, g0, r0, b1, g1, r1;
+            LoadBGR(src0 + x * 4, b0, g0, r0);
+            LoadBGR(src0 + x * 4 + 64, b1, g1, r1);
+            StoreY(dstY0 + x, CalcY(b0, g0, r0), CalcY(b1, g1, r1));
+
+            __m256i b2 = b0, g2 = g0, r2 = r0, b3 = b1, g3 = g1, r3 = r1;
+            if (src1 != nullptr)
+            {
+                LoadBGR(src1 + x * 4, b2, g2, r2);
+                LoadBGR(src1 + x * 4 + 64, b3, g3, r3);
+                StoreY(dstY1 + x, CalcY(b2, g2, r2), CalcY(b3, g3, r3));
+            }
+
+            __m256i b, g, r;
+            if (box)
+            {
+                b = BoxAverage(b0, b1, b2, b3);
+                g = BoxAverage(g0, g1, g2, g3);
+                r = BoxAverage(r0, r1, r2, r3);
+            }
+            else
+            {
+                b = EvenLanes(b0, b1);
+                g = EvenLanes(g0, g1);
+                r = EvenLanes(r0, r1);
+            }
+            StoreUV(dstU + x / 2, CalcU(b, g, r));
+            StoreUV(dstV + x / 2, CalcV(b, g, r));
+        }
+        if (x < width)
+        {
+            const ConvertRowPairFunc tail = box ? ConvertRowPairBox_C : ConvertRowPairTopLeft_C;
+            tail(
+                src0 + x * 4, src1 != nullptr ? src1 + x * 4 : nullptr,
+                dstY0 + x, dstY1 != nullptr ? dstY1 + x : nullptr,
+                dstU + x / 2, dstV + x / 2, width - x);
+        }
+    }
+} // end namespace
+
+void ConvertRowPairTopLeft_AVX2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair<false>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+void ConvertRowPairBox_AVX2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair<true>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+} // end namespace webrtc
+} // end namespace unity
+
+#endif
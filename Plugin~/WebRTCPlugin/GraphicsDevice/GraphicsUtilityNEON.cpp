@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "GraphicsUtilityRow.h"
+
+#if defined(SUPPORT_NEON)
+#include <arm_neon.h>
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace
+{
+    inline uint8x8_t CalcY(uint8x8_t b, uint8x8_t g, uint8x8_t r)
+    {
+        uint16x8_t y = vmull_u8(r, vdup_n_u8(66));
+        y = vmlal_u8(y, g, vdup_n_u8(129));
+        y = vmlal_u8(y, b, vdup_n_u8(25));
+        y = vaddq_u16(y, vdupq_n_u16(128));
+        return vadd_u8(vshrn_n_u16(y, 8), vdup_n_u8(16));
+    }
+
+    inline uint8x16_t CalcY(uint8x16_t b, uint8x16_t g, uint8x16_t r)
+    {
+        return vcombine_u8(
+            CalcY(vget_low_u8(b), vget_low_u8(g), vget_low_u8(r)),
+            CalcY(vget_high_u8(b), vget_high_u8(g), vget_high_u8(r)));
+    }
+
+    inline uint8x8_t CalcUV(int16x8_t b, int16x8_t g, int16x8_t r, int16_t cr, int16_t cg, int16_t cb)
+    {
+        int16x8_t uv = vmulq_n_s16(r, cr);
+        uv = vmlaq_n_s16(uv, g, cg);
+        uv = vmlaq_n_s16(uv, b, cb);
+        uv = vaddq_s16(uv, vdupq_n_s16(128));
+        return vqmovun_s16(vaddq_s16(vshrq_n_s16(uv, 8), vdupq_n_s16(128)));
+    }
+
+    inline int16x8_t EvenLanes(uint8x16_t v)
+    {
+        return vreinterpretq_s16_u16(vmovl_u8(vuzp_u8(vget_low_u8(v), vget_high_u8(v)).val[0]));
+    }
+
+    // Rounded average of each 2x2 block of two rows.
+    inline int16x8_t BoxAverage(uint8x16_t v0, uint8x16_t v1)
+    {
+        return vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(v0), v1), 2));
+    }
+
+    // Processes 16 pixels per iteration.
+    template<bool box>
+    void ConvertRowPair(
+        const uint8_t* src0, const uint8_t* src1,
+        uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+        uint32_t width)
+    {
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const uint8x16x4_t p0 = vld4q_u8(src0 + x * 4);
+            vst1q_u8(dstY0 + x, CalcY(p0.val[0], p0.val[1], p0.val[2]));
+
+            uint8x16x4_t p1 = p0;
+            if (src1 != nullptr)
+            {
+                p1 = vld4q_u8(src1 + x * 4);
+                vst1q_u8(dstY1 + x, CalcY(p1.val[0], p1.val[1], p1.val[2]));
+            }
+
+            int16x8_t b, g, r;
+            if (box)
+            {
+                b = BoxAverage(p0.val[0], p1.val[0]);
+                g = BoxAverage(p0.val[1], p1.val[1]);
+                r = BoxAverage(p0.val[2], p1.val[2]);
+            }
+            else
+            {
+                b = EvenLanes(p0.val[0]);
+                g = EvenLanes(p0.val[1]);
+                r = EvenLanes(p0.val[2]);
+            }
+            vst1_u8(dstU + x / 2, CalcUV(b, g, r, -38, -74, 112));
+            vst1_u8(dstV + x / 2, CalcUV(b, g, r, 112, -94, -18));
+        }
+        if (x < width)
+        {
+            const ConvertRowPairFunc tail = box ? ConvertRowPairBox_C : ConvertRowPairTopLeft_C;
+            tail(
+                src0 + x * 4, src1 != nullptr ? src1 + x * 4 : nullptr,
+                dstY0 + x, dstY1 != nullptr ? dstY1 + x : nullptr,
+                dstU + x / 2, dstV + x / 2, width - x);
+        }
+    }
+} // end namespace
+
+void ConvertRowPairTopLeft_NEON(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair<false>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+void ConvertRowPairBox_NEON(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair<true>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+} // end namespace webrtc
+} // end namespace unity
+
+#endif
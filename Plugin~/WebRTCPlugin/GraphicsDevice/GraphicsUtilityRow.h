@@ -0,0 +1,62 @@
+#pragma once
+
+// Row kernels used by GraphicsUtility. Do not include this file from outside of the GraphicsUtility implementation.
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Converts two BGRA rows into two Y rows and one row of U and V.
+// The "TopLeft" kernels take U and V from the top-left pixel of each 2x2 block,
+// the "Box" kernels take them from the average color of the block.
+// src1 and dstY1 are nullptr when the image has an odd height and src0 is the last row.
+using ConvertRowPairFunc = void(*)(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+
+void ConvertRowPairTopLeft_C(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+void ConvertRowPairBox_C(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+
+#if defined(SUPPORT_SSE2)
+void ConvertRowPairTopLeft_SSE2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+void ConvertRowPairBox_SSE2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+#endif
+
+#if defined(SUPPORT_AVX2)
+void ConvertRowPairTopLeft_AVX2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+void ConvertRowPairBox_AVX2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+#endif
+
+#if defined(SUPPORT_NEON)
+void ConvertRowPairTopLeft_NEON(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+void ConvertRowPairBox_NEON(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width);
+#endif
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,141 @@
+#include "pch.h"
+#include "GraphicsUtilityRow.h"
+
+#if defined(SUPPORT_SSE2)
+#include <emmintrin.h>
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace
+{
+    // Unpacks 8 BGRA pixels into 16-bit B, G and R lanes.
+    inline void LoadBGR(const uint8_t* src, __m128i& b, __m128i& g, __m128i& r)
+    {
+        const __m128i mask = _mm_set1_epi32(0xFF);
+        const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+        g = _mm_packs_epi32(
+            _mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+        r = _mm_packs_epi32(
+            _mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+    }
+
+    // The sum never exceeds 16 bits unsigned, so the logical shift gives the same result as the C code.
+    inline __m128i CalcY(__m128i b, __m128i g, __m128i r)
+    {
+        const __m128i y = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+        return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+    }
+
+    inline __m128i CalcU(__m128i b, __m128i g, __m128i r)
+    {
+        const __m128i u = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(-38)), _mm_mullo_epi16(g, _mm_set1_epi16(-74))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(112)), _mm_set1_epi16(128)));
+        return _mm_add_epi16(_mm_srai_epi16(u, 8), _mm_set1_epi16(128));
+    }
+
+    inline __m128i CalcV(__m128i b, __m128i g, __m128i r)
+    {
+        const __m128i v = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(112)), _mm_mullo_epi16(g, _mm_set1_epi16(-94))),
+            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(-18)), _mm_set1_epi16(128)));
+        return _mm_add_epi16(_mm_srai_epi16(v, 8), _mm_set1_epi16(128));
+    }
+
+    // Picks the even lanes of two vectors of 16-bit values.
+    inline __m128i EvenLanes(__m128i a, __m128i b)
+    {
+        const __m128i mask = _mm_set1_epi32(0xFFFF);
+        return _mm_packs_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    }
+
+    // Rounded average of each 2x2 block, a0 and b0 hold the upper row and a1 and b1 hold the lower row.
+    inline __m128i BoxAverage(__m128i a0, __m128i b0, __m128i a1, __m128i b1)
+    {
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i sum = _mm_packs_epi32(
+            _mm_madd_epi16(_mm_add_epi16(a0, a1), ones), _mm_madd_epi16(_mm_add_epi16(b0, b1), ones));
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+    }
+
+    // Processes 16 pixels per iteration.
+    template<bool box>
+    void ConvertRowPair(
+        const uint8_t* src0, const uint8_t* src1,
+        uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+        uint32_t width)
+    {
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i b0, g0, r0, b1, g1, r1;
+            LoadBGR(src0 + x * 4, b0, g0, r0);
+            LoadBGR(src0 + x * 4 + 32, b1, g1, r1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dstY0 + x),
+                _mm_packus_epi16(CalcY(b0, g0, r0), CalcY(b1, g1, r1)));
+
+            __m128i b2 = b0, g2 = g0, r2 = r0, b3 = b1, g3 = g1, r3 = r1;
+            if (src1 != nullptr)
+            {
+                LoadBGR(src1 + x * 4, b2, g2, r2);
+                LoadBGR(src1 + x * 4 + 32, b3, g3, r3);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dstY1 + x),
+                    _mm_packus_epi16(CalcY(b2, g2, r2), CalcY(b3, g3, r3)));
+            }
+
+            __m128i b, g, r;
+            if (box)
+            {
+                b = BoxAverage(b0, b1, b2, b3);
+                g = BoxAverage(g0, g1, g2, g3);
+                r = BoxAverage(r0, r1, r2, r3);
+            }
+            else
+            {
+                b = EvenLanes(b0, b1);
+                g = EvenLanes(g0, g1);
+                r = EvenLanes(r0, r1);
+            }
+            const __m128i u = CalcU(b, g, r);
+            const __m128i v = CalcV(b, g, r);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dstU + x / 2), _mm_packus_epi16(u, u));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dstV + x / 2), _mm_packus_epi16(v, v));
+        }
+        if (x < width)
+        {
+            const ConvertRowPairFunc tail = box ? ConvertRowPairBox_C : ConvertRowPairTopLeft_C;
+            tail(
+                src0 + x * 4, src1 != nullptr ? src1 + x * 4 : nullptr,
+                dstY0 + x, dstY1 != nullptr ? dstY1 + x : nullptr,
+                dstU + x / 2, dstV + x / 2, width - x);
+        }
+    }
+} // end namespace
+
+void ConvertRowPairTopLeft_SSE2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair<false>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+void ConvertRowPairBox_SSE2(
+    const uint8_t* src0, const uint8_t* src1,
+    uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+    uint32_t width)
+{
+    ConvertRowPair<true>(src0, src1, dstY0, dstY1, dstU, dstV, width);
+}
+
+} // end namespace webrtc
+} // end namespace unity
+
+#endif
@@ -0,0 +1,62 @@
+#include "pch.h"
+#include "I420FrameBufferPool.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace webrtc = ::webrtc;
+
+I420FrameBufferPool::I420FrameBufferPool(size_t maxBuffersPerResolution)
+    : m_maxBuffersPerResolution(maxBuffersPerResolution)
+{
+}
+
+rtc::scoped_refptr<webrtc::I420Buffer> I420FrameBufferPool::CreateBuffer(int width, int height)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& buffers = m_buffers[std::make_pair(width, height)];
+    for (const auto& buffer : buffers)
+    {
+        // Only the pool refers to the buffer, so nobody reads it any more.
+        if (buffer->HasOneRef())
+        {
+            m_hitCount++;
+            return buffer;
+        }
+    }
+    m_missCount++;
+    if (buffers.size() >= m_maxBuffersPerResolution)
+    {
+        return webrtc::I420Buffer::Create(width, height);
+    }
+    rtc::scoped_refptr<PooledBuffer> buffer = new PooledBuffer(width, height);
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+void I420FrameBufferPool::Release()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_buffers.begin(); it != m_buffers.end();)
+    {
+        auto& buffers = it->second;
+        buffers.remove_if([](const rtc::scoped_refptr<PooledBuffer>& buffer) { return buffer->HasOneRef(); });
+        it = buffers.empty() ? m_buffers.erase(it) : std::next(it);
+    }
+}
+
+size_t I420FrameBufferPool::GetBufferCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (const auto& pair : m_buffers)
+    {
+        count += pair.second.size();
+    }
+    return count;
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Recycles I420 buffers so that converting a frame does not allocate memory in the steady state.
+// A buffer returns to the pool when the last reference outside of the pool is released,
+// which usually happens on the encoder thread after the frame is encoded.
+class I420FrameBufferPool {
+public:
+    explicit I420FrameBufferPool(size_t maxBuffersPerResolution = 4);
+
+    // Returns a free buffer of the resolution, or allocates one.
+    // When every pooled buffer is in use, the returned buffer is not kept by the pool.
+    rtc::scoped_refptr<::webrtc::I420Buffer> CreateBuffer(int width, int height);
+    // Frees the buffers which are not in use.
+    void Release();
+
+    // A hit is a buffer reused from the pool, a miss is a new allocation.
+    uint64_t GetHitCount() const { return m_hitCount; }
+    uint64_t GetMissCount() const { return m_missCount; }
+    size_t GetBufferCount() const;
+
+private:
+    using PooledBuffer = rtc::RefCountedObject<::webrtc::I420Buffer>;
+
+    const size_t m_maxBuffersPerResolution;
+    mutable std::mutex m_mutex;
+    std::map<std::pair<int, int>, std::list<rtc::scoped_refptr<PooledBuffer>>> m_buffers;
+    std::atomic<uint64_t> m_hitCount{ 0 };
+    std::atomic<uint64_t> m_missCount{ 0 };
+};
+
+} // end namespace webrtc
+} // end namespace unity
@@ -8,6 +8,7 @@ namespace webrtc
 {
 
 class ITexture2D;
+struct ColorConversionOptions;
 
 class IGraphicsDevice {
 public:
@@ -20,11 +21,15 @@ public:
     virtual void* GetEncodeDevicePtrV() = 0;
     virtual bool CopyResourceV(ITexture2D* dest, ITexture2D* src) = 0;
     virtual bool CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) = 0;
+    // Copies the whole native texture into dest with linear filtering, for the lower simulcast layers.
+    // Returns false when the device can not scale textures.
+    virtual bool ScaleResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) { return false; }
     virtual GraphicsDeviceType GetDeviceType() const = 0;
 
     //Required for software encoding
     virtual ITexture2D* CreateCPUReadTextureV(uint32_t width, uint32_t height) = 0;
-    virtual rtc::scoped_refptr<::webrtc::I420Buffer> ConvertRGBToI420(ITexture2D* tex) = 0;
+    virtual rtc::scoped_refptr<::webrtc::I420Buffer> ConvertRGBToI420(
+        ITexture2D* tex, const ColorConversionOptions& options) = 0;
 
 };
 
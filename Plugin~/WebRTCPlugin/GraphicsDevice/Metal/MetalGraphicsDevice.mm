@@ -122,7 +122,8 @@ namespace webrtc
     }
 
 //---------------------------------------------------------------------------------------------------------------------
-    rtc::scoped_refptr<webrtc::I420Buffer> MetalGraphicsDevice::ConvertRGBToI420(ITexture2D* tex){
+    rtc::scoped_refptr<webrtc::I420Buffer> MetalGraphicsDevice::ConvertRGBToI420(
+        ITexture2D* tex, const ColorConversionOptions& options){
         id<MTLTexture> nativeTex = (__bridge id<MTLTexture>)tex->GetNativeTexturePtrV();
         const uint32_t BYTES_PER_PIXEL = 4;
         
@@ -141,7 +142,7 @@ namespace webrtc
 
         rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer = GraphicsUtility::ConvertRGBToI420Buffer(
             width, height,
-            bytesPerRow, buffer.data()
+            bytesPerRow, buffer.data(), options
         );
         return i420_buffer;
     }
@@ -1,12 +1,141 @@
 ﻿#include "pch.h"
 #include "OpenGLGraphicsDevice.h"
 #include "OpenGLTexture2D.h"
+#include "GraphicsDevice/GraphicsUtility.h"
+#include "GraphicsDevice/I420FrameBufferPool.h"
 
 namespace unity
 {
 namespace webrtc
 {
 
+namespace
+{
+    // Converts the texture to I420 planes packed one after another in the storage buffer.
+    // Each invocation converts a block of 8x2 pixels so that it writes whole words, which requires the width to be
+    // a multiple of 8 and the height to be even. The integer formulas are the same as GraphicsUtility.
+    // The version is prepended by CreateComputeProgram.
+    const char* kConvertRGBToI420Shader = R"(
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(binding = 0) uniform sampler2D u_source;
+layout(std430, binding = 0) writeonly buffer Planes { uint u_planes[]; };
+uniform ivec2 u_size;
+uniform bool u_boxFilter;
+
+ivec3 Fetch(int x, int y) { return ivec3(round(texelFetch(u_source, ivec2(x, y), 0).rgb * 255.0)); }
+uint ToY(ivec3 c) { return uint(((66 * c.r + 129 * c.g + 25 * c.b + 128) >> 8) + 16); }
+uint ToU(ivec3 c) { return uint(((-38 * c.r - 74 * c.g + 112 * c.b + 128) >> 8) + 128); }
+uint ToV(ivec3 c) { return uint(((112 * c.r - 94 * c.g - 18 * c.b + 128) >> 8) + 128); }
+
+void main() {
+    int x0 = int(gl_GlobalInvocationID.x) * 8;
+    int y0 = int(gl_GlobalInvocationID.y) * 2;
+    if (x0 >= u_size.x || y0 >= u_size.y)
+        return;
+    uint y0Words[2] = uint[2](0u, 0u);
+    uint y1Words[2] = uint[2](0u, 0u);
+    uint uWord = 0u;
+    uint vWord = 0u;
+    for (int i = 0; i < 8; i += 2) {
+        ivec3 a = Fetch(x0 + i, y0);
+        ivec3 b = Fetch(x0 + i + 1, y0);
+        ivec3 c = Fetch(x0 + i, y0 + 1);
+        ivec3 d = Fetch(x0 + i + 1, y0 + 1);
+        int shift = (i & 3) * 8;
+        y0Words[i / 4] |= (ToY(a) << shift) | (ToY(b) << (shift + 8));
+        y1Words[i / 4] |= (ToY(c) << shift) | (ToY(d) << (shift + 8));
+        ivec3 chroma = u_boxFilter ? (a + b + c + d + 2) >> 2 : a;
+        uWord |= ToU(chroma) << (i * 4);
+        vWord |= ToV(chroma) << (i * 4);
+    }
+    int yIndex = (y0 * u_size.x + x0) / 4;
+    int rowWords = u_size.x / 4;
+    u_planes[yIndex] = y0Words[0];
+    u_planes[yIndex + 1] = y0Words[1];
+    u_planes[yIndex + rowWords] = y1Words[0];
+    u_planes[yIndex + rowWords + 1] = y1Words[1];
+    int chromaIndex = (y0 / 2) * (u_size.x / 8) + x0 / 8;
+    int uOffset = u_size.x * u_size.y / 4;
+    int vOffset = uOffset + u_size.x * u_size.y / 16;
+    u_planes[uOffset + chromaIndex] = uWord;
+    u_planes[vOffset + chromaIndex] = vWord;
+}
+)";
+
+    bool HasExtension(const char* name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const GLubyte* extension = glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i));
+            if (extension != nullptr && std::strcmp(reinterpret_cast<const char*>(extension), name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Returns the header of the compute shaders for the context, or nullptr when it has no compute shaders.
+    // Compute shaders and storage buffers are core in OpenGL 4.3, older contexts may expose them as extensions.
+    const char* GetComputeShaderHeader()
+    {
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 3))
+            return "#version 430\n";
+        if (major == 4 && minor == 2
+            && HasExtension("GL_ARB_compute_shader")
+            && HasExtension("GL_ARB_shader_storage_buffer_object"))
+        {
+            return "#version 420\n"
+                "#extension GL_ARB_compute_shader : require\n"
+                "#extension GL_ARB_shader_storage_buffer_object : require\n";
+        }
+        return nullptr;
+    }
+
+    GLuint CreateComputeProgram(const char* header, const char* source)
+    {
+        const char* sources[] = { header, source };
+        GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(shader, 2, sources, nullptr);
+        glCompileShader(shader);
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            char log[1024] = {};
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            LogPrint("Failed to compile the conversion shader: %s", log);
+            glDeleteShader(shader);
+            return 0;
+        }
+        GLuint program = glCreateProgram();
+        glAttachShader(program, shader);
+        glLinkProgram(program);
+        glDeleteShader(shader);
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            LogPrint("Failed to link the conversion shader");
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    // Copies planes packed without padding into the buffer, whose strides may be wider.
+    void CopyPlane(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, int dstStride)
+    {
+        for (uint32_t i = 0; i < height; i++)
+        {
+            std::memcpy(dst + i * dstStride, src + i * width, width);
+        }
+    }
+} // end namespace
+
 OpenGLGraphicsDevice::OpenGLGraphicsDevice()
 {
 }
@@ -31,7 +160,21 @@ bool OpenGLGraphicsDevice::InitV() {
 //---------------------------------------------------------------------------------------------------------------------
 
 void OpenGLGraphicsDevice::ShutdownV() {
-
+    if (m_conversionProgram != 0)
+    {
+        glDeleteProgram(m_conversionProgram);
+        m_conversionProgram = 0;
+    }
+    if (m_readFramebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &m_readFramebuffer);
+        m_readFramebuffer = 0;
+    }
+    if (m_drawFramebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &m_drawFramebuffer);
+        m_drawFramebuffer = 0;
+    }
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -47,8 +190,9 @@ ITexture2D* OpenGLGraphicsDevice::CreateDefaultTextureV(uint32_t w, uint32_t h)
 
 //---------------------------------------------------------------------------------------------------------------------
 ITexture2D* OpenGLGraphicsDevice::CreateCPUReadTextureV(uint32_t w, uint32_t h) {
-    assert(false && "CreateCPUReadTextureV need to implement on OpenGL");
-    return nullptr;
+    OpenGLTexture2D* tex = static_cast<OpenGLTexture2D*>(CreateDefaultTextureV(w, h));
+    tex->CreatePixelBuffers(CanConvertOnGPU(w, h));
+    return tex;
 }
 
 
@@ -70,6 +214,50 @@ bool OpenGLGraphicsDevice::CopyResourceFromNativeV(ITexture2D* dest, void* nativ
     return CopyResource(dstName, srcName, width, height);
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+bool OpenGLGraphicsDevice::ScaleResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) {
+    GLuint dstName = reinterpret_cast<intptr_t>(dest->GetNativeTexturePtrV());
+    GLuint srcName = reinterpret_cast<intptr_t>(nativeTexturePtr);
+    if(srcName == dstName || glIsTexture(srcName) == GL_FALSE || glIsTexture(dstName) == GL_FALSE)
+    {
+        LogPrint("Invalid textures to scale");
+        return false;
+    }
+
+    GLint prevTexture = 0;
+    GLint srcWidth = 0;
+    GLint srcHeight = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &prevTexture);
+    glBindTexture(GL_TEXTURE_2D, srcName);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &srcWidth);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &srcHeight);
+    glBindTexture(GL_TEXTURE_2D, prevTexture);
+
+    GLint prevReadFramebuffer = 0;
+    GLint prevDrawFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFramebuffer);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevDrawFramebuffer);
+    if (m_readFramebuffer == 0)
+    {
+        glGenFramebuffers(1, &m_readFramebuffer);
+    }
+    if (m_drawFramebuffer == 0)
+    {
+        glGenFramebuffers(1, &m_drawFramebuffer);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFramebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, srcName, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_drawFramebuffer);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dstName, 0);
+    glBlitFramebuffer(
+        0, 0, srcWidth, srcHeight,
+        0, 0, dest->GetWidth(), dest->GetHeight(),
+        GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFramebuffer);
+    return true;
+}
+
 bool OpenGLGraphicsDevice::CopyResource(GLuint dstName, GLuint srcName, uint32 width, uint32 height) {
     if(srcName == dstName)
     {
@@ -93,10 +281,149 @@ bool OpenGLGraphicsDevice::CopyResource(GLuint dstName, GLuint srcName, uint32 w
     return true;
 }
 
-rtc::scoped_refptr<webrtc::I420Buffer> OpenGLGraphicsDevice::ConvertRGBToI420(ITexture2D* tex)
+//---------------------------------------------------------------------------------------------------------------------
+// The compute shader needs OpenGL 4.3 or its extensions, and sizes which it can write in whole words.
+bool OpenGLGraphicsDevice::CanConvertOnGPU(uint32 width, uint32 height) {
+    if (width % 8 != 0 || height % 2 != 0)
+        return false;
+    if (m_conversionProgram == 0 && !m_conversionProgramFailed)
+    {
+        const char* header = GetComputeShaderHeader();
+        if (header == nullptr)
+        {
+            LogPrint("Compute shaders are not supported, the frames are converted on the CPU");
+            m_conversionProgramFailed = true;
+            return false;
+        }
+        m_conversionProgram = CreateComputeProgram(header, kConvertRGBToI420Shader);
+        m_conversionProgramFailed = m_conversionProgram == 0;
+    }
+    return m_conversionProgram != 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Converts the texture into the pixel buffer with the compute shader, so that only I420 planes are read back.
+void OpenGLGraphicsDevice::ConvertPixelsAsync(
+    OpenGLTexture2D* tex, uint32 bufferIndex, const ColorConversionOptions& options) {
+    GLint prevProgram = 0;
+    GLint prevActiveTexture = 0;
+    GLint prevTexture = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgram);
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &prevActiveTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &prevTexture);
+
+    const GLint width = static_cast<GLint>(tex->GetWidth());
+    const GLint height = static_cast<GLint>(tex->GetHeight());
+    glUseProgram(m_conversionProgram);
+    glUniform2i(glGetUniformLocation(m_conversionProgram, "u_size"), width, height);
+    glUniform1i(glGetUniformLocation(m_conversionProgram, "u_boxFilter"),
+        options.chromaSubsampling == ChromaSubsampling::Box ? 1 : 0);
+    glBindTexture(GL_TEXTURE_2D, tex->m_texture);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tex->m_pixelBuffers[bufferIndex]);
+
+    const GLuint groupSize = 8;
+    const GLuint blocksX = width / 8;
+    const GLuint blocksY = height / 2;
+    glDispatchCompute((blocksX + groupSize - 1) / groupSize, (blocksY + groupSize - 1) / groupSize, 1);
+    // Makes the shader writes visible to glMapBufferRange.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindTexture(GL_TEXTURE_2D, prevTexture);
+    glActiveTexture(prevActiveTexture);
+    glUseProgram(prevProgram);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Starts reading back the texture into the pixel buffer.
+void OpenGLGraphicsDevice::ReadPixelsAsync(OpenGLTexture2D* tex, uint32 bufferIndex) {
+    GLint prevReadFramebuffer = 0;
+    GLint prevPackBuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFramebuffer);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &prevPackBuffer);
+
+    if (m_readFramebuffer == 0)
+    {
+        glGenFramebuffers(1, &m_readFramebuffer);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFramebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex->m_texture, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, tex->m_pixelBuffers[bufferIndex]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // With a pixel pack buffer bound, glReadPixels returns without waiting for the GPU.
+    glReadPixels(0, 0, tex->GetWidth(), tex->GetHeight(), GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, prevPackBuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFramebuffer);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// Returns the frame which was read back (bufferedFrameNum - 1) calls before, so the frames are delayed by two.
+// Returns nullptr until the ring is filled, or when the old readback has not completed yet.
+rtc::scoped_refptr<webrtc::I420Buffer> OpenGLGraphicsDevice::ConvertRGBToI420(
+    ITexture2D* baseTex, const ColorConversionOptions& options)
 {
-    assert(false && "ConvertRGBToI420 need to implement on OpenGL");
-    return nullptr;
+    OpenGLTexture2D* tex = static_cast<OpenGLTexture2D*>(baseTex);
+    if (nullptr == tex || !tex->HasPixelBuffers())
+        return nullptr;
+
+    const uint64 frame = tex->m_readbackCount++;
+    const uint32 writeIndex = frame % bufferedFrameNum;
+    if (tex->m_convertOnGPU)
+        ConvertPixelsAsync(tex, writeIndex, options);
+    else
+        ReadPixelsAsync(tex, writeIndex);
+    // The fence tells when the pixel buffer is ready to map.
+    if (tex->m_fences[writeIndex] != nullptr)
+    {
+        glDeleteSync(tex->m_fences[writeIndex]);
+    }
+    tex->m_fences[writeIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    if (frame + 1 < bufferedFrameNum)
+        return nullptr;
+    const uint32 readIndex = (frame + 1) % bufferedFrameNum;
+    GLsync fence = tex->m_fences[readIndex];
+    if (fence == nullptr)
+        return nullptr;
+    const GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+    {
+        // The readback is slower than the rendering, skip the frame instead of stalling.
+        return nullptr;
+    }
+
+    const uint32_t width = tex->GetWidth();
+    const uint32_t height = tex->GetHeight();
+    const GLsizeiptr size = tex->GetPixelBufferSize();
+
+    GLint prevPackBuffer = 0;
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &prevPackBuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, tex->m_pixelBuffers[readIndex]);
+    const uint8_t* data = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer;
+    if (data != nullptr && tex->m_convertOnGPU)
+    {
+        i420_buffer = options.bufferPool != nullptr ?
+            options.bufferPool->CreateBuffer(width, height) : webrtc::I420Buffer::Create(width, height);
+        const uint32_t chromaWidth = width / 2;
+        const uint32_t chromaHeight = height / 2;
+        const uint8_t* srcU = data + width * height;
+        const uint8_t* srcV = srcU + chromaWidth * chromaHeight;
+        CopyPlane(data, width, height, i420_buffer->MutableDataY(), i420_buffer->StrideY());
+        CopyPlane(srcU, chromaWidth, chromaHeight, i420_buffer->MutableDataU(), i420_buffer->StrideU());
+        CopyPlane(srcV, chromaWidth, chromaHeight, i420_buffer->MutableDataV(), i420_buffer->StrideV());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else if (data != nullptr)
+    {
+        i420_buffer = GraphicsUtility::ConvertRGBToI420Buffer(width, height, width * 4, data, options);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, prevPackBuffer);
+    return i420_buffer;
 }
 
 } // end namespace webrtc
@@ -10,6 +10,8 @@ namespace webrtc
 
 namespace webrtc = ::webrtc;
 
+struct OpenGLTexture2D;
+
 class OpenGLGraphicsDevice : public IGraphicsDevice{
 public:
     OpenGLGraphicsDevice();
@@ -22,12 +24,22 @@ public:
     virtual ITexture2D* CreateDefaultTextureV(uint32_t w, uint32_t h);
     virtual ITexture2D* CreateCPUReadTextureV(uint32_t width, uint32_t height);
     virtual bool CopyResourceV(ITexture2D* dest, ITexture2D* src);
-    virtual rtc::scoped_refptr<webrtc::I420Buffer> ConvertRGBToI420(ITexture2D* tex);
+    virtual rtc::scoped_refptr<webrtc::I420Buffer> ConvertRGBToI420(
+        ITexture2D* tex, const ColorConversionOptions& options);
     virtual bool CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr);
+    virtual bool ScaleResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr);
     inline virtual GraphicsDeviceType GetDeviceType() const;
 
 private:
     bool CopyResource(GLuint dstName, GLuint srcName, uint32 width, uint32 height);
+    void ReadPixelsAsync(OpenGLTexture2D* tex, uint32 bufferIndex);
+    void ConvertPixelsAsync(OpenGLTexture2D* tex, uint32 bufferIndex, const ColorConversionOptions& options);
+    bool CanConvertOnGPU(uint32 width, uint32 height);
+
+    GLuint m_readFramebuffer = 0;
+    GLuint m_drawFramebuffer = 0;
+    GLuint m_conversionProgram = 0;
+    bool m_conversionProgramFailed = false;
 };
 
 void* OpenGLGraphicsDevice::GetEncodeDevicePtrV() { return nullptr; }
@@ -14,5 +14,47 @@ OpenGLTexture2D::OpenGLTexture2D(uint32_t w, uint32_t h, GLuint* tex) : ITexture
 
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+
+void OpenGLTexture2D::CreatePixelBuffers(bool convertOnGPU)
+{
+    m_convertOnGPU = convertOnGPU;
+    const GLsizeiptr size = GetPixelBufferSize();
+    glGenBuffers(bufferedFrameNum, m_pixelBuffers);
+    for (uint32 i = 0; i < bufferedFrameNum; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+void OpenGLTexture2D::ReleasePixelBuffers()
+{
+    for (uint32 i = 0; i < bufferedFrameNum; i++)
+    {
+        if (m_fences[i] != nullptr)
+        {
+            glDeleteSync(m_fences[i]);
+            m_fences[i] = nullptr;
+        }
+    }
+    if (HasPixelBuffers())
+    {
+        glDeleteBuffers(bufferedFrameNum, m_pixelBuffers);
+        std::fill(std::begin(m_pixelBuffers), std::end(m_pixelBuffers), 0);
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+GLsizeiptr OpenGLTexture2D::GetPixelBufferSize() const
+{
+    const GLsizeiptr pixelCount = static_cast<GLsizeiptr>(m_width) * m_height;
+    return m_convertOnGPU ? pixelCount * 3 / 2 : pixelCount * 4;
+}
+
 } // end namespace webrtc
 } // end namespace unity
\ No newline at end of file
@@ -12,13 +12,27 @@ struct OpenGLTexture2D : ITexture2D {
 public:
     GLuint m_texture;
 
+    // Ring of pixel buffer objects to read back the texture without stalling the render thread.
+    // These are created only for the texture returned by CreateCPUReadTextureV.
+    GLuint m_pixelBuffers[bufferedFrameNum] = {};
+    GLsync m_fences[bufferedFrameNum] = {};
+    uint64 m_readbackCount = 0;
+    // The pixel buffers hold I420 planes converted by a compute shader instead of BGRA pixels.
+    bool m_convertOnGPU = false;
+
     OpenGLTexture2D(uint32_t w, uint32_t h, GLuint* tex);
 
     virtual ~OpenGLTexture2D() {
+        ReleasePixelBuffers();
         glDeleteTextures(1 , &m_texture);
         m_texture = 0;
     }
 
+    void CreatePixelBuffers(bool convertOnGPU);
+    void ReleasePixelBuffers();
+    bool HasPixelBuffers() const { return m_pixelBuffers[0] != 0; }
+    GLsizeiptr GetPixelBufferSize() const;
+
     inline virtual void* GetNativeTexturePtrV();
     inline virtual const void* GetNativeTexturePtrV() const;
     inline virtual void* GetEncodeTexturePtrV();
@@ -5,6 +5,7 @@
 #include "IUnityGraphicsVulkan.h"
 #include "vulkan/vulkan.h"
 #include "VulkanUtility.h"
+#include "GraphicsDevice/GraphicsUtility.h"
 
 namespace unity
 {
@@ -44,18 +45,26 @@ bool VulkanGraphicsDevice::InitV() {
 #endif
     }
 
-    if (CUDA_SUCCESS!=m_cudaContext.Init(m_instance, m_physicalDevice))
-        return false;
+    m_cudaAvailable = CUDA_SUCCESS == m_cudaContext.Init(m_instance, m_physicalDevice);
+    if (!m_cudaAvailable)
+    {
+        LogPrint("CUDA is not available. Only the software encoder can be used with Vulkan.");
+    }
 
-    return (VK_SUCCESS == CreateCommandPool());
+    return (VK_SUCCESS == CreateCommandPool()) && (VK_SUCCESS == CreateCopySlots());
 
 }
 
 //---------------------------------------------------------------------------------------------------------------------
 
 void VulkanGraphicsDevice::ShutdownV() {
+    DestroyCopySlots();
     VULKAN_SAFE_DESTROY_COMMAND_POOL(m_device, m_commandPool, m_allocator);
-    m_cudaContext.Shutdown();
+    if (m_cudaAvailable)
+    {
+        m_cudaContext.Shutdown();
+        m_cudaAvailable = false;
+    }
 
     if (s_hModule)
     {
@@ -73,7 +82,8 @@ void VulkanGraphicsDevice::ShutdownV() {
 ITexture2D* VulkanGraphicsDevice::CreateDefaultTextureV(const uint32_t w, const uint32_t h) {
 
     VulkanTexture2D* vulkanTexture = new VulkanTexture2D(w, h);
-    if (!vulkanTexture->Init(m_physicalDevice, m_device)) {
+    vulkanTexture->SetCopyDevice(this);
+    if (!vulkanTexture->Init(m_physicalDevice, m_device, m_cudaAvailable)) {
         vulkanTexture->Shutdown();
         delete (vulkanTexture);
         return nullptr;
@@ -94,10 +104,32 @@ ITexture2D* VulkanGraphicsDevice::CreateDefaultTextureV(const uint32_t w, const
 }
 
 //---------------------------------------------------------------------------------------------------------------------
+//Returns null if failed
 ITexture2D* VulkanGraphicsDevice::CreateCPUReadTextureV(uint32_t width, uint32_t height) {
-    assert(false && "CreateCPUReadTextureV() for Vulkan is not implemented yet");
-    return nullptr;
-    
+
+    const bool EXPORT_TO_CUDA = false;
+    VulkanTexture2D* vulkanTexture = new VulkanTexture2D(width, height);
+    vulkanTexture->SetCopyDevice(this);
+    if (!vulkanTexture->Init(m_physicalDevice, m_device, EXPORT_TO_CUDA) ||
+        !vulkanTexture->InitStagingBuffers(m_physicalDevice, m_commandPool))
+    {
+        vulkanTexture->Shutdown();
+        delete (vulkanTexture);
+        return nullptr;
+    }
+
+    //Transition to dest
+    if (VK_SUCCESS!= VulkanUtility::DoImageLayoutTransition(m_device, m_commandPool, m_graphicsQueue,
+            vulkanTexture->GetImage(), vulkanTexture->GetTextureFormat(),
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT))
+    {
+        vulkanTexture->Shutdown();
+        delete (vulkanTexture);
+        return nullptr;
+    }
+
+    return vulkanTexture;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -110,40 +142,41 @@ bool VulkanGraphicsDevice::CopyResourceV(ITexture2D* dest, ITexture2D* src) {
     if (destTexture == nullptr || srcTexture == nullptr)
         return false;
 
-    //Transition the src texture layout. 
-    VULKAN_CHECK_FAILVALUE(
-        VulkanUtility::DoImageLayoutTransition(m_device, m_commandPool, m_graphicsQueue, 
-            srcTexture->GetImage(), srcTexture->GetTextureFormat(), 
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT
-        ),
-        false
-    );
+    //The layouts of All VulkanTexture2D should be VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, so the src texture is
+    //transitioned for the copy and back in the same command buffer
+    const bool TRANSITION_SRC = true;
+    VULKAN_CHECK_FAILVALUE(CopyImage(destTexture, srcTexture->GetImage(), TRANSITION_SRC), false);
+    srcTexture->SetLastCopy(destTexture->GetLastCopy());
+    return true;
+}
 
-    //[TODO-sin: 2019-11-21] Optimize so that we don't do vkQueueWaitIdle multiple times here
-    //The layouts of All VulkanTexture2D should be VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, so no transition for destTex
-    VULKAN_CHECK_FAILVALUE(
-        VulkanUtility::CopyImage(m_device, m_commandPool, m_graphicsQueue, srcTexture->GetImage(),
-            destTexture->GetImage(), destTexture->GetWidth(), destTexture->GetHeight()
-        ),
-        false
-    );
+//---------------------------------------------------------------------------------------------------------------------
+bool VulkanGraphicsDevice::CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) {
+    if (nullptr == dest || nullptr == nativeTexturePtr)
+        return false;
 
-    //transition the src texture layout back to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-    VULKAN_CHECK_FAILVALUE(
-        VulkanUtility::DoImageLayoutTransition(m_device, m_commandPool, m_graphicsQueue, 
-            srcTexture->GetImage(), srcTexture->GetTextureFormat(), 
-            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT
-        ),
-        false
-    );
+    VulkanTexture2D* destTexture = reinterpret_cast<VulkanTexture2D*>(dest);
+    UnityVulkanImage unityVulkanImage;
+    VkImageSubresource subResource { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+
+    if (!m_unityVulkan->AccessTexture(nativeTexturePtr, &subResource, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, kUnityVulkanResourceAccess_PipelineBarrier,
+        &unityVulkanImage))
+    {
+        return false;
+    }
+
+    if (destTexture->GetImage() == unityVulkanImage.image)
+        return false;
 
+    //Unity has already transitioned the src texture with the pipeline barrier
+    const bool TRANSITION_SRC = false;
+    VULKAN_CHECK_FAILVALUE(CopyImage(destTexture, unityVulkanImage.image, TRANSITION_SRC), false);
     return true;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-bool VulkanGraphicsDevice::CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) {
+bool VulkanGraphicsDevice::ScaleResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) {
     if (nullptr == dest || nullptr == nativeTexturePtr)
         return false;
 
@@ -161,30 +194,229 @@ bool VulkanGraphicsDevice::CopyResourceFromNativeV(ITexture2D* dest, void* nativ
     if (destTexture->GetImage() == unityVulkanImage.image)
         return false;
 
-    //The layouts of All VulkanTexture2D should be VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, so no transition for destTex
-    VULKAN_CHECK_FAILVALUE(
-        VulkanUtility::CopyImage(m_device, m_commandPool, m_graphicsQueue,
-            unityVulkanImage.image, destTexture->GetImage(), destTexture->GetWidth(), destTexture->GetHeight()),
-        false
-    );
-
+    const bool TRANSITION_SRC = false;
+    VULKAN_CHECK_FAILVALUE(CopyImage(destTexture, unityVulkanImage.image, TRANSITION_SRC, &unityVulkanImage.extent),
+        false);
     return true;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+//Records the copy into the next slot of the ring and submits it with the fence of the slot.
+//The GPU work is ordered by the queue, so the readback of the dest texture sees the copied pixels without waiting.
+//When srcExtent is given, the whole src image is blitted with linear filtering into the dest texture.
+VkResult VulkanGraphicsDevice::CopyImage(VulkanTexture2D* destTexture, const VkImage srcImage,
+    const bool transitionSrc, const VkExtent3D* srcExtent)
+{
+    std::lock_guard<std::mutex> lock(m_copyMutex);
+    VulkanCommandSlot& slot = m_copySlots[m_copyCount % bufferedFrameNum];
+    if (slot.submitted) {
+        //Normally the copy bufferedFrameNum frames before has finished long ago
+        VULKAN_CHECK(vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+        slot.submitted = false;
+    }
+    VULKAN_CHECK(vkResetFences(m_device, 1, &slot.fence));
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VULKAN_CHECK(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo));
+
+    if (transitionSrc) {
+        VulkanUtility::RecordImageLayoutTransition(slot.commandBuffer, srcImage, destTexture->GetTextureFormat(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+
+    if (srcExtent != nullptr) {
+        VkImageBlit blitRegion = {};
+        blitRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        blitRegion.srcOffsets[1] = { static_cast<int32_t>(srcExtent->width), static_cast<int32_t>(srcExtent->height), 1 };
+        blitRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        blitRegion.dstOffsets[1] = {
+            static_cast<int32_t>(destTexture->GetWidth()), static_cast<int32_t>(destTexture->GetHeight()), 1 };
+        vkCmdBlitImage(slot.commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            destTexture->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_LINEAR);
+    } else {
+        VkImageCopy copyRegion = {};
+        copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        copyRegion.srcOffset = { 0, 0, 0 };
+        copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        copyRegion.dstOffset = { 0, 0, 0 };
+        copyRegion.extent = { destTexture->GetWidth(), destTexture->GetHeight(), 1 };
+        vkCmdCopyImage(slot.commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            destTexture->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+    }
+
+    if (transitionSrc) {
+        VulkanUtility::RecordImageLayoutTransition(slot.commandBuffer, srcImage, destTexture->GetTextureFormat(),
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+
+    VULKAN_CHECK(vkEndCommandBuffer(slot.commandBuffer));
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &slot.commandBuffer;
+    VULKAN_CHECK(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, slot.fence));
+    slot.submitted = true;
+    m_copyCount++;
+    destTexture->SetLastCopy(m_copyCount);
+
+    //CUDA can not wait for the Vulkan fence, so the texture shared with the hardware encoder must be ready on return
+    if (destTexture->IsExportedToCuda()) {
+        VULKAN_CHECK(vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+    }
+    return VK_SUCCESS;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void VulkanGraphicsDevice::WaitForCopies(const VulkanTexture2D* texture) {
+    std::lock_guard<std::mutex> lock(m_copyMutex);
+    const uint64 lastCopy = texture->GetLastCopy();
+    //A slot is waited before it is recorded again, so only the copies of the last bufferedFrameNum slots may run
+    if (0 == lastCopy || lastCopy > m_copyCount || m_copyCount - lastCopy >= bufferedFrameNum)
+        return;
+    VulkanCommandSlot& slot = m_copySlots[(lastCopy - 1) % bufferedFrameNum];
+    if (slot.submitted) {
+        vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+    }
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 VkResult VulkanGraphicsDevice::CreateCommandPool() {
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = m_queueFamilyIndex;
-    poolInfo.flags = 0; 
+    //The command buffers of the staging buffers are recorded again for every readback
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     return vkCreateCommandPool(m_device, &poolInfo, m_allocator, &m_commandPool);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
-rtc::scoped_refptr<webrtc::I420Buffer> VulkanGraphicsDevice::ConvertRGBToI420(ITexture2D* tex) {
-    assert(false && "ConvertRGBToI420() for Vulkan is not implemented yet");
-    return nullptr;    
+VkResult VulkanGraphicsDevice::CreateCopySlots() {
+    for (VulkanCommandSlot& slot : m_copySlots) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+        VULKAN_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, &slot.commandBuffer));
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VULKAN_CHECK(vkCreateFence(m_device, &fenceInfo, m_allocator, &slot.fence));
+    }
+    return VK_SUCCESS;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void VulkanGraphicsDevice::DestroyCopySlots() {
+    std::lock_guard<std::mutex> lock(m_copyMutex);
+    for (VulkanCommandSlot& slot : m_copySlots) {
+        if (slot.submitted) {
+            vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            slot.submitted = false;
+        }
+        if (VK_NULL_HANDLE != slot.commandBuffer) {
+            vkFreeCommandBuffers(m_device, m_commandPool, 1, &slot.commandBuffer);
+            slot.commandBuffer = VK_NULL_HANDLE;
+        }
+        VULKAN_SAFE_DESTROY_FENCE(m_device, slot.fence, m_allocator);
+    }
+    m_copyCount = 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//Copies the texture into the staging buffer, and signals the fence of the staging buffer when the copy is done
+VkResult VulkanGraphicsDevice::RecordAndSubmitReadback(VulkanTexture2D* texture, VulkanStagingBuffer& staging) {
+    VULKAN_CHECK(vkResetFences(m_device, 1, &staging.fence));
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VULKAN_CHECK(vkBeginCommandBuffer(staging.commandBuffer, &beginInfo));
+
+    //The layouts of All VulkanTexture2D should be VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, so restore it after the copy
+    VulkanUtility::RecordImageLayoutTransition(staging.commandBuffer,
+        texture->GetImage(), texture->GetTextureFormat(),
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; //tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { texture->GetWidth(), texture->GetHeight(), 1 };
+    vkCmdCopyImageToBuffer(staging.commandBuffer, texture->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        staging.buffer, 1, &region);
+
+    VulkanUtility::RecordImageLayoutTransition(staging.commandBuffer,
+        texture->GetImage(), texture->GetTextureFormat(),
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    //Make the copied data visible to the host
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = staging.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(staging.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        0, nullptr,
+        1, &barrier,
+        0, nullptr
+    );
+
+    VULKAN_CHECK(vkEndCommandBuffer(staging.commandBuffer));
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &staging.commandBuffer;
+    VULKAN_CHECK(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, staging.fence));
+    staging.submitted = true;
+    return VK_SUCCESS;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//Returns the frame which was copied (bufferedFrameNum - 1) calls before, so the frames are delayed by two.
+//Returns null until the ring is filled, or when the old copy has not completed yet.
+rtc::scoped_refptr<webrtc::I420Buffer> VulkanGraphicsDevice::ConvertRGBToI420(
+    ITexture2D* tex, const ColorConversionOptions& options) {
+
+    VulkanTexture2D* texture = reinterpret_cast<VulkanTexture2D*>(tex);
+    if (nullptr == texture || !texture->HasStagingBuffers())
+        return nullptr;
+
+    const uint64 frame = texture->GetReadbackCount();
+    VulkanStagingBuffer& writeStaging = texture->GetStagingBuffer(frame % bufferedFrameNum);
+    //The GPU is still copying into the oldest staging buffer, so skip this frame instead of stalling
+    if (writeStaging.submitted && VK_SUCCESS != vkGetFenceStatus(m_device, writeStaging.fence))
+        return nullptr;
+    VULKAN_CHECK_FAILVALUE(RecordAndSubmitReadback(texture, writeStaging), nullptr);
+    texture->AddReadback();
+
+    if (frame + 1 < bufferedFrameNum)
+        return nullptr;
+    VulkanStagingBuffer& readStaging = texture->GetStagingBuffer((frame + 1) % bufferedFrameNum);
+    if (!readStaging.submitted || VK_SUCCESS != vkGetFenceStatus(m_device, readStaging.fence))
+        return nullptr;
+
+    const uint32_t width = texture->GetWidth();
+    const uint32_t height = texture->GetHeight();
+    return GraphicsUtility::ConvertRGBToI420Buffer(width, height, width * 4,
+        static_cast<const uint8_t*>(readStaging.mappedData), options);
 }
 
 } // end namespace webrtc
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include "GraphicsDevice/IGraphicsDevice.h"
 #include "WebRTCConstants.h"
 #include "Cuda/CudaContext.h"
@@ -11,6 +12,16 @@ namespace webrtc
 
 namespace webrtc = ::webrtc;
 
+class VulkanTexture2D;
+struct VulkanStagingBuffer;
+
+//A command buffer which is recorded again every time the slot comes around in the ring
+struct VulkanCommandSlot {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence         fence = VK_NULL_HANDLE;
+    bool            submitted = false;
+};
+
 class VulkanGraphicsDevice : public IGraphicsDevice{
 public:
     VulkanGraphicsDevice( IUnityGraphicsVulkan* unityVulkan, const VkInstance instance,
@@ -26,11 +37,21 @@ public:
 
     virtual bool CopyResourceV(ITexture2D* dest, ITexture2D* src) override;
     virtual bool CopyResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) override;
+    virtual bool ScaleResourceFromNativeV(ITexture2D* dest, void* nativeTexturePtr) override;
     inline virtual GraphicsDeviceType GetDeviceType() const override;
-    virtual rtc::scoped_refptr<webrtc::I420Buffer> ConvertRGBToI420(ITexture2D* tex) override;
+    virtual rtc::scoped_refptr<webrtc::I420Buffer> ConvertRGBToI420(
+        ITexture2D* tex, const ColorConversionOptions& options) override;
+
+    //Waits for the copies which read or wrote the texture, on any thread. The textures are destroyed before the device.
+    void WaitForCopies(const VulkanTexture2D* texture);
 private:
 
     VkResult CreateCommandPool();
+    VkResult RecordAndSubmitReadback(VulkanTexture2D* texture, VulkanStagingBuffer& staging);
+    VkResult CreateCopySlots();
+    void DestroyCopySlots();
+    VkResult CopyImage(VulkanTexture2D* destTexture, const VkImage srcImage, const bool transitionSrc,
+        const VkExtent3D* srcExtent = nullptr);
 
     IUnityGraphicsVulkan*   m_unityVulkan;
     VkInstance              m_instance;
@@ -39,7 +60,15 @@ private:
     VkQueue                 m_graphicsQueue;
     VkCommandPool           m_commandPool;
 
+    //Texture copies are not waited with vkQueueWaitIdle, but are tracked with the fences of the slots
+    //Guards the slots, so that the fence of a slot is not reset while a texture waits for it
+    std::mutex              m_copyMutex;
+    VulkanCommandSlot       m_copySlots[bufferedFrameNum];
+    uint64                  m_copyCount = 0;
+
     CudaContext m_cudaContext;
+    //The CPU readback path works without CUDA, so the device can be used for the software encoder
+    bool m_cudaAvailable = false;
     uint32_t m_queueFamilyIndex;
 
     const VkAllocationCallbacks* m_allocator = nullptr;
@@ -2,6 +2,7 @@
 #include "VulkanTexture2D.h"
 
 #include "GraphicsDevice/Vulkan/VulkanUtility.h"
+#include "GraphicsDevice/Vulkan/VulkanGraphicsDevice.h"
 
 namespace unity
 {
@@ -28,7 +29,13 @@ VulkanTexture2D::~VulkanTexture2D() {
 
 void VulkanTexture2D::Shutdown()
 {
-    //[TODO-sin: 2019-11-20] Create an explicit Shutdown(device) function
+    //The copies are not waited when they are submitted, so the image may still be in use.
+    //Only the copies of this texture are waited, the queues of Unity are not touched.
+    if (nullptr != m_copyDevice) {
+        m_copyDevice->WaitForCopies(this);
+        m_copyDevice = nullptr;
+    }
+    ShutdownStagingBuffers();
     VULKAN_SAFE_DESTROY_IMAGE(m_device, m_textureImage, m_allocator);
     VULKAN_SAFE_FREE_MEMORY(m_device, m_textureImageMemory, m_allocator);
     m_textureImageMemorySize = 0;
@@ -39,24 +46,96 @@ void VulkanTexture2D::Shutdown()
 
 //---------------------------------------------------------------------------------------------------------------------
 
-bool VulkanTexture2D::Init(const VkPhysicalDevice physicalDevice, const VkDevice device) {
+bool VulkanTexture2D::Init(const VkPhysicalDevice physicalDevice, const VkDevice device, const bool exportToCuda) {
     m_device = device;
 
-    const bool EXPORT_HANDLE = true;
     m_textureImageMemorySize = VulkanUtility::CreateImage(physicalDevice,device,m_allocator, m_width, m_height,
         VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,m_textureFormat, &m_textureImage,&m_textureImageMemory,
-        EXPORT_HANDLE
+        exportToCuda
     );
 
     if (m_textureImageMemorySize <= 0) {
         return false;
     }
 
+    if (!exportToCuda)
+        return true;
+
     return (CUDA_SUCCESS == m_cudaImage.Init(m_device, this));
 
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+
+bool VulkanTexture2D::InitStagingBuffers(const VkPhysicalDevice physicalDevice, const VkCommandPool commandPool) {
+    m_commandPool = commandPool;
+
+    //B8G8R8A8 without padding between rows
+    const VkDeviceSize size = static_cast<VkDeviceSize>(m_width) * m_height * 4;
+    for (VulkanStagingBuffer& staging : m_stagingBuffers) {
+        //Cached memory is faster to read from the CPU, but is not available on all devices
+        if (VulkanUtility::CreateBuffer(physicalDevice, m_device, m_allocator, size,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                &staging.buffer, &staging.memory) <= 0)
+        {
+            VULKAN_SAFE_DESTROY_BUFFER(m_device, staging.buffer, m_allocator);
+            VULKAN_SAFE_FREE_MEMORY(m_device, staging.memory, m_allocator);
+            if (VulkanUtility::CreateBuffer(physicalDevice, m_device, m_allocator, size,
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    &staging.buffer, &staging.memory) <= 0)
+            {
+                return false;
+            }
+        }
+        VULKAN_CHECK_FAILVALUE(vkMapMemory(m_device, staging.memory, 0, VK_WHOLE_SIZE, 0, &staging.mappedData), false);
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+        VULKAN_CHECK_FAILVALUE(vkAllocateCommandBuffers(m_device, &allocInfo, &staging.commandBuffer), false);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VULKAN_CHECK_FAILVALUE(vkCreateFence(m_device, &fenceInfo, m_allocator, &staging.fence), false);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+void VulkanTexture2D::ShutdownStagingBuffers()
+{
+    if (!HasStagingBuffers())
+        return;
+
+    for (VulkanStagingBuffer& staging : m_stagingBuffers) {
+        //The copy may still be running on the GPU
+        if (staging.submitted) {
+            vkWaitForFences(m_device, 1, &staging.fence, VK_TRUE, UINT64_MAX);
+        }
+        if (VK_NULL_HANDLE != staging.commandBuffer) {
+            vkFreeCommandBuffers(m_device, m_commandPool, 1, &staging.commandBuffer);
+            staging.commandBuffer = VK_NULL_HANDLE;
+        }
+        VULKAN_SAFE_DESTROY_FENCE(m_device, staging.fence, m_allocator);
+        if (nullptr != staging.mappedData) {
+            vkUnmapMemory(m_device, staging.memory);
+            staging.mappedData = nullptr;
+        }
+        VULKAN_SAFE_DESTROY_BUFFER(m_device, staging.buffer, m_allocator);
+        VULKAN_SAFE_FREE_MEMORY(m_device, staging.memory, m_allocator);
+        staging.submitted = false;
+    }
+    m_commandPool = VK_NULL_HANDLE;
+    m_readbackCount = 0;
+}
+
 } // end namespace webrtc
 } // end namespace unity
@@ -9,13 +9,28 @@ namespace unity
 namespace webrtc
 {
 
+class VulkanGraphicsDevice;
+
+// Host visible buffer which receives a copy of the texture, and the commands and fence of the copy.
+struct VulkanStagingBuffer {
+    VkBuffer        buffer = VK_NULL_HANDLE;
+    VkDeviceMemory  memory = VK_NULL_HANDLE;
+    void*           mappedData = nullptr;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence         fence = VK_NULL_HANDLE;
+    bool            submitted = false;
+};
+
 class VulkanTexture2D : public ITexture2D {
 public:
 
     VulkanTexture2D(const uint32_t w, const uint32_t h);
     virtual ~VulkanTexture2D();
 
-    bool Init(const VkPhysicalDevice physicalDevice, const VkDevice device); 
+    //exportToCuda is not needed for the textures which are read back by the CPU
+    bool Init(const VkPhysicalDevice physicalDevice, const VkDevice device, const bool exportToCuda = true);
+    //Creates the staging buffer ring to read back the texture. The command buffers are allocated from commandPool.
+    bool InitStagingBuffers(const VkPhysicalDevice physicalDevice, const VkCommandPool commandPool);
     void Shutdown(); 
 
     inline virtual void* GetNativeTexturePtrV() override;
@@ -28,7 +43,28 @@ public:
     inline VkDeviceSize GetTextureImageMemorySize() const;
     inline VkFormat     GetTextureFormat() const;
 
+    inline bool IsExportedToCuda() const;
+    inline bool HasStagingBuffers() const;
+    inline VulkanStagingBuffer& GetStagingBuffer(const uint32_t index);
+    //The device records the copies which read or write the texture, and waits for them before it is destroyed
+    inline void SetCopyDevice(VulkanGraphicsDevice* device);
+    inline void SetLastCopy(const uint64 copy);
+    inline uint64 GetLastCopy() const;
+    //Number of the readbacks which have been recorded to the staging buffers
+    inline uint64 GetReadbackCount() const;
+    inline void AddReadback();
+
 private:
+    void ShutdownStagingBuffers();
+
+    VulkanGraphicsDevice* m_copyDevice = nullptr;
+    //One more than the index of the last copy in the ring of the device, 0 without copies
+    uint64              m_lastCopy = 0;
+
+    VulkanStagingBuffer m_stagingBuffers[bufferedFrameNum];
+    uint64              m_readbackCount = 0;
+    VkCommandPool       m_commandPool = VK_NULL_HANDLE;
+
     VkImage             m_textureImage;
     VkDeviceMemory      m_textureImageMemory;
     VkDeviceSize        m_textureImageMemorySize;
@@ -52,6 +88,14 @@ VkImage         VulkanTexture2D::GetImage() const               { return m_textu
 VkDeviceMemory  VulkanTexture2D::GetTextureImageMemory() const  { return m_textureImageMemory; }
 VkDeviceSize    VulkanTexture2D::GetTextureImageMemorySize() const { return m_textureImageMemorySize; }
 VkFormat        VulkanTexture2D::GetTextureFormat() const       { return m_textureFormat; }
+bool            VulkanTexture2D::IsExportedToCuda() const       { return m_cudaImage.GetArray() != nullptr; }
+bool            VulkanTexture2D::HasStagingBuffers() const      { return m_commandPool != VK_NULL_HANDLE; }
+VulkanStagingBuffer& VulkanTexture2D::GetStagingBuffer(const uint32_t index) { return m_stagingBuffers[index]; }
+uint64          VulkanTexture2D::GetReadbackCount() const       { return m_readbackCount; }
+void            VulkanTexture2D::AddReadback()                  { m_readbackCount++; }
+void            VulkanTexture2D::SetCopyDevice(VulkanGraphicsDevice* device) { m_copyDevice = device; }
+void            VulkanTexture2D::SetLastCopy(const uint64 copy) { m_lastCopy = copy; }
+uint64          VulkanTexture2D::GetLastCopy() const            { return m_lastCopy; }
 
 } // end namespace unity
 } // end namespace webrtc
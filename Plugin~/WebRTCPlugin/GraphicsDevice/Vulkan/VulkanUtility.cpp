@@ -96,6 +96,44 @@ VkDeviceSize VulkanUtility::CreateImage(const VkPhysicalDevice physicalDevice, c
     return memRequirements.size;
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+//Returns 0 when failed
+VkDeviceSize VulkanUtility::CreateBuffer(const VkPhysicalDevice physicalDevice, const VkDevice device,
+    const VkAllocationCallbacks* allocator, const VkDeviceSize size,
+    const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties,
+    VkBuffer* buffer, VkDeviceMemory* bufferMemory)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, allocator, buffer) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, *buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    if (!VulkanUtility::FindMemoryTypeInto(
+        physicalDevice, memRequirements.memoryTypeBits, properties, &allocInfo.memoryTypeIndex)
+       )
+    {
+        return 0;
+    }
+
+    if (vkAllocateMemory(device, &allocInfo, allocator, bufferMemory) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VULKAN_CHECK_FAILVALUE(vkBindBufferMemory(device, *buffer, *bufferMemory, 0), 0);
+
+    return memRequirements.size;
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 //returns VK_NULL_HANDLE when failed
 VkImageView  VulkanUtility::CreateImageView(const VkDevice device, const VkAllocationCallbacks* allocator,
@@ -248,6 +286,18 @@ VkResult VulkanUtility::DoImageLayoutTransition(const VkDevice device, const VkC
     VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
     VULKAN_CHECK(BeginOneTimeCommandBufferInto(device, commandPool, &commandBuffer));
 
+    RecordImageLayoutTransition(commandBuffer, image, format, oldLayout, oldStage, newLayout, newStage);
+
+    return EndAndSubmitOneTimeCommandBuffer(device, commandPool, queue, commandBuffer);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+void VulkanUtility::RecordImageLayoutTransition(VkCommandBuffer commandBuffer,
+                                          const VkImage image, const VkFormat format,
+                                          const VkImageLayout oldLayout, const VkPipelineStageFlags oldStage,
+                                          const VkImageLayout newLayout, const VkPipelineStageFlags newStage)
+{
     VkImageMemoryBarrier barrier = {};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -355,8 +405,6 @@ VkResult VulkanUtility::DoImageLayoutTransition(const VkDevice device, const VkC
         0, nullptr,
         1, &barrier
     );
-
-    return EndAndSubmitOneTimeCommandBuffer(device, commandPool, queue, commandBuffer);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
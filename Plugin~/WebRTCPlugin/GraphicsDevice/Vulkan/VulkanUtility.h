@@ -20,6 +20,11 @@ public:
         const VkFormat format,
         VkImage* image, VkDeviceMemory* imageMemory, bool exportHandle);
 
+    static VkDeviceSize CreateBuffer(const VkPhysicalDevice physicalDevice, const VkDevice device,
+        const VkAllocationCallbacks* allocator, const VkDeviceSize size,
+        const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties,
+        VkBuffer* buffer, VkDeviceMemory* bufferMemory);
+
     static VkImageView  CreateImageView(const VkDevice device, const VkAllocationCallbacks* allocator, 
                                         const VkImage image, const VkFormat format);
 
@@ -42,6 +47,12 @@ public:
                                         const VkImageLayout oldLayout, const VkPipelineStageFlags oldStage,
                                         const VkImageLayout newLayout, const VkPipelineStageFlags newStage);
 
+    //Records the layout transition into commandBuffer without submitting it
+    static void RecordImageLayoutTransition(VkCommandBuffer commandBuffer,
+                                        const VkImage image, VkFormat format,
+                                        const VkImageLayout oldLayout, const VkPipelineStageFlags oldStage,
+                                        const VkImageLayout newLayout, const VkPipelineStageFlags newStage);
+
     static VkResult CopyImage(const VkDevice device, const VkCommandPool commandPool, const VkQueue queue,
                const VkImage srcImage, const VkImage dstImage,
                const uint32_t width, const uint32_t height);
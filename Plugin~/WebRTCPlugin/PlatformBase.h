@@ -57,6 +57,7 @@
 #define SUPPORT_OPENGL_UNIFIED 1
 #define SUPPORT_OPENGL_CORE 1
 #define SUPPORT_VULKAN 1
+#define SUPPORT_SOFTWARE_ENCODER 1
 #elif UNITY_OSX
 #define SUPPORT_SOFTWARE_ENCODER 1
 #endif
@@ -65,6 +66,15 @@
 #define SUPPORT_METAL 1
 #endif
 
+// Which SIMD instruction sets we possibly support?
+// The availability is checked again at runtime before any of these code paths is selected.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SUPPORT_SSE2 1
+#define SUPPORT_AVX2 1
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define SUPPORT_NEON 1
+#endif
+
 // COM-like Release macro
 #ifndef SAFE_RELEASE
 #define SAFE_RELEASE(a) if (a) { a->Release(); a = NULL; }
@@ -4,6 +4,7 @@
 #include <IUnityProfiler.h>
 
 #include "Codec/EncoderFactory.h"
+#include "Codec/EncoderPool.h"
 #include "Context.h"
 #include "GraphicsDevice/GraphicsDevice.h"
 
@@ -11,7 +12,9 @@ enum class VideoStreamRenderEventID
 {
     Initialize = 0,
     Encode = 1,
-    Finalize = 2
+    Finalize = 2,
+    // Issued periodically by the main thread, so that the idle encoders expire while no track sends events.
+    Evict = 3
 };
 
 namespace unity
@@ -24,6 +27,8 @@ namespace webrtc
     Context* s_context = nullptr;
     IGraphicsDevice* s_device;
     std::map<const ::webrtc::MediaStreamTrackInterface*, std::unique_ptr<IEncoder>> s_mapEncoder;
+    // The key which each encoder returns to the pool with.
+    std::map<const ::webrtc::MediaStreamTrackInterface*, EncoderPoolKey> s_mapEncoderKey;
 
     const UnityProfilerMarkerDesc* s_MarkerEncode = nullptr;
     bool s_IsDevelopmentBuild = false;
@@ -32,6 +37,15 @@ namespace webrtc
 
 using namespace unity::webrtc;
 
+// The device is kept while the pool holds idle encoders which were created on it.
+static void ShutdownGraphicsDeviceIfUnused()
+{
+    if (s_mapEncoder.empty() && EncoderPool::GetInstance().IsEmpty() && GraphicsDevice::GetInstance().IsInitialized())
+    {
+        GraphicsDevice::GetInstance().Shutdown();
+    }
+}
+
 static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType)
 {
     switch (eventType)
@@ -39,6 +53,8 @@ static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType ev
     case kUnityGfxDeviceEventInitialize:
     {
         s_mapEncoder.clear();
+        s_mapEncoderKey.clear();
+        EncoderPool::GetInstance().Clear();
         break;
     }
     case kUnityGfxDeviceEventShutdown:
@@ -46,6 +62,8 @@ static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType ev
         //UnityPluginUnload not called normally
         s_Graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
         s_mapEncoder.clear();
+        s_mapEncoderKey.clear();
+        EncoderPool::GetInstance().Clear();
         break;
     }
     case kUnityGfxDeviceEventBeforeReset:
@@ -79,6 +97,39 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
     s_Graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
 }
 
+// Returns the encoder of the track to the pool.
+static void ReleaseEncoder(const ::webrtc::MediaStreamTrackInterface* track)
+{
+    auto it = s_mapEncoder.find(track);
+    if (it == s_mapEncoder.end())
+        return;
+    if (it->second != nullptr)
+    {
+        s_context->FinalizeEncoder(it->second.get());
+        EncoderPool::GetInstance().Release(s_mapEncoderKey[track], std::move(it->second));
+    }
+    s_mapEncoder.erase(it);
+    s_mapEncoderKey.erase(track);
+}
+
+// Resizes the encoder when the track is initialized again with another size and nothing else changed.
+static bool ResizeEncoder(::webrtc::MediaStreamTrackInterface* track, const EncoderPoolKey& key)
+{
+    auto it = s_mapEncoder.find(track);
+    if (it == s_mapEncoder.end() || it->second == nullptr)
+        return false;
+    EncoderPoolKey& current = s_mapEncoderKey[track];
+    EncoderPoolKey resized = current;
+    resized.width = key.width;
+    resized.height = key.height;
+    if (resized < key || key < resized)
+        return false;
+    if (!s_context->ResizeEncoder(it->second.get(), track, key.width, key.height))
+        return false;
+    current = key;
+    return true;
+}
+
 static void UNITY_INTERFACE_API OnRenderEvent(int eventID, void* data)
 {
     if (s_context == nullptr)
@@ -99,8 +150,26 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID, void* data)
             }
             s_device = GraphicsDevice::GetInstance().GetDevice();
             const VideoEncoderParameter* param = s_context->GetEncoderParameter(track);
-            const UnityEncoderType encoderType = s_context->GetEncoderType();
-            s_mapEncoder[track] = EncoderFactory::GetInstance().Init(param->width, param->height, s_device, encoderType);
+            EncoderPoolKey key;
+            key.width = param->width;
+            key.height = param->height;
+            key.scaleResolutionDownBy = param->scaleResolutionDownBy;
+            key.bufferCount = param->bufferCount;
+            key.maxWidth = param->maxWidth;
+            key.maxHeight = param->maxHeight;
+            key.encoderType = s_context->GetEncoderType();
+            key.device = s_device;
+            if (ResizeEncoder(track, key))
+                return;
+            ReleaseEncoder(track);
+            const ColorConversionOptions options = s_context->GetColorConversionOptions();
+            s_mapEncoder[track] = EncoderPool::GetInstance().Acquire(key, [&key, &options]()
+            {
+                return EncoderFactory::GetInstance().InitSimulcast(
+                    key.width, key.height, key.scaleResolutionDownBy, key.device, key.encoderType,
+                    options, key.bufferCount, key.maxWidth, key.maxHeight);
+            });
+            s_mapEncoderKey[track] = key;
             if (!s_context->InitializeEncoder(s_mapEncoder[track].get(), track))
             {
                 LogPrint("Encoder initialization faild.");
@@ -109,6 +178,7 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID, void* data)
         }
         case VideoStreamRenderEventID::Encode:
         {
+            // The idle encoders are evicted by the periodic Evict event, not on every frame.
             if (s_IsDevelopmentBuild)
                 s_UnityProfiler->BeginSample(s_MarkerEncode);
             if(!s_context->EncodeFrame(track))
@@ -122,12 +192,15 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID, void* data)
         }
         case VideoStreamRenderEventID::Finalize:
         {
-            s_context->FinalizeEncoder(s_mapEncoder[track].get());
-            s_mapEncoder.erase(track);
-            if(s_mapEncoder.empty())
-            {
-                GraphicsDevice::GetInstance().Shutdown();
-            }
+            ReleaseEncoder(track);
+            EncoderPool::GetInstance().Evict();
+            ShutdownGraphicsDeviceIfUnused();
+            return;
+        }
+        case VideoStreamRenderEventID::Evict:
+        {
+            EncoderPool::GetInstance().Evict();
+            ShutdownGraphicsDeviceIfUnused();
             return;
         }
         default: {
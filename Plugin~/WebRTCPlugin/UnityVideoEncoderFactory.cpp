@@ -24,10 +24,11 @@ namespace webrtc
         return false;
     }
 
-    UnityVideoEncoderFactory::UnityVideoEncoderFactory(IVideoEncoderObserver* observer)
-    : internal_encoder_factory_(new webrtc::InternalEncoderFactory())
+    UnityVideoEncoderFactory::UnityVideoEncoderFactory(UnityEncoderType encoderType, std::function<int()> getCoreCount)
+    : m_encoderType(encoderType)
+    , m_getCoreCount(std::move(getCoreCount))
+    , internal_encoder_factory_(new webrtc::InternalEncoderFactory())
     {
-        m_observer = observer;
     }
 
     std::vector<webrtc::SdpVideoFormat> UnityVideoEncoderFactory::GetHardwareEncoderFormats() const
@@ -38,19 +39,17 @@ namespace webrtc
 
     std::vector<webrtc::SdpVideoFormat> UnityVideoEncoderFactory::GetSupportedFormats() const
     {
-        std::vector <webrtc::SdpVideoFormat> formats = GetHardwareEncoderFormats();
-
-        // todo(kazuki): should support codec other than h264 like vp8, vp9 and av1.
-        // 
-        // std::vector <webrtc::SdpVideoFormat> formats2 = internal_encoder_factory_->GetSupportedFormats();
-        // formats.insert(formats.end(), formats2.begin(), formats2.end());
-        
-        return formats;
+        // The frames of the hardware encoder have no pixels which the internal encoders could read.
+        if (m_encoderType == UnityEncoderType::UnityEncoderHardware)
+        {
+            return GetHardwareEncoderFormats();
+        }
+        return internal_encoder_factory_->GetSupportedFormats();
     }
 
     webrtc::VideoEncoderFactory::CodecInfo UnityVideoEncoderFactory::QueryVideoEncoder(const webrtc::SdpVideoFormat& format) const
     {
-        if (IsFormatSupported(GetHardwareEncoderFormats(), format))
+        if (m_encoderType == UnityEncoderType::UnityEncoderHardware && IsFormatSupported(GetHardwareEncoderFormats(), format))
         {
             return CodecInfo{ true, false };
         }
@@ -60,18 +59,20 @@ namespace webrtc
 
     std::unique_ptr<webrtc::VideoEncoder> UnityVideoEncoderFactory::CreateVideoEncoder(const webrtc::SdpVideoFormat& format)
     {
-        if (IsFormatSupported(GetHardwareEncoderFormats(), format))
+        if (m_encoderType == UnityEncoderType::UnityEncoderHardware && IsFormatSupported(GetHardwareEncoderFormats(), format))
         {
-            return std::make_unique<DummyVideoEncoder>(m_observer);
+            return std::make_unique<DummyVideoEncoder>();
         }
 
-        std::unique_ptr<webrtc::VideoEncoder> internalEncoder;
-        // Try creating internal encoder.
-        if (IsFormatSupported(GetSupportedFormats(), format))
+        if (!IsFormatSupported(GetSupportedFormats(), format))
         {
-            internalEncoder = internal_encoder_factory_->CreateVideoEncoder(format);
+            return nullptr;
         }
-        return internalEncoder;
+        // VP9 and AV1 do not support simulcast streams, so the proxy falls back to an encoder for each stream.
+        // Every encoder of the proxy gets the limited number of cores.
+        std::unique_ptr<webrtc::VideoEncoder> internalEncoder =
+            std::make_unique<webrtc::EncoderSimulcastProxy>(internal_encoder_factory_.get(), format);
+        return std::make_unique<CoreLimitedVideoEncoder>(std::move(internalEncoder), m_getCoreCount());
     }
 
 }
@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <functional>
 
 namespace unity
 {
@@ -6,7 +8,49 @@ namespace webrtc
 {
     namespace webrtc = ::webrtc;
 
-    class IVideoEncoderObserver;
+    // Passes the core budget of the plugin to the internal encoder, which sizes its thread pool by the core count.
+    class CoreLimitedVideoEncoder : public webrtc::VideoEncoder
+    {
+    public:
+        CoreLimitedVideoEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder, int coreCount)
+            : m_encoder(std::move(encoder)), m_coreCount(coreCount) {}
+
+        void SetFecControllerOverride(webrtc::FecControllerOverride* fec_controller_override) override
+        {
+            m_encoder->SetFecControllerOverride(fec_controller_override);
+        }
+        int InitEncode(const webrtc::VideoCodec* codec_settings, const Settings& settings) override
+        {
+            const Settings limited(settings.capabilities,
+                std::max(1, std::min(settings.number_of_cores, m_coreCount)), settings.max_payload_size);
+            return m_encoder->InitEncode(codec_settings, limited);
+        }
+        int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override
+        {
+            return m_encoder->RegisterEncodeCompleteCallback(callback);
+        }
+        int32_t Release() override { return m_encoder->Release(); }
+        int32_t Encode(const webrtc::VideoFrame& frame, const std::vector<webrtc::VideoFrameType>* frame_types) override
+        {
+            return m_encoder->Encode(frame, frame_types);
+        }
+        void SetRates(const RateControlParameters& parameters) override { m_encoder->SetRates(parameters); }
+        void OnPacketLossRateUpdate(float packet_loss_rate) override
+        {
+            m_encoder->OnPacketLossRateUpdate(packet_loss_rate);
+        }
+        void OnRttUpdate(int64_t rtt_ms) override { m_encoder->OnRttUpdate(rtt_ms); }
+        void OnLossNotification(const LossNotification& loss_notification) override
+        {
+            m_encoder->OnLossNotification(loss_notification);
+        }
+        EncoderInfo GetEncoderInfo() const override { return m_encoder->GetEncoderInfo(); }
+
+    private:
+        const std::unique_ptr<webrtc::VideoEncoder> m_encoder;
+        const int m_coreCount;
+    };
+
     class UnityVideoEncoderFactory : public webrtc::VideoEncoderFactory
     {
     public:
@@ -22,9 +66,13 @@ namespace webrtc
 
         virtual std::vector<webrtc::SdpVideoFormat> GetHardwareEncoderFormats() const;
 
-        UnityVideoEncoderFactory(IVideoEncoderObserver* observer);
+        // The hardware encoder sends H.264 frames which are already encoded,
+        // the software encoder sends I420 frames to the internal VP8, VP9 and AV1 encoders.
+        // getCoreCount returns the number of cores which each internal encoder may use.
+        UnityVideoEncoderFactory(UnityEncoderType encoderType, std::function<int()> getCoreCount);
     private:
-        IVideoEncoderObserver* m_observer;
+        const UnityEncoderType m_encoderType;
+        const std::function<int()> m_getCoreCount;
         const std::unique_ptr<VideoEncoderFactory> internal_encoder_factory_;
     };
 }
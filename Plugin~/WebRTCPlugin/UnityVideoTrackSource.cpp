@@ -20,7 +20,10 @@ UnityVideoTrackSource::UnityVideoTrackSource(
 //  DETACH_FROM_THREAD(thread_checker_);
 }
 
-UnityVideoTrackSource::~UnityVideoTrackSource() = default;
+UnityVideoTrackSource::~UnityVideoTrackSource()
+{
+    encoder_thread_.reset();
+}
 
 UnityVideoTrackSource::SourceState UnityVideoTrackSource::state() const
 {
@@ -41,12 +44,59 @@ absl::optional<bool> UnityVideoTrackSource::needs_denoising() const
     return needs_denoising_;
 }
 
-void UnityVideoTrackSource::SetEncoder(IEncoder* encoder)
+void UnityVideoTrackSource::SetEncoder(IEncoder* encoder, EncoderQueuePolicy policy)
 {
+    // The thread is joined before the encoder is disconnected.
+    encoder_thread_.reset();
+    if (encoder_ != nullptr)
+    {
+        encoder_->CaptureFrame.disconnect(this);
+    }
     encoder_ = encoder;
+    if (encoder_ == nullptr)
+        return;
+
     encoder_->CaptureFrame.connect(
         this,
         &UnityVideoTrackSource::DelegateOnFrame);
+    if (encoder_->GetBufferCount() > 1)
+    {
+        encoder_thread_ = std::make_unique<EncoderThread>(encoder_, policy);
+    }
+}
+
+void UnityVideoTrackSource::SetFrameSize(int width, int height)
+{
+    frame_width_ = width;
+    frame_height_ = height;
+}
+
+UnityVideoTrackSource::FrameAdaptationParams UnityVideoTrackSource::ComputeAdaptationParams(
+    int width, int height, int64_t time_us)
+{
+    FrameAdaptationParams result{ false, 0, 0, 0, 0, 0, 0 };
+    const int64_t translated_time_us = timestamp_aligner_.TranslateTimestamp(time_us, rtc::TimeMicros());
+    if (!AdaptFrame(width, height, translated_time_us,
+        &result.scale_to_width, &result.scale_to_height,
+        &result.crop_width, &result.crop_height,
+        &result.crop_x, &result.crop_y))
+    {
+        result.should_drop_frame = true;
+    }
+    return result;
+}
+
+void UnityVideoTrackSource::DelegateOnFrame(const ::webrtc::VideoFrame& frame)
+{
+    OnFrame(frame);
+}
+
+bool UnityVideoTrackSource::GetEncoderQueueStats(EncoderQueueStats* stats) const
+{
+    if (encoder_thread_ == nullptr)
+        return false;
+    *stats = encoder_thread_->GetStats();
+    return true;
 }
 
 
@@ -60,6 +110,33 @@ void UnityVideoTrackSource::OnFrameCaptured()
         LogPrint("encoder is null");
         return;
     }
+
+    // Frames which the sinks do not want are dropped before the texture is copied.
+    FrameAdaptation adaptation;
+    if (frame_width_ > 0 && frame_height_ > 0)
+    {
+        const FrameAdaptationParams params =
+            ComputeAdaptationParams(frame_width_, frame_height_, rtc::TimeMicros());
+        if (params.should_drop_frame)
+        {
+            adaptation_dropped_frames_++;
+            return;
+        }
+        adaptation.cropX = params.crop_x;
+        adaptation.cropY = params.crop_y;
+        adaptation.cropWidth = params.crop_width;
+        adaptation.cropHeight = params.crop_height;
+        adaptation.scaleWidth = params.scale_to_width;
+        adaptation.scaleHeight = params.scale_to_height;
+    }
+    // The encoder copies the frame scaled, or scales it when it is converted, so the frames which are still
+    // queued keep their own adaptation.
+    if (encoder_thread_ != nullptr)
+    {
+        encoder_thread_->CopyAndQueueFrame(frame_, adaptation);
+        return;
+    }
+    encoder_->SetAdaptation(0, adaptation);
     if (!encoder_->CopyBuffer(frame_))
     {
         LogPrint("Copy texture buffer is failed");
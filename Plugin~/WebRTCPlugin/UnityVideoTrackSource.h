@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include "Codec/IEncoder.h"
+#include "EncoderThread.h"
 #include "rtc_base/timestamp_aligner.h"
 
 namespace unity {
@@ -43,11 +46,23 @@ class UnityVideoTrackSource :
     // todo(kazuki)::
     void OnFrameCaptured();
 
-    // todo(kazuki)::
-    void DelegateOnFrame(const ::webrtc::VideoFrame& frame) { OnFrame(frame); }
+    // The encoder crops and scales the raw frames as the sinks requested when the frame was captured.
+    void DelegateOnFrame(const ::webrtc::VideoFrame& frame);
 
-    // todo(kazuki)::
-    void SetEncoder(IEncoder* encoder);
+    // Size of the texture passed to the constructor, which the adaptation is computed from.
+    void SetFrameSize(int width, int height);
+    // Number of frames dropped by the adaptation before they were copied.
+    uint64_t GetAdaptationDroppedFrames() const { return adaptation_dropped_frames_; }
+
+    // Encoders which have several buffers encode on their own thread, the others on the rendering thread.
+    // Passing nullptr stops the encoder thread, so call it before the encoder is destroyed.
+    void SetEncoder(IEncoder* encoder, EncoderQueuePolicy policy = EncoderQueuePolicy::DropOldest);
+    IEncoder* GetEncoder() const { return encoder_; }
+    // The native texture which the frames are copied from.
+    void* GetFrame() const { return frame_; }
+
+    // Returns false when the frames are encoded on the rendering thread.
+    bool GetEncoderQueueStats(EncoderQueueStats* stats) const;
 
     // todo(kazuki)::
     CodecInitializationResult GetCodecInitializationResult() const
@@ -81,9 +96,14 @@ class UnityVideoTrackSource :
   // State for the timestamp translation.
   rtc::TimestampAligner timestamp_aligner_;
 
+  int frame_width_ = 0;
+  int frame_height_ = 0;
+  std::atomic<uint64_t> adaptation_dropped_frames_{ 0 };
+
   const bool is_screencast_;
   const absl::optional<bool> needs_denoising_;
   IEncoder* encoder_;
+  std::unique_ptr<EncoderThread> encoder_thread_;
   void* frame_;
 };
 
@@ -24,6 +24,20 @@
     } \
 }
 
+#define VULKAN_SAFE_DESTROY_BUFFER(device, obj, allocator) { \
+    if (VK_NULL_HANDLE != obj) { \
+        vkDestroyBuffer(device, obj, allocator); \
+        obj = VK_NULL_HANDLE; \
+    } \
+}
+
+#define VULKAN_SAFE_DESTROY_FENCE(device, obj, allocator) { \
+    if (VK_NULL_HANDLE != obj) { \
+        vkDestroyFence(device, obj, allocator); \
+        obj = VK_NULL_HANDLE; \
+    } \
+}
+
 #define VULKAN_SAFE_DESTROY_COMMAND_POOL(device, obj, allocator) { \
     if (VK_NULL_HANDLE != obj) { \
         vkDestroyCommandPool(device, obj, allocator); \
@@ -5,7 +5,7 @@
 #include "SetSessionDescriptionObserver.h"
 #include "Context.h"
 #include "Codec/EncoderFactory.h"
-#include "HWSettings.h"
+#include "Codec/EncoderPool.h"
 
 namespace unity
 {
@@ -93,11 +93,67 @@ extern "C"
         return EncoderFactory::GetHardwareEncoderSupport();
     }
 
+    // The idle encoders are kept for the time to live after their track is finalized. 0 disables the pool.
+    UNITY_INTERFACE_EXPORT void SetEncoderPoolTimeToLive(int milliseconds)
+    {
+        EncoderPool::GetInstance().SetTimeToLive(std::chrono::milliseconds(milliseconds));
+    }
+
+    UNITY_INTERFACE_EXPORT void SetEncoderPoolMaxIdleEncoders(int count)
+    {
+        EncoderPool::GetInstance().SetMaxIdleEncoders(static_cast<size_t>(std::max(0, count)));
+    }
+
+    UNITY_INTERFACE_EXPORT void GetEncoderPoolStats(EncoderPoolStats* stats)
+    {
+        *stats = EncoderPool::GetInstance().GetStats();
+    }
+
     UNITY_INTERFACE_EXPORT UnityEncoderType ContextGetEncoderType(Context* context)
     {
         return context->GetEncoderType();
     }
 
+    UNITY_INTERFACE_EXPORT void ContextSetChromaSubsampling(Context* context, ChromaSubsampling chromaSubsampling)
+    {
+        context->SetChromaSubsampling(chromaSubsampling);
+    }
+
+    UNITY_INTERFACE_EXPORT void ContextSetConversionThreadCount(Context* context, int threadCount)
+    {
+        context->SetConversionThreadCount(threadCount);
+    }
+
+    UNITY_INTERFACE_EXPORT int ContextGetConversionThreadCount(Context* context)
+    {
+        return context->GetConversionThreadCount();
+    }
+
+    UNITY_INTERFACE_EXPORT void ContextSetEncoderQueuePolicy(Context* context, EncoderQueuePolicy policy)
+    {
+        context->SetEncoderQueuePolicy(policy);
+    }
+
+    UNITY_INTERFACE_EXPORT bool ContextGetEncoderQueueStats(Context* context, MediaStreamTrackInterface* track, EncoderQueueStats* stats)
+    {
+        return context->GetEncoderQueueStats(track, stats);
+    }
+
+    UNITY_INTERFACE_EXPORT bool ContextGetEncoderBitrateStats(Context* context, MediaStreamTrackInterface* track, EncoderBitrateStats* stats)
+    {
+        return context->GetEncoderBitrateStats(track, stats);
+    }
+
+    UNITY_INTERFACE_EXPORT void ContextSetVideoEncoderCoreCount(Context* context, int coreCount)
+    {
+        context->SetVideoEncoderCoreCount(coreCount);
+    }
+
+    UNITY_INTERFACE_EXPORT int ContextGetVideoEncoderCoreCount(Context* context)
+    {
+        return context->GetVideoEncoderCoreCount();
+    }
+
     UNITY_INTERFACE_EXPORT CodecInitializationResult GetInitializationResult(Context* context, MediaStreamTrackInterface* track)
     {
         return context->GetInitializationResult(track);
@@ -108,6 +164,21 @@ extern "C"
         context->SetEncoderParameter(track, width, height);
     }
 
+    UNITY_INTERFACE_EXPORT bool ContextSetVideoEncoderBufferCount(Context* context, MediaStreamTrackInterface* track, int bufferCount)
+    {
+        return context->SetEncoderBufferCount(track, bufferCount);
+    }
+
+    UNITY_INTERFACE_EXPORT bool ContextSetVideoEncoderMaxSize(Context* context, MediaStreamTrackInterface* track, int maxWidth, int maxHeight)
+    {
+        return context->SetEncoderMaxSize(track, maxWidth, maxHeight);
+    }
+
+    UNITY_INTERFACE_EXPORT bool ContextSetVideoEncoderSimulcastLayers(Context* context, MediaStreamTrackInterface* track, const float* scaleResolutionDownBy, int layerCount)
+    {
+        return context->SetEncoderSimulcastLayers(track, scaleResolutionDownBy, layerCount);
+    }
+
     UNITY_INTERFACE_EXPORT MediaStreamInterface* ContextCreateMediaStream(Context* context, const char* streamId)
     {
         return context->CreateMediaStream(streamId);
@@ -128,6 +199,16 @@ extern "C"
         context->DeleteMediaStreamTrack(track);
     }
 
+    UNITY_INTERFACE_EXPORT bool ContextRegisterVideoFrameBuffer(Context* context, MediaStreamTrackInterface* track, int size)
+    {
+        return context->RegisterFrameBuffer(track, size);
+    }
+
+    UNITY_INTERFACE_EXPORT void ContextUnregisterVideoFrameBuffer(Context* context, MediaStreamTrackInterface* track)
+    {
+        context->UnregisterFrameBuffer(track);
+    }
+
     UNITY_INTERFACE_EXPORT void ContextStopMediaStreamTrack(Context* context, ::webrtc::MediaStreamTrackInterface* track)
     {
         context->StopMediaStreamTrack(track);
@@ -701,6 +782,9 @@ extern "C"
         bool hasValueInfiniteGOP;
         bool infiniteGOP;
 
+        bool hasValueSceneChangeDetection;
+        bool sceneChangeDetection;
+
         bool hasValueScaleResolutionDownBy;
         double scaleResolutionDownBy;
 
@@ -761,26 +845,39 @@ extern "C"
         return error.type();
     }
 
-    UNITY_INTERFACE_EXPORT void SetHardwareParameters(const RTCRtpEncodingParameters* src) {
-
-                HWSettings* hw = HWSettings::getPtr();
-                hw->maxBitrate = static_cast<int>(src->maxBitrate);
-                hw->minBitrate = static_cast<int>(src->minBitrate);
-                hw->maxFramerate = static_cast<int>(src->maxFramerate);
-                hw->rateControlMode = static_cast<int>(src->rateControlMode);
-                hw->minQP = static_cast<int>(src->minQP);
-                hw->maxQP = static_cast<int>(src->maxQP);
-                hw->width = static_cast<int>(src->width);
-                hw->height = static_cast<int>(src->height);
-                hw->minFramerate = static_cast<int>(src->minFramerate);
-                hw->intraRefreshPeriod = static_cast<int>(src->intraRefreshPeriod);
-                hw->intraRefreshCount = static_cast<int>(src->intraRefreshCount);
-                hw->enableAQ = src->enableAQ;
-                hw->maxNumRefFrames = static_cast<int>(src->maxNumRefFrames);
-                hw->infiniteGOP = src->infiniteGOP;
-
-                hw->msg = "[WebRTCPlugin.cpp] parameters set";
-                DebugLog("[WebRTCPlugin.cpp] parameters set");
+    static EncoderSettings ConvertEncoderSettings(const RTCRtpEncodingParameters& src)
+    {
+        EncoderSettings dst;
+        dst.maxBitrate = static_cast<int>(src.maxBitrate);
+        dst.minBitrate = static_cast<int>(src.minBitrate);
+        dst.maxFramerate = static_cast<int>(src.maxFramerate);
+        dst.rateControlMode = static_cast<int>(src.rateControlMode);
+        dst.minQP = static_cast<int>(src.minQP);
+        dst.maxQP = static_cast<int>(src.maxQP);
+        dst.minFramerate = static_cast<int>(src.minFramerate);
+        dst.intraRefreshPeriod = static_cast<int>(src.intraRefreshPeriod);
+        dst.intraRefreshCount = static_cast<int>(src.intraRefreshCount);
+        dst.enableAQ = src.enableAQ;
+        dst.maxNumRefFrames = static_cast<int>(src.maxNumRefFrames);
+        dst.infiniteGOP = src.infiniteGOP;
+        dst.sceneChangeDetection = src.sceneChangeDetection;
+        return dst;
+    }
+
+    // Used by the tracks which are created after the call.
+    UNITY_INTERFACE_EXPORT void SetHardwareParameters(const RTCRtpEncodingParameters* src)
+    {
+        EncoderSettings::SetDefault(ConvertEncoderSettings(*src));
+        DebugLog("[WebRTCPlugin.cpp] parameters set");
+    }
+
+    // Applied by the encoder of the track of the sender before its next frame.
+    UNITY_INTERFACE_EXPORT bool SenderSetHardwareParameters(Context* context, RtpSenderInterface* sender, const RTCRtpEncodingParameters* src)
+    {
+        const rtc::scoped_refptr<MediaStreamTrackInterface> track = sender->track();
+        if (track == nullptr)
+            return false;
+        return context->SetEncoderSettings(track.get(), ConvertEncoderSettings(*src));
     }
 
     UNITY_INTERFACE_EXPORT MediaStreamTrackInterface* SenderGetTrack(RtpSenderInterface* sender)
@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace unity
+{
+namespace webrtc
+{
+
+    WorkerPool::WorkerPool(int threadCount)
+    {
+        StartThreads(threadCount);
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        StopThreads();
+    }
+
+    int WorkerPool::GetDefaultThreadCount()
+    {
+        // Leave the other cores to Unity and the encoder.
+        const int cores = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, std::min(cores / 2, 4));
+    }
+
+    int WorkerPool::GetThreadCount() const
+    {
+        return m_threadCount;
+    }
+
+    void WorkerPool::SetThreadCount(int threadCount)
+    {
+        std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+        StopThreads();
+        StartThreads(threadCount);
+    }
+
+    void WorkerPool::StartThreads(int threadCount)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = false;
+        }
+        for (int i = 1; i < threadCount; i++)
+        {
+            m_threads.emplace_back(&WorkerPool::WorkerMain, this);
+        }
+        m_threadCount = static_cast<int>(m_threads.size()) + 1;
+    }
+
+    void WorkerPool::StopThreads()
+    {
+        // The workers finish the tasks which they started, the callers run the tasks which are left.
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeCondition.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+        m_threads.clear();
+        m_threadCount = 1;
+    }
+
+    void WorkerPool::ParallelFor(int count, const std::function<void(int)>& task)
+    {
+        if (m_threadCount == 1 || count < 2)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                task(i);
+            }
+            return;
+        }
+        Call call;
+        call.task = &task;
+        call.taskCount = count;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_calls.push_back(&call);
+        m_wakeCondition.notify_all();
+
+        // The calling thread only runs the tasks of its own call, so it does not wait for the tasks of other calls.
+        while (call.nextTask < call.taskCount)
+        {
+            RunTask(call, lock);
+        }
+        // The workers which run the last tasks leave the call before they release the lock.
+        call.doneCondition.wait(lock, [&call]()
+        {
+            return call.finishedTasks == call.taskCount;
+        });
+    }
+
+    void WorkerPool::RunTask(Call& call, std::unique_lock<std::mutex>& lock)
+    {
+        const int index = call.nextTask++;
+        if (call.nextTask == call.taskCount)
+        {
+            m_calls.erase(std::find(m_calls.begin(), m_calls.end(), &call));
+        }
+        lock.unlock();
+        (*call.task)(index);
+        lock.lock();
+        if (++call.finishedTasks == call.taskCount)
+        {
+            call.doneCondition.notify_all();
+        }
+    }
+
+    void WorkerPool::WorkerMain()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_wakeCondition.wait(lock, [this]()
+            {
+                return m_stop || !m_calls.empty();
+            });
+            if (m_stop)
+                return;
+            RunTask(*m_calls.front(), lock);
+        }
+    }
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace unity
+{
+namespace webrtc
+{
+
+    // Persistent threads which split CPU heavy work like the colour conversion of a frame.
+    // The calling thread also runs tasks, so a pool with the thread count 1 has no worker threads.
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(int threadCount = GetDefaultThreadCount());
+        ~WorkerPool();
+
+        // Number of threads including the calling thread.
+        int GetThreadCount() const;
+        // Blocks while the running tasks finish, then restarts the worker threads.
+        void SetThreadCount(int threadCount);
+
+        // Runs task(0) ... task(count - 1) and returns after all of them finish.
+        void ParallelFor(int count, const std::function<void(int)>& task);
+
+        static int GetDefaultThreadCount();
+
+    private:
+        // A ParallelFor call, which lives on the stack of its caller until all of its tasks finish.
+        struct Call
+        {
+            const std::function<void(int)>* task = nullptr;
+            int taskCount = 0;
+            int nextTask = 0;
+            int finishedTasks = 0;
+            std::condition_variable doneCondition;
+        };
+
+        void StartThreads(int threadCount);
+        void StopThreads();
+        void WorkerMain();
+        void RunTask(Call& call, std::unique_lock<std::mutex>& lock);
+
+        // Serializes SetThreadCount. The ParallelFor calls of several threads run at the same time.
+        std::mutex m_threadsMutex;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeCondition;
+        std::vector<std::thread> m_threads;
+        std::atomic<int> m_threadCount{ 1 };
+
+        // The calls which have tasks left to start, guarded by m_mutex with the state of the calls.
+        std::deque<Call*> m_calls;
+        bool m_stop = false;
+    };
+
+} // end namespace webrtc
+} // end namespace unity
@@ -41,6 +41,7 @@
 #endif
 
 #include "media/engine/internal_encoder_factory.h"
+#include "media/engine/encoder_simulcast_proxy.h"
 #include "media/engine/internal_decoder_factory.h"
 #include "media/base/h264_profile_level_id.h"
 #include "media/base/adapted_video_track_source.h"
@@ -138,7 +139,10 @@ namespace webrtc
     using int32 = signed int;
     using int64 = signed long long;
 
+    // Depth of the readback rings of the graphics devices, and the default depth of the encoder rings.
     const uint32 bufferedFrameNum = 3;
+    // The encoder ring of a track holds from 1 frame, for the lowest latency, to this many frames.
+    const uint32 maxEncoderBufferCount = 8;
 
     enum UnityEncoderType
     {
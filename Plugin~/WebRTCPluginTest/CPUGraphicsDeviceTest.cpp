@@ -0,0 +1,86 @@
+#include "pch.h"
+#include "../WebRTCPlugin/Context.h"
+#include "../WebRTCPlugin/GraphicsDevice/CPU/CPUGraphicsDevice.h"
+
+extern "C" bool ContextRegisterVideoFrameBuffer(
+    unity::webrtc::Context* context, ::webrtc::MediaStreamTrackInterface* track, int size);
+extern "C" void ContextUnregisterVideoFrameBuffer(
+    unity::webrtc::Context* context, ::webrtc::MediaStreamTrackInterface* track);
+
+namespace unity
+{
+namespace webrtc
+{
+
+class CPUGraphicsDeviceTest : public testing::Test
+{
+protected:
+    const uint32_t width = 64;
+    const uint32_t height = 32;
+    CPUGraphicsDevice m_device;
+};
+
+TEST_F(CPUGraphicsDeviceTest, CopiesFromOwnTextures)
+{
+    const std::unique_ptr<ITexture2D> src(m_device.CreateDefaultTextureV(width, height));
+    const std::unique_ptr<ITexture2D> dst(m_device.CreateCPUReadTextureV(width, height));
+    EXPECT_TRUE(m_device.CopyResourceFromNativeV(dst.get(), src->GetNativeTexturePtrV()));
+    EXPECT_TRUE(m_device.CopyResourceV(dst.get(), src.get()));
+}
+
+TEST_F(CPUGraphicsDeviceTest, RejectsUnknownBuffers)
+{
+    const std::unique_ptr<ITexture2D> dst(m_device.CreateDefaultTextureV(width, height));
+    std::vector<uint8_t> pixels(width * height * 4);
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), nullptr));
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+
+    m_device.RegisterBuffer(pixels.data(), pixels.size());
+    EXPECT_TRUE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+    // A pointer into the buffer is not the buffer.
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data() + 4));
+    m_device.UnregisterBuffer(pixels.data());
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+}
+
+TEST_F(CPUGraphicsDeviceTest, RejectsSmallerBuffers)
+{
+    const std::unique_ptr<ITexture2D> src(m_device.CreateDefaultTextureV(width / 2, height));
+    const std::unique_ptr<ITexture2D> dst(m_device.CreateDefaultTextureV(width, height));
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), src->GetNativeTexturePtrV()));
+}
+
+TEST_F(CPUGraphicsDeviceTest, ForgetsDestroyedTextures)
+{
+    const std::unique_ptr<ITexture2D> dst(m_device.CreateDefaultTextureV(width, height));
+    std::unique_ptr<ITexture2D> src(m_device.CreateDefaultTextureV(width, height));
+    const void* pixels = src->GetNativeTexturePtrV();
+    src.reset();
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), const_cast<void*>(pixels)));
+}
+
+TEST_F(CPUGraphicsDeviceTest, CopiesFromTrackFrameBuffer)
+{
+    const std::unique_ptr<ITexture2D> dst(m_device.CreateDefaultTextureV(width, height));
+    std::vector<uint8_t> pixels(width * height * 4);
+    Context context;
+    const auto track = context.CreateVideoTrack("video", pixels.data());
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+    EXPECT_FALSE(ContextRegisterVideoFrameBuffer(&context, track, 0));
+
+    EXPECT_TRUE(ContextRegisterVideoFrameBuffer(&context, track, static_cast<int>(pixels.size())));
+    EXPECT_TRUE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+    // The buffer is known to the devices created after it was registered.
+    CPUGraphicsDevice device;
+    EXPECT_TRUE(device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+    ContextUnregisterVideoFrameBuffer(&context, track);
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+
+    // Deleting the track unregisters its buffer.
+    EXPECT_TRUE(ContextRegisterVideoFrameBuffer(&context, track, static_cast<int>(pixels.size())));
+    context.DeleteMediaStreamTrack(track);
+    EXPECT_FALSE(m_device.CopyResourceFromNativeV(dst.get(), pixels.data()));
+}
+
+} // end namespace webrtc
+} // end namespace unity
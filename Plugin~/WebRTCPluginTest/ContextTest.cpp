@@ -38,6 +38,52 @@ TEST_P(ContextTest, InitializeAndFinalizeEncoder) {
     EXPECT_TRUE(context->InitializeEncoder(encoder_.get(), track));
 }
 
+TEST_P(ContextTest, SetEncoderBufferCount) {
+    const std::unique_ptr<ITexture2D> tex(m_device->CreateDefaultTextureV(width, height));
+    const auto track = context->CreateVideoTrack("video", tex.get());
+    EXPECT_FALSE(context->SetEncoderBufferCount(track, 1));
+
+    context->SetEncoderParameter(track, width, height);
+    EXPECT_EQ(bufferedFrameNum, context->GetEncoderParameter(track)->bufferCount);
+    EXPECT_TRUE(context->SetEncoderBufferCount(track, 1));
+    EXPECT_EQ(1u, context->GetEncoderParameter(track)->bufferCount);
+    EXPECT_FALSE(context->SetEncoderBufferCount(track, 0));
+    EXPECT_FALSE(context->SetEncoderBufferCount(track, maxEncoderBufferCount + 1));
+    EXPECT_EQ(1u, context->GetEncoderParameter(track)->bufferCount);
+    context->DeleteMediaStreamTrack(track);
+}
+
+TEST_P(ContextTest, SetEncoderMaxSize) {
+    const std::unique_ptr<ITexture2D> tex(m_device->CreateDefaultTextureV(width, height));
+    const auto track = context->CreateVideoTrack("video", tex.get());
+    EXPECT_FALSE(context->SetEncoderMaxSize(track, width * 2, height * 2));
+
+    context->SetEncoderParameter(track, width, height);
+    EXPECT_EQ(0, context->GetEncoderParameter(track)->maxWidth);
+    EXPECT_TRUE(context->SetEncoderMaxSize(track, width * 2, height * 2));
+    EXPECT_FALSE(context->SetEncoderMaxSize(track, -1, height));
+    // The maximum size of the track is kept when its size changes.
+    context->SetEncoderParameter(track, width / 2, height / 2);
+    EXPECT_EQ(width * 2, context->GetEncoderParameter(track)->maxWidth);
+    EXPECT_EQ(height * 2, context->GetEncoderParameter(track)->maxHeight);
+    context->DeleteMediaStreamTrack(track);
+}
+
+TEST_P(ContextTest, SetEncoderSettings) {
+    const std::unique_ptr<ITexture2D> tex(m_device->CreateDefaultTextureV(width, height));
+    const auto track = context->CreateVideoTrack("video", tex.get());
+    EncoderSettings settings;
+    settings.maxQP = 40;
+    EXPECT_FALSE(context->SetEncoderSettings(track, settings));
+
+    context->SetEncoderParameter(track, width, height);
+    EXPECT_TRUE(context->SetEncoderSettings(track, settings));
+    // The settings of the track are kept when its size changes.
+    context->SetEncoderParameter(track, width / 2, height / 2);
+    EXPECT_EQ(40, context->GetEncoderParameter(track)->settings->Read()->maxQP);
+    context->DeleteMediaStreamTrack(track);
+}
+
 TEST_P(ContextTest, CreateAndDeleteMediaStream) {
     const auto stream = context->CreateMediaStream("test");
     context->DeleteMediaStream(stream);
@@ -0,0 +1,200 @@
+#include "pch.h"
+#include <thread>
+#include "../WebRTCPlugin/DummyVideoEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Encodes frames whose size overshoots the bitrate it is set to.
+class OvershootingEncoder : public IEncoder
+{
+public:
+    explicit OvershootingEncoder(float overshoot) : m_overshoot(overshoot)
+    {
+        m_initializationResult = CodecInitializationResult::Success;
+    }
+
+    void InitV() override {}
+    void SetRates(uint32_t bitRate, int64_t frameRate) override
+    {
+        m_bitRate = bitRate;
+        m_frameRate = frameRate;
+    }
+    void UpdateSettings() override {}
+    bool CopyBuffer(void* frame) override { return true; }
+    bool EncodeFrame() override
+    {
+        // Start code and the header of a non-IDR slice, padded to the size of the frame.
+        const uint8_t header[] = { 0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x00, 0x00 };
+        const size_t size = std::max(sizeof(header),
+            static_cast<size_t>(m_bitRate * m_overshoot / 8 / std::max<int64_t>(1, m_frameRate)));
+        const auto data = webrtc::EncodedImageBuffer::Create(size);
+        std::memset(data->data(), 0, size);
+        std::memcpy(data->data(), header, sizeof(header));
+        const rtc::scoped_refptr<FrameBuffer> buffer =
+            new rtc::RefCountedObject<FrameBuffer>(256, 256, data, GetControl());
+        CaptureFrame(webrtc::VideoFrame::Builder().set_video_frame_buffer(buffer).build());
+        return true;
+    }
+    bool IsSupported() const override { return true; }
+    void SetIdrFrame() override {}
+    uint64 GetCurrentFrameCount() const override { return 0; }
+
+    uint32_t m_bitRate = 0;
+    int64_t m_frameRate = 0;
+    float m_overshoot;
+};
+
+class DummyVideoEncoderTest : public testing::Test, public sigslot::has_slots<>, public webrtc::EncodedImageCallback
+{
+protected:
+    void SetUp() override
+    {
+        webrtc::VideoCodec codec;
+        codec.codecType = webrtc::kVideoCodecH264;
+        codec.width = 256;
+        codec.height = 256;
+        codec.maxFramerate = frameRate;
+        codec.startBitrate = 1000;
+        codec.maxBitrate = 2000;
+        ASSERT_EQ(WEBRTC_VIDEO_CODEC_OK, m_encoder.InitEncode(&codec, 1, 1200));
+        m_encoder.RegisterEncodeCompleteCallback(this);
+    }
+
+    Result OnEncodedImage(const webrtc::EncodedImage& encodedImage, const webrtc::CodecSpecificInfo* codecSpecificInfo,
+        const webrtc::RTPFragmentationHeader* fragmentation) override
+    {
+        m_spatialIndices.push_back(encodedImage.SpatialIndex().value_or(-1));
+        return Result(Result::OK);
+    }
+
+    // Sets up two simulcast streams, the top one at the size of the frames.
+    void InitSimulcast()
+    {
+        webrtc::VideoCodec codec;
+        codec.codecType = webrtc::kVideoCodecH264;
+        codec.width = 256;
+        codec.height = 256;
+        codec.maxFramerate = frameRate;
+        codec.startBitrate = 1000;
+        codec.maxBitrate = 2000;
+        codec.numberOfSimulcastStreams = 2;
+        for (int i = 0; i < 2; i++)
+        {
+            webrtc::SimulcastStream& stream = codec.simulcastStream[i];
+            stream.width = 128 << i;
+            stream.height = 128 << i;
+            stream.maxFramerate = frameRate;
+            stream.numberOfTemporalLayers = 1;
+            stream.minBitrate = 50;
+            stream.targetBitrate = 150;
+            stream.maxBitrate = 1000;
+            stream.active = true;
+        }
+        ASSERT_EQ(WEBRTC_VIDEO_CODEC_OK, m_encoder.InitEncode(&codec, 1, 1200));
+    }
+
+    void OnFrame(const webrtc::VideoFrame& frame)
+    {
+        EXPECT_EQ(WEBRTC_VIDEO_CODEC_OK, m_encoder.Encode(frame, nullptr));
+    }
+
+    const int frameRate = 30;
+    DummyVideoEncoder m_encoder;
+    std::vector<int> m_spatialIndices;
+};
+
+// The adjustment needs a second of frames, so the frames are sent in real time.
+TEST_F(DummyVideoEncoderTest, CompensatesOvershoot)
+{
+    OvershootingEncoder source(1.3f);
+    source.CaptureFrame.connect(this, &DummyVideoEncoderTest::OnFrame);
+    const uint32_t target = 1000000;
+
+    for (int i = 0; i < frameRate * 2 + 10; i++)
+    {
+        source.EncodeFrame();
+        if (i == 0)
+        {
+            // The rates requested before the first frame reach the encoder with it.
+            EXPECT_EQ(target, source.m_bitRate);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / frameRate));
+    }
+
+    EXPECT_LT(source.m_bitRate, target);
+    const EncoderBitrateStats stats = source.GetControl()->GetBitrateStats();
+    EXPECT_EQ(target, stats.targetBitrate);
+    EXPECT_EQ(source.m_bitRate, stats.adjustedBitrate);
+    EXPECT_EQ(static_cast<uint64_t>(frameRate * 2 + 10), stats.frameCount);
+    // The encoder still overshoots what it is set to, but the frames which were sent are closer to the target.
+    EXPECT_GT(stats.overshoot, 0.0f);
+    EXPECT_LT(stats.overshoot, 0.3f);
+}
+
+// An encoder which stops undershooting is lowered back to the target as soon as the frames reach it.
+TEST_F(DummyVideoEncoderTest, KeepsUnderTargetAfterUndershoot)
+{
+    OvershootingEncoder source(0.5f);
+    source.CaptureFrame.connect(this, &DummyVideoEncoderTest::OnFrame);
+    const uint32_t target = 1000000;
+
+    for (int i = 0; i < frameRate * 2 + 10; i++)
+    {
+        source.EncodeFrame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / frameRate));
+    }
+    EXPECT_GT(source.m_bitRate, target);
+
+    source.m_overshoot = 1.0f;
+    for (int i = 0; i < frameRate * 3; i++)
+    {
+        source.EncodeFrame();
+        const EncoderBitrateStats stats = source.GetControl()->GetBitrateStats();
+        EXPECT_EQ(source.m_bitRate, stats.adjustedBitrate);
+        if (stats.encodedBitrate >= target)
+        {
+            EXPECT_LE(source.m_bitRate, target);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / frameRate));
+    }
+
+    // The frames of the raised bitrate have left the measured window.
+    const EncoderBitrateStats stats = source.GetControl()->GetBitrateStats();
+    EXPECT_GT(stats.encodedBitrate, 0u);
+    EXPECT_LE(stats.encodedBitrate, target * 105 / 100);
+}
+
+// A sender with several encodings whose track encodes a single bitstream.
+TEST_F(DummyVideoEncoderTest, SendsFrameWithoutLayersAsTopStream)
+{
+    InitSimulcast();
+    OvershootingEncoder source(1.0f);
+    source.CaptureFrame.connect(this, &DummyVideoEncoderTest::OnFrame);
+    for (int i = 0; i < 3; i++)
+    {
+        source.EncodeFrame();
+    }
+    EXPECT_EQ(std::vector<int>({ 1, 1, 1 }), m_spatialIndices);
+}
+
+TEST_F(DummyVideoEncoderTest, MapsFewerLayersToHighestStreams)
+{
+    InitSimulcast();
+    OvershootingEncoder source(1.0f);
+    const uint8_t header[] = { 0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x00, 0x00 };
+    const auto data = webrtc::EncodedImageBuffer::Create(sizeof(header));
+    std::memcpy(data->data(), header, sizeof(header));
+    const rtc::scoped_refptr<FrameBuffer> layer =
+        new rtc::RefCountedObject<FrameBuffer>(256, 256, data, source.GetControl());
+    const rtc::scoped_refptr<FrameBuffer> buffer =
+        new rtc::RefCountedObject<FrameBuffer>(256, 256, data, source.GetControl());
+    buffer->SetSimulcastLayers({ layer });
+    OnFrame(webrtc::VideoFrame::Builder().set_video_frame_buffer(buffer).build());
+    EXPECT_EQ(std::vector<int>({ 1 }), m_spatialIndices);
+}
+
+} // end namespace webrtc
+} // end namespace unity
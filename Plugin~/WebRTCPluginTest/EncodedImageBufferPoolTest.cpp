@@ -0,0 +1,121 @@
+#include "pch.h"
+#include "../WebRTCPlugin/Codec/EncodedImageBufferPool.h"
+#include "../WebRTCPlugin/DummyVideoEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Checks that the encoded image refers to the bitstream which the encoder wrote.
+class ExpectBufferCallback : public webrtc::EncodedImageCallback
+{
+public:
+    Result OnEncodedImage(const webrtc::EncodedImage& encodedImage, const webrtc::CodecSpecificInfo* codecSpecificInfo,
+        const webrtc::RTPFragmentationHeader* fragmentation) override
+    {
+        EXPECT_EQ(m_expected, encodedImage.data());
+        m_count++;
+        return Result(Result::OK);
+    }
+
+    const uint8_t* m_expected = nullptr;
+    int m_count = 0;
+};
+
+TEST(EncodedImageBufferPoolTest, ReusesReleasedBuffer)
+{
+    EncodedImageBufferPool pool;
+    const PooledEncodedImageBuffer* first = nullptr;
+    {
+        const auto buffer = pool.CreateBuffer(1000);
+        first = buffer.get();
+        EXPECT_EQ(1000u, buffer->size());
+    }
+    const auto buffer = pool.CreateBuffer(500);
+    EXPECT_EQ(first, buffer.get());
+    EXPECT_EQ(500u, buffer->size());
+    EXPECT_EQ(1u, pool.GetHitCount());
+    EXPECT_EQ(1u, pool.GetMissCount());
+}
+
+TEST(EncodedImageBufferPoolTest, DoesNotReuseBufferInUse)
+{
+    EncodedImageBufferPool pool;
+    const auto buffer1 = pool.CreateBuffer(1000);
+    const auto buffer2 = pool.CreateBuffer(1000);
+    EXPECT_NE(buffer1.get(), buffer2.get());
+    EXPECT_EQ(0u, pool.GetHitCount());
+    EXPECT_EQ(2u, pool.GetMissCount());
+}
+
+TEST(EncodedImageBufferPoolTest, KeepsCapacity)
+{
+    EncodedImageBufferPool pool(1);
+    const uint8_t* data = nullptr;
+    {
+        const auto buffer = pool.CreateBuffer(4000);
+        data = buffer->data();
+    }
+    {
+        const auto buffer = pool.CreateBuffer(100);
+        EXPECT_EQ(4000u, buffer->capacity());
+    }
+    const auto buffer = pool.CreateBuffer(4000);
+    EXPECT_EQ(data, buffer->data());
+}
+
+TEST(EncodedImageBufferPoolTest, LimitsPooledBuffers)
+{
+    EncodedImageBufferPool pool(2);
+    std::vector<rtc::scoped_refptr<PooledEncodedImageBuffer>> buffers;
+    for (int i = 0; i < 3; i++)
+    {
+        buffers.push_back(pool.CreateBuffer(1000));
+    }
+    EXPECT_EQ(2u, pool.GetBufferCount());
+    buffers.clear();
+    pool.Release();
+    EXPECT_EQ(0u, pool.GetBufferCount());
+}
+
+TEST(EncodedImageBufferPoolTest, SteadyStateSendingDoesNotAllocate)
+{
+    const int width = 256;
+    const int height = 256;
+    // Start code and the header of an IDR slice.
+    const uint8_t bitstream[] = { 0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00 };
+
+    webrtc::VideoCodec codec;
+    codec.codecType = webrtc::kVideoCodecH264;
+    codec.width = width;
+    codec.height = height;
+    codec.maxFramerate = 30;
+    codec.startBitrate = 1000;
+    codec.maxBitrate = 2000;
+    DummyVideoEncoder encoder;
+    ExpectBufferCallback callback;
+    ASSERT_EQ(WEBRTC_VIDEO_CODEC_OK, encoder.InitEncode(&codec, 1, 1200));
+    encoder.RegisterEncodeCompleteCallback(&callback);
+
+    EncodedImageBufferPool pool;
+    // A detached control, there is no encoder to receive the rates.
+    const rtc::scoped_refptr<EncoderControl> control = new rtc::RefCountedObject<EncoderControl>(nullptr);
+    for (int i = 0; i < 100; i++)
+    {
+        const auto encoded = pool.CreateBuffer(sizeof(bitstream));
+        std::memcpy(encoded->data(), bitstream, sizeof(bitstream));
+        callback.m_expected = encoded->data();
+
+        const rtc::scoped_refptr<FrameBuffer> buffer =
+            new rtc::RefCountedObject<FrameBuffer>(width, height, encoded, control);
+        const webrtc::VideoFrame frame = webrtc::VideoFrame::Builder().set_video_frame_buffer(buffer).build();
+        EXPECT_EQ(WEBRTC_VIDEO_CODEC_OK, encoder.Encode(frame, nullptr));
+    }
+    EXPECT_EQ(100, callback.m_count);
+    EXPECT_EQ(1u, pool.GetMissCount());
+    EXPECT_EQ(99u, pool.GetHitCount());
+}
+
+} // end namespace webrtc
+} // end namespace unity
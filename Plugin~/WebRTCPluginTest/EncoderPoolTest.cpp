@@ -0,0 +1,266 @@
+#include "pch.h"
+#include <chrono>
+#include <thread>
+#include <IUnityGraphics.h>
+#include "GraphicsDeviceTestBase.h"
+#include "../WebRTCPlugin/Codec/EncoderPool.h"
+#include "../WebRTCPlugin/Codec/IEncoder.h"
+#include "../WebRTCPlugin/Codec/SimulcastEncoder.h"
+#include "../WebRTCPlugin/Context.h"
+#include "../WebRTCPlugin/GraphicsDevice/GraphicsDevice.h"
+
+extern "C" UnityRenderingEventAndData UNITY_INTERFACE_API GetRenderEventFunc(unity::webrtc::Context* context);
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Counts the live encoders, and captures a frame for each encoded frame.
+class FakePooledEncoder : public IEncoder
+{
+public:
+    FakePooledEncoder(int* liveCount, CodecInitializationResult result) : m_liveCount(liveCount)
+    {
+        m_initializationResult = result;
+        (*m_liveCount)++;
+    }
+    ~FakePooledEncoder() override { (*m_liveCount)--; }
+
+    void InitV() override {}
+    void SetRates(uint32_t bitRate, int64_t frameRate) override {}
+    void UpdateSettings() override {}
+    bool CopyBuffer(void* frame) override { return true; }
+    bool EncodeFrame() override
+    {
+        const auto frame = webrtc::VideoFrame::Builder()
+            .set_video_frame_buffer(webrtc::I420Buffer::Create(2, 2))
+            .build();
+        CaptureFrame(frame);
+        m_isIdrFrame = false;
+        return true;
+    }
+    bool IsSupported() const override { return true; }
+    void SetIdrFrame() override { m_isIdrFrame = true; }
+    uint64 GetCurrentFrameCount() const override { return 0; }
+
+    bool m_isIdrFrame = false;
+
+private:
+    int* m_liveCount;
+};
+
+class EncoderPoolTest : public testing::Test
+{
+protected:
+    EncoderPool::CreateEncoder Creator(CodecInitializationResult result = CodecInitializationResult::Success)
+    {
+        return [this, result]()
+        {
+            m_createdCount++;
+            return std::make_unique<FakePooledEncoder>(&m_liveCount, result);
+        };
+    }
+
+    EncoderPoolKey Key(int width, int height, UnityEncoderType encoderType = UnityEncoderHardware)
+    {
+        EncoderPoolKey key;
+        key.width = width;
+        key.height = height;
+        key.encoderType = encoderType;
+        return key;
+    }
+
+    int m_liveCount = 0;
+    int m_createdCount = 0;
+    EncoderPool m_pool{ std::chrono::seconds(10), 2 };
+};
+
+TEST_F(EncoderPoolTest, ReusesEncoderOfSameKey)
+{
+    auto encoder = m_pool.Acquire(Key(256, 256), Creator());
+    IEncoder* const first = encoder.get();
+    const auto control = encoder->GetControl();
+    m_pool.Release(Key(256, 256), std::move(encoder));
+    EXPECT_EQ(1, m_liveCount);
+    EXPECT_FALSE(m_pool.IsEmpty());
+
+    // Another size needs a new encoder.
+    encoder = m_pool.Acquire(Key(128, 128), Creator());
+    EXPECT_NE(first, encoder.get());
+    m_pool.Release(Key(128, 128), std::move(encoder));
+
+    encoder = m_pool.Acquire(Key(256, 256), Creator());
+    EXPECT_EQ(first, encoder.get());
+    EXPECT_EQ(2, m_createdCount);
+    // The reused encoder starts with a key frame and a new control.
+    EXPECT_TRUE(static_cast<FakePooledEncoder*>(encoder.get())->m_isIdrFrame);
+    EXPECT_NE(control, encoder->GetControl());
+
+    const EncoderPoolStats stats = m_pool.GetStats();
+    EXPECT_EQ(1u, stats.hitCount);
+    EXPECT_EQ(2u, stats.missCount);
+    EXPECT_EQ(1u, stats.idleEncoders);
+}
+
+TEST_F(EncoderPoolTest, ReusesSimulcastEncoderWithNewLayerControls)
+{
+    const auto createSimulcast = [this]()
+    {
+        m_createdCount++;
+        std::vector<std::unique_ptr<IEncoder>> layers;
+        layers.push_back(std::make_unique<FakePooledEncoder>(&m_liveCount, CodecInitializationResult::Success));
+        layers.push_back(std::make_unique<FakePooledEncoder>(&m_liveCount, CodecInitializationResult::Success));
+        std::unique_ptr<IEncoder> encoder =
+            std::make_unique<SimulcastEncoder>(std::move(layers), std::vector<bool>{ true, false });
+        encoder->InitV();
+        return encoder;
+    };
+    auto encoder = m_pool.Acquire(Key(256, 256), createSimulcast);
+    SimulcastEncoder* const simulcast = static_cast<SimulcastEncoder*>(encoder.get());
+    FakePooledEncoder* const layer = static_cast<FakePooledEncoder*>(simulcast->GetLayer(0));
+    // The sender of the lower stream got the control of the layer from the layer frames.
+    const rtc::scoped_refptr<EncoderControl> layerControl = layer->GetControl();
+
+    // The track is finalized.
+    encoder->DetachControl();
+    m_pool.Release(Key(256, 256), std::move(encoder));
+    layer->m_isIdrFrame = false;
+    layerControl->SetIdrFrame();
+    EXPECT_FALSE(layer->m_isIdrFrame);
+
+    encoder = m_pool.Acquire(Key(256, 256), createSimulcast);
+    ASSERT_EQ(simulcast, encoder.get());
+    EXPECT_EQ(1, m_createdCount);
+    EXPECT_NE(layerControl, layer->GetControl());
+    // Only the new track drives the layers.
+    layer->m_isIdrFrame = false;
+    layerControl->SetIdrFrame();
+    EXPECT_FALSE(layer->m_isIdrFrame);
+    layer->GetControl()->SetIdrFrame();
+    EXPECT_TRUE(layer->m_isIdrFrame);
+}
+
+TEST_F(EncoderPoolTest, EvictsAfterTimeToLive)
+{
+    m_pool.Release(Key(256, 256), m_pool.Acquire(Key(256, 256), Creator()));
+    m_pool.Evict(EncoderPool::Clock::now() + std::chrono::seconds(1));
+    EXPECT_EQ(1, m_liveCount);
+    m_pool.Evict(EncoderPool::Clock::now() + std::chrono::seconds(11));
+    EXPECT_EQ(0, m_liveCount);
+    EXPECT_TRUE(m_pool.IsEmpty());
+    EXPECT_EQ(1u, m_pool.GetStats().evictionCount);
+}
+
+TEST_F(EncoderPoolTest, EvictsOldestWhenFull)
+{
+    auto a = m_pool.Acquire(Key(64, 64), Creator());
+    auto b = m_pool.Acquire(Key(128, 128), Creator());
+    auto c = m_pool.Acquire(Key(256, 256), Creator());
+    m_pool.Release(Key(64, 64), std::move(a));
+    m_pool.Release(Key(128, 128), std::move(b));
+    m_pool.Release(Key(256, 256), std::move(c));
+    EXPECT_EQ(2, m_liveCount);
+
+    m_pool.Acquire(Key(64, 64), Creator());
+    EXPECT_EQ(4, m_createdCount);
+    EXPECT_EQ(1u, m_pool.GetStats().evictionCount);
+}
+
+TEST_F(EncoderPoolTest, DoesNotKeepSomeEncoders)
+{
+    m_pool.Release(Key(256, 256, UnityEncoderSoftware), m_pool.Acquire(Key(256, 256, UnityEncoderSoftware), Creator()));
+    m_pool.Release(Key(256, 256),
+        m_pool.Acquire(Key(256, 256), Creator(CodecInitializationResult::EncoderInitializationFailed)));
+    EXPECT_EQ(0, m_liveCount);
+
+    m_pool.SetTimeToLive(std::chrono::milliseconds(0));
+    m_pool.Release(Key(256, 256), m_pool.Acquire(Key(256, 256), Creator()));
+    EXPECT_EQ(0, m_liveCount);
+    EXPECT_TRUE(m_pool.IsEmpty());
+}
+
+TEST_F(EncoderPoolTest, RetriesWithoutIdleEncodersWhenCreationFails)
+{
+    m_pool.Release(Key(256, 256), m_pool.Acquire(Key(256, 256), Creator()));
+    // Stands for a driver which has no more sessions while the idle encoder holds one.
+    auto encoder = m_pool.Acquire(Key(128, 128), [this]()
+    {
+        m_createdCount++;
+        const auto result = m_liveCount > 0
+            ? CodecInitializationResult::EncoderInitializationFailed : CodecInitializationResult::Success;
+        return std::make_unique<FakePooledEncoder>(&m_liveCount, result);
+    });
+    EXPECT_EQ(CodecInitializationResult::Success, encoder->GetCodecInitializationResult());
+    EXPECT_EQ(3, m_createdCount);
+    EXPECT_TRUE(m_pool.IsEmpty());
+}
+
+TEST_F(EncoderPoolTest, MeasuresTimeToFirstFrame)
+{
+    EXPECT_EQ(-1, m_pool.GetStats().coldTimeToFirstFrameUs);
+    auto encoder = m_pool.Acquire(Key(256, 256), Creator());
+    encoder->EncodeFrame();
+    encoder->EncodeFrame();
+    m_pool.Release(Key(256, 256), std::move(encoder));
+    EXPECT_LE(0, m_pool.GetStats().coldTimeToFirstFrameUs);
+    EXPECT_EQ(-1, m_pool.GetStats().warmTimeToFirstFrameUs);
+
+    encoder = m_pool.Acquire(Key(256, 256), Creator());
+    encoder->EncodeFrame();
+    EXPECT_LE(0, m_pool.GetStats().warmTimeToFirstFrameUs);
+}
+
+// The pool of the plugin, evicted by the render event which the main thread issues without any track.
+class EncoderPoolRenderEventTest : public GraphicsDeviceTestBase
+{
+protected:
+    // Matches VideoStreamRenderEventID::Evict.
+    const int evictEventID = 3;
+    const int contextID = 100;
+    int m_liveCount = 0;
+    Context* m_context = nullptr;
+
+    void SetUp() override
+    {
+        m_context = ContextManager::GetInstance()->CreateContext(contextID, m_encoderType);
+        EncoderPool::GetInstance().SetTimeToLive(std::chrono::milliseconds(50));
+    }
+    void TearDown() override
+    {
+        EncoderPool::GetInstance().Clear();
+        EncoderPool::GetInstance().SetTimeToLive(std::chrono::seconds(10));
+        ContextManager::GetInstance()->DestroyContext(contextID);
+    }
+};
+
+TEST_P(EncoderPoolRenderEventTest, ReleasesDeviceAfterTimeToLive)
+{
+    // The D3D12 device of the test is not owned by the plugin.
+    if (m_unityGfxRenderer == kUnityGfxRendererD3D12)
+        return;
+    ASSERT_NE(nullptr, m_context);
+    EncoderPoolKey key;
+    key.width = 256;
+    key.height = 256;
+    key.device = m_device;
+    EncoderPool::GetInstance().Release(
+        key, std::make_unique<FakePooledEncoder>(&m_liveCount, CodecInitializationResult::Success));
+    ASSERT_EQ(1, m_liveCount);
+
+    const UnityRenderingEventAndData onRenderEvent = GetRenderEventFunc(m_context);
+    onRenderEvent(evictEventID, nullptr);
+    EXPECT_EQ(1, m_liveCount);
+    EXPECT_TRUE(GraphicsDevice::GetInstance().IsInitialized());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    onRenderEvent(evictEventID, nullptr);
+    EXPECT_EQ(0, m_liveCount);
+    EXPECT_TRUE(EncoderPool::GetInstance().IsEmpty());
+    EXPECT_FALSE(GraphicsDevice::GetInstance().IsInitialized());
+}
+
+INSTANTIATE_TEST_CASE_P(GraphicsDeviceParameters, EncoderPoolRenderEventTest, testing::ValuesIn(VALUES_TEST_ENV));
+
+} // end namespace webrtc
+} // end namespace unity
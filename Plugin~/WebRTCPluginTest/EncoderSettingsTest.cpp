@@ -0,0 +1,94 @@
+#include "pch.h"
+#include <atomic>
+#include <thread>
+#include "../WebRTCPlugin/Codec/EncoderSettings.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+TEST(EncoderSettingsTest, PublishesSnapshots)
+{
+    EncoderSettings settings;
+    settings.maxQP = 40;
+    EncoderSettingsPublisher publisher(settings);
+    const EncoderSettings* first = publisher.Read();
+    EXPECT_EQ(40, first->maxQP);
+    EXPECT_EQ(1u, first->version);
+    // Reading again without a change returns the same snapshot.
+    EXPECT_EQ(first, publisher.Read());
+
+    settings = publisher.Get();
+    settings.infiniteGOP = true;
+    publisher.Publish(settings);
+    // The snapshot which was read is kept until the next read.
+    EXPECT_EQ(40, first->maxQP);
+    const EncoderSettings* second = publisher.Read();
+    EXPECT_TRUE(second->infiniteGOP);
+    EXPECT_EQ(40, second->maxQP);
+    EXPECT_EQ(2u, second->version);
+}
+
+TEST(EncoderSettingsTest, FreesOldSnapshots)
+{
+    EncoderSettingsPublisher publisher;
+    publisher.Read();
+    for (int i = 0; i < 100; i++)
+    {
+        EncoderSettings settings;
+        settings.maxBitrate = i;
+        publisher.Publish(settings);
+    }
+    // The current snapshot and the one which was read last.
+    EXPECT_EQ(2u, publisher.GetSnapshotCount());
+    EXPECT_EQ(99, publisher.Read()->maxBitrate);
+    publisher.Publish(EncoderSettings());
+    EXPECT_EQ(2u, publisher.GetSnapshotCount());
+}
+
+TEST(EncoderSettingsTest, DefaultIsUsedByNewPublishers)
+{
+    const EncoderSettings previous = EncoderSettings::GetDefault();
+    EncoderSettings settings;
+    settings.rateControlMode = 2;
+    EncoderSettings::SetDefault(settings);
+    EXPECT_EQ(2, EncoderSettingsPublisher().Read()->rateControlMode);
+    EncoderSettings::SetDefault(previous);
+}
+
+// The reader sees every snapshot whole while another thread publishes.
+TEST(EncoderSettingsTest, ReadsWhilePublishing)
+{
+    EncoderSettingsPublisher publisher;
+    std::atomic<bool> done{ false };
+    std::thread writer([&]()
+    {
+        for (int i = 1; i <= 10000; i++)
+        {
+            EncoderSettings settings;
+            settings.minBitrate = i;
+            settings.maxBitrate = i * 2;
+            publisher.Publish(settings);
+        }
+        done = true;
+    });
+
+    uint64_t version = 0;
+    while (!done)
+    {
+        const EncoderSettings* settings = publisher.Read();
+        ASSERT_LE(version, settings->version);
+        version = settings->version;
+        if (version > 1)
+        {
+            ASSERT_EQ(settings->minBitrate * 2, settings->maxBitrate);
+        }
+    }
+    writer.join();
+    EXPECT_EQ(10000, publisher.Read()->minBitrate);
+    EXPECT_LE(publisher.GetSnapshotCount(), 2u);
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,179 @@
+#include "pch.h"
+#include <chrono>
+#include <thread>
+#include "../WebRTCPlugin/EncoderThread.h"
+#include "../WebRTCPlugin/Codec/IEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Records which frame each buffer holds, and takes a while to encode it.
+class FakeBufferedEncoder : public IEncoder
+{
+public:
+    explicit FakeBufferedEncoder(std::chrono::milliseconds encodeTime) : m_encodeTime(encodeTime) {}
+
+    void InitV() override {}
+    void SetRates(uint32_t bitRate, int64_t frameRate) override {}
+    void UpdateSettings() override {}
+    bool CopyBuffer(void* frame) override { return false; }
+    bool EncodeFrame() override { return false; }
+    bool IsSupported() const override { return true; }
+    void SetIdrFrame() override {}
+    uint64 GetCurrentFrameCount() const override { return m_encodedCount; }
+
+    uint32 GetBufferCount() const override { return bufferedFrameNum; }
+    bool CopyBufferAt(void* frame, uint32 bufferIndex) override
+    {
+        m_buffers[bufferIndex] = reinterpret_cast<intptr_t>(frame);
+        return true;
+    }
+    bool EncodeFrameAt(uint32 bufferIndex) override
+    {
+        std::this_thread::sleep_for(m_encodeTime);
+        m_encoded.push_back(m_buffers[bufferIndex]);
+        m_encodedCount++;
+        return true;
+    }
+
+    // Only read after the encoder thread is destroyed.
+    std::vector<intptr_t> m_encoded;
+
+private:
+    std::atomic<uint64> m_encodedCount{ 0 };
+    std::chrono::milliseconds m_encodeTime;
+    intptr_t m_buffers[bufferedFrameNum] = {};
+};
+
+void* FrameAt(intptr_t frame)
+{
+    return reinterpret_cast<void*>(frame);
+}
+
+TEST(BufferIndexQueueTest, PushAndPop)
+{
+    BufferIndexQueue queue(2);
+    uint32_t index = 0;
+    EXPECT_FALSE(queue.Pop(&index));
+    EXPECT_TRUE(queue.Push(4));
+    EXPECT_TRUE(queue.Push(5));
+    EXPECT_FALSE(queue.Push(6));
+    EXPECT_EQ(2u, queue.Size());
+    EXPECT_TRUE(queue.Pop(&index));
+    EXPECT_EQ(4u, index);
+    EXPECT_TRUE(queue.Push(7));
+    EXPECT_TRUE(queue.Pop(&index));
+    EXPECT_EQ(5u, index);
+    EXPECT_TRUE(queue.Pop(&index));
+    EXPECT_EQ(7u, index);
+    EXPECT_EQ(0u, queue.Size());
+}
+
+TEST(BufferIndexQueueTest, ConcurrentPopTakesEachIndexOnce)
+{
+    const uint32_t count = 10000;
+    BufferIndexQueue queue(8);
+    std::vector<std::atomic<int>> taken(count);
+    std::atomic<bool> done(false);
+    auto consume = [&]()
+    {
+        uint32_t index = 0;
+        while (!done || queue.Size() > 0)
+        {
+            if (queue.Pop(&index))
+                taken[index]++;
+            else
+                std::this_thread::yield();
+        }
+    };
+    std::thread consumer1(consume);
+    std::thread consumer2(consume);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        while (!queue.Push(i))
+        {
+            std::this_thread::yield();
+        }
+    }
+    done = true;
+    consumer1.join();
+    consumer2.join();
+    for (const auto& value : taken)
+    {
+        EXPECT_EQ(1, value);
+    }
+}
+
+TEST(EncoderThreadTest, BlockEncodesEveryFrameInOrder)
+{
+    FakeBufferedEncoder encoder(std::chrono::milliseconds(2));
+    const int frameCount = 20;
+    {
+        EncoderThread thread(&encoder, EncoderQueuePolicy::Block);
+        for (int i = 1; i <= frameCount; i++)
+        {
+            EXPECT_TRUE(thread.CopyAndQueueFrame(FrameAt(i)));
+        }
+        while (thread.GetStats().encodedFrames < frameCount)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        const EncoderQueueStats stats = thread.GetStats();
+        EXPECT_EQ(0u, stats.depth);
+        EXPECT_LE(stats.maxDepth, bufferedFrameNum);
+        EXPECT_EQ(static_cast<uint64_t>(frameCount), stats.queuedFrames);
+        EXPECT_EQ(0u, stats.droppedFrames);
+    }
+    ASSERT_EQ(static_cast<size_t>(frameCount), encoder.m_encoded.size());
+    for (int i = 0; i < frameCount; i++)
+    {
+        EXPECT_EQ(i + 1, encoder.m_encoded[i]);
+    }
+}
+
+TEST(EncoderThreadTest, DropOldestNeverWaitsForEncoder)
+{
+    const auto encodeTime = std::chrono::milliseconds(50);
+    FakeBufferedEncoder encoder(encodeTime);
+    const int frameCount = 20;
+    {
+        EncoderThread thread(&encoder, EncoderQueuePolicy::DropOldest);
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 1; i <= frameCount; i++)
+        {
+            thread.CopyAndQueueFrame(FrameAt(i));
+        }
+        EXPECT_LT(std::chrono::steady_clock::now() - start, encodeTime * 2);
+
+        const EncoderQueueStats stats = thread.GetStats();
+        EXPECT_LE(stats.maxDepth, bufferedFrameNum);
+        EXPECT_EQ(static_cast<uint64_t>(frameCount), stats.queuedFrames);
+        EXPECT_LT(0u, stats.droppedFrames);
+
+        // The newest frame is never dropped.
+        while (encoder.GetCurrentFrameCount() + thread.GetStats().droppedFrames < frameCount)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    ASSERT_FALSE(encoder.m_encoded.empty());
+    EXPECT_EQ(frameCount, encoder.m_encoded.back());
+    for (size_t i = 1; i < encoder.m_encoded.size(); i++)
+    {
+        EXPECT_LT(encoder.m_encoded[i - 1], encoder.m_encoded[i]);
+    }
+}
+
+TEST(EncoderThreadTest, SetPolicy)
+{
+    FakeBufferedEncoder encoder(std::chrono::milliseconds(0));
+    EncoderThread thread(&encoder, EncoderQueuePolicy::DropOldest);
+    EXPECT_EQ(EncoderQueuePolicy::DropOldest, thread.GetPolicy());
+    thread.SetPolicy(EncoderQueuePolicy::Block);
+    EXPECT_EQ(EncoderQueuePolicy::Block, thread.GetPolicy());
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -1,6 +1,14 @@
 #include "pch.h"
+#include <chrono>
+#include <random>
+#include <thread>
 #include "GraphicsDeviceTestBase.h"
 #include "../WebRTCPlugin/GraphicsDevice/ITexture2D.h"
+#include "../WebRTCPlugin/GraphicsDevice/GraphicsUtility.h"
+#if defined(SUPPORT_VULKAN)
+#include "../WebRTCPlugin/GraphicsDevice/Vulkan/VulkanTexture2D.h"
+#include "../WebRTCPlugin/GraphicsDevice/Vulkan/VulkanUtility.h"
+#endif
 
 namespace unity
 {
@@ -61,14 +69,208 @@ TEST_P(GraphicsDeviceTest, ConvertRGBToI420) {
     const std::unique_ptr<ITexture2D> src(m_device->CreateDefaultTextureV(width, height));
     const std::unique_ptr <ITexture2D> dst(m_device->CreateCPUReadTextureV(width, height));
     EXPECT_TRUE(m_device->CopyResourceFromNativeV(dst.get(), src->GetNativeTexturePtrV()));
-    const auto frameBuffer = m_device->ConvertRGBToI420(dst.get());
+    const auto frameBuffer = m_device->ConvertRGBToI420(dst.get(), ColorConversionOptions());
     EXPECT_NE(nullptr, frameBuffer);
     EXPECT_EQ(width, frameBuffer->width());
     EXPECT_EQ(height, frameBuffer->height());
 }
 #endif
 
+#if defined(SUPPORT_OPENGL_CORE)
+// Runs without a GPU on Mesa llvmpipe by setting LIBGL_ALWAYS_SOFTWARE=1.
+TEST_P(GraphicsDeviceTest, ConvertRGBToI420WithPixelBufferRing) {
+    if (m_unityGfxRenderer != kUnityGfxRendererOpenGLCore)
+        return;
+    const auto width = 256;
+    const auto height = 256;
+    const std::unique_ptr<ITexture2D> src(m_device->CreateDefaultTextureV(width, height));
+    const std::unique_ptr<ITexture2D> dst(m_device->CreateCPUReadTextureV(width, height));
+
+    const std::vector<uint8_t> pixels(width * height * 4, 128);
+    const GLuint srcName = static_cast<GLuint>(reinterpret_cast<intptr_t>(src->GetNativeTexturePtrV()));
+    glBindTexture(GL_TEXTURE_2D, srcName);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    EXPECT_TRUE(m_device->CopyResourceFromNativeV(dst.get(), src->GetNativeTexturePtrV()));
+
+    // The frame read back two calls before is returned, so nothing comes out until the ring is filled.
+    for (uint32 i = 0; i + 1 < bufferedFrameNum; i++)
+    {
+        EXPECT_EQ(nullptr, m_device->ConvertRGBToI420(dst.get(), ColorConversionOptions()));
+    }
+    glFinish();
+    const auto frameBuffer = m_device->ConvertRGBToI420(dst.get(), ColorConversionOptions());
+    ASSERT_NE(nullptr, frameBuffer);
+    EXPECT_EQ(width, frameBuffer->width());
+    EXPECT_EQ(height, frameBuffer->height());
+    EXPECT_EQ(126, frameBuffer->DataY()[0]);
+    EXPECT_EQ(126, frameBuffer->DataY()[(height - 1) * frameBuffer->StrideY() + width - 1]);
+    EXPECT_EQ(128, frameBuffer->DataU()[0]);
+    EXPECT_EQ(128, frameBuffer->DataV()[0]);
+}
+
+// The lower simulcast layers are scaled from the captured texture on the GPU.
+TEST_P(GraphicsDeviceTest, ScaleResourceFromNativeV) {
+    if (m_unityGfxRenderer != kUnityGfxRendererOpenGLCore)
+        return;
+    const auto width = 256;
+    const auto height = 144;
+    const std::unique_ptr<ITexture2D> src(m_device->CreateDefaultTextureV(width, height));
+    const std::unique_ptr<ITexture2D> dst(m_device->CreateDefaultTextureV(width / 2, height / 2));
+
+    // The left half is black and the right half is white.
+    std::vector<uint8_t> pixels(width * height * 4, 0);
+    for (int y = 0; y < height; y++)
+    {
+        std::fill_n(&pixels[(y * width + width / 2) * 4], width / 2 * 4, 255);
+    }
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(reinterpret_cast<intptr_t>(src->GetNativeTexturePtrV())));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+    EXPECT_TRUE(m_device->ScaleResourceFromNativeV(dst.get(), src->GetNativeTexturePtrV()));
+
+    std::vector<uint8_t> scaled(width / 2 * height / 2 * 4);
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(reinterpret_cast<intptr_t>(dst->GetNativeTexturePtrV())));
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, scaled.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    EXPECT_EQ(0, scaled[0]);
+    EXPECT_EQ(255, scaled[(width / 2 - 1) * 4]);
+    EXPECT_EQ(0, scaled[((height / 2 - 1) * width / 2 + width / 4 - 1) * 4]);
+    EXPECT_EQ(255, scaled[((height / 2 - 1) * width / 2 + width / 4) * 4]);
+}
+
+// The compute shader conversion must give the same planes as the CPU conversion.
+TEST_P(GraphicsDeviceTest, ConvertRGBToI420OnGPUMatchesCPU) {
+    if (m_unityGfxRenderer != kUnityGfxRendererOpenGLCore)
+        return;
+    const auto width = 256;
+    const auto height = 144;
+    std::vector<uint8_t> pixels(width * height * 4);
+    std::mt19937 random(0);
+    for (auto& value : pixels)
+    {
+        value = static_cast<uint8_t>(random());
+    }
+    for (const auto mode : { ChromaSubsampling::TopLeft, ChromaSubsampling::Box })
+    {
+        const std::unique_ptr<ITexture2D> src(m_device->CreateDefaultTextureV(width, height));
+        const std::unique_ptr<ITexture2D> dst(m_device->CreateCPUReadTextureV(width, height));
+        const GLuint srcName = static_cast<GLuint>(reinterpret_cast<intptr_t>(src->GetNativeTexturePtrV()));
+        glBindTexture(GL_TEXTURE_2D, srcName);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        EXPECT_TRUE(m_device->CopyResourceFromNativeV(dst.get(), src->GetNativeTexturePtrV()));
+
+        ColorConversionOptions options;
+        options.chromaSubsampling = mode;
+        rtc::scoped_refptr<::webrtc::I420Buffer> frameBuffer;
+        for (uint32 i = 0; i < bufferedFrameNum; i++)
+        {
+            glFinish();
+            frameBuffer = m_device->ConvertRGBToI420(dst.get(), options);
+        }
+        ASSERT_NE(nullptr, frameBuffer);
+        const auto expected = GraphicsUtility::ConvertRGBToI420Buffer(width, height, width * 4, pixels.data(), options);
+        for (int i = 0; i < height; i++)
+        {
+            ASSERT_EQ(0, memcmp(expected->DataY() + i * expected->StrideY(),
+                frameBuffer->DataY() + i * frameBuffer->StrideY(), width)) << "row " << i;
+        }
+        for (int i = 0; i < height / 2; i++)
+        {
+            ASSERT_EQ(0, memcmp(expected->DataU() + i * expected->StrideU(),
+                frameBuffer->DataU() + i * frameBuffer->StrideU(), width / 2)) << "row " << i;
+            ASSERT_EQ(0, memcmp(expected->DataV() + i * expected->StrideV(),
+                frameBuffer->DataV() + i * frameBuffer->StrideV(), width / 2)) << "row " << i;
+        }
+    }
+}
+#endif
+
 INSTANTIATE_TEST_CASE_P(GraphicsDeviceParameters, GraphicsDeviceTest, testing::ValuesIn(VALUES_TEST_ENV));
 
+#if defined(SUPPORT_VULKAN) && defined(UNITY_LINUX)
+// Runs without a GPU on lavapipe by setting VK_ICD_FILENAMES to lvp_icd.x86_64.json.
+// Only the CPU readback is tested because CUDA and the Unity interface are not available there.
+class VulkanReadbackTest : public GraphicsDeviceTestBase {};
+
+TEST_P(VulkanReadbackTest, ConvertRGBToI420WithStagingBufferRing) {
+    const auto width = 256;
+    const auto height = 256;
+    const std::unique_ptr<ITexture2D> tex(m_device->CreateCPUReadTextureV(width, height));
+    ASSERT_NE(nullptr, tex);
+
+    // The frame copied two calls before is returned, so nothing comes out until the ring is filled.
+    for (uint32 i = 0; i + 1 < bufferedFrameNum; i++)
+    {
+        EXPECT_EQ(nullptr, m_device->ConvertRGBToI420(tex.get(), ColorConversionOptions()));
+    }
+    rtc::scoped_refptr<::webrtc::I420Buffer> frameBuffer;
+    for (int i = 0; i < 100 && frameBuffer == nullptr; i++)
+    {
+        frameBuffer = m_device->ConvertRGBToI420(tex.get(), ColorConversionOptions());
+        if (frameBuffer == nullptr)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_NE(nullptr, frameBuffer);
+    EXPECT_EQ(width, frameBuffer->width());
+    EXPECT_EQ(height, frameBuffer->height());
+}
+
+// Compares the render thread time of CopyResourceV with the previous implementation, which submitted three
+// command buffers and waited for the queue to become idle after each of them.
+TEST_P(VulkanReadbackTest, DISABLED_CopyResourceBenchmark) {
+    const auto width = 1280;
+    const auto height = 720;
+    const int iterations = 300;
+    const std::unique_ptr<ITexture2D> src(m_device->CreateDefaultTextureV(width, height));
+    const std::unique_ptr<ITexture2D> dst(m_device->CreateDefaultTextureV(width, height));
+    ASSERT_NE(nullptr, src);
+    ASSERT_NE(nullptr, dst);
+    const auto srcTexture = static_cast<VulkanTexture2D*>(src.get());
+    const auto dstTexture = static_cast<VulkanTexture2D*>(dst.get());
+
+    const auto vulkan = static_cast<const UnityVulkanInstance*>(CreateDevice(kUnityGfxRendererVulkan));
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = vulkan->queueFamilyIndex;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    ASSERT_EQ(VK_SUCCESS, vkCreateCommandPool(vulkan->device, &poolInfo, nullptr, &commandPool));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        VulkanUtility::DoImageLayoutTransition(vulkan->device, commandPool, vulkan->graphicsQueue,
+            srcTexture->GetImage(), srcTexture->GetTextureFormat(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        VulkanUtility::CopyImage(vulkan->device, commandPool, vulkan->graphicsQueue,
+            srcTexture->GetImage(), dstTexture->GetImage(), width, height);
+        VulkanUtility::DoImageLayoutTransition(vulkan->device, commandPool, vulkan->graphicsQueue,
+            srcTexture->GetImage(), srcTexture->GetTextureFormat(),
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+    const std::chrono::duration<double, std::milli> waitIdleElapsed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        EXPECT_TRUE(m_device->CopyResourceV(dst.get(), src.get()));
+    }
+    const std::chrono::duration<double, std::milli> ringElapsed = std::chrono::steady_clock::now() - start;
+    vkQueueWaitIdle(vulkan->graphicsQueue);
+    vkDestroyCommandPool(vulkan->device, commandPool, nullptr);
+
+    const double waitIdleMs = waitIdleElapsed.count() / iterations;
+    const double ringMs = ringElapsed.count() / iterations;
+    printf("vkQueueWaitIdle x3 %8.3f ms/frame\n", waitIdleMs);
+    printf("fenced ring        %8.3f ms/frame (%.3f ms saved)\n", ringMs, waitIdleMs - ringMs);
+}
+
+INSTANTIATE_TEST_CASE_P(VulkanReadbackParameters, VulkanReadbackTest,
+    testing::Values(tuple<UnityGfxRenderer, UnityEncoderType>(
+        kUnityGfxRendererVulkan, UnityEncoderType::UnityEncoderSoftware)));
+#endif
+
 } // end namespace webrtc
 } // end namespace unity
@@ -149,6 +149,61 @@ void* CreateDeviceOpenGL()
 
 #endif
 
+#if defined(SUPPORT_VULKAN) // Vulkan
+
+static UnityVulkanInstance s_vulkan;
+
+// Creates the device without a window, so that the tests also run on lavapipe with no GPU.
+void* CreateDeviceVulkan()
+{
+    if (s_vulkan.device != VK_NULL_HANDLE)
+        return &s_vulkan;
+
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "test";
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+
+    VkInstanceCreateInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &appInfo;
+    EXPECT_EQ(VK_SUCCESS, vkCreateInstance(&instanceInfo, nullptr, &s_vulkan.instance));
+
+    uint32_t physicalDeviceCount = 1;
+    vkEnumeratePhysicalDevices(s_vulkan.instance, &physicalDeviceCount, &s_vulkan.physicalDevice);
+    EXPECT_NE(VK_NULL_HANDLE, s_vulkan.physicalDevice);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(s_vulkan.physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(s_vulkan.physicalDevice, &queueFamilyCount, queueFamilies.data());
+    for (uint32_t i = 0; i < queueFamilyCount; i++)
+    {
+        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        {
+            s_vulkan.queueFamilyIndex = i;
+            break;
+        }
+    }
+
+    const float queuePriority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = s_vulkan.queueFamilyIndex;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &queuePriority;
+
+    VkDeviceCreateInfo deviceInfo = {};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    EXPECT_EQ(VK_SUCCESS, vkCreateDevice(s_vulkan.physicalDevice, &deviceInfo, nullptr, &s_vulkan.device));
+    vkGetDeviceQueue(s_vulkan.device, s_vulkan.queueFamilyIndex, 0, &s_vulkan.graphicsQueue);
+    return &s_vulkan;
+}
+
+#endif
+
 IUnityInterface* CreateUnityInterface(UnityGfxRenderer renderer) {
 
     switch(renderer)
@@ -195,7 +250,14 @@ void* CreateDevice(UnityGfxRenderer renderer)
     case kUnityGfxRendererMetal:
         return CreateDeviceMetal();
 #endif
+#if defined(SUPPORT_VULKAN)
+    case kUnityGfxRendererVulkan:
+        return CreateDeviceVulkan();
+#endif
+    case kUnityGfxRendererNull:
+        return nullptr;
     }
+    return nullptr;
 }
 
 //---------------------------------------------------------------------------------------------------------------------
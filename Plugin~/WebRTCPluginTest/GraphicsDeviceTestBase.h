@@ -12,6 +12,9 @@ using unity::webrtc::UnityEncoderType;
 using std::tuple;
 using testing::Values;
 
+// Returns the native device of the renderer, which is shared by all tests.
+void* CreateDevice(UnityGfxRenderer renderer);
+
 class GraphicsDeviceTestBase
     : public testing::TestWithParam<tuple<UnityGfxRenderer, UnityEncoderType> >
 {
@@ -25,6 +28,7 @@ protected:
 };
 
 static tuple<UnityGfxRenderer, UnityEncoderType> VALUES_TEST_ENV[] = {
+    { kUnityGfxRendererNull, UnityEncoderType::UnityEncoderSoftware },
 #if defined(UNITY_WIN)
     { kUnityGfxRendererD3D11, UnityEncoderType::UnityEncoderHardware },
     { kUnityGfxRendererD3D11, UnityEncoderType::UnityEncoderSoftware },
@@ -0,0 +1,509 @@
+#include "pch.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "../WebRTCPlugin/GraphicsDevice/GraphicsUtility.h"
+#include "../WebRTCPlugin/WorkerPool.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace webrtc = ::webrtc;
+
+namespace
+{
+    std::vector<uint8_t> CreateRandomImage(uint32_t rowToRowInBytes, uint32_t height)
+    {
+        std::mt19937 random(0);
+        std::uniform_int_distribution<int> dist(0, 255);
+        std::vector<uint8_t> image(rowToRowInBytes * height);
+        for (auto& value : image)
+        {
+            value = static_cast<uint8_t>(dist(random));
+        }
+        return image;
+    }
+
+    void ExpectPlaneNear(const uint8_t* expected, int expectedStride,
+        const uint8_t* actual, int actualStride, int width, int height, int tolerance = 1)
+    {
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                ASSERT_NEAR(expected[i * expectedStride + j], actual[i * actualStride + j], tolerance)
+                    << "at (" << j << ", " << i << ")";
+            }
+        }
+    }
+
+    // The per-pixel loop which converted the frames before the kernels were added, kept as the reference
+    // of their output and of their speedup. The chroma is sampled at the top-left pixel of each block.
+    void ConvertRGBToI420Baseline(const uint32_t width, const uint32_t height, const uint32_t rowToRowInBytes,
+        const uint8_t* srcData, webrtc::I420Buffer* i420_buffer)
+    {
+        uint8_t* yuv_y = i420_buffer->MutableDataY();
+        uint8_t* yuv_u = i420_buffer->MutableDataU();
+        uint8_t* yuv_v = i420_buffer->MutableDataV();
+
+        for (uint32_t i = 0; i < height; i++)
+        {
+            for (uint32_t j = 0; j < width; j++)
+            {
+                const uint32_t startIndex = i * rowToRowInBytes + j * 4;
+                const int B = srcData[startIndex + 0];
+                const int G = srcData[startIndex + 1];
+                const int R = srcData[startIndex + 2];
+
+                const int Y = ((66 * R + 129 * G + 25 * B + 128) >> 8) + 16;
+                const int U = ((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128;
+                const int V = ((112 * R - 94 * G - 18 * B + 128) >> 8) + 128;
+
+                yuv_y[i * i420_buffer->StrideY() + j] = static_cast<uint8_t>((Y < 0) ? 0 : ((Y > 255) ? 255 : Y));
+                if (i % 2 == 0 && j % 2 == 0)
+                {
+                    const uint32_t chromaIndex = (i / 2) * i420_buffer->StrideU() + j / 2;
+                    yuv_u[chromaIndex] = static_cast<uint8_t>((U < 0) ? 0 : ((U > 255) ? 255 : U));
+                    yuv_v[chromaIndex] = static_cast<uint8_t>((V < 0) ? 0 : ((V > 255) ? 255 : V));
+                }
+            }
+        }
+    }
+
+    ColorConversionOptions MakeOptions(ChromaSubsampling chromaSubsampling, ColorConversionKernel kernel)
+    {
+        ColorConversionOptions options;
+        options.chromaSubsampling = chromaSubsampling;
+        options.kernel = kernel;
+        return options;
+    }
+
+    const ChromaSubsampling kChromaSubsamplings[] = {
+        ChromaSubsampling::TopLeft,
+        ChromaSubsampling::Box
+    };
+
+    const ColorConversionKernel kSIMDKernels[] = {
+        ColorConversionKernel::SSE2,
+        ColorConversionKernel::AVX2,
+        ColorConversionKernel::NEON
+    };
+} // end namespace
+
+class ConvertRGBToI420Test : public testing::TestWithParam<std::tuple<int, int>> {};
+
+TEST_P(ConvertRGBToI420Test, SIMDKernelsMatchScalar)
+{
+    int width, height;
+    std::tie(width, height) = GetParam();
+    const uint32_t rowToRowInBytes = width * 4 + 16;
+    const std::vector<uint8_t> image = CreateRandomImage(rowToRowInBytes, height);
+
+    for (const ChromaSubsampling chromaSubsampling : kChromaSubsamplings)
+    {
+        const auto expected = webrtc::I420Buffer::Create(width, height);
+        GraphicsUtility::ConvertRGBToI420(width, height, rowToRowInBytes, image.data(), expected,
+            MakeOptions(chromaSubsampling, ColorConversionKernel::C));
+
+        for (const ColorConversionKernel kernel : kSIMDKernels)
+        {
+            if (!GraphicsUtility::IsKernelSupported(kernel))
+                continue;
+            const auto actual = webrtc::I420Buffer::Create(width, height);
+            GraphicsUtility::ConvertRGBToI420(width, height, rowToRowInBytes, image.data(), actual,
+                MakeOptions(chromaSubsampling, kernel));
+            ExpectPlaneNear(expected->DataY(), expected->StrideY(), actual->DataY(), actual->StrideY(),
+                width, height);
+            ExpectPlaneNear(expected->DataU(), expected->StrideU(), actual->DataU(), actual->StrideU(),
+                expected->ChromaWidth(), expected->ChromaHeight());
+            ExpectPlaneNear(expected->DataV(), expected->StrideV(), actual->DataV(), actual->StrideV(),
+                expected->ChromaWidth(), expected->ChromaHeight());
+        }
+    }
+}
+
+TEST_P(ConvertRGBToI420Test, KernelsMatchBaseline)
+{
+    int width, height;
+    std::tie(width, height) = GetParam();
+    const uint32_t rowToRowInBytes = width * 4 + 16;
+    const std::vector<uint8_t> image = CreateRandomImage(rowToRowInBytes, height);
+    const auto expected = webrtc::I420Buffer::Create(width, height);
+    ConvertRGBToI420Baseline(width, height, rowToRowInBytes, image.data(), expected);
+
+    const ColorConversionKernel kernels[] = {
+        ColorConversionKernel::C,
+        ColorConversionKernel::SSE2,
+        ColorConversionKernel::AVX2,
+        ColorConversionKernel::NEON
+    };
+    for (const ColorConversionKernel kernel : kernels)
+    {
+        if (!GraphicsUtility::IsKernelSupported(kernel))
+            continue;
+        const auto actual = webrtc::I420Buffer::Create(width, height);
+        GraphicsUtility::ConvertRGBToI420(width, height, rowToRowInBytes, image.data(), actual,
+            MakeOptions(ChromaSubsampling::TopLeft, kernel));
+        // The scalar kernel computes the same values as the baseline, the SIMD kernels may round differently.
+        const int tolerance = kernel == ColorConversionKernel::C ? 0 : 1;
+        ExpectPlaneNear(expected->DataY(), expected->StrideY(), actual->DataY(), actual->StrideY(),
+            width, height, tolerance);
+        ExpectPlaneNear(expected->DataU(), expected->StrideU(), actual->DataU(), actual->StrideU(),
+            expected->ChromaWidth(), expected->ChromaHeight(), tolerance);
+        ExpectPlaneNear(expected->DataV(), expected->StrideV(), actual->DataV(), actual->StrideV(),
+            expected->ChromaWidth(), expected->ChromaHeight(), tolerance);
+    }
+}
+
+TEST_P(ConvertRGBToI420Test, ParallelConversionMatchesSerial)
+{
+    int width, height;
+    std::tie(width, height) = GetParam();
+    const uint32_t rowToRowInBytes = width * 4;
+    const std::vector<uint8_t> image = CreateRandomImage(rowToRowInBytes, height);
+    WorkerPool pool(4);
+
+    for (const ChromaSubsampling chromaSubsampling : kChromaSubsamplings)
+    {
+        ColorConversionOptions options = MakeOptions(chromaSubsampling, ColorConversionKernel::Auto);
+        const auto expected = GraphicsUtility::ConvertRGBToI420Buffer(width, height, rowToRowInBytes, image.data(),
+            options);
+        options.workerPool = &pool;
+        const auto actual = GraphicsUtility::ConvertRGBToI420Buffer(width, height, rowToRowInBytes, image.data(),
+            options);
+        ExpectPlaneNear(expected->DataY(), expected->StrideY(), actual->DataY(), actual->StrideY(),
+            width, height);
+        ExpectPlaneNear(expected->DataU(), expected->StrideU(), actual->DataU(), actual->StrideU(),
+            expected->ChromaWidth(), expected->ChromaHeight());
+        ExpectPlaneNear(expected->DataV(), expected->StrideV(), actual->DataV(), actual->StrideV(),
+            expected->ChromaWidth(), expected->ChromaHeight());
+    }
+}
+
+TEST(GraphicsUtilityTest, BoxChromaAveragesBlock)
+{
+    // Red and blue BGRA pixels in a checker pattern.
+    const uint8_t image[] = {
+        0, 0, 255, 255,   255, 0, 0, 255,
+        255, 0, 0, 255,   0, 0, 255, 255,
+    };
+    const auto topLeft = webrtc::I420Buffer::Create(2, 2);
+    GraphicsUtility::ConvertRGBToI420(2, 2, 8, image, topLeft,
+        MakeOptions(ChromaSubsampling::TopLeft, ColorConversionKernel::C));
+    const auto box = webrtc::I420Buffer::Create(2, 2);
+    GraphicsUtility::ConvertRGBToI420(2, 2, 8, image, box,
+        MakeOptions(ChromaSubsampling::Box, ColorConversionKernel::C));
+
+    // The top-left pixel is pure red.
+    EXPECT_EQ(90, topLeft->DataU()[0]);
+    EXPECT_EQ(240, topLeft->DataV()[0]);
+    // The average color is (128, 0, 128).
+    EXPECT_EQ(165, box->DataU()[0]);
+    EXPECT_EQ(175, box->DataV()[0]);
+    EXPECT_EQ(0, memcmp(topLeft->DataY(), box->DataY(), 2));
+    EXPECT_EQ(0, memcmp(topLeft->DataY() + topLeft->StrideY(), box->DataY() + box->StrideY(), 2));
+}
+
+TEST(GraphicsUtilityTest, DefaultKernelIsSupported)
+{
+    const ColorConversionKernel kernel = GraphicsUtility::GetDefaultKernel();
+    EXPECT_NE(ColorConversionKernel::Auto, kernel);
+    EXPECT_TRUE(GraphicsUtility::IsKernelSupported(kernel));
+}
+
+// Reports the throughput of each kernel against the per-pixel baseline loop and the scalar kernel.
+// Run with --gtest_also_run_disabled_tests.
+TEST(GraphicsUtilityTest, DISABLED_ConvertRGBToI420Benchmark)
+{
+    const int resolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    const ColorConversionKernel kernels[] = {
+        ColorConversionKernel::C,
+        ColorConversionKernel::SSE2,
+        ColorConversionKernel::AVX2,
+        ColorConversionKernel::NEON
+    };
+    const char* kernelNames[] = { "Auto", "C", "SSE2", "AVX2", "NEON" };
+    const char* chromaNames[] = { "TopLeft", "Box" };
+    const int iterations = 100;
+
+    for (const auto& resolution : resolutions)
+    {
+        const int width = resolution[0];
+        const int height = resolution[1];
+        const std::vector<uint8_t> image = CreateRandomImage(width * 4, height);
+        const auto buffer = webrtc::I420Buffer::Create(width, height);
+
+        const auto baselineStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            ConvertRGBToI420Baseline(width, height, width * 4, image.data(), buffer);
+        }
+        const std::chrono::duration<double, std::milli> baselineElapsed =
+            std::chrono::steady_clock::now() - baselineStart;
+        const double baselineMs = baselineElapsed.count() / iterations;
+        printf("%4dx%-4d %-7s %-8s %8.3f ms/frame %8.1f Mpixel/s\n",
+            width, height, "TopLeft", "Baseline", baselineMs, width * height / (baselineMs * 1000.0));
+
+        for (const ChromaSubsampling chromaSubsampling : kChromaSubsamplings)
+        {
+            double scalarMs = 0;
+            for (const ColorConversionKernel kernel : kernels)
+            {
+                if (!GraphicsUtility::IsKernelSupported(kernel))
+                    continue;
+                const ColorConversionOptions options = MakeOptions(chromaSubsampling, kernel);
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < iterations; i++)
+                {
+                    GraphicsUtility::ConvertRGBToI420(width, height, width * 4, image.data(), buffer, options);
+                }
+                const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                const double ms = elapsed.count() / iterations;
+                if (kernel == ColorConversionKernel::C)
+                    scalarMs = ms;
+                printf("%4dx%-4d %-7s %-8s %8.3f ms/frame %8.1f Mpixel/s x%.2f baseline x%.2f scalar\n",
+                    width, height, chromaNames[static_cast<int>(chromaSubsampling)],
+                    kernelNames[static_cast<int>(kernel)], ms,
+                    width * height / (ms * 1000.0), baselineMs / ms, scalarMs / ms);
+            }
+        }
+    }
+}
+
+// Reports how the 4K conversion scales with the thread count of the worker pool.
+// Run with --gtest_also_run_disabled_tests.
+TEST(GraphicsUtilityTest, DISABLED_ParallelConversionScalingBenchmark)
+{
+    const int width = 3840;
+    const int height = 2160;
+    const int iterations = 100;
+    const int maxThreadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const std::vector<uint8_t> image = CreateRandomImage(width * 4, height);
+    const auto buffer = webrtc::I420Buffer::Create(width, height);
+    WorkerPool pool(1);
+
+    double singleMs = 0;
+    for (int threadCount = 1; threadCount <= maxThreadCount; threadCount++)
+    {
+        pool.SetThreadCount(threadCount);
+        ColorConversionOptions options;
+        options.workerPool = &pool;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            GraphicsUtility::ConvertRGBToI420(width, height, width * 4, image.data(), buffer, options);
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        const double ms = elapsed.count() / iterations;
+        if (threadCount == 1)
+            singleMs = ms;
+        printf("%2d threads %8.3f ms/frame %7.1f fps x%.2f\n", threadCount, ms, 1000.0 / ms, singleMs / ms);
+    }
+}
+
+namespace
+{
+    // Synthetic BGRA images which are stable across runs.
+    // "Stripes" has one pixel wide red and blue columns which alias badly without chroma filtering.
+    std::vector<uint8_t> CreateTestImage(const std::string& name, int width, int height)
+    {
+        std::vector<uint8_t> image(width * height * 4);
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                uint8_t* p = &image[(i * width + j) * 4];
+                if (name == "Stripes")
+                {
+                    const bool red = (j % 2) == 0;
+                    p[0] = red ? 0 : 255;
+                    p[1] = static_cast<uint8_t>(i * 255 / height);
+                    p[2] = red ? 255 : 0;
+                }
+                else if (name == "ZonePlate")
+                {
+                    const double r = (j - width / 2.0) * (j - width / 2.0) + (i - height / 2.0) * (i - height / 2.0);
+                    const double s = std::sin(r * 3.14159265 / width);
+                    p[0] = static_cast<uint8_t>(128 - 127 * s);
+                    p[1] = 128;
+                    p[2] = static_cast<uint8_t>(128 + 127 * s);
+                }
+                else
+                {
+                    p[0] = static_cast<uint8_t>(j * 255 / width);
+                    p[1] = static_cast<uint8_t>(i * 255 / height);
+                    p[2] = static_cast<uint8_t>(255 - j * 255 / width);
+                }
+                p[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    // YUV planes of a BGRA image without chroma subsampling, converted in floating point (BT.601 limited range)
+    // independently of GraphicsUtility.
+    struct FullResolutionYUV
+    {
+        std::vector<uint8_t> y;
+        std::vector<uint8_t> u;
+        std::vector<uint8_t> v;
+    };
+
+    FullResolutionYUV ConvertToFullResolutionYUV(const std::vector<uint8_t>& image, int width, int height)
+    {
+        FullResolutionYUV yuv;
+        yuv.y.resize(width * height);
+        yuv.u.resize(width * height);
+        yuv.v.resize(width * height);
+        for (int i = 0; i < width * height; i++)
+        {
+            const double b = image[i * 4 + 0];
+            const double g = image[i * 4 + 1];
+            const double r = image[i * 4 + 2];
+            yuv.y[i] = static_cast<uint8_t>(std::lround(16.0 + 0.2568 * r + 0.5041 * g + 0.0979 * b));
+            yuv.u[i] = static_cast<uint8_t>(std::lround(128.0 - 0.1482 * r - 0.2910 * g + 0.4392 * b));
+            yuv.v[i] = static_cast<uint8_t>(std::lround(128.0 + 0.4392 * r - 0.3678 * g - 0.0714 * b));
+        }
+        return yuv;
+    }
+
+    // PSNR of plane b against the full resolution plane a. Each sample of b covers a block of
+    // (1 << shift) x (1 << shift) samples of a, so that subsampled chroma is compared at full resolution.
+    double PlanePSNR(const uint8_t* a, int strideA, const uint8_t* b, int strideB, int width, int height,
+        int shift = 0)
+    {
+        double sse = 0;
+        for (int i = 0; i < height; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                const double diff = a[i * strideA + j] - b[(i >> shift) * strideB + (j >> shift)];
+                sse += diff * diff;
+            }
+        }
+        if (sse == 0)
+            return 99.0;
+        return 10.0 * std::log10(255.0 * 255.0 * width * height / sse);
+    }
+
+    // Decodes every encoded frame immediately, the encoded buffer is only valid inside the callback.
+    class EncodeDecodeLoop : public webrtc::EncodedImageCallback, public webrtc::DecodedImageCallback
+    {
+    public:
+        explicit EncodeDecodeLoop(webrtc::VideoDecoder* decoder) : m_decoder(decoder) {}
+
+        Result OnEncodedImage(const webrtc::EncodedImage& image,
+            const webrtc::CodecSpecificInfo* codecSpecificInfo,
+            const webrtc::RTPFragmentationHeader* fragmentation) override
+        {
+            m_encodedBytes += image.size();
+            m_decoder->Decode(image, false, 0);
+            return Result(Result::OK);
+        }
+
+        int32_t Decoded(webrtc::VideoFrame& decodedImage) override
+        {
+            m_decoded = decodedImage.video_frame_buffer()->ToI420();
+            return 0;
+        }
+
+        size_t m_encodedBytes = 0;
+        rtc::scoped_refptr<webrtc::I420BufferInterface> m_decoded;
+    private:
+        webrtc::VideoDecoder* m_decoder;
+    };
+} // end namespace
+
+// Compares the quality of the software encoder (VP8) at a fixed bitrate for each chroma subsampling.
+// PSNR is measured against the source converted at full resolution, so that neither subsampling is the reference.
+// Run with --gtest_also_run_disabled_tests.
+TEST(GraphicsUtilityTest, DISABLED_ChromaSubsamplingQualityHarness)
+{
+    const int width = 640;
+    const int height = 360;
+    const int frameCount = 60;
+    const int framerate = 30;
+    const int bitratesKbps[] = { 250, 500, 1000, 2000 };
+    const char* imageNames[] = { "Stripes", "ZonePlate", "Gradient" };
+    const char* chromaNames[] = { "TopLeft", "Box" };
+
+    webrtc::InternalEncoderFactory encoderFactory;
+    webrtc::InternalDecoderFactory decoderFactory;
+    const webrtc::SdpVideoFormat format("VP8");
+
+    for (const char* imageName : imageNames)
+    {
+        const std::vector<uint8_t> image = CreateTestImage(imageName, width, height);
+        const FullResolutionYUV reference = ConvertToFullResolutionYUV(image, width, height);
+
+        for (const int bitrateKbps : bitratesKbps)
+        {
+            for (const ChromaSubsampling chromaSubsampling : kChromaSubsamplings)
+            {
+                const auto source = GraphicsUtility::ConvertRGBToI420Buffer(width, height, width * 4, image.data(),
+                    MakeOptions(chromaSubsampling, ColorConversionKernel::Auto));
+
+                webrtc::VideoCodec codec;
+                codec.codecType = webrtc::kVideoCodecVP8;
+                codec.width = width;
+                codec.height = height;
+                codec.startBitrate = bitrateKbps;
+                codec.maxBitrate = bitrateKbps;
+                codec.minBitrate = 30;
+                codec.maxFramerate = framerate;
+                codec.qpMax = 56;
+                *codec.VP8() = webrtc::VideoEncoder::GetDefaultVp8Settings();
+
+                const std::unique_ptr<webrtc::VideoEncoder> encoder = encoderFactory.CreateVideoEncoder(format);
+                const std::unique_ptr<webrtc::VideoDecoder> decoder = decoderFactory.CreateVideoDecoder(format);
+                ASSERT_EQ(WEBRTC_VIDEO_CODEC_OK, encoder->InitEncode(&codec, 1, 1200));
+                ASSERT_EQ(WEBRTC_VIDEO_CODEC_OK, decoder->InitDecode(&codec, 1));
+
+                EncodeDecodeLoop loop(decoder.get());
+                encoder->RegisterEncodeCompleteCallback(&loop);
+                decoder->RegisterDecodeCompleteCallback(&loop);
+
+                webrtc::VideoBitrateAllocation allocation;
+                allocation.SetBitrate(0, 0, bitrateKbps * 1000);
+                encoder->SetRates(webrtc::VideoEncoder::RateControlParameters(allocation, framerate));
+
+                for (int i = 0; i < frameCount; i++)
+                {
+                    const webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+                        .set_video_frame_buffer(source)
+                        .set_timestamp_rtp(i * 90000 / framerate)
+                        .set_timestamp_us(i * rtc::kNumMicrosecsPerSec / framerate)
+                        .set_rotation(webrtc::kVideoRotation_0)
+                        .build();
+                    const std::vector<webrtc::VideoFrameType> frameTypes = {
+                        i == 0 ? webrtc::VideoFrameType::kVideoFrameKey : webrtc::VideoFrameType::kVideoFrameDelta
+                    };
+                    encoder->Encode(frame, &frameTypes);
+                }
+                encoder->Release();
+                decoder->Release();
+                ASSERT_NE(nullptr, loop.m_decoded);
+
+                const auto& decoded = loop.m_decoded;
+                printf("%-9s %-7s %5d kbps %8zu bytes PSNR Y %6.2f U %6.2f V %6.2f\n",
+                    imageName, chromaNames[static_cast<int>(chromaSubsampling)], bitrateKbps, loop.m_encodedBytes,
+                    PlanePSNR(reference.y.data(), width, decoded->DataY(), decoded->StrideY(), width, height),
+                    PlanePSNR(reference.u.data(), width, decoded->DataU(), decoded->StrideU(), width, height, 1),
+                    PlanePSNR(reference.v.data(), width, decoded->DataV(), decoded->StrideV(), width, height, 1));
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(ImageSizes, ConvertRGBToI420Test, testing::Values(
+    std::tuple<int, int>(1, 1),
+    std::tuple<int, int>(17, 3),
+    std::tuple<int, int>(64, 64),
+    std::tuple<int, int>(257, 129),
+    std::tuple<int, int>(1280, 720),
+    std::tuple<int, int>(1921, 1081)));
+
+} // end namespace webrtc
+} // end namespace unity
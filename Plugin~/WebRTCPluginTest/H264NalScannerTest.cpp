@@ -0,0 +1,312 @@
+#include "pch.h"
+#include <chrono>
+#include <functional>
+#include <random>
+#include "rtc_base/bit_buffer.h"
+#include "rtc_base/buffer.h"
+#include "../WebRTCPlugin/Codec/H264NalScanner.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace webrtc = ::webrtc;
+
+namespace
+{
+    const uint8_t kStartCode[] = { 0x00, 0x00, 0x00, 0x01 };
+
+    // Writes the bitstream of a constrained baseline stream with the structure of the one NVENC produces:
+    // the parameter sets and an IDR frame, then P frames, each frame split into slices.
+    // The H.264 encoder is not built in WebRTC, so the slice data is random bytes after a valid slice header.
+    class H264FixtureWriter
+    {
+    public:
+        H264FixtureWriter(int width, int height) : m_width(width), m_height(height), m_random(0) {}
+
+        std::vector<uint8_t> WriteFrame(bool idr, int sliceCount, size_t sliceSize, int qpDelta)
+        {
+            std::vector<uint8_t> frame;
+            if (idr)
+            {
+                m_frameNum = 0;
+                WriteNalu(frame, 0x67, WriteSps(), 0);
+                WriteNalu(frame, 0x68, WritePps(), 0);
+            }
+            const int mbCount = ((m_width + 15) / 16) * ((m_height + 15) / 16);
+            for (int i = 0; i < sliceCount; i++)
+            {
+                const uint8_t header = idr ? 0x65 : 0x41;
+                WriteNalu(frame, header, WriteSliceHeader(idr, mbCount * i / sliceCount, qpDelta), sliceSize);
+            }
+            m_frameNum = (m_frameNum + 1) % 16;
+            return frame;
+        }
+
+    private:
+        std::vector<uint8_t> WriteSps()
+        {
+            uint8_t bytes[32] = {};
+            rtc::BitBufferWriter writer(bytes, sizeof(bytes));
+            writer.WriteUInt8(66); // profile_idc
+            writer.WriteUInt8(0xC0); // constraint flags
+            writer.WriteUInt8(40); // level_idc
+            writer.WriteExponentialGolomb(0); // seq_parameter_set_id
+            writer.WriteExponentialGolomb(0); // log2_max_frame_num_minus4
+            writer.WriteExponentialGolomb(2); // pic_order_cnt_type
+            writer.WriteExponentialGolomb(1); // max_num_ref_frames
+            writer.WriteBits(0, 1); // gaps_in_frame_num_value_allowed_flag
+            writer.WriteExponentialGolomb((m_width + 15) / 16 - 1);
+            writer.WriteExponentialGolomb((m_height + 15) / 16 - 1);
+            writer.WriteBits(1, 1); // frame_mbs_only_flag
+            writer.WriteBits(1, 1); // direct_8x8_inference_flag
+            writer.WriteBits(0, 1); // frame_cropping_flag
+            writer.WriteBits(0, 1); // vui_parameters_present_flag
+            return Finish(writer, bytes);
+        }
+
+        std::vector<uint8_t> WritePps()
+        {
+            uint8_t bytes[32] = {};
+            rtc::BitBufferWriter writer(bytes, sizeof(bytes));
+            writer.WriteExponentialGolomb(0); // pic_parameter_set_id
+            writer.WriteExponentialGolomb(0); // seq_parameter_set_id
+            writer.WriteBits(0, 1); // entropy_coding_mode_flag
+            writer.WriteBits(0, 1); // bottom_field_pic_order_in_frame_present_flag
+            writer.WriteExponentialGolomb(0); // num_slice_groups_minus1
+            writer.WriteExponentialGolomb(0); // num_ref_idx_l0_default_active_minus1
+            writer.WriteExponentialGolomb(0); // num_ref_idx_l1_default_active_minus1
+            writer.WriteBits(0, 1); // weighted_pred_flag
+            writer.WriteBits(0, 2); // weighted_bipred_idc
+            writer.WriteSignedExponentialGolomb(0); // pic_init_qp_minus26
+            writer.WriteSignedExponentialGolomb(0); // pic_init_qs_minus26
+            writer.WriteSignedExponentialGolomb(0); // chroma_qp_index_offset
+            writer.WriteBits(1, 1); // deblocking_filter_control_present_flag
+            writer.WriteBits(0, 1); // constrained_intra_pred_flag
+            writer.WriteBits(0, 1); // redundant_pic_cnt_present_flag
+            return Finish(writer, bytes);
+        }
+
+        std::vector<uint8_t> WriteSliceHeader(bool idr, int firstMb, int qpDelta)
+        {
+            uint8_t bytes[32] = {};
+            rtc::BitBufferWriter writer(bytes, sizeof(bytes));
+            writer.WriteExponentialGolomb(firstMb);
+            writer.WriteExponentialGolomb(idr ? 7 : 5); // slice_type, I or P
+            writer.WriteExponentialGolomb(0); // pic_parameter_set_id
+            writer.WriteBits(m_frameNum, 4); // frame_num
+            if (idr)
+            {
+                writer.WriteExponentialGolomb(0); // idr_pic_id
+            }
+            else
+            {
+                writer.WriteBits(0, 1); // num_ref_idx_active_override_flag
+                writer.WriteBits(0, 1); // ref_pic_list_modification_flag_l0
+            }
+            if (idr)
+            {
+                writer.WriteBits(0, 1); // no_output_of_prior_pics_flag
+                writer.WriteBits(0, 1); // long_term_reference_flag
+            }
+            else
+            {
+                writer.WriteBits(0, 1); // adaptive_ref_pic_marking_mode_flag
+            }
+            writer.WriteSignedExponentialGolomb(qpDelta); // slice_qp_delta
+            writer.WriteExponentialGolomb(0); // disable_deblocking_filter_idc
+            writer.WriteSignedExponentialGolomb(0); // slice_alpha_c0_offset_div2
+            writer.WriteSignedExponentialGolomb(0); // slice_beta_offset_div2
+            return Finish(writer, bytes);
+        }
+
+        std::vector<uint8_t> Finish(rtc::BitBufferWriter& writer, const uint8_t* bytes)
+        {
+            size_t byteOffset = 0;
+            size_t bitOffset = 0;
+            writer.GetCurrentOffset(&byteOffset, &bitOffset);
+            // rbsp_stop_one_bit, then the bytes are aligned with zero bits.
+            writer.WriteBits(1, 1);
+            return std::vector<uint8_t>(bytes, bytes + byteOffset + 1);
+        }
+
+        void WriteNalu(std::vector<uint8_t>& frame, uint8_t header, const std::vector<uint8_t>& rbsp, size_t dataSize)
+        {
+            std::uniform_int_distribution<int> dist(0, 255);
+            std::vector<uint8_t> payload = rbsp;
+            for (size_t i = 0; i < dataSize; i++)
+            {
+                payload.push_back(static_cast<uint8_t>(dist(m_random)));
+            }
+            rtc::Buffer escaped;
+            webrtc::H264::WriteRbsp(payload.data(), payload.size(), &escaped);
+            // The first NAL unit of a frame has the long start code.
+            const size_t startCodeSize = frame.empty() ? 4 : 3;
+            frame.insert(frame.end(), std::end(kStartCode) - startCodeSize, std::end(kStartCode));
+            frame.push_back(header);
+            frame.insert(frame.end(), escaped.data(), escaped.data() + escaped.size());
+        }
+
+        int m_width;
+        int m_height;
+        int m_frameNum = 0;
+        std::mt19937 m_random;
+    };
+
+    // The three passes over the bitstream which the scanner replaces.
+    struct ThreePassResult
+    {
+        std::vector<webrtc::H264::NaluIndex> nalus;
+        bool keyFrame = false;
+        int qp = -1;
+    };
+
+    ThreePassResult ScanThreePasses(webrtc::H264BitstreamParser& parser, const std::vector<uint8_t>& frame)
+    {
+        ThreePassResult result;
+        result.nalus = webrtc::H264::FindNaluIndices(frame.data(), frame.size());
+        for (const auto& nalu : result.nalus)
+        {
+            if (webrtc::H264::ParseNaluType(frame[nalu.payload_start_offset]) == webrtc::H264::kIdr)
+            {
+                result.keyFrame = true;
+                break;
+            }
+        }
+        parser.ParseBitstream(frame.data(), frame.size());
+        parser.GetLastSliceQp(&result.qp);
+        return result;
+    }
+
+    std::vector<std::vector<uint8_t>> CreateFixture(int width, int height, int frameCount, int sliceCount,
+        size_t idrSliceSize, size_t sliceSize)
+    {
+        H264FixtureWriter writer(width, height);
+        std::vector<std::vector<uint8_t>> frames;
+        for (int i = 0; i < frameCount; i++)
+        {
+            const bool idr = i % 30 == 0;
+            frames.push_back(writer.WriteFrame(idr, sliceCount, idr ? idrSliceSize : sliceSize, i % 7 - 3));
+        }
+        return frames;
+    }
+} // namespace
+
+TEST(H264NalScannerTest, FindsSameNaluIndicesAsWebRTC)
+{
+    std::mt19937 random(0);
+    // Mostly the bytes of start codes, so that they appear at every offset.
+    std::discrete_distribution<int> dist({ 4, 2, 1 });
+    std::vector<webrtc::H264::NaluIndex> indices;
+    for (int i = 0; i < 10000; i++)
+    {
+        std::vector<uint8_t> data(random() % 80);
+        for (auto& value : data)
+        {
+            const int kind = dist(random);
+            value = kind == 0 ? 0 : kind == 1 ? 1 : static_cast<uint8_t>(random());
+        }
+        const auto expected = webrtc::H264::FindNaluIndices(data.data(), data.size());
+        for (const bool useSimd : { false, true })
+        {
+            H264NalScanner::FindNaluIndices(data.data(), data.size(), &indices, useSimd);
+            ASSERT_EQ(expected.size(), indices.size());
+            for (size_t j = 0; j < expected.size(); j++)
+            {
+                EXPECT_EQ(expected[j].start_offset, indices[j].start_offset);
+                EXPECT_EQ(expected[j].payload_start_offset, indices[j].payload_start_offset);
+                EXPECT_EQ(expected[j].payload_size, indices[j].payload_size);
+            }
+        }
+    }
+}
+
+TEST(H264NalScannerTest, MatchesThreePasses)
+{
+    const auto frames = CreateFixture(640, 360, 40, 4, 2000, 300);
+    H264NalScanner scanner;
+    webrtc::H264BitstreamParser parser;
+    webrtc::RTPFragmentationHeader fragmentation;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const auto& frame = frames[i];
+        const ThreePassResult expected = ScanThreePasses(parser, frame);
+        ASSERT_TRUE(scanner.Scan(frame.data(), frame.size(), &fragmentation));
+
+        EXPECT_EQ(i % 30 == 0, scanner.IsKeyFrame());
+        EXPECT_EQ(expected.keyFrame, scanner.IsKeyFrame());
+        ASSERT_EQ(expected.nalus.size(), fragmentation.fragmentationVectorSize);
+        for (size_t j = 0; j < expected.nalus.size(); j++)
+        {
+            EXPECT_EQ(expected.nalus[j].payload_start_offset, fragmentation.fragmentationOffset[j]);
+            EXPECT_EQ(expected.nalus[j].payload_size, fragmentation.fragmentationLength[j]);
+        }
+        int qp = -1;
+        EXPECT_TRUE(scanner.GetLastSliceQp(&qp));
+        EXPECT_EQ(26 + static_cast<int>(i % 7) - 3, qp);
+        EXPECT_EQ(expected.qp, qp);
+    }
+}
+
+TEST(H264NalScannerTest, NoNalu)
+{
+    H264NalScanner scanner;
+    webrtc::RTPFragmentationHeader fragmentation;
+    const uint8_t data[] = { 0x00, 0x00, 0x01 };
+    EXPECT_FALSE(scanner.Scan(data, 0, &fragmentation));
+    EXPECT_FALSE(scanner.Scan(data, sizeof(data), &fragmentation));
+    EXPECT_EQ(0, fragmentation.fragmentationVectorSize);
+    EXPECT_FALSE(scanner.IsKeyFrame());
+    int qp = -1;
+    EXPECT_FALSE(scanner.GetLastSliceQp(&qp));
+}
+
+// Compares the scanner with the three passes over 1080p sized frames.
+// Run with --gtest_also_run_disabled_tests.
+TEST(H264NalScannerTest, DISABLED_ScanBenchmark)
+{
+    const auto frames = CreateFixture(1920, 1080, 300, 4, 40000, 5000);
+    const int iterations = 10;
+    size_t totalSize = 0;
+    for (const auto& frame : frames)
+    {
+        totalSize += frame.size();
+    }
+
+    webrtc::H264BitstreamParser parser;
+    H264NalScanner scanner;
+    webrtc::RTPFragmentationHeader fragmentation;
+    std::vector<webrtc::H264::NaluIndex> indices;
+    const std::pair<const char*, std::function<void(const std::vector<uint8_t>&)>> cases[] = {
+        { "Three passes", [&](const std::vector<uint8_t>& frame) { ScanThreePasses(parser, frame); } },
+        { "Scan", [&](const std::vector<uint8_t>& frame) { scanner.Scan(frame.data(), frame.size(), &fragmentation); } },
+        { "Find WebRTC", [&](const std::vector<uint8_t>& frame) { webrtc::H264::FindNaluIndices(frame.data(), frame.size()); } },
+        { "Find C", [&](const std::vector<uint8_t>& frame)
+            { H264NalScanner::FindNaluIndices(frame.data(), frame.size(), &indices, false); } },
+        { "Find SIMD", [&](const std::vector<uint8_t>& frame)
+            { H264NalScanner::FindNaluIndices(frame.data(), frame.size(), &indices, true); } },
+    };
+
+    double threePassesUs = 0;
+    for (const auto& benchmark : cases)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            for (const auto& frame : frames)
+            {
+                benchmark.second(frame);
+            }
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        const double us = elapsed.count() / (iterations * frames.size());
+        if (threePassesUs == 0)
+            threePassesUs = us;
+        printf("%-12s %8.2f us/frame %8.1f MB/s x%.2f\n", benchmark.first, us,
+            totalSize * iterations / elapsed.count(), threePassesUs / us);
+    }
+}
+
+} // end namespace webrtc
+} // end namespace unity
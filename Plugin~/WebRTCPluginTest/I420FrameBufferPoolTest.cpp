@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "../WebRTCPlugin/GraphicsDevice/GraphicsUtility.h"
+#include "../WebRTCPlugin/GraphicsDevice/I420FrameBufferPool.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+TEST(I420FrameBufferPoolTest, ReusesReleasedBuffer)
+{
+    I420FrameBufferPool pool;
+    const ::webrtc::I420Buffer* first = nullptr;
+    {
+        const auto buffer = pool.CreateBuffer(320, 240);
+        first = buffer.get();
+        EXPECT_EQ(320, buffer->width());
+        EXPECT_EQ(240, buffer->height());
+    }
+    const auto buffer = pool.CreateBuffer(320, 240);
+    EXPECT_EQ(first, buffer.get());
+    EXPECT_EQ(1u, pool.GetHitCount());
+    EXPECT_EQ(1u, pool.GetMissCount());
+}
+
+TEST(I420FrameBufferPoolTest, DoesNotReuseBufferInUse)
+{
+    I420FrameBufferPool pool;
+    const auto buffer1 = pool.CreateBuffer(320, 240);
+    const auto buffer2 = pool.CreateBuffer(320, 240);
+    EXPECT_NE(buffer1.get(), buffer2.get());
+    EXPECT_EQ(0u, pool.GetHitCount());
+    EXPECT_EQ(2u, pool.GetMissCount());
+}
+
+TEST(I420FrameBufferPoolTest, KeyedByResolution)
+{
+    I420FrameBufferPool pool;
+    pool.CreateBuffer(320, 240);
+    const auto buffer = pool.CreateBuffer(640, 480);
+    EXPECT_EQ(640, buffer->width());
+    EXPECT_EQ(480, buffer->height());
+    pool.CreateBuffer(320, 240);
+    EXPECT_EQ(1u, pool.GetHitCount());
+    EXPECT_EQ(2u, pool.GetMissCount());
+    EXPECT_EQ(2u, pool.GetBufferCount());
+}
+
+TEST(I420FrameBufferPoolTest, LimitsPooledBuffers)
+{
+    I420FrameBufferPool pool(2);
+    std::vector<rtc::scoped_refptr<::webrtc::I420Buffer>> buffers;
+    for (int i = 0; i < 3; i++)
+    {
+        buffers.push_back(pool.CreateBuffer(320, 240));
+    }
+    EXPECT_EQ(2u, pool.GetBufferCount());
+    buffers.clear();
+    pool.Release();
+    EXPECT_EQ(0u, pool.GetBufferCount());
+}
+
+TEST(I420FrameBufferPoolTest, SteadyStateConversionDoesNotAllocate)
+{
+    const int width = 256;
+    const int height = 128;
+    const std::vector<uint8_t> image(width * height * 4, 128);
+    I420FrameBufferPool pool;
+    ColorConversionOptions options;
+    options.bufferPool = &pool;
+
+    // The encoder keeps the previous frame while the next one is converted.
+    rtc::scoped_refptr<::webrtc::I420Buffer> previous;
+    for (int i = 0; i < 100; i++)
+    {
+        previous = GraphicsUtility::ConvertRGBToI420Buffer(width, height, width * 4, image.data(), options);
+    }
+    EXPECT_EQ(2u, pool.GetMissCount());
+    EXPECT_EQ(98u, pool.GetHitCount());
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,497 @@
+// Built into the tests and into the stand-in library, so it does not use the precompiled header of the plugin.
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "NvEncodeAPIStub.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+namespace
+{
+    const uint8_t kNalRefIdc = 3;
+    const uint8_t kNaluIdr = 5;
+    const uint8_t kNaluP = 1;
+    const uint8_t kNaluSps = 7;
+    const uint8_t kNaluPps = 8;
+    const uint32_t kSliceTypeP = 5;
+    const uint32_t kSliceTypeI = 7;
+    const uint32_t kMbTypeIPcm = 25;
+    const uint32_t kMaxFrameNum = 16;
+    const uint8_t kGraySample = 128;
+    // 16x16 luma and two 8x8 chroma samples.
+    const size_t kPcmSamplesPerMb = 384;
+
+    // Writes the RBSP of a NAL unit.
+    class BitWriter
+    {
+    public:
+        void WriteBits(uint32_t value, int count)
+        {
+            for (int i = count - 1; i >= 0; i--)
+            {
+                m_current = static_cast<uint8_t>((m_current << 1) | ((value >> i) & 1));
+                if (++m_bitCount == 8)
+                    Flush();
+            }
+        }
+        void WriteUe(uint32_t value)
+        {
+            const uint64_t codeNum = static_cast<uint64_t>(value) + 1;
+            int length = 0;
+            while ((codeNum >> length) > 1)
+                length++;
+            WriteBits(0, length);
+            WriteBits(static_cast<uint32_t>(codeNum), length + 1);
+        }
+        void WriteSe(int32_t value)
+        {
+            WriteUe(value > 0 ? static_cast<uint32_t>(value) * 2 - 1 : static_cast<uint32_t>(-value) * 2);
+        }
+        void AlignWithZeros()
+        {
+            while (m_bitCount != 0)
+                WriteBits(0, 1);
+        }
+        void WriteByte(uint8_t value) { m_bytes.push_back(value); }
+        void WriteTrailingBits()
+        {
+            WriteBits(1, 1);
+            AlignWithZeros();
+        }
+        const std::vector<uint8_t>& GetBytes() const { return m_bytes; }
+
+    private:
+        void Flush()
+        {
+            m_bytes.push_back(m_current);
+            m_current = 0;
+            m_bitCount = 0;
+        }
+
+        std::vector<uint8_t> m_bytes;
+        uint8_t m_current = 0;
+        int m_bitCount = 0;
+    };
+
+    // Appends a NAL unit with its start code, inserting the emulation prevention bytes.
+    void AppendNalu(std::vector<uint8_t>* output, uint8_t type, const BitWriter& rbsp)
+    {
+        const uint8_t header[] = { 0, 0, 0, 1, static_cast<uint8_t>((kNalRefIdc << 5) | type) };
+        output->insert(output->end(), std::begin(header), std::end(header));
+        int zeros = 0;
+        for (const uint8_t byte : rbsp.GetBytes())
+        {
+            if (zeros == 2 && byte <= 3)
+            {
+                output->push_back(3);
+                zeros = 0;
+            }
+            output->push_back(byte);
+            zeros = byte == 0 ? zeros + 1 : 0;
+        }
+    }
+
+    std::chrono::milliseconds GetLatencyFromEnvironment(const char* name)
+    {
+        const char* value = std::getenv(name);
+        return std::chrono::milliseconds(value != nullptr ? std::atoi(value) : 0);
+    }
+}
+
+struct NvEncodeAPIStub::Session
+{
+    explicit Session(NvEncodeAPIStub* stub) : stub(stub) {}
+
+    NvEncodeAPIStub* stub;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Set by the initialization, the reconfigurations cannot exceed them.
+    uint32_t maxWidth = 0;
+    uint32_t maxHeight = 0;
+    // 0 when only the first frame and the forced frames are IDR frames.
+    uint32_t idrPeriod = 0;
+    uint32_t framesSinceIdr = 0;
+    uint32_t frameNum = 0;
+    uint32_t idrPicId = 0;
+    bool forceIdr = true;
+};
+
+std::atomic<NvEncodeAPIStub*> NvEncodeAPIStub::s_current{ nullptr };
+
+NvEncodeAPIStub::NvEncodeAPIStub()
+{
+    m_functionList.nvEncOpenEncodeSessionEx = OpenEncodeSessionEx;
+    m_functionList.nvEncGetEncodePresetConfig = GetEncodePresetConfig;
+    m_functionList.nvEncGetEncodeCaps = GetEncodeCaps;
+    m_functionList.nvEncInitializeEncoder = InitializeEncoder;
+    m_functionList.nvEncReconfigureEncoder = ReconfigureEncoder;
+    m_functionList.nvEncRegisterResource = RegisterResource;
+    m_functionList.nvEncUnregisterResource = UnregisterResource;
+    m_functionList.nvEncMapInputResource = MapInputResource;
+    m_functionList.nvEncUnmapInputResource = UnmapInputResource;
+    m_functionList.nvEncCreateBitstreamBuffer = CreateBitstreamBuffer;
+    m_functionList.nvEncDestroyBitstreamBuffer = DestroyBitstreamBuffer;
+    m_functionList.nvEncRegisterAsyncEvent = RegisterAsyncEvent;
+    m_functionList.nvEncUnregisterAsyncEvent = UnregisterAsyncEvent;
+    m_functionList.nvEncEncodePicture = EncodePicture;
+    m_functionList.nvEncLockBitstream = LockBitstream;
+    m_functionList.nvEncUnlockBitstream = UnlockBitstream;
+    m_functionList.nvEncDestroyEncoder = DestroyEncoder;
+    m_previous = s_current.exchange(this);
+}
+
+NvEncodeAPIStub::~NvEncodeAPIStub()
+{
+    s_current = m_previous;
+}
+
+NvEncodeAPIStub& NvEncodeAPIStub::GetDefault()
+{
+    static NvEncodeAPIStub* stub = []
+    {
+        NvEncodeAPIStub* defaultStub = new NvEncodeAPIStub();
+        defaultStub->SetEncodeLatency(GetLatencyFromEnvironment("NVENC_STUB_ENCODE_LATENCY_MS"));
+        defaultStub->SetLockLatency(GetLatencyFromEnvironment("NVENC_STUB_LOCK_LATENCY_MS"));
+        return defaultStub;
+    }();
+    return *stub;
+}
+
+NvEncodeAPIStub& NvEncodeAPIStub::GetCurrent()
+{
+    NvEncodeAPIStub* current = s_current;
+    return current != nullptr ? *current : GetDefault();
+}
+
+void NvEncodeAPIStub::InjectFailure(NvEncodeAPIStubFunction function, NVENCSTATUS status, int count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failures[function] = std::make_pair(status, count);
+}
+
+bool NvEncodeAPIStub::TakeFailure(NvEncodeAPIStubFunction function, NVENCSTATUS* status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto failure = m_failures.find(function);
+    if (failure == m_failures.end() || failure->second.second <= 0)
+        return false;
+    *status = failure->second.first;
+    failure->second.second--;
+    return true;
+}
+
+bool NvEncodeAPIStub::HasLockedOnThread(std::thread::id id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::find(m_lockThreads.begin(), m_lockThreads.end(), id) != m_lockThreads.end();
+}
+
+void NvEncodeAPIStub::Configure(Session* session, const NV_ENC_INITIALIZE_PARAMS* params)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    session->width = params->encodeWidth;
+    session->height = params->encodeHeight;
+    session->idrPeriod = 0;
+    if (params->encodeConfig != nullptr)
+    {
+        m_averageBitRate = params->encodeConfig->rcParams.averageBitRate;
+        // Like the driver, the IDR period applies whatever the GOP length is.
+        const uint32_t idrPeriod = params->encodeConfig->encodeCodecConfig.h264Config.idrPeriod;
+        if (idrPeriod != NVENC_INFINITE_GOPLENGTH)
+            session->idrPeriod = idrPeriod;
+    }
+    m_frameRate = params->frameRateDen != 0 ? params->frameRateNum / params->frameRateDen : 0;
+}
+
+NVENCSTATUS NvEncodeAPIStub::OpenEncodeSessionEx(NV_ENC_OPEN_ENCODE_SESSION_EX_PARAMS* params, void** encoder)
+{
+    NvEncodeAPIStub& stub = GetCurrent();
+    NVENCSTATUS status;
+    if (stub.TakeFailure(NvEncodeAPIStubFunction::OpenEncodeSession, &status))
+        return status;
+    *encoder = new Session(&stub);
+    stub.m_openSessions++;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::GetEncodePresetConfig(void* encoder, GUID encodeGUID, GUID presetGUID, NV_ENC_PRESET_CONFIG* presetConfig)
+{
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::GetEncodeCaps(void* encoder, GUID encodeGUID, NV_ENC_CAPS_PARAM* capsParam, int* capsVal)
+{
+    // The stub has no completion events.
+    *capsVal = 0;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::InitializeEncoder(void* encoder, NV_ENC_INITIALIZE_PARAMS* params)
+{
+    Session* session = static_cast<Session*>(encoder);
+    NVENCSTATUS status;
+    if (session->stub->TakeFailure(NvEncodeAPIStubFunction::InitializeEncoder, &status))
+        return status;
+    session->maxWidth = std::max(params->maxEncodeWidth, params->encodeWidth);
+    session->maxHeight = std::max(params->maxEncodeHeight, params->encodeHeight);
+    session->stub->Configure(session, params);
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::ReconfigureEncoder(void* encoder, NV_ENC_RECONFIGURE_PARAMS* params)
+{
+    Session* session = static_cast<Session*>(encoder);
+    NVENCSTATUS status;
+    if (session->stub->TakeFailure(NvEncodeAPIStubFunction::ReconfigureEncoder, &status))
+        return status;
+    if (params->reInitEncodeParams.encodeWidth > session->maxWidth ||
+        params->reInitEncodeParams.encodeHeight > session->maxHeight)
+        return NV_ENC_ERR_INVALID_PARAM;
+    session->stub->Configure(session, &params->reInitEncodeParams);
+    if (params->forceIDR)
+    {
+        std::lock_guard<std::mutex> lock(session->stub->m_mutex);
+        session->forceIdr = true;
+    }
+    session->stub->m_reconfigures++;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::RegisterResource(void* encoder, NV_ENC_REGISTER_RESOURCE* params)
+{
+    params->registeredResource = params->resourceToRegister;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::UnregisterResource(void* encoder, NV_ENC_REGISTERED_PTR registeredResource)
+{
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::MapInputResource(void* encoder, NV_ENC_MAP_INPUT_RESOURCE* params)
+{
+    params->mappedResource = params->registeredResource;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::UnmapInputResource(void* encoder, NV_ENC_INPUT_PTR mappedInputBuffer)
+{
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::CreateBitstreamBuffer(void* encoder, NV_ENC_CREATE_BITSTREAM_BUFFER* params)
+{
+    params->bitstreamBuffer = new Bitstream();
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::DestroyBitstreamBuffer(void* encoder, NV_ENC_OUTPUT_PTR bitstreamBuffer)
+{
+    delete static_cast<Bitstream*>(bitstreamBuffer);
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::RegisterAsyncEvent(void* encoder, NV_ENC_EVENT_PARAMS* params)
+{
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::UnregisterAsyncEvent(void* encoder, NV_ENC_EVENT_PARAMS* params)
+{
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::EncodePicture(void* encoder, NV_ENC_PIC_PARAMS* picParams)
+{
+    Session* session = static_cast<Session*>(encoder);
+    NvEncodeAPIStub* stub = session->stub;
+    std::this_thread::sleep_for(stub->m_encodeLatency.load());
+    NVENCSTATUS status;
+    if (stub->TakeFailure(NvEncodeAPIStubFunction::EncodePicture, &status))
+        return status;
+
+    std::lock_guard<std::mutex> lock(stub->m_mutex);
+    const bool idr = session->forceIdr || (picParams->encodePicFlags & NV_ENC_PIC_FLAG_FORCEIDR) != 0 ||
+        (session->idrPeriod != 0 && session->framesSinceIdr >= session->idrPeriod);
+    if (idr)
+    {
+        session->forceIdr = false;
+        session->framesSinceIdr = 0;
+        session->frameNum = 0;
+        session->idrPicId = (session->idrPicId + 1) % 2;
+    }
+
+    const uint32_t widthInMbs = (session->width + 15) / 16;
+    const uint32_t heightInMbs = (session->height + 15) / 16;
+    std::vector<uint8_t> data;
+    if (idr)
+    {
+        BitWriter sps;
+        sps.WriteBits(66, 8);     // profile_idc: baseline
+        sps.WriteBits(0xC0, 8);   // constraint_set0_flag, constraint_set1_flag
+        sps.WriteBits(51, 8);     // level_idc
+        sps.WriteUe(0);           // seq_parameter_set_id
+        sps.WriteUe(0);           // log2_max_frame_num_minus4
+        sps.WriteUe(2);           // pic_order_cnt_type
+        sps.WriteUe(1);           // max_num_ref_frames
+        sps.WriteBits(0, 1);      // gaps_in_frame_num_value_allowed_flag
+        sps.WriteUe(widthInMbs - 1);
+        sps.WriteUe(heightInMbs - 1);
+        sps.WriteBits(1, 1);      // frame_mbs_only_flag
+        sps.WriteBits(1, 1);      // direct_8x8_inference_flag
+        const uint32_t cropRight = (widthInMbs * 16 - session->width) / 2;
+        const uint32_t cropBottom = (heightInMbs * 16 - session->height) / 2;
+        const bool cropping = cropRight != 0 || cropBottom != 0;
+        sps.WriteBits(cropping ? 1 : 0, 1);
+        if (cropping)
+        {
+            sps.WriteUe(0);
+            sps.WriteUe(cropRight);
+            sps.WriteUe(0);
+            sps.WriteUe(cropBottom);
+        }
+        sps.WriteBits(0, 1);      // vui_parameters_present_flag
+        sps.WriteTrailingBits();
+        AppendNalu(&data, kNaluSps, sps);
+
+        BitWriter pps;
+        pps.WriteUe(0);           // pic_parameter_set_id
+        pps.WriteUe(0);           // seq_parameter_set_id
+        pps.WriteBits(0, 1);      // entropy_coding_mode_flag
+        pps.WriteBits(0, 1);      // bottom_field_pic_order_in_frame_present_flag
+        pps.WriteUe(0);           // num_slice_groups_minus1
+        pps.WriteUe(0);           // num_ref_idx_l0_default_active_minus1
+        pps.WriteUe(0);           // num_ref_idx_l1_default_active_minus1
+        pps.WriteBits(0, 1);      // weighted_pred_flag
+        pps.WriteBits(0, 2);      // weighted_bipred_idc
+        pps.WriteSe(0);           // pic_init_qp_minus26
+        pps.WriteSe(0);           // pic_init_qs_minus26
+        pps.WriteSe(0);           // chroma_qp_index_offset
+        pps.WriteBits(1, 1);      // deblocking_filter_control_present_flag
+        pps.WriteBits(0, 1);      // constrained_intra_pred_flag
+        pps.WriteBits(0, 1);      // redundant_pic_cnt_present_flag
+        pps.WriteTrailingBits();
+        AppendNalu(&data, kNaluPps, pps);
+    }
+
+    BitWriter slice;
+    slice.WriteUe(0);             // first_mb_in_slice
+    slice.WriteUe(idr ? kSliceTypeI : kSliceTypeP);
+    slice.WriteUe(0);             // pic_parameter_set_id
+    slice.WriteBits(session->frameNum, 4);
+    if (idr)
+    {
+        slice.WriteUe(session->idrPicId);
+    }
+    else
+    {
+        slice.WriteBits(0, 1);    // num_ref_idx_active_override_flag
+        slice.WriteBits(0, 1);    // ref_pic_list_modification_flag_l0
+    }
+    if (idr)
+    {
+        slice.WriteBits(0, 1);    // no_output_of_prior_pics_flag
+        slice.WriteBits(0, 1);    // long_term_reference_flag
+    }
+    else
+    {
+        slice.WriteBits(0, 1);    // adaptive_ref_pic_marking_mode_flag
+    }
+    slice.WriteSe(stub->m_sliceQp - 26);
+    slice.WriteUe(1);             // disable_deblocking_filter_idc
+    const uint32_t mbCount = widthInMbs * heightInMbs;
+    if (idr)
+    {
+        for (uint32_t i = 0; i < mbCount; i++)
+        {
+            slice.WriteUe(kMbTypeIPcm);
+            slice.AlignWithZeros();
+            for (size_t j = 0; j < kPcmSamplesPerMb; j++)
+            {
+                slice.WriteByte(kGraySample);
+            }
+        }
+    }
+    else
+    {
+        slice.WriteUe(mbCount);   // mb_skip_run
+    }
+    slice.WriteTrailingBits();
+    AppendNalu(&data, idr ? kNaluIdr : kNaluP, slice);
+
+    session->framesSinceIdr++;
+    session->frameNum = (session->frameNum + 1) % kMaxFrameNum;
+
+    Bitstream* bitstream = static_cast<Bitstream*>(picParams->outputBitstream);
+    if (bitstream->pending)
+        stub->m_reusedPendingBitstream = true;
+    bitstream->pending = true;
+    bitstream->data = std::move(data);
+    stub->m_encodedPictures++;
+    if (idr)
+        stub->m_idrPictures++;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::LockBitstream(void* encoder, NV_ENC_LOCK_BITSTREAM* lockBitstreamBufferParams)
+{
+    NvEncodeAPIStub* stub = static_cast<Session*>(encoder)->stub;
+    std::this_thread::sleep_for(stub->m_lockLatency.load());
+    NVENCSTATUS status;
+    if (stub->TakeFailure(NvEncodeAPIStubFunction::LockBitstream, &status))
+    {
+        // The frame is lost, as when the driver fails to encode it.
+        std::lock_guard<std::mutex> lock(stub->m_mutex);
+        static_cast<Bitstream*>(lockBitstreamBufferParams->outputBitstream)->pending = false;
+        return status;
+    }
+    Bitstream* bitstream = static_cast<Bitstream*>(lockBitstreamBufferParams->outputBitstream);
+    {
+        std::lock_guard<std::mutex> lock(stub->m_mutex);
+        stub->m_lockThreads.push_back(std::this_thread::get_id());
+        lockBitstreamBufferParams->bitstreamBufferPtr = bitstream->data.data();
+        lockBitstreamBufferParams->bitstreamSizeInBytes = static_cast<uint32_t>(bitstream->data.size());
+    }
+    stub->m_lockedBitstreams++;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::UnlockBitstream(void* encoder, NV_ENC_OUTPUT_PTR bitstreamBuffer)
+{
+    NvEncodeAPIStub* stub = static_cast<Session*>(encoder)->stub;
+    {
+        std::lock_guard<std::mutex> lock(stub->m_mutex);
+        static_cast<Bitstream*>(bitstreamBuffer)->pending = false;
+    }
+    stub->m_unlockedBitstreams++;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NvEncodeAPIStub::DestroyEncoder(void* encoder)
+{
+    Session* session = static_cast<Session*>(encoder);
+    session->stub->m_openSessions--;
+    delete session;
+    return NV_ENC_SUCCESS;
+}
+
+} // end namespace webrtc
+} // end namespace unity
+
+// Entry points of the stand-in library, which the plugin looks up after loading it.
+NVENCSTATUS NVENCAPI NvEncodeAPIGetMaxSupportedVersion(uint32_t* version)
+{
+    *version = (NVENCAPI_MAJOR_VERSION << 4) | NVENCAPI_MINOR_VERSION;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI NvEncodeAPICreateInstance(NV_ENCODE_API_FUNCTION_LIST* functionList)
+{
+    if (functionList->version != NV_ENCODE_API_FUNCTION_LIST_VER)
+        return NV_ENC_ERR_INVALID_VERSION;
+    *functionList = unity::webrtc::NvEncodeAPIStub::GetCurrent().GetFunctionList();
+    return NV_ENC_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../WebRTCPlugin/Codec/NvCodec/nvEncodeAPI.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Functions of the stub which can be made to fail.
+enum class NvEncodeAPIStubFunction
+{
+    OpenEncodeSession,
+    InitializeEncoder,
+    ReconfigureEncoder,
+    EncodePicture,
+    LockBitstream
+};
+
+// Stands in for the NVENC driver, so that NvEncoder runs without a GPU.
+// Each picture is a valid H.264 baseline frame: an IDR frame of gray I_PCM macroblocks preceded by
+// the parameter sets, or a P frame whose macroblocks are all skipped.
+//
+// The tests install the function table of a stub with NvEncoder::OverrideFunctionList. The same source
+// is also built as libnvidia-encode.so.1, which the plugin loads instead of the driver when it is found first
+// in LD_LIBRARY_PATH. The library is configured with the environment variables NVENC_STUB_ENCODE_LATENCY_MS
+// and NVENC_STUB_LOCK_LATENCY_MS.
+class NvEncodeAPIStub
+{
+public:
+    // The sessions which are opened while the stub is alive belong to it.
+    NvEncodeAPIStub();
+    ~NvEncodeAPIStub();
+
+    const NV_ENCODE_API_FUNCTION_LIST& GetFunctionList() const { return m_functionList; }
+
+    // How long nvEncEncodePicture takes to submit a picture.
+    void SetEncodeLatency(std::chrono::milliseconds latency) { m_encodeLatency = latency; }
+    // How long nvEncLockBitstream waits for the driver.
+    void SetLockLatency(std::chrono::milliseconds latency) { m_lockLatency = latency; }
+    void SetSliceQp(int qp) { m_sliceQp = qp; }
+    // The next calls of the function return the status instead of succeeding.
+    void InjectFailure(NvEncodeAPIStubFunction function, NVENCSTATUS status, int count = 1);
+
+    int GetOpenSessionCount() const { return m_openSessions; }
+    int GetEncodedPictureCount() const { return m_encodedPictures; }
+    int GetIdrPictureCount() const { return m_idrPictures; }
+    int GetReconfigureCount() const { return m_reconfigures; }
+    int GetLockedBitstreamCount() const { return m_lockedBitstreams; }
+    int GetUnlockedBitstreamCount() const { return m_unlockedBitstreams; }
+    // The parameters of the last initialization or reconfiguration.
+    uint32_t GetAverageBitRate() const { return m_averageBitRate; }
+    uint32_t GetFrameRate() const { return m_frameRate; }
+    // Whether a bitstream buffer was submitted again before it was locked.
+    bool HasReusedPendingBitstream() const { return m_reusedPendingBitstream; }
+    // Whether the bitstream was ever locked on the thread.
+    bool HasLockedOnThread(std::thread::id id) const;
+
+    // Used by the entry points of the library when no stub is alive.
+    static NvEncodeAPIStub& GetDefault();
+    static NvEncodeAPIStub& GetCurrent();
+
+private:
+    struct Session;
+    struct Bitstream
+    {
+        std::vector<uint8_t> data;
+        bool pending = false;
+    };
+
+    bool TakeFailure(NvEncodeAPIStubFunction function, NVENCSTATUS* status);
+    void Configure(Session* session, const NV_ENC_INITIALIZE_PARAMS* params);
+
+    static NVENCSTATUS NVENCAPI OpenEncodeSessionEx(NV_ENC_OPEN_ENCODE_SESSION_EX_PARAMS* params, void** encoder);
+    static NVENCSTATUS NVENCAPI GetEncodePresetConfig(void* encoder, GUID encodeGUID, GUID presetGUID, NV_ENC_PRESET_CONFIG* presetConfig);
+    static NVENCSTATUS NVENCAPI GetEncodeCaps(void* encoder, GUID encodeGUID, NV_ENC_CAPS_PARAM* capsParam, int* capsVal);
+    static NVENCSTATUS NVENCAPI InitializeEncoder(void* encoder, NV_ENC_INITIALIZE_PARAMS* params);
+    static NVENCSTATUS NVENCAPI ReconfigureEncoder(void* encoder, NV_ENC_RECONFIGURE_PARAMS* params);
+    static NVENCSTATUS NVENCAPI RegisterResource(void* encoder, NV_ENC_REGISTER_RESOURCE* params);
+    static NVENCSTATUS NVENCAPI UnregisterResource(void* encoder, NV_ENC_REGISTERED_PTR registeredResource);
+    static NVENCSTATUS NVENCAPI MapInputResource(void* encoder, NV_ENC_MAP_INPUT_RESOURCE* params);
+    static NVENCSTATUS NVENCAPI UnmapInputResource(void* encoder, NV_ENC_INPUT_PTR mappedInputBuffer);
+    static NVENCSTATUS NVENCAPI CreateBitstreamBuffer(void* encoder, NV_ENC_CREATE_BITSTREAM_BUFFER* params);
+    static NVENCSTATUS NVENCAPI DestroyBitstreamBuffer(void* encoder, NV_ENC_OUTPUT_PTR bitstreamBuffer);
+    static NVENCSTATUS NVENCAPI RegisterAsyncEvent(void* encoder, NV_ENC_EVENT_PARAMS* params);
+    static NVENCSTATUS NVENCAPI UnregisterAsyncEvent(void* encoder, NV_ENC_EVENT_PARAMS* params);
+    static NVENCSTATUS NVENCAPI EncodePicture(void* encoder, NV_ENC_PIC_PARAMS* picParams);
+    static NVENCSTATUS NVENCAPI LockBitstream(void* encoder, NV_ENC_LOCK_BITSTREAM* lockBitstreamBufferParams);
+    static NVENCSTATUS NVENCAPI UnlockBitstream(void* encoder, NV_ENC_OUTPUT_PTR bitstreamBuffer);
+    static NVENCSTATUS NVENCAPI DestroyEncoder(void* encoder);
+
+    static std::atomic<NvEncodeAPIStub*> s_current;
+
+    NV_ENCODE_API_FUNCTION_LIST m_functionList = { NV_ENCODE_API_FUNCTION_LIST_VER };
+    NvEncodeAPIStub* m_previous;
+
+    std::atomic<std::chrono::milliseconds> m_encodeLatency{ std::chrono::milliseconds(0) };
+    std::atomic<std::chrono::milliseconds> m_lockLatency{ std::chrono::milliseconds(0) };
+    std::atomic<int> m_sliceQp{ 30 };
+
+    std::atomic<int> m_openSessions{ 0 };
+    std::atomic<int> m_encodedPictures{ 0 };
+    std::atomic<int> m_idrPictures{ 0 };
+    std::atomic<int> m_reconfigures{ 0 };
+    std::atomic<int> m_lockedBitstreams{ 0 };
+    std::atomic<int> m_unlockedBitstreams{ 0 };
+    std::atomic<uint32_t> m_averageBitRate{ 0 };
+    std::atomic<uint32_t> m_frameRate{ 0 };
+    std::atomic<bool> m_reusedPendingBitstream{ false };
+
+    mutable std::mutex m_mutex;
+    std::map<NvEncodeAPIStubFunction, std::pair<NVENCSTATUS, int>> m_failures;
+    std::vector<std::thread::id> m_lockThreads;
+};
+
+} // end namespace webrtc
+} // end namespace unity
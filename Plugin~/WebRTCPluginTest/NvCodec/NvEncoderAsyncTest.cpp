@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "StubNvEncoderTestBase.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+class NvEncoderAsyncTest : public StubNvEncoderTestBase
+{
+};
+
+TEST_F(NvEncoderAsyncTest, EncodeFrameOnlySubmits)
+{
+    ASSERT_EQ(CodecInitializationResult::Success, m_encoder->GetCodecInitializationResult());
+    EXPECT_TRUE(m_encoder->IsAsyncOutput());
+    EXPECT_FALSE(m_encoder->IsAsyncEncode());
+
+    m_stub.SetLockLatency(std::chrono::milliseconds(20));
+    for (uint32 i = 0; i < bufferedFrameNum; i++)
+    {
+        EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    EXPECT_EQ(static_cast<uint64>(bufferedFrameNum), m_encoder->GetCurrentFrameCount());
+    EXPECT_FALSE(m_stub.HasLockedOnThread(std::this_thread::get_id()));
+
+    WaitForCapturedCount(bufferedFrameNum);
+    for (const auto& frame : m_captured)
+    {
+        EXPECT_NE(std::this_thread::get_id(), frame.thread);
+    }
+}
+
+TEST_F(NvEncoderAsyncTest, CapturesFramesInSubmittedOrder)
+{
+    m_stub.SetLockLatency(std::chrono::milliseconds(2));
+    const int frameCount = 20;
+    const int firstQp = 20;
+    for (int i = 0; i < frameCount; i++)
+    {
+        // Each frame is told apart by its QP.
+        m_stub.SetSliceQp(firstQp + i);
+        // Waits for the retrieval thread when every buffer is pending.
+        EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    WaitForCapturedCount(frameCount);
+    for (int i = 0; i < frameCount; i++)
+    {
+        EXPECT_EQ(firstQp + i, m_captured[i].qp);
+    }
+    EXPECT_FALSE(m_stub.HasReusedPendingBitstream());
+    EXPECT_EQ(m_stub.GetLockedBitstreamCount(), m_stub.GetUnlockedBitstreamCount());
+}
+
+TEST_F(NvEncoderAsyncTest, SyncOutputCapturesBeforeEncodeFrameReturns)
+{
+    m_stub.SetLockLatency(std::chrono::milliseconds(20));
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    m_encoder->SetAsyncOutput(false);
+    EXPECT_FALSE(m_encoder->IsAsyncOutput());
+    // The frame submitted before is captured first.
+    EXPECT_EQ(1u, GetCapturedCount());
+
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_EQ(2u, GetCapturedCount());
+    EXPECT_EQ(std::this_thread::get_id(), m_captured.back().thread);
+    EXPECT_TRUE(m_stub.HasLockedOnThread(std::this_thread::get_id()));
+}
+
+TEST_F(NvEncoderAsyncTest, DestructorRetrievesPendingFrames)
+{
+    m_stub.SetLockLatency(std::chrono::milliseconds(20));
+    for (uint32 i = 0; i < bufferedFrameNum; i++)
+    {
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    m_encoder.reset();
+    EXPECT_EQ(static_cast<size_t>(bufferedFrameNum), GetCapturedCount());
+    EXPECT_EQ(static_cast<int>(bufferedFrameNum), m_stub.GetUnlockedBitstreamCount());
+}
+
+TEST_F(NvEncoderAsyncTest, RingDepth)
+{
+    for (const uint32 bufferCount : { 1u, 5u })
+    {
+        m_encoder.reset();
+        CreateEncoder(bufferCount);
+        ASSERT_EQ(CodecInitializationResult::Success, m_encoder->GetCodecInitializationResult());
+        EXPECT_EQ(bufferCount, m_encoder->GetBufferCount());
+        const size_t captured = GetCapturedCount();
+        for (uint32 i = 0; i < bufferCount; i++)
+        {
+            EXPECT_TRUE(m_encoder->CopyBufferAt(m_pixels.data(), i));
+            EXPECT_TRUE(m_encoder->EncodeFrameAt(i));
+        }
+        WaitForCapturedCount(captured + bufferCount);
+    }
+
+    // Out of range depths are clamped.
+    m_encoder.reset();
+    CreateEncoder(0);
+    EXPECT_EQ(1u, m_encoder->GetBufferCount());
+    m_encoder.reset();
+    CreateEncoder(maxEncoderBufferCount + 1);
+    EXPECT_EQ(maxEncoderBufferCount, m_encoder->GetBufferCount());
+}
+
+TEST_F(NvEncoderAsyncTest, SingleBufferCapturesFramesInSubmittedOrder)
+{
+    m_encoder.reset();
+    CreateEncoder(1);
+    m_stub.SetLockLatency(std::chrono::milliseconds(2));
+    const int frameCount = 10;
+    const int firstQp = 20;
+    for (int i = 0; i < frameCount; i++)
+    {
+        m_stub.SetSliceQp(firstQp + i);
+        // The only buffer is reused once the frame before has been captured.
+        EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    WaitForCapturedCount(frameCount);
+    for (int i = 0; i < frameCount; i++)
+    {
+        EXPECT_EQ(firstQp + i, m_captured[i].qp);
+    }
+    EXPECT_FALSE(m_stub.HasReusedPendingBitstream());
+}
+
+// Measures the throughput and the latency from EncodeFrame to the captured frame at each ring depth.
+TEST_F(NvEncoderAsyncTest, DISABLED_RingDepthBenchmark)
+{
+    const int frameCount = 200;
+    m_stub.SetEncodeLatency(std::chrono::milliseconds(1));
+    m_stub.SetLockLatency(std::chrono::milliseconds(4));
+    for (const uint32 bufferCount : { 1u, 2u, 3u, 4u, 6u })
+    {
+        m_encoder.reset();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_captured.clear();
+        }
+        CreateEncoder(bufferCount);
+
+        std::vector<std::chrono::steady_clock::time_point> submitted(frameCount);
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frameCount; i++)
+        {
+            m_encoder->CopyBuffer(m_pixels.data());
+            submitted[i] = std::chrono::steady_clock::now();
+            m_encoder->EncodeFrame();
+        }
+        WaitForCapturedCount(frameCount);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::chrono::duration<double, std::milli> latency(0);
+        for (int i = 0; i < frameCount; i++)
+        {
+            latency += m_captured[i].time - submitted[i];
+        }
+        printf("depth %u %8.1f fps %8.2f ms\n", bufferCount, frameCount / elapsed.count(),
+            latency.count() / frameCount);
+    }
+}
+
+} // end namespace webrtc
+} // end namespace unity
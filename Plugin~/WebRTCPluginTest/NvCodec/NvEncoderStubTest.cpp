@@ -0,0 +1,350 @@
+#include "pch.h"
+#include <chrono>
+#include "StubNvEncoderTestBase.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Keeps the textures in system memory but reports a GPU, so that the thumbnails of the scene change detection are
+// scaled on the GPU, which it can not do like D3D11, D3D12 and Metal.
+class UnscalableGraphicsDevice : public CPUGraphicsDevice
+{
+public:
+    GraphicsDeviceType GetDeviceType() const override { return GRAPHICS_DEVICE_D3D11; }
+};
+
+class NvEncoderStubTest : public StubNvEncoderTestBase
+{
+protected:
+    void SetUp() override
+    {
+        StubNvEncoderTestBase::SetUp();
+        // The tests read the frames right after they are encoded.
+        m_encoder->SetAsyncOutput(false);
+    }
+};
+
+TEST_F(NvEncoderStubTest, OpensAndDestroysSession)
+{
+    EXPECT_EQ(CodecInitializationResult::Success, m_encoder->GetCodecInitializationResult());
+    EXPECT_TRUE(m_encoder->IsSupported());
+    EXPECT_EQ(1, m_stub.GetOpenSessionCount());
+    EXPECT_EQ(30u, m_stub.GetFrameRate());
+    m_encoder.reset();
+    EXPECT_EQ(0, m_stub.GetOpenSessionCount());
+}
+
+TEST_F(NvEncoderStubTest, SessionFailures)
+{
+    m_encoder.reset();
+    m_stub.InjectFailure(NvEncodeAPIStubFunction::OpenEncodeSession, NV_ENC_ERR_NO_ENCODE_DEVICE);
+    CreateEncoder();
+    EXPECT_EQ(CodecInitializationResult::EncoderInitializationFailed, m_encoder->GetCodecInitializationResult());
+    EXPECT_FALSE(m_encoder->IsSupported());
+    m_encoder.reset();
+
+    m_stub.InjectFailure(NvEncodeAPIStubFunction::InitializeEncoder, NV_ENC_ERR_INVALID_PARAM);
+    CreateEncoder();
+    EXPECT_EQ(CodecInitializationResult::EncoderInitializationFailed, m_encoder->GetCodecInitializationResult());
+    EXPECT_FALSE(m_encoder->IsSupported());
+    EXPECT_EQ(0, m_stub.GetOpenSessionCount());
+}
+
+TEST_F(NvEncoderStubTest, EncodesKeyFrameFirst)
+{
+    m_stub.SetSliceQp(28);
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    ASSERT_EQ(3u, m_captured.size());
+    EXPECT_TRUE(m_captured[0].keyFrame);
+    EXPECT_FALSE(m_captured[1].keyFrame);
+    EXPECT_FALSE(m_captured[2].keyFrame);
+    EXPECT_EQ(28, m_captured[2].qp);
+    EXPECT_EQ(1, m_stub.GetIdrPictureCount());
+}
+
+TEST_F(NvEncoderStubTest, ForcesIdrFrame)
+{
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    m_encoder->SetIdrFrame();
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    ASSERT_EQ(3u, m_captured.size());
+    EXPECT_FALSE(m_captured[1].keyFrame);
+    EXPECT_TRUE(m_captured[2].keyFrame);
+
+    // The request is kept when the frame which should have been the key frame fails.
+    m_encoder->SetIdrFrame();
+    m_stub.InjectFailure(NvEncodeAPIStubFunction::EncodePicture, NV_ENC_ERR_ENCODER_BUSY);
+    EXPECT_FALSE(m_encoder->EncodeFrame());
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    ASSERT_EQ(4u, m_captured.size());
+    EXPECT_TRUE(m_captured[3].keyFrame);
+}
+
+TEST_F(NvEncoderStubTest, ReconfiguresRates)
+{
+    const uint32_t bitRate = 1000000;
+    m_encoder->SetRates(bitRate, 60);
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_EQ(1, m_stub.GetReconfigureCount());
+    EXPECT_EQ(bitRate, m_stub.GetAverageBitRate());
+    EXPECT_EQ(60u, m_stub.GetFrameRate());
+
+    // The settings are only sent again when they change.
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_EQ(1, m_stub.GetReconfigureCount());
+
+    // A lower estimate is applied in the same sequence.
+    m_encoder->SetRates(bitRate / 2, 60);
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_EQ(2, m_stub.GetReconfigureCount());
+    EXPECT_EQ(bitRate / 2, m_stub.GetAverageBitRate());
+    EXPECT_EQ(1, m_stub.GetIdrPictureCount());
+}
+
+TEST_F(NvEncoderStubTest, AppliesPublishedSettings)
+{
+    const auto settings = std::make_shared<EncoderSettingsPublisher>();
+    m_encoder->SetSettings(settings);
+    for (int i = 0; i < 31; i++)
+    {
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    // The period of the IDR frames is one second by default.
+    ASSERT_EQ(31u, m_captured.size());
+    EXPECT_TRUE(m_captured[30].keyFrame);
+    EXPECT_EQ(2, m_stub.GetIdrPictureCount());
+
+    EncoderSettings infinite = settings->Get();
+    infinite.infiniteGOP = true;
+    settings->Publish(infinite);
+    for (int i = 0; i < 40; i++)
+    {
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    // A new sequence starts with the settings, without another IDR frame after it.
+    EXPECT_TRUE(m_captured[31].keyFrame);
+    EXPECT_EQ(3, m_stub.GetIdrPictureCount());
+    EXPECT_EQ(1, m_stub.GetReconfigureCount());
+}
+
+// Emulates the estimates of a link whose capacity drops by half, with the noise of the estimator, and compares
+// the size of the frames with an encoder which starts a key frame at each estimate.
+TEST_F(NvEncoderStubTest, RateChangesDoNotForceKeyFrames)
+{
+    const int frameCount = 300;
+    const int frameRate = 30;
+    const int framesPerEstimate = 5;
+    auto sendFrames = [&](bool keyFrameOnRates)
+    {
+        const size_t first = m_captured.size();
+        for (int i = 0; i < frameCount; i++)
+        {
+            if (i % framesPerEstimate == 0)
+            {
+                const uint32_t capacity = i < frameCount / 2 ? 2000000 : 1000000;
+                const int noise = (i / framesPerEstimate * 7919) % 11 - 5;
+                m_encoder->SetRates(capacity + capacity / 100 * noise, frameRate);
+                if (keyFrameOnRates)
+                    m_encoder->SetIdrFrame();
+            }
+            EXPECT_TRUE(m_encoder->EncodeFrame());
+        }
+        // The variance of the bytes sent with each frame.
+        double mean = 0.0;
+        for (size_t i = first; i < m_captured.size(); i++)
+            mean += static_cast<double>(m_captured[i].size) / frameCount;
+        double variance = 0.0;
+        for (size_t i = first; i < m_captured.size(); i++)
+            variance += (m_captured[i].size - mean) * (m_captured[i].size - mean) / frameCount;
+        return variance;
+    };
+
+    const double keyFrameVariance = sendFrames(true);
+    m_encoder.reset();
+    const int idrPictures = m_stub.GetIdrPictureCount();
+    const int reconfigures = m_stub.GetReconfigureCount();
+    CreateEncoder();
+    m_encoder->SetAsyncOutput(false);
+    const double governedVariance = sendFrames(false);
+
+    // Only the periodic IDR frames are left, and the noise of the estimates does not reconfigure the session.
+    EXPECT_EQ(frameCount / frameRate, m_stub.GetIdrPictureCount() - idrPictures);
+    EXPECT_LE(m_stub.GetReconfigureCount() - reconfigures, 4);
+    // The drop of the capacity is applied right away.
+    EXPECT_GE(1050000u, m_stub.GetAverageBitRate());
+    EXPECT_LT(governedVariance, keyFrameVariance / 2);
+}
+
+TEST_F(NvEncoderStubTest, FrameFailures)
+{
+    m_stub.InjectFailure(NvEncodeAPIStubFunction::EncodePicture, NV_ENC_ERR_ENCODER_BUSY);
+    EXPECT_FALSE(m_encoder->EncodeFrame());
+    EXPECT_EQ(0u, m_encoder->GetCurrentFrameCount());
+
+    // The frame is lost but the following frames are still captured.
+    m_stub.InjectFailure(NvEncodeAPIStubFunction::LockBitstream, NV_ENC_ERR_GENERIC);
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_EQ(2u, m_encoder->GetCurrentFrameCount());
+    EXPECT_EQ(1u, m_captured.size());
+    EXPECT_EQ(m_stub.GetLockedBitstreamCount(), m_stub.GetUnlockedBitstreamCount());
+
+    // Frames which the device refuses to copy are not encoded.
+    std::vector<uint8_t> unregistered(m_pixels.size());
+    EXPECT_FALSE(m_encoder->CopyBuffer(unregistered.data()));
+    EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+}
+
+TEST_F(NvEncoderStubTest, SceneChangeForcesKeyFrame)
+{
+    const auto settings = std::make_shared<EncoderSettingsPublisher>();
+    EncoderSettings detection = settings->Get();
+    detection.sceneChangeDetection = true;
+    detection.maxQP = 40;
+    settings->Publish(detection);
+    m_encoder->SetSettings(settings);
+
+    for (int i = 0; i < 50; i++)
+    {
+        // A black scene, then a white one.
+        if (i == 10)
+            std::fill(m_pixels.begin(), m_pixels.end(), 0xff);
+        EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    ASSERT_EQ(50u, m_captured.size());
+    EXPECT_TRUE(m_captured[0].keyFrame);
+    // The CPU device compares the copied frames without a readback, so the key frame is the first frame of the
+    // new scene.
+    EXPECT_FALSE(m_captured[9].keyFrame);
+    EXPECT_TRUE(m_captured[10].keyFrame);
+    EXPECT_FALSE(m_captured[11].keyFrame);
+    // The cut replaces the IDR frame of every second.
+    EXPECT_FALSE(m_captured[30].keyFrame);
+    EXPECT_EQ(2, m_stub.GetIdrPictureCount());
+    // The settings, then the QP bounds which are widened after the cut and restored half a second later.
+    EXPECT_EQ(3, m_stub.GetReconfigureCount());
+}
+
+TEST_F(NvEncoderStubTest, SceneChangeFallsBackToPeriodicIdr)
+{
+    UnscalableGraphicsDevice device;
+    device.RegisterBuffer(m_pixels.data(), m_pixels.size());
+    m_encoder = std::make_unique<NvEncoderCuda>(width, height, &device);
+    m_encoder->InitV();
+    m_encoder->SetAsyncOutput(false);
+    m_encoder->CaptureFrame.connect(this, &StubNvEncoderTestBase::OnFrame);
+
+    const auto settings = std::make_shared<EncoderSettingsPublisher>();
+    EncoderSettings detection = settings->Get();
+    detection.sceneChangeDetection = true;
+    settings->Publish(detection);
+    m_encoder->SetSettings(settings);
+
+    for (int i = 0; i < 62; i++)
+    {
+        EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+        EXPECT_TRUE(m_encoder->EncodeFrame());
+    }
+    m_encoder.reset();
+    device.UnregisterBuffer(m_pixels.data());
+
+    // The detection fails with the first thumbnail, and the session is configured again with the IDR frame of
+    // every second.
+    ASSERT_EQ(62u, m_captured.size());
+    EXPECT_TRUE(m_captured[1].keyFrame);
+    EXPECT_FALSE(m_captured[30].keyFrame);
+    EXPECT_TRUE(m_captured[31].keyFrame);
+    EXPECT_TRUE(m_captured[61].keyFrame);
+    EXPECT_EQ(2, m_stub.GetReconfigureCount());
+}
+
+TEST_F(NvEncoderStubTest, ResizesInSameSession)
+{
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+
+    EXPECT_TRUE(m_encoder->Resize(32, 48));
+    std::vector<uint8_t> pixels(32 * 48 * 4);
+    m_device.RegisterBuffer(pixels.data(), pixels.size());
+    EXPECT_TRUE(m_encoder->CopyBuffer(pixels.data()));
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    m_device.UnregisterBuffer(pixels.data());
+    ASSERT_EQ(3u, m_captured.size());
+    EXPECT_EQ(32, m_captured[2].width);
+    EXPECT_EQ(48, m_captured[2].height);
+    // A new sequence starts at the new size.
+    EXPECT_TRUE(m_captured[2].keyFrame);
+    EXPECT_EQ(1, m_stub.GetOpenSessionCount());
+    EXPECT_EQ(1, m_stub.GetReconfigureCount());
+}
+
+TEST_F(NvEncoderStubTest, GrowsUpToMaxSize)
+{
+    m_encoder.reset();
+    CreateEncoder(bufferedFrameNum, width * 2, height * 2);
+    m_encoder->SetAsyncOutput(false);
+    EXPECT_FALSE(m_encoder->Resize(width * 2 + 2, height));
+    EXPECT_FALSE(m_encoder->Resize(width, height * 2 + 2));
+
+    EXPECT_TRUE(m_encoder->Resize(width * 2, height * 2));
+    std::vector<uint8_t> pixels(width * 2 * height * 2 * 4);
+    m_device.RegisterBuffer(pixels.data(), pixels.size());
+    EXPECT_TRUE(m_encoder->CopyBuffer(pixels.data()));
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    m_device.UnregisterBuffer(pixels.data());
+    ASSERT_EQ(1u, m_captured.size());
+    EXPECT_EQ(width * 2, m_captured[0].width);
+    EXPECT_EQ(height * 2, m_captured[0].height);
+    EXPECT_EQ(1, m_stub.GetOpenSessionCount());
+}
+
+TEST_F(NvEncoderStubTest, ResizeFailures)
+{
+    // Larger than the initial size, which is the maximum size by default.
+    EXPECT_FALSE(m_encoder->Resize(width * 2, height));
+    EXPECT_FALSE(m_encoder->Resize(width, height + 2));
+    EXPECT_FALSE(m_encoder->Resize(0, 64));
+
+    m_stub.InjectFailure(NvEncodeAPIStubFunction::ReconfigureEncoder, NV_ENC_ERR_INVALID_PARAM);
+    EXPECT_FALSE(m_encoder->Resize(32, 32));
+
+    // The encoder keeps its size.
+    EXPECT_TRUE(m_encoder->CopyBuffer(m_pixels.data()));
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    ASSERT_EQ(1u, m_captured.size());
+    EXPECT_EQ(width, m_captured[0].width);
+    EXPECT_EQ(height, m_captured[0].height);
+}
+
+// Measures how many frames per second the render thread can submit when the driver takes a while.
+TEST_F(NvEncoderStubTest, DISABLED_ThroughputBenchmark)
+{
+    const int frameCount = 300;
+    m_stub.SetEncodeLatency(std::chrono::milliseconds(1));
+    m_stub.SetLockLatency(std::chrono::milliseconds(4));
+    for (const bool asyncOutput : { false, true })
+    {
+        m_encoder->SetAsyncOutput(asyncOutput);
+        const size_t captured = GetCapturedCount();
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frameCount; i++)
+        {
+            m_encoder->CopyBuffer(m_pixels.data());
+            m_encoder->EncodeFrame();
+        }
+        WaitForCapturedCount(captured + frameCount);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%-12s %8.1f fps\n", asyncOutput ? "async" : "sync", frameCount / elapsed.count());
+    }
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,99 @@
+#pragma once
+#include "NvEncodeAPIStub.h"
+#include "../WebRTCPlugin/Codec/H264NalScanner.h"
+#include "../WebRTCPlugin/Codec/NvCodec/NvEncoderCuda.h"
+#include "../WebRTCPlugin/GraphicsDevice/CPU/CPUGraphicsDevice.h"
+#include "../WebRTCPlugin/DummyVideoEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Runs a CUDA NvEncoder against the stub of the driver, on the CPU graphics device.
+// The encoded frames are scanned as they are captured.
+class StubNvEncoderTestBase : public testing::Test, public sigslot::has_slots<>
+{
+protected:
+    struct CapturedFrame
+    {
+        std::thread::id thread;
+        std::chrono::steady_clock::time_point time;
+        int width = 0;
+        int height = 0;
+        size_t size = 0;
+        bool keyFrame = false;
+        int qp = -1;
+    };
+
+    void SetUp() override
+    {
+        NvEncoder::OverrideFunctionList(&m_stub.GetFunctionList());
+        m_pixels.resize(width * height * 4);
+        m_device.RegisterBuffer(m_pixels.data(), m_pixels.size());
+        CreateEncoder();
+    }
+
+    void TearDown() override
+    {
+        m_encoder.reset();
+        m_device.UnregisterBuffer(m_pixels.data());
+        NvEncoder::OverrideFunctionList(nullptr);
+    }
+
+    void CreateEncoder(uint32 bufferCount = bufferedFrameNum, int maxWidth = 0, int maxHeight = 0)
+    {
+        m_encoder = std::make_unique<NvEncoderCuda>(width, height, &m_device, bufferCount);
+        m_encoder->SetMaxSize(maxWidth, maxHeight);
+        m_encoder->InitV();
+        m_encoder->CaptureFrame.connect(this, &StubNvEncoderTestBase::OnFrame);
+    }
+
+    void OnFrame(const webrtc::VideoFrame& frame)
+    {
+        const auto buffer = static_cast<FrameBuffer*>(frame.video_frame_buffer().get())->buffer();
+        webrtc::RTPFragmentationHeader fragmentation;
+        CapturedFrame captured;
+        captured.thread = std::this_thread::get_id();
+        captured.time = std::chrono::steady_clock::now();
+        captured.width = frame.width();
+        captured.height = frame.height();
+        captured.size = buffer->size();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_scanner.Scan(buffer->data(), buffer->size(), &fragmentation))
+        {
+            captured.keyFrame = m_scanner.IsKeyFrame();
+            m_scanner.GetLastSliceQp(&captured.qp);
+        }
+        m_captured.push_back(captured);
+    }
+
+    size_t GetCapturedCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_captured.size();
+    }
+
+    void WaitForCapturedCount(size_t count)
+    {
+        while (GetCapturedCount() < count)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    const int width = 64;
+    const int height = 64;
+
+    std::mutex m_mutex;
+    H264NalScanner m_scanner;
+    std::vector<CapturedFrame> m_captured;
+
+    NvEncodeAPIStub m_stub;
+    CPUGraphicsDevice m_device;
+    std::vector<uint8_t> m_pixels;
+    std::unique_ptr<NvEncoder> m_encoder;
+};
+
+} // end namespace webrtc
+} // end namespace unity
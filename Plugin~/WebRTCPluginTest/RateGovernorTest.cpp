@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "../WebRTCPlugin/Codec/RateGovernor.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+TEST(RateGovernorTest, AppliesFirstRates)
+{
+    RateGovernor governor(0.1, 1000);
+    RateGovernor::Rates rates;
+    EXPECT_FALSE(governor.Poll(0, &rates));
+    governor.SetRates(1000000, 30);
+    ASSERT_TRUE(governor.Poll(0, &rates));
+    EXPECT_EQ(1000000u, rates.bitRate);
+    EXPECT_EQ(30u, rates.frameRate);
+    EXPECT_FALSE(governor.Poll(0, &rates));
+}
+
+TEST(RateGovernorTest, IgnoresChangesWithinThreshold)
+{
+    RateGovernor governor(0.1, 1000);
+    RateGovernor::Rates rates;
+    governor.SetRates(1000000, 30);
+    governor.Poll(0, &rates);
+    governor.SetRates(1090000, 30);
+    EXPECT_FALSE(governor.Poll(5000, &rates));
+    governor.SetRates(910000, 30);
+    EXPECT_FALSE(governor.Poll(5000, &rates));
+    EXPECT_EQ(3u, governor.GetRequestCount());
+    EXPECT_EQ(1u, governor.GetAppliedCount());
+}
+
+TEST(RateGovernorTest, LowersRightAwayAndRaisesAfterInterval)
+{
+    RateGovernor governor(0.1, 1000);
+    RateGovernor::Rates rates;
+    governor.SetRates(1000000, 30);
+    governor.Poll(0, &rates);
+
+    governor.SetRates(500000, 30);
+    ASSERT_TRUE(governor.Poll(100, &rates));
+    EXPECT_EQ(500000u, rates.bitRate);
+
+    // The last of the coalesced estimates is applied.
+    governor.SetRates(800000, 30);
+    governor.SetRates(900000, 30);
+    EXPECT_FALSE(governor.Poll(1000, &rates));
+    ASSERT_TRUE(governor.Poll(1100, &rates));
+    EXPECT_EQ(900000u, rates.bitRate);
+
+    governor.SetRates(900000, 15);
+    EXPECT_FALSE(governor.Poll(1500, &rates));
+    ASSERT_TRUE(governor.Poll(2100, &rates));
+    EXPECT_EQ(15u, rates.frameRate);
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "../WebRTCPlugin/Codec/SceneChangeDetector.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+class SceneChangeDetectorTest : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_plane.resize(stride * height);
+    }
+
+    void Fill(uint8_t value)
+    {
+        std::fill(m_plane.begin(), m_plane.end(), value);
+    }
+
+    bool Detect()
+    {
+        return m_detector.Detect(m_plane.data(), width, height, stride);
+    }
+
+    const int width = 320;
+    const int height = 180;
+    const int stride = 336;
+    std::vector<uint8_t> m_plane;
+    SceneChangeDetector m_detector;
+};
+
+TEST_F(SceneChangeDetectorTest, SumOfAbsoluteDifferencesMatchesScalar)
+{
+    // Sizes which leave a tail after the 16 byte blocks.
+    for (const size_t size : { 0, 1, 15, 16, 17, 100, 2304, 2311 })
+    {
+        std::vector<uint8_t> a(size);
+        std::vector<uint8_t> b(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            a[i] = static_cast<uint8_t>(i * 7);
+            b[i] = static_cast<uint8_t>(255 - i * 13);
+        }
+        EXPECT_EQ(SceneChangeDetector::SumOfAbsoluteDifferences(a.data(), b.data(), size, false),
+            SceneChangeDetector::SumOfAbsoluteDifferences(a.data(), b.data(), size, true));
+    }
+}
+
+TEST_F(SceneChangeDetectorTest, DetectsCut)
+{
+    Fill(16);
+    for (int i = 0; i < 5; i++)
+    {
+        EXPECT_FALSE(Detect());
+    }
+    Fill(235);
+    EXPECT_TRUE(Detect());
+    EXPECT_FLOAT_EQ(219.0f, m_detector.GetLastDifference());
+    EXPECT_FALSE(Detect());
+}
+
+TEST_F(SceneChangeDetectorTest, IgnoresStaticSceneAndNoise)
+{
+    for (int i = 0; i < 30; i++)
+    {
+        for (size_t j = 0; j < m_plane.size(); j++)
+        {
+            m_plane[j] = static_cast<uint8_t>(128 + (j * 31 + i * 17) % 9);
+        }
+        EXPECT_FALSE(Detect());
+    }
+}
+
+TEST_F(SceneChangeDetectorTest, IgnoresSteadyMotion)
+{
+    // A pan of a high contrast pattern, which differs a lot from one frame to the next.
+    for (int i = 0; i < 30; i++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                m_plane[y * stride + x] = ((x + i * 3) / 4 % 2) ? 200 : 40;
+            }
+        }
+        const bool cut = Detect();
+        // Only the start of the motion may look like a cut.
+        if (i > 1)
+        {
+            EXPECT_FALSE(cut);
+        }
+    }
+}
+
+TEST_F(SceneChangeDetectorTest, DetectsCutInBGRA)
+{
+    std::vector<uint8_t> pixels(width * height * 4, 0);
+    SceneChangeDetector detector;
+    EXPECT_FALSE(detector.DetectBGRA(pixels.data(), width, height, width * 4));
+    EXPECT_FALSE(detector.DetectBGRA(pixels.data(), width, height, width * 4));
+    std::fill(pixels.begin(), pixels.end(), 255);
+    EXPECT_TRUE(detector.DetectBGRA(pixels.data(), width, height, width * 4));
+    // Black and white have the luma of the I420 conversion.
+    EXPECT_FLOAT_EQ(219.0f, detector.GetLastDifference());
+}
+
+TEST_F(SceneChangeDetectorTest, ResetForgetsPreviousFrame)
+{
+    Fill(16);
+    Detect();
+    m_detector.Reset();
+    Fill(235);
+    EXPECT_FALSE(Detect());
+}
+
+} // end namespace webrtc
+} // end namespace unity
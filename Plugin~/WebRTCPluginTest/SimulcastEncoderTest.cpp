@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "../WebRTCPlugin/Codec/SimulcastEncoder.h"
+#include "../WebRTCPlugin/DummyVideoEncoder.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Captures a frame of its own size whose data is the layer number.
+class FakeLayerEncoder : public IEncoder
+{
+public:
+    FakeLayerEncoder(int width, int height, uint8 layer, bool canScale)
+        : m_width(width), m_height(height), m_data(webrtc::EncodedImageBuffer::Create(&layer, 1)), m_canScale(canScale)
+    {
+        m_initializationResult = CodecInitializationResult::Success;
+    }
+
+    void InitV() override {}
+    void SetRates(uint32_t bitRate, int64_t frameRate) override { m_bitRate = bitRate; }
+    void UpdateSettings() override {}
+    bool CopyBuffer(void* frame) override { m_copied++; return true; }
+    bool ScaleBuffer(void* frame) override { m_scaled++; return m_canScale; }
+    bool EncodeFrame() override
+    {
+        const rtc::scoped_refptr<FrameBuffer> buffer =
+            new rtc::RefCountedObject<FrameBuffer>(m_width, m_height, m_data, GetControl());
+        CaptureFrame(webrtc::VideoFrame::Builder().set_video_frame_buffer(buffer).build());
+        m_frameCount++;
+        return true;
+    }
+    bool IsSupported() const override { return true; }
+    void SetIdrFrame() override { m_idrRequested = true; }
+    uint64 GetCurrentFrameCount() const override { return m_frameCount; }
+
+    int m_copied = 0;
+    int m_scaled = 0;
+    uint32_t m_bitRate = 0;
+    bool m_idrRequested = false;
+
+private:
+    int m_width;
+    int m_height;
+    rtc::scoped_refptr<webrtc::EncodedImageBuffer> m_data;
+    bool m_canScale;
+    uint64 m_frameCount = 0;
+};
+
+class SimulcastEncoderTest : public testing::Test, public sigslot::has_slots<>
+{
+protected:
+    void Create(bool canScale)
+    {
+        std::vector<std::unique_ptr<IEncoder>> layers;
+        layers.push_back(std::make_unique<FakeLayerEncoder>(320, 180, 0, canScale));
+        layers.push_back(std::make_unique<FakeLayerEncoder>(640, 360, 1, canScale));
+        layers.push_back(std::make_unique<FakeLayerEncoder>(1280, 720, 2, canScale));
+        for (const auto& layer : layers)
+        {
+            m_layers.push_back(static_cast<FakeLayerEncoder*>(layer.get()));
+        }
+        m_encoder = std::make_unique<SimulcastEncoder>(std::move(layers), std::vector<bool>{ true, true, false });
+        m_encoder->InitV();
+        m_encoder->CaptureFrame.connect(this, &SimulcastEncoderTest::OnFrame);
+    }
+
+    void OnFrame(const webrtc::VideoFrame& frame)
+    {
+        m_frame = static_cast<FrameBuffer*>(frame.video_frame_buffer().get());
+    }
+
+    std::unique_ptr<SimulcastEncoder> m_encoder;
+    std::vector<FakeLayerEncoder*> m_layers;
+    rtc::scoped_refptr<FrameBuffer> m_frame;
+};
+
+TEST_F(SimulcastEncoderTest, EncodesEveryLayerFromOneFrame)
+{
+    Create(true);
+    EXPECT_EQ(CodecInitializationResult::Success, m_encoder->GetCodecInitializationResult());
+    EXPECT_EQ(3u, m_encoder->GetLayerCount());
+
+    EXPECT_TRUE(m_encoder->CopyBuffer(nullptr));
+    EXPECT_EQ(1, m_layers[0]->m_scaled);
+    EXPECT_EQ(1, m_layers[1]->m_scaled);
+    EXPECT_EQ(1, m_layers[2]->m_copied);
+    EXPECT_EQ(0, m_layers[2]->m_scaled);
+
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    ASSERT_NE(nullptr, m_frame);
+    EXPECT_EQ(1280, m_frame->width());
+    EXPECT_EQ(m_encoder->GetControl(), m_frame->encoderControl());
+    const auto& layers = m_frame->simulcastLayers();
+    ASSERT_EQ(3u, layers.size());
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+        ASSERT_NE(nullptr, layers[i]);
+        EXPECT_EQ(i, layers[i]->buffer()->data()[0]);
+        EXPECT_EQ(m_layers[i]->GetControl(), layers[i]->encoderControl());
+    }
+    EXPECT_EQ(320, layers[0]->width());
+    EXPECT_EQ(1u, m_encoder->GetCurrentFrameCount());
+}
+
+TEST_F(SimulcastEncoderTest, SkipsLayersWhichCanNotBeScaled)
+{
+    Create(false);
+    EXPECT_TRUE(m_encoder->CopyBuffer(nullptr));
+    EXPECT_TRUE(m_encoder->EncodeFrame());
+    ASSERT_NE(nullptr, m_frame);
+    const auto& layers = m_frame->simulcastLayers();
+    ASSERT_EQ(3u, layers.size());
+    EXPECT_EQ(nullptr, layers[0]);
+    EXPECT_EQ(nullptr, layers[1]);
+    EXPECT_NE(nullptr, layers[2]);
+}
+
+TEST_F(SimulcastEncoderTest, ControlsReachLayers)
+{
+    Create(true);
+    m_layers[0]->GetControl()->SetRates(100000, 30);
+    EXPECT_EQ(100000u, m_layers[0]->m_bitRate);
+
+    // Without simulcast only the full resolution is sent.
+    m_encoder->GetControl()->SetRates(2000000, 30);
+    EXPECT_EQ(2000000u, m_layers[2]->m_bitRate);
+    EXPECT_EQ(100000u, m_layers[0]->m_bitRate);
+
+    m_encoder->SetIdrFrame();
+    for (const auto layer : m_layers)
+    {
+        EXPECT_TRUE(layer->m_idrRequested);
+    }
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "../WebRTCPlugin/Codec/SoftwareCodec/SoftwareEncoder.h"
+#include "../WebRTCPlugin/GraphicsDevice/CPU/CPUGraphicsDevice.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+class SoftwareEncoderTest : public testing::Test, public sigslot::has_slots<>
+{
+protected:
+    void OnFrame(const webrtc::VideoFrame& frame)
+    {
+        m_frames.push_back(frame);
+    }
+
+    CPUGraphicsDevice m_device;
+    std::vector<webrtc::VideoFrame> m_frames;
+};
+
+TEST_F(SoftwareEncoderTest, Resize)
+{
+    SoftwareEncoder encoder(64, 64, &m_device);
+    encoder.InitV();
+    encoder.CaptureFrame.connect(this, &SoftwareEncoderTest::OnFrame);
+
+    std::vector<uint8_t> pixels(64 * 64 * 4);
+    m_device.RegisterBuffer(pixels.data(), pixels.size());
+    EXPECT_TRUE(encoder.CopyBuffer(pixels.data()));
+    EXPECT_TRUE(encoder.EncodeFrame());
+    m_device.UnregisterBuffer(pixels.data());
+
+    EXPECT_TRUE(encoder.Resize(32, 16));
+    EXPECT_FALSE(encoder.Resize(0, 16));
+    std::vector<uint8_t> resized(32 * 16 * 4);
+    m_device.RegisterBuffer(resized.data(), resized.size());
+    EXPECT_TRUE(encoder.CopyBuffer(resized.data()));
+    EXPECT_TRUE(encoder.EncodeFrame());
+    m_device.UnregisterBuffer(resized.data());
+
+    ASSERT_EQ(2u, m_frames.size());
+    EXPECT_EQ(64, m_frames[0].width());
+    EXPECT_EQ(32, m_frames[1].width());
+    EXPECT_EQ(16, m_frames[1].height());
+}
+
+TEST_F(SoftwareEncoderTest, AdaptsEachBuffer)
+{
+    SoftwareEncoder encoder(64, 64, &m_device, ColorConversionOptions(), 2);
+    encoder.InitV();
+    encoder.CaptureFrame.connect(this, &SoftwareEncoderTest::OnFrame);
+    std::vector<uint8_t> pixels(64 * 64 * 4);
+    m_device.RegisterBuffer(pixels.data(), pixels.size());
+
+    // The frame in the first buffer is scaled, the one in the second buffer is cropped.
+    FrameAdaptation scaled;
+    scaled.cropWidth = 64;
+    scaled.cropHeight = 64;
+    scaled.scaleWidth = 32;
+    scaled.scaleHeight = 32;
+    FrameAdaptation cropped;
+    cropped.cropX = 8;
+    cropped.cropWidth = 48;
+    cropped.cropHeight = 64;
+    cropped.scaleWidth = 48;
+    cropped.scaleHeight = 64;
+    encoder.SetAdaptation(0, scaled);
+    EXPECT_TRUE(encoder.CopyBufferAt(pixels.data(), 0));
+    encoder.SetAdaptation(1, cropped);
+    EXPECT_TRUE(encoder.CopyBufferAt(pixels.data(), 1));
+    // The buffers are encoded after both frames were copied.
+    EXPECT_TRUE(encoder.EncodeFrameAt(0));
+    EXPECT_TRUE(encoder.EncodeFrameAt(1));
+    encoder.SetAdaptation(0, FrameAdaptation());
+    EXPECT_TRUE(encoder.CopyBufferAt(pixels.data(), 0));
+    EXPECT_TRUE(encoder.EncodeFrameAt(0));
+    m_device.UnregisterBuffer(pixels.data());
+
+    ASSERT_EQ(3u, m_frames.size());
+    EXPECT_EQ(32, m_frames[0].width());
+    EXPECT_EQ(32, m_frames[0].height());
+    EXPECT_EQ(48, m_frames[1].width());
+    EXPECT_EQ(64, m_frames[1].height());
+    EXPECT_EQ(64, m_frames[2].width());
+}
+
+TEST_F(SoftwareEncoderTest, SkipsFramesWhichAreNotCopied)
+{
+    SoftwareEncoder encoder(64, 64, &m_device);
+    encoder.InitV();
+    std::vector<uint8_t> pixels(64 * 64 * 4);
+    EXPECT_FALSE(encoder.CopyBuffer(pixels.data()));
+    m_device.RegisterBuffer(pixels.data(), pixels.size());
+    EXPECT_TRUE(encoder.CopyBuffer(pixels.data()));
+    m_device.UnregisterBuffer(pixels.data());
+}
+
+} // end namespace webrtc
+} // end namespace unity
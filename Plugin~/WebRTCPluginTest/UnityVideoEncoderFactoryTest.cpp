@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "../WebRTCPlugin/UnityVideoEncoderFactory.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+// Records the settings which the encoder is initialized with.
+class FakeInternalEncoder : public webrtc::VideoEncoder
+{
+public:
+    explicit FakeInternalEncoder(int* numberOfCores) : m_numberOfCores(numberOfCores) {}
+
+    int InitEncode(const webrtc::VideoCodec* codec_settings, const Settings& settings) override
+    {
+        *m_numberOfCores = settings.number_of_cores;
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override { return WEBRTC_VIDEO_CODEC_OK; }
+    int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+    int32_t Encode(const webrtc::VideoFrame& frame, const std::vector<webrtc::VideoFrameType>* frame_types) override
+    {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+    void SetRates(const RateControlParameters& parameters) override {}
+
+private:
+    int* m_numberOfCores;
+};
+
+bool HasFormat(const std::vector<webrtc::SdpVideoFormat>& formats, const std::string& name)
+{
+    return std::any_of(formats.begin(), formats.end(),
+        [&](const webrtc::SdpVideoFormat& format) { return format.name == name; });
+}
+
+TEST(UnityVideoEncoderFactoryTest, HardwareEncoderSendsH264)
+{
+    UnityVideoEncoderFactory factory(UnityEncoderType::UnityEncoderHardware, []() { return 1; });
+    const auto formats = factory.GetSupportedFormats();
+    EXPECT_TRUE(HasFormat(formats, "H264"));
+    EXPECT_FALSE(HasFormat(formats, "VP8"));
+}
+
+TEST(UnityVideoEncoderFactoryTest, SoftwareEncoderSendsVpx)
+{
+    UnityVideoEncoderFactory factory(UnityEncoderType::UnityEncoderSoftware, []() { return 1; });
+    const auto formats = factory.GetSupportedFormats();
+    EXPECT_TRUE(HasFormat(formats, "VP8"));
+    EXPECT_TRUE(HasFormat(formats, "VP9"));
+
+    const auto encoder = factory.CreateVideoEncoder(webrtc::SdpVideoFormat("VP8"));
+    ASSERT_NE(nullptr, encoder);
+    EXPECT_EQ("libvpx", encoder->GetEncoderInfo().implementation_name);
+}
+
+TEST(UnityVideoEncoderFactoryTest, Vp9KeepsSimulcastStreams)
+{
+    UnityVideoEncoderFactory factory(UnityEncoderType::UnityEncoderSoftware, []() { return 1; });
+    const auto encoder = factory.CreateVideoEncoder(webrtc::SdpVideoFormat("VP9"));
+    ASSERT_NE(nullptr, encoder);
+
+    webrtc::VideoCodec codec;
+    codec.codecType = webrtc::kVideoCodecVP9;
+    *codec.VP9() = webrtc::VideoEncoder::GetDefaultVp9Settings();
+    codec.width = 320;
+    codec.height = 180;
+    codec.maxFramerate = 30;
+    codec.startBitrate = 300;
+    codec.minBitrate = 30;
+    codec.maxBitrate = 700;
+    codec.qpMax = 56;
+    codec.numberOfSimulcastStreams = 2;
+    for (int i = 0; i < 2; i++)
+    {
+        webrtc::SimulcastStream& stream = codec.simulcastStream[i];
+        stream.width = codec.width >> (1 - i);
+        stream.height = codec.height >> (1 - i);
+        stream.maxFramerate = 30;
+        stream.numberOfTemporalLayers = 1;
+        stream.minBitrate = 30;
+        stream.targetBitrate = 150 * (i + 1);
+        stream.maxBitrate = 200 * (i + 1);
+        stream.qpMax = 56;
+        stream.active = true;
+    }
+    const webrtc::VideoEncoder::Capabilities capabilities(false);
+    // VP9 encodes one stream, so an encoder is created for each simulcast stream.
+    EXPECT_EQ(WEBRTC_VIDEO_CODEC_OK, encoder->InitEncode(&codec, webrtc::VideoEncoder::Settings(capabilities, 4, 1200)));
+    EXPECT_EQ(WEBRTC_VIDEO_CODEC_OK, encoder->Release());
+}
+
+TEST(UnityVideoEncoderFactoryTest, LimitsNumberOfCores)
+{
+    int numberOfCores = 0;
+    const webrtc::VideoEncoder::Capabilities capabilities(false);
+    const webrtc::VideoCodec codec;
+
+    CoreLimitedVideoEncoder encoder(std::make_unique<FakeInternalEncoder>(&numberOfCores), 2);
+    encoder.InitEncode(&codec, webrtc::VideoEncoder::Settings(capabilities, 8, 1200));
+    EXPECT_EQ(2, numberOfCores);
+    encoder.InitEncode(&codec, webrtc::VideoEncoder::Settings(capabilities, 1, 1200));
+    EXPECT_EQ(1, numberOfCores);
+
+    // The encoder always gets at least one core.
+    CoreLimitedVideoEncoder noBudget(std::make_unique<FakeInternalEncoder>(&numberOfCores), 0);
+    noBudget.InitEncode(&codec, webrtc::VideoEncoder::Settings(capabilities, 8, 1200));
+    EXPECT_EQ(1, numberOfCores);
+}
+
+} // end namespace webrtc
+} // end namespace unity
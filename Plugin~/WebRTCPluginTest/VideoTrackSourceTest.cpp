@@ -1,4 +1,6 @@
 #include "pch.h"
+#include <chrono>
+#include <thread>
 #include "GraphicsDeviceTestBase.h"
 #include "../WebRTCPlugin/Codec/EncoderFactory.h"
 #include "../WebRTCPlugin/Codec/IEncoder.h"
@@ -35,6 +37,7 @@ public:
             /*is_screencast=*/ false,
             /*needs_denoising=*/ absl::nullopt);
         m_trackSource->AddOrUpdateSink(&mock_sink_, rtc::VideoSinkWants());
+        m_trackSource->SetFrameSize(width, height);
         m_trackSource->SetEncoder(encoder_.get());
 
         EXPECT_NE(nullptr, m_device);
@@ -44,6 +47,7 @@ public:
     }
     ~VideoTrackSourceTest() override
     {
+        m_trackSource->SetEncoder(nullptr);
         m_trackSource->RemoveSink(&mock_sink_);
     }
 protected:
@@ -66,6 +70,14 @@ protected:
     void SendTestFrame(int width, int height)
     {
         m_trackSource->OnFrameCaptured();
+
+        // Wait for the encoder thread of the track.
+        EncoderQueueStats stats;
+        while (m_trackSource->GetEncoderQueueStats(&stats) &&
+            stats.encodedFrames + stats.droppedFrames < stats.queuedFrames)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
     }
 };
 
@@ -95,6 +107,39 @@ TEST_P(VideoTrackSourceTest, SendTestFrame)
     }));
     SendTestFrame(width, height);
 }
+
+TEST_P(VideoTrackSourceTest, DropFrameBeforeCopy)
+{
+    rtc::VideoSinkWants wants;
+    wants.max_framerate_fps = 1;
+    m_trackSource->AddOrUpdateSink(&mock_sink_, wants);
+
+    EXPECT_CALL(mock_sink_, OnFrame(_)).Times(1);
+    const uint64 copied = encoder_->GetCurrentFrameCount();
+    SendTestFrame(width, height);
+    SendTestFrame(width, height);
+    EXPECT_EQ(1u, m_trackSource->GetAdaptationDroppedFrames());
+    EXPECT_EQ(copied + 1, encoder_->GetCurrentFrameCount());
+}
+
+TEST_P(VideoTrackSourceTest, ScaleDownRawFrame)
+{
+    // Hardware encoders deliver encoded frames, which keep the size of the texture.
+    if (m_encoderType != UnityEncoderType::UnityEncoderSoftware)
+        return;
+
+    rtc::VideoSinkWants wants;
+    wants.max_pixel_count = width * height / 4;
+    m_trackSource->AddOrUpdateSink(&mock_sink_, wants);
+
+    EXPECT_CALL(mock_sink_, OnFrame(_))
+        .WillOnce(Invoke([](const webrtc::VideoFrame& frame) {
+            EXPECT_GT(width, frame.width());
+            EXPECT_GT(height, frame.height());
+            EXPECT_GE(width * height / 4, frame.width() * frame.height());
+    }));
+    SendTestFrame(width, height);
+}
 #endif
 
 INSTANTIATE_TEST_CASE_P(
@@ -0,0 +1,68 @@
+#include "pch.h"
+#include "../WebRTCPlugin/WorkerPool.h"
+
+namespace unity
+{
+namespace webrtc
+{
+
+TEST(WorkerPoolTest, RunsEveryTaskOnce)
+{
+    for (const int threadCount : { 1, 2, 4, 8 })
+    {
+        WorkerPool pool(threadCount);
+        EXPECT_EQ(threadCount, pool.GetThreadCount());
+        for (const int count : { 0, 1, 3, 64 })
+        {
+            std::vector<std::atomic<int>> calls(count);
+            pool.ParallelFor(count, [&calls](int index) { calls[index]++; });
+            for (const auto& call : calls)
+            {
+                EXPECT_EQ(1, call);
+            }
+        }
+    }
+}
+
+TEST(WorkerPoolTest, SetThreadCount)
+{
+    WorkerPool pool(1);
+    pool.SetThreadCount(3);
+    EXPECT_EQ(3, pool.GetThreadCount());
+    std::atomic<int> sum(0);
+    pool.ParallelFor(100, [&sum](int index) { sum += index; });
+    EXPECT_EQ(4950, sum);
+    pool.SetThreadCount(1);
+    EXPECT_EQ(1, pool.GetThreadCount());
+}
+
+TEST(WorkerPoolTest, CallsFromSeveralThreadsOverlap)
+{
+    WorkerPool pool(2);
+    std::atomic<bool> secondCallDone(false);
+    // A task of the first call waits for the second call, which could not start while the first one runs if the
+    // calls were serialized.
+    std::thread first([&pool, &secondCallDone]()
+    {
+        pool.ParallelFor(4, [&secondCallDone](int index)
+        {
+            while (index == 0 && !secondCallDone)
+            {
+                std::this_thread::yield();
+            }
+        });
+    });
+    std::atomic<int> sum(0);
+    pool.ParallelFor(8, [&sum](int index) { sum += index; });
+    secondCallDone = true;
+    first.join();
+    EXPECT_EQ(28, sum);
+}
+
+TEST(WorkerPoolTest, DefaultThreadCountIsPositive)
+{
+    EXPECT_LE(1, WorkerPool::GetDefaultThreadCount());
+}
+
+} // end namespace webrtc
+} // end namespace unity
@@ -151,6 +151,16 @@ namespace Unity.WebRTC
             NativeMethods.ContextDeleteMediaStreamTrack(self, track);
         }
 
+        public bool RegisterVideoFrameBuffer(IntPtr track, int size)
+        {
+            return NativeMethods.ContextRegisterVideoFrameBuffer(self, track, size);
+        }
+
+        public void UnregisterVideoFrameBuffer(IntPtr track)
+        {
+            NativeMethods.ContextUnregisterVideoFrameBuffer(self, track);
+        }
+
         public void DeleteStatsReport(IntPtr report)
         {
             NativeMethods.ContextDeleteStatsReport(self, report);
@@ -161,6 +171,82 @@ namespace Unity.WebRTC
             NativeMethods.ContextSetVideoEncoderParameter(self, track, width, height);
         }
 
+        /// <summary>
+        /// Sets the largest size which the hardware encoder of the track can be resized to without a new session.
+        /// The session allocates its buffers for this size, so 0 keeps the initial size as the maximum.
+        /// Call this after SetVideoEncoderParameter and before the encoder is initialized.
+        /// </summary>
+        public bool SetVideoEncoderMaxSize(IntPtr track, int maxWidth, int maxHeight)
+        {
+            return NativeMethods.ContextSetVideoEncoderMaxSize(self, track, maxWidth, maxHeight);
+        }
+
+        public bool SetSenderHardwareParameters(IntPtr sender, IntPtr parameters)
+        {
+            return NativeMethods.SenderSetHardwareParameters(self, sender, parameters);
+        }
+
+        public void SetChromaSubsampling(ChromaSubsampling chromaSubsampling)
+        {
+            NativeMethods.ContextSetChromaSubsampling(self, chromaSubsampling);
+        }
+
+        /// <summary>
+        /// The number of threads converting a frame for the software encoder, including the render thread.
+        /// </summary>
+        public int ConversionThreadCount
+        {
+            get { return NativeMethods.ContextGetConversionThreadCount(self); }
+            set { NativeMethods.ContextSetConversionThreadCount(self, value); }
+        }
+
+        /// <summary>
+        /// Applied to the encoders initialized after the call.
+        /// </summary>
+        public void SetEncoderQueuePolicy(EncoderQueuePolicy policy)
+        {
+            NativeMethods.ContextSetEncoderQueuePolicy(self, policy);
+        }
+
+        public bool GetEncoderQueueStats(IntPtr track, out EncoderQueueStats stats)
+        {
+            return NativeMethods.ContextGetEncoderQueueStats(self, track, out stats);
+        }
+
+        /// <summary>
+        /// Sets the divisor of the size for each simulcast layer, in the order of the send encodings
+        /// from the lowest resolution. Call this after SetVideoEncoderParameter and before the encoder is initialized.
+        /// </summary>
+        public bool SetVideoEncoderSimulcastLayers(IntPtr track, float[] scaleResolutionDownBy)
+        {
+            return NativeMethods.ContextSetVideoEncoderSimulcastLayers(
+                self, track, scaleResolutionDownBy, scaleResolutionDownBy?.Length ?? 0);
+        }
+
+        /// <summary>
+        /// The number of cores each VP8, VP9 or AV1 encoder of the software encoder may use, applied to the
+        /// encoders created afterwards. 0 leaves the cores which do not convert frames to the encoders.
+        /// </summary>
+        public int VideoEncoderCoreCount
+        {
+            get { return NativeMethods.ContextGetVideoEncoderCoreCount(self); }
+            set { NativeMethods.ContextSetVideoEncoderCoreCount(self, value); }
+        }
+
+        /// <summary>
+        /// Sets the depth of the ring of frames held by the encoder of the track, from 1 to 8.
+        /// Call this after SetVideoEncoderParameter and before the encoder is initialized.
+        /// </summary>
+        public bool SetVideoEncoderBufferCount(IntPtr track, int bufferCount)
+        {
+            return NativeMethods.ContextSetVideoEncoderBufferCount(self, track, bufferCount);
+        }
+
+        public bool GetEncoderBitrateStats(IntPtr track, out EncoderBitrateStats stats)
+        {
+            return NativeMethods.ContextGetEncoderBitrateStats(self, track, out stats);
+        }
+
         public CodecInitializationResult GetInitializationResult(IntPtr track)
         {
             return NativeMethods.GetInitializationResult(self, track);
@@ -178,6 +264,12 @@ namespace Unity.WebRTC
             VideoEncoderMethods.FinalizeEncoder(renderFunction, track);
         }
 
+        internal void EvictEncoders()
+        {
+            renderFunction = renderFunction == IntPtr.Zero ? GetRenderEventFunc() : renderFunction;
+            VideoEncoderMethods.EvictEncoders(renderFunction);
+        }
+
         internal void Encode(IntPtr track)
         {
             renderFunction = renderFunction == IntPtr.Zero ? GetRenderEventFunc() : renderFunction;
@@ -175,6 +175,26 @@ namespace Unity.WebRTC
             tracks.Add(this);
         }
 
+        /// <summary>
+        /// With the null renderer, which is used in batch mode, the pointer which the track was created with
+        /// points to BGRA32 pixels in system memory. The frames are read from these pixels only once the buffer
+        /// is registered, until it is unregistered or the track is disposed.
+        /// </summary>
+        /// <param name="size">The size of the buffer in bytes, at least width * height * 4.</param>
+        /// <returns>false when the track has no buffer.</returns>
+        public bool RegisterFrameBuffer(int size)
+        {
+            return WebRTC.Context.RegisterVideoFrameBuffer(self, size);
+        }
+
+        /// <summary>
+        /// Stops reading the buffer registered with RegisterFrameBuffer, so that it can be released.
+        /// </summary>
+        public void UnregisterFrameBuffer()
+        {
+            WebRTC.Context.UnregisterVideoFrameBuffer(self);
+        }
+
         public override void Dispose()
         {
             if (this.disposed)
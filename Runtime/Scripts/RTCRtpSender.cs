@@ -49,11 +49,44 @@ namespace Unity.WebRTC
 
             return error;
         }
-        public void SetHardwareParameters(RTCRtpEncodingParametersInternal parameters)
+        /// <summary>
+        /// Applies the parameters to the hardware encoder of the track of this sender.
+        /// </summary>
+        public bool SetHardwareParameters(RTCRtpEncodingParametersInternal parameters)
         {
             IntPtr ptr = Marshal.AllocCoTaskMem(Marshal.SizeOf(parameters));
             Marshal.StructureToPtr(parameters, ptr, false);
-            NativeMethods.SetHardwareParameters(ptr);
+            bool result = WebRTC.Context.SetSenderHardwareParameters(self, ptr);
+            Marshal.FreeCoTaskMem(ptr);
+            return result;
+        }
+
+        /// <summary>
+        /// Returns false when the track of this sender is not encoded on an encoder thread.
+        /// </summary>
+        public bool GetEncoderQueueStats(out EncoderQueueStats stats)
+        {
+            IntPtr track = NativeMethods.SenderGetTrack(self);
+            if (track == IntPtr.Zero)
+            {
+                stats = default(EncoderQueueStats);
+                return false;
+            }
+            return WebRTC.Context.GetEncoderQueueStats(track, out stats);
+        }
+
+        /// <summary>
+        /// Returns false when the track of this sender has no encoder.
+        /// </summary>
+        public bool GetEncoderBitrateStats(out EncoderBitrateStats stats)
+        {
+            IntPtr track = NativeMethods.SenderGetTrack(self);
+            if (track == IntPtr.Zero)
+            {
+                stats = default(EncoderBitrateStats);
+                return false;
+            }
+            return WebRTC.Context.GetEncoderBitrateStats(track, out stats);
         }
     }
 }
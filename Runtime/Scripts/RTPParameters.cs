@@ -26,6 +26,7 @@ namespace Unity.WebRTC
         public bool enableAQ;
         public uint? maxNumRefFrames;
         public bool infiniteGOP;
+        public bool sceneChangeDetection;
         public double? scaleResolutionDownBy;
         public string rid;
 
@@ -68,6 +69,8 @@ namespace Unity.WebRTC
                maxNumRefFrames = parameter.maxNumRefFrames;
             if (parameter.hasValueInfiniteGOP)
                infiniteGOP = parameter.infiniteGOP;
+            if (parameter.hasValueSceneChangeDetection)
+               sceneChangeDetection = parameter.sceneChangeDetection;
 
                
             if (parameter.hasValueScaleResolutionDownBy)
@@ -138,6 +141,7 @@ namespace Unity.WebRTC
                instance.maxNumRefFrames = maxNumRefFrames.Value;
                 
             instance.infiniteGOP = infiniteGOP;
+            instance.sceneChangeDetection = sceneChangeDetection;
 
             instance.rid = string.IsNullOrEmpty(rid) ? IntPtr.Zero : Marshal.StringToCoTaskMemAnsi(rid);
         }
@@ -258,6 +262,11 @@ namespace Unity.WebRTC
         [MarshalAs(UnmanagedType.U1)]
         public bool infiniteGOP;
 
+        [MarshalAs(UnmanagedType.U1)]
+        public bool hasValueSceneChangeDetection;
+        [MarshalAs(UnmanagedType.U1)]
+        public bool sceneChangeDetection;
+
         [MarshalAs(UnmanagedType.U1)]
         public bool hasValueScaleResolutionDownBy;
         public double scaleResolutionDownBy;
@@ -16,6 +16,55 @@ namespace Unity.WebRTC
         Hardware = 1
     }
 
+    /// <summary>
+    /// How the chroma of two by two pixels is sampled when the frames are converted to I420 on the CPU.
+    /// </summary>
+    public enum ChromaSubsampling
+    {
+        // The top left pixel, which is the fastest.
+        TopLeft = 0,
+        // The average of the four pixels, which avoids aliasing in the colors.
+        Box = 1
+    }
+
+    /// <summary>
+    /// What the render thread does when every buffer of the hardware encoder holds a frame to encode.
+    /// </summary>
+    public enum EncoderQueuePolicy
+    {
+        // Reuses the buffer of the oldest queued frame, so the render thread never waits.
+        DropOldest = 0,
+        // Waits until the encoder thread finishes a frame.
+        Block = 1
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EncoderQueueStats
+    {
+        public uint depth;
+        public uint maxDepth;
+        public ulong queuedFrames;
+        public ulong droppedFrames;
+        public ulong encodedFrames;
+    }
+
+    /// <summary>
+    /// The bitrates of the frames which the encoder of a track sent, summed over the simulcast streams.
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EncoderBitrateStats
+    {
+        // Set by the congestion controller.
+        public uint targetBitrate;
+        // Set to the encoder, so that the frames it encodes reach the target.
+        public uint adjustedBitrate;
+        // Measured over the frames of the last seconds, 0 until enough frames were sent.
+        public uint encodedBitrate;
+        // encodedBitrate / targetBitrate - 1, negative when the encoder undershoots.
+        public float overshoot;
+        public ulong frameCount;
+    }
+
     public struct RTCIceCandidate
     {
         [MarshalAs(UnmanagedType.LPStr)]
@@ -236,6 +285,8 @@ namespace Unity.WebRTC
 #endif
         private static Context s_context;
         private static SynchronizationContext s_syncContext;
+        // Seconds between the events which release the expired encoders.
+        private const float EvictInterval = 1.0f;
         internal static Material flipMat;
 
 
@@ -282,6 +333,7 @@ namespace Unity.WebRTC
         }
         public static IEnumerator Update()
         {
+            float lastEvictTime = Time.realtimeSinceStartup;
             while (true)
             {
                 // Wait until all frame rendering is done
@@ -295,6 +347,13 @@ namespace Unity.WebRTC
                         }
                     }
                 }
+                // The idle encoders of the finalized tracks, and the graphics device they use,
+                // are released once their time to live elapses, even when no track is left.
+                if (s_context != null && Time.realtimeSinceStartup - lastEvictTime >= EvictInterval)
+                {
+                    lastEvictTime = Time.realtimeSinceStartup;
+                    s_context.EvictEncoders();
+                }
             }
         }
 
@@ -518,10 +577,42 @@ namespace Unity.WebRTC
         [DllImport(WebRTC.Lib)]
         public static extern void ContextDeleteMediaStreamTrack(IntPtr context, IntPtr track);
         [DllImport(WebRTC.Lib)]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ContextRegisterVideoFrameBuffer(IntPtr context, IntPtr track, int size);
+        [DllImport(WebRTC.Lib)]
+        public static extern void ContextUnregisterVideoFrameBuffer(IntPtr context, IntPtr track);
+        [DllImport(WebRTC.Lib)]
         public static extern void ContextDeleteStatsReport(IntPtr context, IntPtr report);
         [DllImport(WebRTC.Lib)]
         public static extern void ContextSetVideoEncoderParameter(IntPtr context, IntPtr track, int width, int height);
         [DllImport(WebRTC.Lib)]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ContextSetVideoEncoderMaxSize(IntPtr context, IntPtr track, int maxWidth, int maxHeight);
+        [DllImport(WebRTC.Lib)]
+        public static extern void ContextSetChromaSubsampling(IntPtr context, ChromaSubsampling chromaSubsampling);
+        [DllImport(WebRTC.Lib)]
+        public static extern void ContextSetConversionThreadCount(IntPtr context, int threadCount);
+        [DllImport(WebRTC.Lib)]
+        public static extern int ContextGetConversionThreadCount(IntPtr context);
+        [DllImport(WebRTC.Lib)]
+        public static extern void ContextSetEncoderQueuePolicy(IntPtr context, EncoderQueuePolicy policy);
+        [DllImport(WebRTC.Lib)]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ContextGetEncoderQueueStats(IntPtr context, IntPtr track, out EncoderQueueStats stats);
+        [DllImport(WebRTC.Lib)]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ContextSetVideoEncoderSimulcastLayers(IntPtr context, IntPtr track, float[] scaleResolutionDownBy, int layerCount);
+        [DllImport(WebRTC.Lib)]
+        public static extern void ContextSetVideoEncoderCoreCount(IntPtr context, int coreCount);
+        [DllImport(WebRTC.Lib)]
+        public static extern int ContextGetVideoEncoderCoreCount(IntPtr context);
+        [DllImport(WebRTC.Lib)]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ContextSetVideoEncoderBufferCount(IntPtr context, IntPtr track, int bufferCount);
+        [DllImport(WebRTC.Lib)]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ContextGetEncoderBitrateStats(IntPtr context, IntPtr track, out EncoderBitrateStats stats);
+        [DllImport(WebRTC.Lib)]
         public static extern CodecInitializationResult GetInitializationResult(IntPtr context, IntPtr track);
         [DllImport(WebRTC.Lib)]
         public static extern IntPtr PeerConnectionGetConfiguration(IntPtr ptr);
@@ -617,6 +708,9 @@ namespace Unity.WebRTC
         [DllImport(WebRTC.Lib)]
         public static extern void SetHardwareParameters(IntPtr parameters);
         [DllImport(WebRTC.Lib)]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool SenderSetHardwareParameters(IntPtr context, IntPtr sender, IntPtr parameters);
+        [DllImport(WebRTC.Lib)]
         public static extern int DataChannelGetID(IntPtr ptr);
         [DllImport(WebRTC.Lib)]
         public static extern IntPtr DataChannelGetLabel(IntPtr ptr);
@@ -736,6 +830,7 @@ namespace Unity.WebRTC
             Initialize = 0,
             Encode = 1,
             Finalize = 2,
+            Evict = 3,
         }
 
         public static void InitializeEncoder(IntPtr callback, IntPtr track)
@@ -757,6 +852,12 @@ namespace Unity.WebRTC
             Graphics.ExecuteCommandBuffer(_command);
             _command.Clear();
         }
+        public static void EvictEncoders(IntPtr callback)
+        {
+            _command.IssuePluginEventAndData(callback, (int)VideoStreamRenderEventId.Evict, IntPtr.Zero);
+            Graphics.ExecuteCommandBuffer(_command);
+            _command.Clear();
+        }
     }
 }
 
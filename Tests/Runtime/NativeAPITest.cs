@@ -153,6 +153,22 @@ namespace Unity.WebRTC.RuntimeTest
             UnityEngine.Object.DestroyImmediate(renderTexture);
         }
 
+        [Test]
+        public void RegisterAndUnregisterVideoFrameBuffer()
+        {
+            var context = NativeMethods.ContextCreate(0, encoderType);
+            const int width = 256;
+            const int height = 256;
+            var pixels = Marshal.AllocHGlobal(width * height * 4);
+            var track = NativeMethods.ContextCreateVideoTrack(context, "video", pixels);
+            Assert.IsFalse(NativeMethods.ContextRegisterVideoFrameBuffer(context, track, 0));
+            Assert.IsTrue(NativeMethods.ContextRegisterVideoFrameBuffer(context, track, width * height * 4));
+            NativeMethods.ContextUnregisterVideoFrameBuffer(context, track);
+            NativeMethods.ContextDeleteMediaStreamTrack(context, track);
+            NativeMethods.ContextDestroy(0);
+            Marshal.FreeHGlobal(pixels);
+        }
+
         [Test]
         public void AddAndRemoveVideoTrackToPeerConnection()
         {